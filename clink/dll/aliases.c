@@ -0,0 +1,323 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "aliases.h"
+#include "shared/str_builder.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+int                     get_clink_setting_int(const char*);
+
+static alias_table_t    g_alias_cache;
+static int              g_alias_cache_init      = 0;
+static int              g_alias_cache_dirty     = 1;
+static int              g_alias_cache_bytes     = -1;
+static int              g_alias_generation      = 0;
+
+//------------------------------------------------------------------------------
+static void fold_key(char* key)
+{
+    // Aliases are indexed case-insensitively, and with '-' and '_' the same so
+    // the index can also narrow down matches when -/_ case mapping is enabled.
+    // Only ASCII is folded. Keys are not unique ("a-b" and "a_b" share one) so
+    // exact lookups must still compare names.
+
+    for (; *key; ++key)
+    {
+        char c = *key;
+        if (c == '-')
+        {
+            *key = '_';
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            *key = c - 'A' + 'a';
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static int compare_aliases(const void* lhs, const void* rhs)
+{
+    const alias_t* l = (const alias_t*)lhs;
+    const alias_t* r = (const alias_t*)rhs;
+    int order;
+
+    // Names that fold to the same key are kept in a stable order.
+    order = strcmp(l->key, r->key);
+    return order ? order : strcmp(l->name_utf8, r->name_utf8);
+}
+
+//------------------------------------------------------------------------------
+void alias_table_init(alias_table_t* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+//------------------------------------------------------------------------------
+void alias_table_free(alias_table_t* table)
+{
+    free(table->buffer);
+    free(table->utf8);
+    free(table->aliases);
+    alias_table_init(table);
+}
+
+//------------------------------------------------------------------------------
+int alias_table_parse(alias_table_t* table, const wchar_t* buffer, int chars)
+{
+    // 'buffer' is as GetConsoleAliasesW() fills it; a run of "name=text\0"
+    // strings. Returns the number of aliases found.
+
+    wchar_t* read;
+    wchar_t* end;
+    char* utf8;
+    int utf8_size;
+    int count;
+
+    alias_table_free(table);
+
+    table->buffer = malloc((chars + 1) * sizeof(wchar_t));
+    memcpy(table->buffer, buffer, chars * sizeof(wchar_t));
+    table->buffer[chars] = '\0';
+    end = table->buffer + chars;
+
+    // Count the aliases and how much utf-8 their names need (twice; once for
+    // the name and once for its key).
+    count = 0;
+    utf8_size = 0;
+    for (read = table->buffer; read < end && *read; read += wcslen(read) + 1)
+    {
+        wchar_t* eq = wcschr(read, '=');
+        if (eq == NULL || eq == read)
+        {
+            continue;
+        }
+
+        utf8_size += WideCharToMultiByte(CP_UTF8, 0, read, (int)(eq - read),
+            NULL, 0, NULL, NULL) + 1;
+        ++count;
+    }
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    table->aliases = malloc(count * sizeof(alias_t));
+    table->utf8 = malloc(utf8_size * 2);
+    utf8_size *= 2;
+
+    // Split the strings and convert the names.
+    utf8 = table->utf8;
+    count = 0;
+    for (read = table->buffer; read < end && *read;)
+    {
+        alias_t* alias;
+        wchar_t* next;
+        wchar_t* eq;
+        int n;
+
+        next = read + wcslen(read) + 1;
+
+        eq = wcschr(read, '=');
+        if (eq == NULL || eq == read)
+        {
+            read = next;
+            continue;
+        }
+
+        *eq = '\0';
+
+        alias = table->aliases + count;
+        alias->name = read;
+        alias->text = eq + 1;
+
+        n = WideCharToMultiByte(CP_UTF8, 0, read, -1, utf8, utf8_size, NULL,
+            NULL);
+
+        alias->name_utf8 = utf8;
+        alias->key = utf8 + n;
+        memcpy(utf8 + n, utf8, n);
+        fold_key(utf8 + n);
+
+        utf8 += n * 2;
+        utf8_size -= n * 2;
+        read = next;
+        ++count;
+    }
+
+    table->count = count;
+    qsort(table->aliases, count, sizeof(alias_t), compare_aliases);
+    return count;
+}
+
+//------------------------------------------------------------------------------
+static int lower_bound(const alias_table_t* table, const char* key, int n)
+{
+    // Index of the first alias whose key's first 'n' characters aren't less
+    // than 'key'.
+
+    int lo = 0;
+    int hi = table->count;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (strncmp(table->aliases[mid].key, key, n) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+//------------------------------------------------------------------------------
+const alias_t* alias_table_find(const alias_table_t* table, const char* name)
+{
+    str_builder_t key;
+    const alias_t* found;
+    int i;
+
+    str_builder_init(&key);
+    str_builder_append(&key, name);
+    fold_key(key.data);
+
+    // Find the run of aliases sharing the folded key then pick the one whose
+    // name matches; cmd.exe resolves aliases ignoring case but not -/_.
+    found = NULL;
+    i = lower_bound(table, key.data, key.length + 1);
+    for (; i < table->count; ++i)
+    {
+        const alias_t* alias = table->aliases + i;
+        if (strcmp(alias->key, key.data) != 0)
+        {
+            break;
+        }
+
+        if (_stricmp(alias->name_utf8, name) == 0)
+        {
+            found = alias;
+            break;
+        }
+    }
+
+    str_builder_free(&key);
+    return found;
+}
+
+//------------------------------------------------------------------------------
+int alias_table_prefix(const alias_table_t* table, const char* prefix, int* first)
+{
+    // Finds the run of aliases whose names start with 'prefix' (with case and
+    // -/_ folded). Returns how many there are, the first being at '*first'.
+
+    str_builder_t key;
+    int i;
+    int j;
+
+    str_builder_init(&key);
+    str_builder_append(&key, prefix);
+    fold_key(key.data);
+
+    i = lower_bound(table, key.data, key.length);
+    for (j = i; j < table->count; ++j)
+    {
+        if (strncmp(table->aliases[j].key, key.data, key.length) != 0)
+        {
+            break;
+        }
+    }
+
+    str_builder_free(&key);
+
+    *first = i;
+    return j - i;
+}
+
+//------------------------------------------------------------------------------
+void invalidate_alias_cache()
+{
+    g_alias_cache_dirty = 1;
+}
+
+//------------------------------------------------------------------------------
+const alias_table_t* get_alias_cache(int* generation)
+{
+    // Console aliases are only read when they could have changed; after a
+    // doskey command has run or if the size of the console's aliases has
+    // changed (which catches most changes made without Clink seeing them).
+    // Setting 'alias_cache' to 0 reads them every time.
+
+    wchar_t exe_path[MAX_PATH];
+    wchar_t* exe;
+    int bytes;
+
+    if (!g_alias_cache_init)
+    {
+        alias_table_init(&g_alias_cache);
+        g_alias_cache_init = 1;
+    }
+
+#if !defined(__MINGW32__) && !defined(__MINGW64__)
+    GetModuleFileNameW(NULL, exe_path, sizeof_array(exe_path));
+    exe = wcsrchr(exe_path, L'\\');
+    exe = (exe != NULL) ? (exe + 1) : exe_path;
+
+    bytes = GetConsoleAliasesLengthW(exe);
+    if (g_alias_cache_dirty ||
+        bytes != g_alias_cache_bytes ||
+        !get_clink_setting_int("alias_cache"))
+    {
+        wchar_t* buffer;
+        int chars;
+
+        chars = 0;
+        buffer = malloc(bytes + sizeof(wchar_t));
+        if (bytes > 0 && GetConsoleAliasesW(buffer, bytes, exe))
+        {
+            chars = bytes / sizeof(wchar_t);
+        }
+
+        alias_table_parse(&g_alias_cache, buffer, chars);
+        free(buffer);
+
+        g_alias_cache_bytes = bytes;
+        g_alias_cache_dirty = 0;
+        ++g_alias_generation;
+    }
+#endif // !__MINGW32__ && !__MINGW64__
+
+    if (generation != NULL)
+    {
+        *generation = g_alias_generation;
+    }
+
+    return &g_alias_cache;
+}
+
+// vim: expandtab
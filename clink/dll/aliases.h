@@ -0,0 +1,54 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ALIASES_H
+#define ALIASES_H
+
+//------------------------------------------------------------------------------
+typedef struct
+{
+    const wchar_t*  name;
+    const wchar_t*  text;
+    const char*     name_utf8;
+    const char*     key;            // folded utf-8 name the table's sorted by
+} alias_t;
+
+typedef struct
+{
+    wchar_t*        buffer;
+    char*           utf8;
+    alias_t*        aliases;
+    int             count;
+} alias_table_t;
+
+//------------------------------------------------------------------------------
+void                    alias_table_init(alias_table_t* table);
+void                    alias_table_free(alias_table_t* table);
+int                     alias_table_parse(alias_table_t* table, const wchar_t* buffer, int chars);
+const alias_t*          alias_table_find(const alias_table_t* table, const char* name);
+int                     alias_table_prefix(const alias_table_t* table, const char* prefix, int* first);
+
+const alias_table_t*    get_alias_cache(int* generation);
+void                    invalidate_alias_cache();
+
+#endif // ALIASES_H
+
+// vim: expandtab
@@ -20,6 +20,380 @@
  */
 
 #include "pch.h"
+#include "ansi.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+// Classes of character that drive the escape sequence state machine.
+enum
+{
+    CLASS_TEXT,
+    CLASS_CTRL,         // C0 controls other than those below
+    CLASS_ESC,          // 0x1b
+    CLASS_BEL,          // 0x07 (terminates OSC)
+    CLASS_C1_CSI,       // 0x9b
+    CLASS_C1_OSC,       // 0x9d, and DCS 0x90 which is treated the same
+    CLASS_C1_ST,        // 0x9c
+    CLASS_DIGIT,        // 0-9
+    CLASS_SEP,          // ; :
+    CLASS_PRIVATE,      // < = > ?
+    CLASS_INTER,        // 0x20-0x2f
+    CLASS_CSI_INTRO,    // [
+    CLASS_OSC_INTRO,    // ] P
+    CLASS_BACKSLASH,    // \ (ESC \ is ST)
+    CLASS_FINAL,        // the rest of 0x40-0x7e
+    CLASS_COUNT,
+};
+
+//------------------------------------------------------------------------------
+// States, followed by outcomes that end a sequence.
+enum
+{
+    STATE_TEXT,
+    STATE_ESC,
+    STATE_CSI,
+    STATE_CSI_INTER,
+    STATE_OSC,
+    STATE_OSC_ESC,
+    STATE_COUNT,
+
+    END_NOT_CODE = STATE_COUNT, // lone ESC, which is just text
+    END_CUT,                    // sequence ends before the current character
+    END_CSI,                    // current character is CSI's final byte
+    END_OSC,                    // current character terminates OSC
+};
+
+//------------------------------------------------------------------------------
+#define T   STATE_TEXT
+#define E   STATE_ESC
+#define C   STATE_CSI
+#define I   STATE_CSI_INTER
+#define O   STATE_OSC
+#define OE  STATE_OSC_ESC
+#define NC  END_NOT_CODE
+#define X   END_CUT
+#define EC  END_CSI
+#define EO  END_OSC
+
+static const unsigned char g_transitions[STATE_COUNT][CLASS_COUNT] = {
+//       txt ctl esc bel csi osc st  dig sep prv int [   ]P  \   fin
+/* T  */ { T,  T,  E,  T,  C,  O,  T,  T,  T,  T,  T,  T,  T,  T,  T  },
+/* E  */ { NC, NC, NC, NC, NC, NC, NC, NC, NC, NC, NC, C,  O,  NC, NC },
+/* C  */ { X,  X,  X,  X,  X,  X,  X,  C,  C,  C,  I,  EC, EC, EC, EC },
+/* I  */ { X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  I,  EC, EC, EC, EC },
+/* O  */ { O,  O,  OE, EO, O,  O,  EO, O,  O,  O,  O,  O,  O,  O,  O  },
+/* OE */ { O,  O,  OE, EO, O,  O,  EO, O,  O,  O,  O,  O,  O,  EO, O  },
+};
+
+#undef T
+#undef E
+#undef C
+#undef I
+#undef O
+#undef OE
+#undef NC
+#undef X
+#undef EC
+#undef EO
+
+//------------------------------------------------------------------------------
+static unsigned char    g_ascii_classes[0x80];
+
+//------------------------------------------------------------------------------
+// What each SGR parameter does to the console's attributes.
+enum
+{
+    SGR_NONE,
+    SGR_SET,            // attr = (attr & ~clear) | set
+    SGR_RESET,
+    SGR_DEFAULT_FG,
+    SGR_DEFAULT_BG,
+    SGR_EXTENDED_FG,    // 38;5;n or 38;2;r;g;b
+    SGR_EXTENDED_BG,    // 48;...
+};
+
+typedef struct {
+    unsigned char   type;
+    unsigned char   clear;
+    unsigned char   set;
+} sgr_op_t;
+
+static sgr_op_t         g_sgr_ops[108];
+
+//------------------------------------------------------------------------------
+// The console's default palette, in attribute order.
+static const unsigned char g_console_rgb[16][3] = {
+    {   0,   0,   0 }, {   0,   0, 128 }, {   0, 128,   0 }, {   0, 128, 128 },
+    { 128,   0,   0 }, { 128,   0, 128 }, { 128, 128,   0 }, { 192, 192, 192 },
+    { 128, 128, 128 }, {   0,   0, 255 }, {   0, 255,   0 }, {   0, 255, 255 },
+    { 255,   0,   0 }, { 255,   0, 255 }, { 255, 255,   0 }, { 255, 255, 255 },
+};
+
+//------------------------------------------------------------------------------
+typedef struct {
+    int             attr;
+    int             defaults;
+    int             param;          // parameter being accumulated
+    int             is_sgr;         // private or intermediate bytes clear this
+    int             ext_op;         // SGR_EXTENDED_* while parsing one
+    int             ext_stage;
+    int             ext_rgb[3];
+} sgr_parse_t;
+
+//------------------------------------------------------------------------------
+static int ansi_to_attr(int colour)
+{
+    static const int map[] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+    return map[colour & 7];
+}
+
+//------------------------------------------------------------------------------
+static void set_sgr_op(int param, int type, int clear, int set)
+{
+    sgr_op_t* op = g_sgr_ops + param;
+    op->type = type;
+    op->clear = clear;
+    op->set = set;
+}
+
+//------------------------------------------------------------------------------
+static void initialise_tables()
+{
+    static int initialised = 0;
+    int i;
+
+    if (initialised)
+    {
+        return;
+    }
+
+    for (i = 0; i < 0x80; ++i)
+    {
+        int c = CLASS_TEXT;
+
+        if (i < 0x20)                   c = CLASS_CTRL;
+        else if (i < 0x30)              c = CLASS_INTER;
+        else if (i < 0x3a)              c = CLASS_DIGIT;
+        else if (i < 0x3c)              c = CLASS_SEP;
+        else if (i < 0x40)              c = CLASS_PRIVATE;
+        else if (i < 0x7f)              c = CLASS_FINAL;
+
+        g_ascii_classes[i] = c;
+    }
+
+    g_ascii_classes[0x1b] = CLASS_ESC;
+    g_ascii_classes[0x07] = CLASS_BEL;
+    g_ascii_classes['['] = CLASS_CSI_INTRO;
+    g_ascii_classes[']'] = CLASS_OSC_INTRO;
+    g_ascii_classes['P'] = CLASS_OSC_INTRO;
+    g_ascii_classes['\\'] = CLASS_BACKSLASH;
+
+    // Parameters are as Clink has always interpreted them. Note that 4 and 24
+    // control background intensity rather than underline.
+    for (i = 0; i < sizeof_array(g_sgr_ops); ++i)
+    {
+        int colour = ansi_to_attr(i % 10);
+        int group = (i % 10 < 8) ? i / 10 : 0;
+
+        switch (group)
+        {
+        case 3:     set_sgr_op(i, SGR_SET, 0x07, colour);               break;
+        case 4:     set_sgr_op(i, SGR_SET, 0x70, colour << 4);          break;
+        case 9:     set_sgr_op(i, SGR_SET, 0x0f, colour | 0x08);        break;
+        case 10:    set_sgr_op(i, SGR_SET, 0xf0, (colour << 4) | 0x80); break;
+        default:    set_sgr_op(i, SGR_NONE, 0, 0);                      break;
+        }
+    }
+
+    set_sgr_op(0,  SGR_RESET,       0,    0);
+    set_sgr_op(1,  SGR_SET,         0,    0x08);
+    set_sgr_op(2,  SGR_SET,         0x08, 0);
+    set_sgr_op(22, SGR_SET,         0x08, 0);
+    set_sgr_op(4,  SGR_SET,         0,    0x80);
+    set_sgr_op(24, SGR_SET,         0x80, 0);
+    set_sgr_op(38, SGR_EXTENDED_FG, 0,    0);
+    set_sgr_op(39, SGR_DEFAULT_FG,  0,    0);
+    set_sgr_op(48, SGR_EXTENDED_BG, 0,    0);
+    set_sgr_op(49, SGR_DEFAULT_BG,  0,    0);
+
+    initialised = 1;
+}
+
+//------------------------------------------------------------------------------
+static int rgb_to_console(int r, int g, int b)
+{
+    int i;
+    int best;
+    int best_distance;
+
+    best = 0;
+    best_distance = 0x7fffffff;
+    for (i = 0; i < sizeof_array(g_console_rgb); ++i)
+    {
+        int dr = r - g_console_rgb[i][0];
+        int dg = g - g_console_rgb[i][1];
+        int db = b - g_console_rgb[i][2];
+        int distance = (dr * dr) + (dg * dg) + (db * db);
+
+        if (distance < best_distance)
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+//------------------------------------------------------------------------------
+static int xterm256_to_console(int index)
+{
+    static const int cube_levels[] = { 0, 95, 135, 175, 215, 255 };
+
+    if (index < 8)
+    {
+        return ansi_to_attr(index);
+    }
+
+    if (index < 16)
+    {
+        return ansi_to_attr(index - 8) | 0x08;
+    }
+
+    if (index < 232)
+    {
+        index -= 16;
+        return rgb_to_console(
+            cube_levels[index / 36],
+            cube_levels[(index / 6) % 6],
+            cube_levels[index % 6]
+        );
+    }
+
+    index = 8 + ((index - 232) * 10);
+    return rgb_to_console(index, index, index);
+}
+
+//------------------------------------------------------------------------------
+static void sgr_begin(sgr_parse_t* sgr, const ansi_state_t* state)
+{
+    sgr->attr = state->attr;
+    sgr->defaults = state->defaults;
+    sgr->param = 0;
+    sgr->is_sgr = 1;
+    sgr->ext_op = SGR_NONE;
+    sgr->ext_stage = 0;
+}
+
+//------------------------------------------------------------------------------
+static void sgr_digit(sgr_parse_t* sgr, int digit)
+{
+    if (sgr->param < 100000)
+    {
+        sgr->param = (sgr->param * 10) + digit;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void sgr_extended(sgr_parse_t* sgr, int param)
+{
+    int colour;
+
+    // Stage 1 is the format, 2 a 256-colour index, and 3-5 are r, g, and b.
+    switch (sgr->ext_stage)
+    {
+    case 1:
+        switch (param)
+        {
+        case 5:     sgr->ext_stage = 2; break;
+        case 2:     sgr->ext_stage = 3; break;
+        default:    sgr->ext_op = SGR_NONE; break;
+        }
+        return;
+
+    case 2:
+        colour = xterm256_to_console(param & 0xff);
+        break;
+
+    case 3:
+    case 4:
+        sgr->ext_rgb[sgr->ext_stage - 3] = param;
+        ++sgr->ext_stage;
+        return;
+
+    default:
+        colour = rgb_to_console(sgr->ext_rgb[0], sgr->ext_rgb[1], param);
+        break;
+    }
+
+    if (sgr->ext_op == SGR_EXTENDED_FG)
+    {
+        sgr->attr = (sgr->attr & ~0x0f) | colour;
+    }
+    else
+    {
+        sgr->attr = (sgr->attr & ~0xf0) | (colour << 4);
+    }
+
+    sgr->ext_op = SGR_NONE;
+}
+
+//------------------------------------------------------------------------------
+static void sgr_end_param(sgr_parse_t* sgr)
+{
+    int param;
+    const sgr_op_t* op;
+
+    param = sgr->param;
+    sgr->param = 0;
+
+    if (sgr->ext_op != SGR_NONE)
+    {
+        sgr_extended(sgr, param);
+        return;
+    }
+
+    if ((unsigned int)param >= sizeof_array(g_sgr_ops))
+    {
+        return;
+    }
+
+    op = g_sgr_ops + param;
+    switch (op->type)
+    {
+    case SGR_SET:
+        sgr->attr = (sgr->attr & ~op->clear) | op->set;
+        break;
+
+    case SGR_RESET:
+        sgr->attr = sgr->defaults;
+        break;
+
+    case SGR_DEFAULT_FG:
+        sgr->attr = (sgr->attr & ~0x07) | (sgr->defaults & 0x07);
+        break;
+
+    case SGR_DEFAULT_BG:
+        sgr->attr = (sgr->attr & ~0x70) | (sgr->defaults & 0x70);
+        break;
+
+    case SGR_EXTENDED_FG:
+    case SGR_EXTENDED_BG:
+        sgr->ext_op = op->type;
+        sgr->ext_stage = 1;
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ansi_begin(ansi_state_t* state, int attr)
+{
+    initialise_tables();
+
+    state->offset = 0;
+    state->attr = attr;
+    state->defaults = attr;
+}
 
 #define ANSI_X_COMPILE
 
@@ -27,11 +401,9 @@
 
 #define char_t          char
 #define ANSI_FNAME(x)   x
-#define ansi_str_len(x) strlen(x)
 
 #include "ansi.x"
 
-#undef ansi_str_len
 #undef char_t
 #undef ANSI_FNAME
 
@@ -39,11 +411,9 @@
 
 #define char_t          wchar_t
 #define ANSI_FNAME(x)   x##_w
-#define ansi_str_len(x) wcslen(x)
 
 #include "ansi.x"
 
-#undef ansi_str_len
 #undef char_t
 #undef ANSI_FNAME
 
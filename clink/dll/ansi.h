@@ -0,0 +1,51 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ANSI_H
+#define ANSI_H
+
+//------------------------------------------------------------------------------
+typedef enum {
+    ANSI_SPAN_TEXT,                 // plain text
+    ANSI_SPAN_CODE,                 // an escape sequence that isn't SGR
+    ANSI_SPAN_SGR,                  // SGR sequence, state's 'attr' updated
+} ansi_span_type_e;
+
+typedef struct {
+    int             offset;         // in characters from the string's start
+    int             length;
+    ansi_span_type_e type;
+} ansi_span_t;
+
+typedef struct {
+    int             offset;         // where the next span starts
+    int             attr;           // console attributes in effect at 'offset'
+    int             defaults;       // what SGR 0, 39 and 49 restore
+} ansi_state_t;
+
+//------------------------------------------------------------------------------
+void ansi_begin(ansi_state_t* state, int attr);
+int  ansi_next(const char* str, ansi_state_t* state, ansi_span_t* span);
+int  ansi_next_w(const wchar_t* str, ansi_state_t* state, ansi_span_t* span);
+
+#endif // ANSI_H
+
+// vim: expandtab
@@ -25,141 +25,128 @@
 #endif
 
 //------------------------------------------------------------------------------
-static int ANSI_FNAME(is_osc)(const char_t* str)
+static int ANSI_FNAME(char_class)(const char_t* str, int* length)
 {
-    if ((str[0] == 0x1b) && (str[1] == ']'))  return 2;
-    if ((str[0] == 0xc2) && (str[1] == 0x9d)) return 2;
-    if (str[0] == 0x9d)                       return 1;
+    unsigned int c;
 
-    // Also lump DCS under OSC too.
-    if ((str[0] == 0x1b) && (str[1] == 'P'))  return 2;
-    if ((str[0] == 0xc2) && (str[1] == 0x90)) return 2;
-    if (str[0] == 0x90)                       return 1;
+    c = (sizeof(char_t) == 1) ? (unsigned char)str[0] : (unsigned int)str[0];
 
-    return 0;
-}
-
-//------------------------------------------------------------------------------
-static int ANSI_FNAME(is_csi)(const char_t* str)
-{
-    if ((str[0] == 0x1b) && (str[1] == '['))  return 2;
-    if ((str[0] == 0xc2) && (str[1] == 0x9b)) return 2;
-    if (str[0] == 0x9b)                       return 1;
-
-    return 0;
-}
-
-//------------------------------------------------------------------------------
-const char_t* ANSI_FNAME(find_next_ansi_code)(const char_t* buffer, int* size)
-{
-    int size_temp;
-    const char_t* read;
-    int state;
-    int osc;
-
-    if (size == NULL)
+    *length = 1;
+    if (c < 0x80)
     {
-        size = &size_temp;
+        return g_ascii_classes[c];
     }
 
-    read = buffer;
-    state = -1;
-    osc = 0;
-    while (*read)
+    // The 8-bit forms of C1 controls are also valid UTF-8 continuation bytes so
+    // in UTF-8 strings they are only recognised when encoded.
+    if (sizeof(char_t) == 1)
     {
-        if (state < 0)
+        if (c != 0xc2)
         {
-            osc = ANSI_FNAME(is_osc)(read);
-            int csi_len = ANSI_FNAME(is_csi)(read) + osc;
-            if (csi_len)
-            {
-                state = read - buffer;
-                read += (csi_len > 1);
-            }
+            return CLASS_TEXT;
         }
-        else
-        {
-            int done;
-
-            char c = *read;
-            if (osc)
-                done = (c == 0x9c) || (c == 0x1b && read[1] == '\\');
-            else
-                done = (c < '0' || c > '9') && c != ';';
 
-            if (done)
-            {
-                buffer += state;
-
-                *size = (int)(read - buffer);
-                *size += 1 + !!osc;
-
-                return buffer;
-            }
-        }
+        c = (unsigned char)str[1];
+        *length = 2;
+    }
 
-        ++read;
+    switch (c)
+    {
+    case 0x9b:  return CLASS_C1_CSI;
+    case 0x9d:
+    case 0x90:  return CLASS_C1_OSC;
+    case 0x9c:  return CLASS_C1_ST;
     }
 
-    *size = 0;
-    return (buffer +  ansi_str_len(buffer));
+    *length = 1;
+    return CLASS_TEXT;
 }
 
 //------------------------------------------------------------------------------
-int ANSI_FNAME(parse_ansi_code)(const char_t* code, int* params, int max_params)
+int ANSI_FNAME(ansi_next)(const char_t* str, ansi_state_t* state, ansi_span_t* span)
 {
-    int i;
-    int command;
-    int csi_len;
+    const char_t* start;
+    const char_t* read;
+    sgr_parse_t sgr;
+    int current;
 
-    csi_len = ANSI_FNAME(is_csi)(code);
-    if (csi_len <= 0)
+    start = str + state->offset;
+    if (*start == '\0')
     {
-        return -1;
+        return 0;
     }
 
-    code += csi_len;
-    i = 0;
-    command = -1;
+    // Walk the string once. Text is returned up to the start of the next escape
+    // sequence, and a sequence's SGR parameters are applied as they're read. A
+    // sequence that's not terminated is left as text.
+    sgr_begin(&sgr, state);
+    span->type = ANSI_SPAN_TEXT;
+    current = STATE_TEXT;
+    read = start;
+    while (*read)
+    {
+        int length;
+        int cls;
+        int next;
 
-    params[i] = 0;
-    --max_params;       // one param must be -1 terminator.
+        cls = ANSI_FNAME(char_class)(read, &length);
+        next = g_transitions[current][cls];
 
-    while (*code)
-    {
-        // Accumilate numerics.
-        unsigned int n = (unsigned int)*code - '0';
-        if (n < 10)
+        if (next == END_NOT_CODE)
         {
-            if (i < max_params)
+            // The ESC wasn't the start of a sequence so it's just text.
+            current = STATE_TEXT;
+            continue;
+        }
+
+        if (next >= STATE_COUNT)
+        {
+            // A sequence cut short by something that can't be part of it is
+            // text too, up to the character that interrupted it.
+            if (next == END_CUT)
             {
-                params[i] *= 10;
-                params[i] += n;
+                break;
             }
 
-            ++code;
-            continue;
+            span->type = ANSI_SPAN_CODE;
+            read += length;
+            if (next == END_CSI && sgr.is_sgr && read[-1] == 'm')
+            {
+                sgr_end_param(&sgr);
+                state->attr = sgr.attr;
+                span->type = ANSI_SPAN_SGR;
+            }
+
+            break;
         }
 
-        // Still room to move onto the next parameter?
-        if (i < max_params)
+        if (current == STATE_TEXT && next != STATE_TEXT)
         {
-            ++i;
-            params[i] = 0;
+            // Return any text before the sequence first.
+            if (read > start)
+            {
+                break;
+            }
         }
-
-        // Anything but [0-9;] indicates the end of the sequence
-        if (*code != ';')
+        else if (current == STATE_CSI)
         {
-            command = *code;
-            break;
+            switch (cls)
+            {
+            case CLASS_DIGIT:   sgr_digit(&sgr, *read - '0'); break;
+            case CLASS_SEP:     sgr_end_param(&sgr);          break;
+            case CLASS_PRIVATE:
+            case CLASS_INTER:   sgr.is_sgr = 0;               break;
+            }
         }
 
-        ++code;
+        current = next;
+        read += length;
     }
 
-    params[i] = -1;
-    return command;
+    span->offset = state->offset;
+    span->length = (int)(read - start);
+    state->offset += span->length;
+    return 1;
 }
 
 // vim: expandtab syntax=c
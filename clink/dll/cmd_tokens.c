@@ -0,0 +1,250 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "cmd_tokens.h"
+
+//------------------------------------------------------------------------------
+static int is_space(char c)
+{
+    return (c == ' ' || c == '\t');
+}
+
+//------------------------------------------------------------------------------
+static int is_operator(char c)
+{
+    return (c == '&' || c == '|' || c == '<' || c == '>');
+}
+
+//------------------------------------------------------------------------------
+static int is_digit(char c)
+{
+    return (c >= '0' && c <= '9');
+}
+
+//------------------------------------------------------------------------------
+static void add_token(cmd_tokens_t* tokens, int start, int end, int type,
+    int flags)
+{
+    cmd_token_t* token;
+
+    if (tokens->count >= tokens->size)
+    {
+        tokens->size = (tokens->size > 0) ? tokens->size * 2 : 16;
+        tokens->tokens = realloc(tokens->tokens,
+            tokens->size * sizeof(cmd_token_t));
+    }
+
+    token = tokens->tokens + tokens->count;
+    token->start = start;
+    token->length = end - start;
+    token->type = type;
+    token->flags = flags;
+
+    ++tokens->count;
+}
+
+//------------------------------------------------------------------------------
+void cmd_tokens_init(cmd_tokens_t* tokens)
+{
+    memset(tokens, 0, sizeof(*tokens));
+}
+
+//------------------------------------------------------------------------------
+void cmd_tokens_free(cmd_tokens_t* tokens)
+{
+    free(tokens->tokens);
+    cmd_tokens_init(tokens);
+}
+
+//------------------------------------------------------------------------------
+int cmd_tokenise(cmd_tokens_t* tokens, const char* line, int length)
+{
+    // Splits a line up as cmd.exe would; into words, command separators and
+    // redirections. Quotes stop spaces and operators from ending a word, and
+    // outside of quotes a '^' escapes the character after it. Returns the
+    // number of tokens.
+
+    int expect_command;
+    int expect_target;
+    int i;
+
+    tokens->count = 0;
+    expect_command = 1;
+    expect_target = 0;
+
+    i = 0;
+    while (i < length)
+    {
+        int start;
+        int flags;
+        int quote;
+        char c;
+
+        c = line[i];
+        start = i;
+
+        if (is_space(c))
+        {
+            ++i;
+            continue;
+        }
+
+        // '&', '&&', '|', and '||' all separate commands.
+        if (c == '&' || c == '|')
+        {
+            ++i;
+            if (i < length && line[i] == c)
+            {
+                ++i;
+            }
+
+            add_token(tokens, start, i, CMD_TOKEN_SEPARATOR, 0);
+            expect_command = 1;
+            expect_target = 0;
+            continue;
+        }
+
+        // Redirections. A handle number is only part of a redirection if it is
+        // at the start of a word ("echo 2>nul" vs. "echo a2>nul").
+        if (c == '<' || c == '>' ||
+            (is_digit(c) && i + 1 < length &&
+            (line[i + 1] == '<' || line[i + 1] == '>')))
+        {
+            if (is_digit(c))
+            {
+                ++i;
+            }
+
+            c = line[i++];
+            if (c == '>' && i < length && line[i] == '>')
+            {
+                ++i;
+            }
+
+            // Redirecting to another handle ("2>&1") doesn't need a file.
+            if (i + 1 < length && line[i] == '&' && is_digit(line[i + 1]))
+            {
+                i += 2;
+            }
+            else
+            {
+                expect_target = 1;
+            }
+
+            add_token(tokens, start, i, CMD_TOKEN_REDIRECT, 0);
+            continue;
+        }
+
+        // Anything else is a word.
+        flags = 0;
+        quote = 0;
+        while (i < length)
+        {
+            c = line[i];
+            if (c == '"')
+            {
+                flags |= CMD_TOKEN_QUOTED;
+                quote = !quote;
+            }
+            else if (!quote)
+            {
+                if (is_space(c) || is_operator(c))
+                {
+                    break;
+                }
+
+                if (c == '^' && i + 1 < length)
+                {
+                    ++i;
+                }
+            }
+
+            ++i;
+        }
+
+        if (quote)
+        {
+            flags |= CMD_TOKEN_OPEN_QUOTE;
+        }
+
+        if (expect_target)
+        {
+            flags |= CMD_TOKEN_TARGET;
+            expect_target = 0;
+        }
+        else if (expect_command)
+        {
+            flags |= CMD_TOKEN_COMMAND;
+            expect_command = 0;
+        }
+
+        add_token(tokens, start, i, CMD_TOKEN_WORD, flags);
+    }
+
+    return tokens->count;
+}
+
+//------------------------------------------------------------------------------
+void cmd_token_text(const cmd_token_t* token, const char* line,
+    str_builder_t* out)
+{
+    // Appends the token's text to 'out' as the command would see it; with
+    // quotes and escaping '^'s removed.
+
+    const char* read;
+    const char* end;
+    int quote;
+
+    read = line + token->start;
+    end = read + token->length;
+
+    if (token->type != CMD_TOKEN_WORD)
+    {
+        str_builder_append_n(out, read, token->length);
+        return;
+    }
+
+    quote = 0;
+    for (; read < end; ++read)
+    {
+        char c = *read;
+        if (c == '"')
+        {
+            quote = !quote;
+            continue;
+        }
+
+        if (c == '^' && !quote)
+        {
+            if (++read >= end)
+            {
+                break;
+            }
+
+            c = *read;
+        }
+
+        str_builder_append_c(out, c);
+    }
+}
+
+// vim: expandtab
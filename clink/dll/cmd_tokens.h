@@ -0,0 +1,66 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CMD_TOKENS_H
+#define CMD_TOKENS_H
+
+#include "shared/str_builder.h"
+
+//------------------------------------------------------------------------------
+enum
+{
+    CMD_TOKEN_WORD,
+    CMD_TOKEN_SEPARATOR,            // & && | ||
+    CMD_TOKEN_REDIRECT              // < > >> n> n>&m etc.
+};
+
+enum
+{
+    CMD_TOKEN_QUOTED        = 1 << 0,   // word has quotes in it somewhere
+    CMD_TOKEN_OPEN_QUOTE    = 1 << 1,   // ...and the last one isn't closed
+    CMD_TOKEN_COMMAND       = 1 << 2,   // first word of a command
+    CMD_TOKEN_TARGET        = 1 << 3    // file name for a redirection
+};
+
+typedef struct
+{
+    int             start;          // byte offset into the line
+    int             length;
+    int             type;
+    int             flags;
+} cmd_token_t;
+
+typedef struct
+{
+    cmd_token_t*    tokens;
+    int             count;
+    int             size;
+} cmd_tokens_t;
+
+//------------------------------------------------------------------------------
+void                    cmd_tokens_init(cmd_tokens_t* tokens);
+void                    cmd_tokens_free(cmd_tokens_t* tokens);
+int                     cmd_tokenise(cmd_tokens_t* tokens, const char* line, int length);
+void                    cmd_token_text(const cmd_token_t* token, const char* line, str_builder_t* out);
+
+#endif // CMD_TOKENS_H
+
+// vim: expandtab
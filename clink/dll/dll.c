@@ -26,11 +26,9 @@
 #include "shared/shared_mem.h"
 
 //------------------------------------------------------------------------------
-void                    load_history();
 void                    save_history();
 void                    shutdown_lua();
 void                    shutdown_clink_settings();
-int                     get_clink_setting_int(const char*);
 void                    prepare_env_for_inputrc();
 
 inject_args_t           g_inject_args;
@@ -175,9 +173,6 @@ static BOOL on_dll_detach()
     {
         g_shell->shutdown();
 
-        if (get_clink_setting_int("history_io"))
-            load_history();
-
         save_history();
         shutdown_lua();
         shutdown_clink_settings();
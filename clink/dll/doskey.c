@@ -20,6 +20,7 @@
  */
 
 #include "pch.h"
+#include "aliases.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
@@ -68,10 +69,29 @@ static int tokenise(wchar_t* source, token_t* tokens, int max_tokens)
     return i;
 }
 
+//------------------------------------------------------------------------------
+static void check_for_doskey(const wchar_t* command)
+{
+    // Commands that run doskey may well change the console's aliases.
+
+    static const wchar_t doskey[] = L"doskey";
+    const wchar_t* read;
+
+    for (read = command; *read; ++read)
+    {
+        if (_wcsnicmp(read, doskey, sizeof_array(doskey) - 1) == 0)
+        {
+            invalidate_alias_cache();
+            return;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 int continue_doskey(wchar_t* chars, unsigned max_chars)
 {
     wchar_t* read = g_state.alias_next;
+    wchar_t* command = chars;
 
     if (g_state.alias_text == NULL)
         return 0;
@@ -138,6 +158,7 @@ int continue_doskey(wchar_t* chars, unsigned max_chars)
     }
 
     *chars = '\0';
+    check_for_doskey(command);
 
     // Move g_state.next on to the next command or the end of the expansion.
     g_state.alias_next = read;
@@ -175,24 +196,26 @@ int begin_doskey(wchar_t* chars, unsigned max_chars)
         alias[i] = '\0';
     }
 
+    check_for_doskey(chars);
+
     // Find the alias' text.
     {
         int bytes;
-        wchar_t* exe;
-        wchar_t exe_path[MAX_PATH];
+        char alias_utf8[sizeof_array(alias) * 3];
+        const alias_t* found;
 
-        GetModuleFileNameW(NULL, exe_path, sizeof_array(exe_path));
-        exe = wcsrchr(exe_path, L'\\');
-        exe = (exe != NULL) ? (exe + 1) : exe_path;
+        WideCharToMultiByte(CP_UTF8, 0, alias, -1, alias_utf8,
+            sizeof_array(alias_utf8), NULL, NULL);
 
-        // Check it exists. (ERROR_NOT_FOUND is set when an alias is, well, not found)
-        if (!GetConsoleAliasW(alias, exe_path, sizeof(wchar_t), exe) && GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        found = alias_table_find(get_alias_cache(NULL), alias_utf8);
+        if (found == NULL)
             return 0;
 
         // It does. Allocate space and fetch it.
         bytes = max_chars * sizeof(wchar_t);
         g_state.alias_text = malloc(bytes * 2);
-        GetConsoleAliasW(alias, g_state.alias_text, bytes, exe);
+        wcsncpy(g_state.alias_text, found->text, max_chars - 1);
+        g_state.alias_text[max_chars - 1] = '\0';
 
         // Copy the input and tokenise it. Lots of pointer aliasing here...
         g_state.input = g_state.alias_text + max_chars;
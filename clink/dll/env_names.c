@@ -0,0 +1,75 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "env_names.h"
+
+//------------------------------------------------------------------------------
+static alias_table_t    g_env_names;
+static int              g_env_names_init        = 0;
+static int              g_env_names_generation  = 0;
+static int              g_env_generation        = 1;
+
+//------------------------------------------------------------------------------
+void invalidate_env_names()
+{
+    ++g_env_generation;
+}
+
+//------------------------------------------------------------------------------
+const alias_table_t* get_env_names()
+{
+    // The environment block has the same "name=value\0" layout as the console's
+    // aliases so it's indexed in the same way. The index is only rebuilt after
+    // the environment's changed; cmd.exe's changes come through set_env_var().
+
+    wchar_t* env;
+    const wchar_t* c;
+
+    if (!g_env_names_init)
+    {
+        alias_table_init(&g_env_names);
+        g_env_names_init = 1;
+    }
+
+    if (g_env_names_generation == g_env_generation)
+    {
+        return &g_env_names;
+    }
+
+    env = GetEnvironmentStringsW();
+    if (env != NULL)
+    {
+        c = env;
+        while (*c)
+        {
+            c += wcslen(c) + 1;
+        }
+
+        alias_table_parse(&g_env_names, env, (int)(c - env));
+        FreeEnvironmentStringsW(env);
+    }
+
+    g_env_names_generation = g_env_generation;
+    return &g_env_names;
+}
+
+// vim: expandtab
@@ -25,6 +25,9 @@
 //------------------------------------------------------------------------------
 DWORD   g_knownBufferSize = 0;
 int     get_clink_setting_int(const char*);
+int     lua_update_prompt(int*);
+int     lua_idle_gc();
+void    refresh_prompt();
 
 //------------------------------------------------------------------------------
 static void simulate_sigwinch()
@@ -42,6 +45,8 @@ static void simulate_sigwinch()
     int cell_count;
     DWORD written;
 
+    hooked_fflush(NULL);
+
     handle = GetStdHandle(STD_OUTPUT_HANDLE);
     GetConsoleScreenBufferInfo(handle, &csbi);
 
@@ -319,23 +324,223 @@ end:
     return key_char;
 }
 
+//------------------------------------------------------------------------------
+static int getc_internal_pending()
+{
+    // Only a key-down carrying a character is sure to be returned by
+    // getc_internal() without it blocking to wait for more input.
+
+    INPUT_RECORD records[64];
+    DWORD count;
+    DWORD i;
+
+    if (!PeekConsoleInputW(GetStdHandle(STD_INPUT_HANDLE), records,
+        sizeof_array(records), &count))
+    {
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        const KEY_EVENT_RECORD* key = &records[i].Event.KeyEvent;
+
+        if (records[i].EventType != KEY_EVENT || !key->uChar.UnicodeChar)
+        {
+            continue;
+        }
+
+        if (key->bKeyDown || key->wVirtualKeyCode == VK_MENU)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// A key can be read ahead and then handed back if it turns out it's not to be
+// coalesced with the keys before it.
+static int      g_pushed_key            = -1;
+static int      g_pushed_alt            = 0;
+static wchar_t* g_text_keys             = NULL;
+static int      g_text_keys_size        = 0;
+
+//------------------------------------------------------------------------------
+static int read_key(int* alt)
+{
+    int key;
+
+    if (g_pushed_key >= 0)
+    {
+        key = g_pushed_key;
+        *alt = g_pushed_alt;
+        g_pushed_key = -1;
+        return key;
+    }
+
+    *alt = 0;
+    key = GETWCH_IMPL(alt);
+
+    // MSB is set if value represents a printable character.
+    return key & ~0x80000000;
+}
+
+//------------------------------------------------------------------------------
+static void push_key(int key, int alt)
+{
+    g_pushed_key = key;
+    g_pushed_alt = alt;
+}
+
+//------------------------------------------------------------------------------
+static int key_pending()
+{
+    return (g_pushed_key >= 0) || GETWCH_PENDING_IMPL();
+}
+
+//------------------------------------------------------------------------------
+static int is_text_key(int key, int alt)
+{
+    Keymap keymap;
+
+    // Characters outside of ASCII are always inserted directly.
+    if (key >= 0x80)
+    {
+        return (key != 0xe0);
+    }
+
+    // ASCII is only if it's the start of a command and it would self-insert.
+    if (alt || key < 0x20 || key == 0x7f)
+    {
+        return 0;
+    }
+
+    if (!RL_ISSTATE(RL_STATE_READCMD) || rl_insert_mode != RL_IM_INSERT)
+    {
+        return 0;
+    }
+
+    keymap = rl_get_keymap();
+    return (keymap[key].type == ISFUNC && keymap[key].function == rl_insert);
+}
+
+//------------------------------------------------------------------------------
+static int gather_text_keys(int key)
+{
+    // Collects 'key' and the text keys that are queued up behind it (such as
+    // when text's pasted). Returns the number of keys gathered.
+
+    int count;
+
+    count = 0;
+    while (1)
+    {
+        int alt;
+
+        if (count >= g_text_keys_size)
+        {
+            g_text_keys_size = g_text_keys_size ? g_text_keys_size * 2 : 256;
+            g_text_keys = realloc(g_text_keys, g_text_keys_size * sizeof(wchar_t));
+        }
+
+        g_text_keys[count] = (wchar_t)key;
+        ++count;
+
+        if (!key_pending())
+        {
+            break;
+        }
+
+        key = read_key(&alt);
+        if (!is_text_key(key, alt))
+        {
+            push_key(key, alt);
+            break;
+        }
+    }
+
+    return count;
+}
+
+//------------------------------------------------------------------------------
+static void insert_text_keys(int count)
+{
+    char* utf8;
+    int utf8_size;
+
+    // Convert to utf-8 and insert directly into rl's line buffer.
+    utf8_size = WideCharToMultiByte(CP_UTF8, 0, g_text_keys, count, NULL, 0,
+        NULL, NULL);
+
+    utf8 = malloc(utf8_size + 1);
+    utf8_size = WideCharToMultiByte(CP_UTF8, 0, g_text_keys, count, utf8,
+        utf8_size, NULL, NULL);
+    utf8[utf8_size] = '\0';
+
+    rl_insert_text(utf8);
+    rl_redisplay();
+
+    free(utf8);
+}
+
+//------------------------------------------------------------------------------
+static void wait_for_input()
+{
+    // Asynchronous prompt filters finish while Clink sits waiting for input so
+    // rather than blocking on the console indefinitely we wake periodically
+    // to collect their results, redrawing the prompt when they change it. The
+    // time's also used to collect Lua's garbage, a step at a time.
+
+    HANDLE handle_stdin;
+    int pending;
+    int collecting;
+    DWORD timeout;
+
+    if (key_pending())
+    {
+        return;
+    }
+
+    handle_stdin = GetStdHandle(STD_INPUT_HANDLE);
+    while (1)
+    {
+        if (lua_update_prompt(&pending))
+        {
+            refresh_prompt();
+            hooked_fflush(NULL);
+        }
+
+        collecting = lua_idle_gc();
+        if (!pending && !collecting)
+        {
+            break;
+        }
+
+        // Any input at all hands control back to getc_internal().
+        timeout = collecting ? 0 : 50;
+        if (WaitForSingleObject(handle_stdin, timeout) == WAIT_OBJECT_0)
+        {
+            break;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 int getc_impl(FILE* stream)
 {
-    int printable;
     int alt;
     int i;
     while (1)
     {
-        wchar_t wc[2];
-        char utf8[4];
+        int count;
 
-        alt = 0;
-        i = GETWCH_IMPL(&alt);
+        // Make sure everything Readline's written so far is on screen before
+        // blocking for input.
+        hooked_fflush(NULL);
+        wait_for_input();
 
-        // MSB is set if value represents a printable character.
-        printable = (i & 0x80000000);
-        i &= ~printable;
+        i = read_key(&alt);
 
         // Treat esc like cmd.exe does - clear the line.
         if (i == 0x1b)
@@ -351,19 +556,20 @@ int getc_impl(FILE* stream)
             }
         }
 
-        // Mask off top bits, they're used to track ALT key state.
-        if (i < 0x80 || (i == 0xe0 && !printable))
+        if (!is_text_key(i, alt))
         {
             break;
         }
 
-        // Convert to utf-8 and insert directly into rl's line buffer.
-        wc[0] = (wchar_t)i;
-        wc[1] = L'\0';
-        WideCharToMultiByte(CP_UTF8, 0, wc, -1, utf8, sizeof(utf8), NULL, NULL);
+        // A lone ASCII key is left for Readline to dispatch as normal. Runs of
+        // text keys are inserted in one go with only the one redisplay.
+        count = gather_text_keys(i);
+        if (count == 1 && i < 0x80)
+        {
+            break;
+        }
 
-        rl_insert_text(utf8);
-        rl_redisplay();
+        insert_text_keys(count);
     }
 
     alt = alt ? 0x80 : 0;
@@ -21,68 +21,368 @@
 
 #include "pch.h"
 #include "shared/util.h"
+#include "shared/history_db.h"
+#include "shared/history_rank.h"
+
+#include <time.h>
+
+//------------------------------------------------------------------------------
+int get_clink_setting_int(const char*);
+static history_db_t g_history_db;
+static history_db_t g_pending_db;
+static int          g_history_mirrored              = 0;
+static int          g_last_ordinal                  = -1;
+static int          g_last_pending                  = -1;
+static int          g_exit_code                     = 0;
+static int          g_have_exit_code                = 0;
+static HANDLE       g_compact_thread                = NULL;
+static volatile LONG g_compacting                   = 0;
+static history_rank_t g_history_rank;
+static int          g_ranked_entries                = 0;
+static int          g_ranked_pending                = 0;
+static char**       g_ranked_lines                  = NULL;
+static int          g_ranked_lines_size             = 0;
+
+//------------------------------------------------------------------------------
+// The history file (see shared/history_db.h) is shared by every Clink session.
+// Sessions only ever append to it (with the file locked) and remember how far
+// into it they've read, so picking up other sessions' lines costs only what was
+// added since. Each entry carries when and where it was run, and the exit code
+// of the command if one's known by the time the next prompt's shown.
+//
+// 'g_history_db' mirrors the file and readline's history mirrors it. Lines
+// added when history isn't shared as it goes are kept in 'g_pending_db' until
+// they're appended at exit.
+//
+// Once the file's grown 'HISTORY_SLACK' past the line limit a compacted copy is
+// written in the background with the next generation number in its header,
+// and renamed over the old file. The old file's then rewritten as a bare "dead"
+// header so sessions that were waiting on it know to open the file again.
+// Sessions reread the file whenever its generation isn't the one they read.
+#define HISTORY_SLACK(max)      (((max) / 4 > 16) ? (max) / 4 : 16)
+
+typedef struct
+{
+    char                file_name[512];
+    int                 max_history;
+    int                 dedupe;
+} compact_args_t;
+
+static compact_args_t   g_compact_args;
+
+//------------------------------------------------------------------------------
+static int get_max_history()
+{
+    int max_history;
+
+    max_history = get_clink_setting_int("history_file_lines");
+    return (max_history == 0) ? INT_MAX : max_history;
+}
+
+//------------------------------------------------------------------------------
+static int get_dedupe_history()
+{
+    return (get_clink_setting_int("history_dupe_mode") > 0);
+}
+
+//------------------------------------------------------------------------------
+static void reset_history_rank()
+{
+    history_rank_clear(&g_history_rank);
+    g_ranked_entries = 0;
+    g_ranked_pending = 0;
+}
+
+//------------------------------------------------------------------------------
+static void sync_history(history_file_t* file, int mirror)
+{
+    // Catches up with the file and, if 'mirror' is set, readline's history
+    // with the database. Only the newest lines readline keeps are loaded.
+
+    int max_history;
+    int reset;
+    int i;
+
+    max_history = get_max_history();
+    reset = history_db_sync(&g_history_db, file,
+        (max_history == INT_MAX) ? 0 : max_history);
+
+    if (reset)
+    {
+        g_last_ordinal = -1;
+        reset_history_rank();
+    }
+
+    if (!mirror)
+    {
+        return;
+    }
+
+    if (reset)
+    {
+        clear_history();
+        g_history_mirrored = 0;
+    }
+
+    for (i = g_history_mirrored; i < g_history_db.entry_count; ++i)
+    {
+        add_history(history_db_line(&g_history_db, i));
+    }
+
+    g_history_mirrored = g_history_db.entry_count;
+}
+
+//------------------------------------------------------------------------------
+static int open_history_file(const char* file_name, history_file_t* file)
+{
+    // Opens (and locks) the history file. If that made a new file the text
+    // history earlier versions wrote is brought over first.
+
+    if (!history_db_open(file_name, file))
+    {
+        return 0;
+    }
+
+    if (file->created)
+    {
+        history_db_import_legacy(file);
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static DWORD WINAPI compact_thread_proc(compact_args_t* args)
+{
+    history_file_t file;
+
+    if (open_history_file(args->file_name, &file))
+    {
+        history_db_compact(args->file_name, &file, args->max_history,
+            HISTORY_SLACK(args->max_history), args->dedupe);
+
+        history_db_close(&file);
+    }
+
+    InterlockedExchange(&g_compacting, 0);
+    return 0;
+}
 
 //------------------------------------------------------------------------------
-int                 get_clink_setting_int(const char*);
-static int          g_new_history_count             = 0;
+static int is_compacting()
+{
+    // The thread clears the flag as it finishes, so it stays set if the thread
+    // was killed part way through (as happens when the process exits) and may
+    // have left the file locked.
+
+    if (g_compacting)
+    {
+        return 1;
+    }
+
+    if (g_compact_thread != NULL)
+    {
+        CloseHandle(g_compact_thread);
+        g_compact_thread = NULL;
+    }
+
+    return 0;
+}
 
 //------------------------------------------------------------------------------
-static void get_history_file_name(char* buffer, int size)
+static void compact_in_background(const char* file_name, int max_history)
 {
-    get_config_dir(buffer, size);
-    if (buffer[0])
+    if (is_compacting())
+    {
+        return;
+    }
+
+    str_cpy(g_compact_args.file_name, file_name,
+        sizeof_array(g_compact_args.file_name));
+    g_compact_args.max_history = max_history;
+    g_compact_args.dedupe = get_dedupe_history();
+
+    g_compacting = 1;
+    g_compact_thread = CreateThread(NULL, 0,
+        (LPTHREAD_START_ROUTINE)compact_thread_proc, &g_compact_args, 0, NULL);
+    if (g_compact_thread == NULL)
     {
-        str_cat(buffer, "/.history", size);
+        g_compacting = 0;
     }
 }
 
 //------------------------------------------------------------------------------
 void load_history()
 {
+    history_file_t file;
+    int max_history;
     char buffer[512];
 
-    get_history_file_name(buffer, sizeof(buffer));
+    get_history_db_file_name(buffer, sizeof(buffer));
 
     // Clear existing history.
     clear_history();
-    g_new_history_count = 0;
+    history_db_clear(&g_history_db);
+    history_db_clear(&g_pending_db);
+    g_history_mirrored = 0;
+    g_last_ordinal = -1;
+    g_last_pending = -1;
+    reset_history_rank();
+
+    // Read from disk, trimming the file to our maximum first if need be.
+    if (open_history_file(buffer, &file))
+    {
+        max_history = get_max_history();
+        if (max_history != INT_MAX && history_db_compact(buffer, &file,
+            max_history, 0, get_dedupe_history()))
+        {
+            history_db_close(&file);
+            if (!open_history_file(buffer, &file))
+            {
+                using_history();
+                return;
+            }
+        }
+
+        sync_history(&file, 1);
+        history_db_close(&file);
+    }
 
-    // Read from disk.
-    read_history(buffer);
     using_history();
 }
 
 //------------------------------------------------------------------------------
 void save_history()
 {
-    int always_write;
+    history_buffer_t records;
+    history_file_t file;
     int max_history;
     char buffer[512];
+    int i;
 
-    always_write = get_clink_setting_int("history_io");
-    get_history_file_name(buffer, sizeof(buffer));
+    get_history_db_file_name(buffer, sizeof(buffer));
 
     // Get max history size.
-    max_history = get_clink_setting_int("history_file_lines");
-    max_history = (max_history == 0) ? INT_MAX : max_history;
+    max_history = get_max_history();
     if (max_history < 0)
     {
         unlink(buffer);
         return;
     }
 
-    // Write new history to the file, and truncate to our maximum.
-    if (always_write || append_history(g_new_history_count, buffer) != 0)
+    // Append lines this session added, and trim the file to our maximum. This
+    // is skipped if compaction's under way as we're likely exiting and can't
+    // wait for it. Only shared history compacts in the background and it has
+    // nothing left to append.
+    if (is_compacting() || !open_history_file(buffer, &file))
     {
-        write_history(buffer);
+        return;
+    }
+
+    if (g_pending_db.entry_count > 0)
+    {
+        sync_history(&file, 0);
+
+        history_buffer_init(&records);
+        for (i = 0; i < g_pending_db.entry_count; ++i)
+        {
+            const history_entry_t* entry = g_pending_db.entries + i;
+
+            history_db_add(&g_history_db, &records,
+                history_db_line(&g_pending_db, i), entry->time,
+                history_db_cwd(&g_pending_db, entry->cwd), entry->exit_code,
+                entry->has_exit_code);
+        }
+
+        if (history_db_append(&g_history_db, &file, &records))
+        {
+            history_db_clear(&g_pending_db);
+            g_last_pending = -1;
+        }
+
+        history_buffer_free(&records);
     }
 
     if (max_history != INT_MAX)
     {
-        history_truncate_file(buffer, max_history);
+        history_db_compact(buffer, &file, max_history, 0,
+            get_dedupe_history());
+    }
+
+    history_db_close(&file);
+}
+
+//------------------------------------------------------------------------------
+static int get_exit_code(int* exit_code)
+{
+    // cmd.exe keeps the exit code of the last program it ran in the hidden
+    // "=ExitCode" variable, as eight hex digits.
+
+    char buffer[16];
+    DWORD length;
+
+    length = GetEnvironmentVariable("=ExitCode", buffer, sizeof_array(buffer));
+    if (length == 0 || length >= sizeof_array(buffer))
+    {
+        return 0;
     }
 
-    g_new_history_count = 0;
+    *exit_code = (int)strtoul(buffer, NULL, 16);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void capture_history_exit_code()
+{
+    // Called as each prompt's shown to attach the exit code of what ran to the
+    // line this session last added. cmd.exe only updates "=ExitCode" when an
+    // external program exits, so codes that didn't change are left unknown
+    // rather than guessed at.
+
+    history_buffer_t records;
+    history_file_t file;
+    int exit_code;
+    int changed;
+    char buffer[512];
+
+    if (!get_exit_code(&exit_code))
+    {
+        g_have_exit_code = 0;
+        g_last_ordinal = -1;
+        g_last_pending = -1;
+        return;
+    }
+
+    changed = (!g_have_exit_code || exit_code != g_exit_code);
+    g_exit_code = exit_code;
+    g_have_exit_code = 1;
+
+    if (changed && g_last_pending >= 0 &&
+        g_last_pending < g_pending_db.entry_count)
+    {
+        g_pending_db.entries[g_last_pending].exit_code = exit_code;
+        g_pending_db.entries[g_last_pending].has_exit_code = 1;
+    }
+
+    if (changed && g_last_ordinal >= 0)
+    {
+        get_history_db_file_name(buffer, sizeof(buffer));
+        if (open_history_file(buffer, &file))
+        {
+            sync_history(&file, 1);
+
+            history_buffer_init(&records);
+            history_db_set_exit(&g_history_db, &records, g_last_ordinal,
+                exit_code);
+            history_db_append(&g_history_db, &file, &records);
+            history_buffer_free(&records);
+
+            history_db_close(&file);
+        }
+    }
+
+    g_last_ordinal = -1;
+    g_last_pending = -1;
 }
 
 //------------------------------------------------------------------------------
@@ -103,7 +403,7 @@ static int find_duplicate(const char* line)
 }
 
 //------------------------------------------------------------------------------
-void add_to_history(const char* line)
+static int add_to_readline_history(const char* line)
 {
     int dupe_mode;
     const unsigned char* c;
@@ -112,7 +412,7 @@ void add_to_history(const char* line)
     c = (const unsigned char*)line;
     if (isspace(*c) && get_clink_setting_int("history_ignore_space") > 0)
     {
-        return;
+        return 0;
     }
 
     // Skip leading whitespace
@@ -129,7 +429,7 @@ void add_to_history(const char* line)
     // Skip empty lines
     if (*c == '\0')
     {
-        return;
+        return 0;
     }
 
     // Check if the line's a duplicate of and existing history entry.
@@ -146,7 +446,7 @@ void add_to_history(const char* line)
             }
             else
             {
-                return;
+                return 0;
             }
         }
     }
@@ -154,7 +454,194 @@ void add_to_history(const char* line)
     // All's well. Add the line.
     using_history();
     add_history(line);
-    ++g_new_history_count;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static void add_pending_line(const char* line, unsigned time, const char* cwd)
+{
+    history_buffer_t scratch;
+
+    history_buffer_init(&scratch);
+    g_last_pending = history_db_add(&g_pending_db, &scratch, line, time, cwd,
+        0, 0);
+    history_buffer_free(&scratch);
+}
+
+//------------------------------------------------------------------------------
+int add_to_history(const char* line)
+{
+    // Adds the line to readline's history, keeping it to be appended to the
+    // history file at exit.
+
+    char cwd[MAX_PATH];
+
+    if (!add_to_readline_history(line))
+    {
+        return 0;
+    }
+
+    cwd[0] = '\0';
+    GetCurrentDirectory(sizeof_array(cwd), cwd);
+    add_pending_line(line, (unsigned)time(NULL), cwd);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void add_to_shared_history(const char* line)
+{
+    // As add_to_history() but first catches up with lines other sessions have
+    // added to the history file, and appends the line to it straight away.
+
+    history_buffer_t records;
+    history_file_t file;
+    int max_history;
+    int ordinal;
+    unsigned now;
+    char buffer[512];
+    char cwd[MAX_PATH];
+
+    max_history = get_max_history();
+    if (max_history < 0)
+    {
+        add_to_history(line);
+        return;
+    }
+
+    get_history_db_file_name(buffer, sizeof(buffer));
+    if (!open_history_file(buffer, &file))
+    {
+        add_to_history(line);
+        return;
+    }
+
+    sync_history(&file, 1);
+    if (add_to_readline_history(line))
+    {
+        cwd[0] = '\0';
+        GetCurrentDirectory(sizeof_array(cwd), cwd);
+
+        now = (unsigned)time(NULL);
+        history_buffer_init(&records);
+        ordinal = history_db_add(&g_history_db, &records, line, now, cwd, 0, 0);
+        g_history_mirrored = g_history_db.entry_count;
+
+        // If the line couldn't be written it's kept to try again at exit.
+        if (ordinal >= 0 && history_db_append(&g_history_db, &file, &records))
+        {
+            g_last_ordinal = ordinal;
+        }
+        else
+        {
+            add_pending_line(line, now, cwd);
+        }
+
+        history_buffer_free(&records);
+    }
+
+    history_db_close(&file);
+
+    if (max_history != INT_MAX && g_history_db.first_ordinal +
+        g_history_db.entry_count - HISTORY_SLACK(max_history) > max_history)
+    {
+        compact_in_background(buffer, max_history);
+    }
+
+    using_history();
+}
+
+//------------------------------------------------------------------------------
+static void update_history_rank()
+{
+    // Feeds the rank any lines it hasn't seen yet, oldest first. Pending lines
+    // are newer than the file's so if the file's grown since they were fed
+    // the rank's rebuilt to keep the order right.
+
+    const history_entry_t* entry;
+    const char* cwd;
+    int i;
+
+    if (g_ranked_pending > g_pending_db.entry_count ||
+        (g_ranked_pending > 0 && g_ranked_entries < g_history_db.entry_count))
+    {
+        reset_history_rank();
+    }
+
+    for (i = g_ranked_entries; i < g_history_db.entry_count; ++i)
+    {
+        entry = g_history_db.entries + i;
+        if (!history_rank_add(&g_history_rank, history_db_line(&g_history_db, i),
+            entry->cwd))
+        {
+            reset_history_rank();
+            return;
+        }
+    }
+    g_ranked_entries = g_history_db.entry_count;
+
+    // Pending lines' cwd ids are their own so they're mapped to the file's.
+    for (i = g_ranked_pending; i < g_pending_db.entry_count; ++i)
+    {
+        entry = g_pending_db.entries + i;
+        cwd = history_db_cwd(&g_pending_db, entry->cwd);
+        if (!history_rank_add(&g_history_rank, history_db_line(&g_pending_db, i),
+            (cwd != NULL) ? history_db_find_cwd(&g_history_db, cwd) : -1))
+        {
+            reset_history_rank();
+            return;
+        }
+    }
+    g_ranked_pending = g_pending_db.entry_count;
+}
+
+//------------------------------------------------------------------------------
+char** get_ranked_history(int* count)
+{
+    // Readline's 'rl_history_rank_hook'. Returns the distinct history lines
+    // best first for the current directory, or NULL to search as usual.
+
+    char cwd[MAX_PATH];
+    char** lines;
+    int cwd_id;
+    int n;
+    int i;
+
+    if (get_clink_setting_int("history_rank") <= 0)
+    {
+        return NULL;
+    }
+
+    update_history_rank();
+
+    cwd[0] = '\0';
+    GetCurrentDirectory(sizeof_array(cwd), cwd);
+    cwd_id = history_db_find_cwd(&g_history_db, cwd);
+
+    n = history_rank_score(&g_history_rank, cwd_id);
+    if (n <= 0)
+    {
+        return NULL;
+    }
+
+    if (n > g_ranked_lines_size)
+    {
+        lines = realloc(g_ranked_lines, n * sizeof(char*));
+        if (lines == NULL)
+        {
+            return NULL;
+        }
+
+        g_ranked_lines = lines;
+        g_ranked_lines_size = n;
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        g_ranked_lines[i] = (char*)history_rank_line(&g_history_rank, i);
+    }
+
+    *count = n;
+    return g_ranked_lines;
 }
 
 //------------------------------------------------------------------------------
@@ -20,7 +20,16 @@
  */
 
 #include "pch.h"
+#include "aliases.h"
+#include "cmd_tokens.h"
+#include "compat/casefold.h"
+#include "env_names.h"
 #include "inject_args.h"
+#include "lua_alloc.h"
+#include "lua_strings.h"
+#include "match_info.h"
+#include "stats.h"
+#include "shared/str_builder.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
@@ -29,6 +38,11 @@ const char*             get_clink_setting_str(const char*);
 int                     get_clink_setting_int(const char*);
 int                     rl_add_funmap_entry(const char*, int (*)(int, int));
 int                     lua_execute(lua_State* state);
+int                     lua_execute_async(lua_State* state);
+int                     lua_poll_async(lua_State* state);
+void                    reap_async_execs();
+int                     lua_fuzzy_score(lua_State* state);
+int                     lua_fuzzy_rank(lua_State* state);
 
 extern inject_args_t    g_inject_args;
 extern int              rl_filename_completion_desired;
@@ -39,6 +53,78 @@ extern int              _rl_completion_case_map;
 extern int              g_slash_translation;
 extern char*            rl_variable_value(const char*);
 static lua_State*       g_lua                        = NULL;
+static int              g_gc_base                    = 0;
+static int              g_gc_wanted                  = 0;
+static int              g_prompt_pending             = 0;
+
+//------------------------------------------------------------------------------
+#define GC_PAUSE        150     // % growth before collecting when idle
+#define GC_LIMIT        400     // % growth before collecting regardless
+#define GC_LIMIT_MIN    4096    // KB
+#define GC_STEP_KB      32
+
+//------------------------------------------------------------------------------
+static int panic(lua_State* state)
+{
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n",
+        lua_tostring(state, -1));
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static void gc_after_activity()
+{
+    // Lua's collector is kept stopped so it doesn't pause completion or the
+    // prompt. It is stepped while waiting for input instead (see lua_idle_gc()).
+    // If the heap grows too much before there's any idle time the collector is
+    // allowed to run as normal until its next cycle finishes.
+
+    int kb;
+    int limit;
+
+    kb = lua_gc(g_lua, LUA_GCCOUNT, 0);
+    if (kb * 100 >= g_gc_base * GC_PAUSE)
+    {
+        g_gc_wanted = 1;
+    }
+
+    limit = (g_gc_base * GC_LIMIT) / 100;
+    limit = (limit > GC_LIMIT_MIN) ? limit : GC_LIMIT_MIN;
+    if (kb > limit)
+    {
+        lua_gc(g_lua, LUA_GCRESTART, 0);
+        g_gc_wanted = 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+int lua_idle_gc()
+{
+    // Advances Lua's collector by a step. Returns non-zero while a cycle is
+    // still in progress.
+
+    double started;
+
+    if (g_lua == NULL || !g_gc_wanted)
+    {
+        return 0;
+    }
+
+    started = stats_clock();
+    if (lua_gc(g_lua, LUA_GCSTEP, GC_STEP_KB))
+    {
+        lua_gc(g_lua, LUA_GCSTOP, 0);
+        g_gc_base = lua_gc(g_lua, LUA_GCCOUNT, 0);
+        g_gc_wanted = 0;
+    }
+
+    if (stats_enabled())
+    {
+        stats_record("gc:idle_step", started, 0, 0);
+    }
+
+    return g_gc_wanted;
+}
 
 //------------------------------------------------------------------------------
 static void load_lua_script(const char* script)
@@ -56,25 +142,26 @@ static void load_lua_script(const char* script)
 static void load_lua_scripts(const char* path)
 {
     int i;
-    char path_buf[1024];
+    str_builder_t path_buf;
     HANDLE find;
     WIN32_FIND_DATA fd;
 
-    str_cpy(path_buf, path, sizeof_array(path_buf));
-    str_cat(path_buf, "\\", sizeof_array(path_buf));
-    i = strlen(path_buf);
+    str_builder_init(&path_buf);
+    str_builder_append(&path_buf, path);
+    str_builder_join_path(&path_buf, "");
+    i = path_buf.length;
 
-    str_cat(path_buf, "*.lua", sizeof_array(path_buf));
-    find = FindFirstFile(path_buf, &fd);
-    path_buf[i] = '\0';
+    str_builder_append(&path_buf, "*.lua");
+    find = FindFirstFile(path_buf.data, &fd);
+    str_builder_truncate(&path_buf, i);
 
     while (find != INVALID_HANDLE_VALUE)
     {
         if (_stricmp(fd.cFileName, "clink.lua") != 0)
         {
-            str_cat(path_buf, fd.cFileName, sizeof_array(path_buf));
-            load_lua_script(path_buf);
-            path_buf[i] = '\0';
+            str_builder_append(&path_buf, fd.cFileName);
+            load_lua_script(path_buf.data);
+            str_builder_truncate(&path_buf, i);
         }
 
         if (FindNextFile(find, &fd) == FALSE)
@@ -83,6 +170,8 @@ static void load_lua_scripts(const char* path)
             break;
         }
     }
+
+    str_builder_free(&path_buf);
 }
 
 //------------------------------------------------------------------------------
@@ -93,6 +182,7 @@ char** lua_match_display_filter(char** matches, int match_count)
     // displaying the matches. So matches[1...n] are useful.
 
     char** new_matches;
+    double started;
     int top;
     int i;
 
@@ -113,6 +203,7 @@ char** lua_match_display_filter(char** matches, int match_count)
     }
 
     // Convert matches to a Lua table.
+    started = stats_clock();
     lua_createtable(g_lua, match_count, 0);
     for (i = 1; i < match_count; ++i)
     {
@@ -127,6 +218,11 @@ char** lua_match_display_filter(char** matches, int match_count)
         goto done;
     }
 
+    if (stats_enabled())
+    {
+        stats_record("display_filter", started, match_count - 1, 0);
+    }
+
     // Convert table returned by the Lua filter function to C.
     new_matches = (char**)calloc(match_count + 1, sizeof(*new_matches));
     for (i = 0; i < match_count; ++i)
@@ -155,13 +251,20 @@ done:
     return new_matches;
 }
 
+//------------------------------------------------------------------------------
+static int get_casefold_flags()
+{
+    // How clink.lower() and clink.is_prefix() fold strings.
+    return CASEFOLD_CASE | (_rl_completion_case_map ? CASEFOLD_MAP : 0);
+}
+
 //------------------------------------------------------------------------------
 static int to_lowercase(lua_State* state)
 {
     const char* string;
+    size_t length;
+    luaL_Buffer buffer;
     char* lowered;
-    int length;
-    int i;
 
     // Check we've got at least one argument...
     if (lua_gettop(state) == 0)
@@ -175,39 +278,120 @@ static int to_lowercase(lua_State* state)
         return 0;
     }
     
-    string = lua_tostring(state, 1);
-    length = (int)strlen(string);
+    string = lua_tolstring(state, 1, &length);
+
+    lowered = luaL_buffinitsize(state, &buffer, length);
+    casefold_lower(lowered, string, (int)length, get_casefold_flags());
+    luaL_pushresultsize(&buffer, length);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int is_prefix(lua_State* state)
+{
+    // clink.is_prefix(needle, candidate); returns true if 'candidate' starts
+    // with 'needle', compared as clink.lower() would see them.
+
+    const char* needle;
+    const char* candidate;
+    size_t needle_length;
+    size_t candidate_length;
+
+    if (lua_gettop(state) < 2 || !lua_isstring(state, 1) || !lua_isstring(state, 2))
+    {
+        return 0;
+    }
+
+    needle = lua_tolstring(state, 1, &needle_length);
+    candidate = lua_tolstring(state, 2, &candidate_length);
+
+    lua_pushboolean(state, candidate_length >= needle_length &&
+        casefold_compare(needle, candidate, (int)needle_length,
+            get_casefold_flags()) == 0);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static void push_tokens(lua_State* state, const char* line, int length)
+{
+    // Pushes a table of the line's tokens. Each is a table; first, last (both
+    // 1-based and inclusive like string.sub()), type ("word", "separator", or
+    // "redirect"), text (unquoted and unescaped), and quoted, open_quote,
+    // command, and target flags that are only present when set.
+
+    static const char* types[] = { "word", "separator", "redirect" };
+    static const struct {
+        int         flag;
+        const char* name;
+    } flags[] = {
+        { CMD_TOKEN_QUOTED,     "quoted" },
+        { CMD_TOKEN_OPEN_QUOTE, "open_quote" },
+        { CMD_TOKEN_COMMAND,    "command" },
+        { CMD_TOKEN_TARGET,     "target" },
+    };
+
+    cmd_tokens_t tokens;
+    str_builder_t text;
+    int count;
+    int i;
+    int j;
+
+    cmd_tokens_init(&tokens);
+    str_builder_init(&text);
 
-    lowered = (char*)malloc(length + 1);
-    if (_rl_completion_case_map)
+    count = cmd_tokenise(&tokens, line, length);
+    lua_createtable(state, count, 0);
+    for (i = 0; i < count; ++i)
     {
-        for (i = 0; i <= length; ++i)
+        const cmd_token_t* token = tokens.tokens + i;
+
+        str_builder_clear(&text);
+        cmd_token_text(token, line, &text);
+
+        lua_createtable(state, 0, 5);
+
+        lua_pushinteger(state, token->start + 1);
+        lua_setfield(state, -2, "first");
+
+        lua_pushinteger(state, token->start + token->length);
+        lua_setfield(state, -2, "last");
+
+        lua_pushstring(state, types[token->type]);
+        lua_setfield(state, -2, "type");
+
+        lua_pushlstring(state, text.data, text.length);
+        lua_setfield(state, -2, "text");
+
+        for (j = 0; j < (int)sizeof_array(flags); ++j)
         {
-            char c = string[i];
-            if (c == '-')
+            if (token->flags & flags[j].flag)
             {
-                c = '_';
+                lua_pushboolean(state, 1);
+                lua_setfield(state, -2, flags[j].name);
             }
-            else
-            {
-                c = tolower(c);
-            }
-
-            lowered[i] = c;
         }
+
+        lua_rawseti(state, -2, i + 1);
     }
-    else
+
+    str_builder_free(&text);
+    cmd_tokens_free(&tokens);
+}
+
+//------------------------------------------------------------------------------
+static int tokenise(lua_State* state)
+{
+    const char* line;
+    size_t length;
+
+    if (lua_gettop(state) == 0 || !lua_isstring(state, 1))
     {
-        for (i = 0; i <= length; ++i)
-        {
-            char c = string[i];
-            lowered[i] = tolower(c);
-        }
+        return 0;
     }
 
-    lua_pushstring(state, lowered);
-    free(lowered);
-
+    line = lua_tolstring(state, 1, &length);
+    push_tokens(state, line, (int)length);
     return 1;
 }
 
@@ -216,11 +400,14 @@ static int find_files_impl(lua_State* state, int dirs_only)
 {
     DIR* dir;
     struct dirent* entry;
-    char buffer[512];
+    str_builder_t buffer;
+    str_builder_t types;
+    lua_strings_t results;
     const char* mask;
     const char* mask_file;
     int i;
-    int case_map;
+    int packed;
+    int with_types;
 
     // Check arguments.
     i = lua_gettop(state);
@@ -231,18 +418,19 @@ static int find_files_impl(lua_State* state, int dirs_only)
 
     mask = lua_tostring(state, 1);
     mask_file = NULL;
+    str_builder_init(&buffer);
 
     // Should the mask be adjusted for -/_ case mapping?
     if (_rl_completion_case_map && i > 1 && lua_toboolean(state, 2))
     {
         char* slash;
 
-        str_cpy(buffer, mask, sizeof_array(buffer));
-        mask = buffer;
+        str_builder_append(&buffer, mask);
+        mask = buffer.data;
 
-        slash = strrchr(buffer, '\\');
-        slash = slash ? slash : strrchr(buffer, '/');
-        slash = slash ? slash + 1 : buffer;
+        slash = strrchr(buffer.data, '\\');
+        slash = slash ? slash : strrchr(buffer.data, '/');
+        slash = slash ? slash + 1 : buffer.data;
 
         while (*slash)
         {
@@ -261,7 +449,23 @@ static int find_files_impl(lua_State* state, int dirs_only)
         mask_file = (mask_file == NULL) ? mask : mask_file + 1;
     }
     
-    lua_createtable(state, 0, 0);
+    // Callers that only iterate the results can ask for them packed into a
+    // single userdata rather than a table.
+    packed = (lua_gettop(state) > 2 && lua_toboolean(state, 3));
+
+    // They can also ask for a second result, a string with a character for
+    // each entry's type; 'd' for directories and 'f' for everything else.
+    with_types = (lua_gettop(state) > 3 && lua_toboolean(state, 4));
+    str_builder_init(&types);
+
+    if (packed)
+    {
+        lua_strings_init(&results);
+    }
+    else
+    {
+        lua_createtable(state, 0, 0);
+    }
 
     i = 1;
     dir = opendir(mask);
@@ -301,24 +505,255 @@ static int find_files_impl(lua_State* state, int dirs_only)
                 continue;
         }
 
-        lua_pushstring(state, entry->d_name);
-        lua_rawseti(state, -2, i++);
+        if (packed)
+        {
+            lua_strings_add(&results, entry->d_name, -1);
+        }
+        else
+        {
+            lua_pushstring(state, entry->d_name);
+            lua_rawseti(state, -2, i++);
+        }
+
+        if (with_types)
+        {
+            str_builder_append_c(&types, (entry->attrib & _A_SUBDIR) ? 'd' : 'f');
+        }
     }
     closedir(dir);
+    str_builder_free(&buffer);
 
-    return 1;
+    if (packed)
+    {
+        lua_strings_push(state, &results);
+        lua_strings_free(&results);
+    }
+
+    if (with_types)
+    {
+        lua_pushlstring(state, types.data, types.length);
+    }
+    str_builder_free(&types);
+
+    return 1 + with_types;
+}
+
+//------------------------------------------------------------------------------
+static int record_native(lua_State* state, const char* probe, double started,
+    int ret)
+{
+    // Natives that return tables count their size as the number of matches.
+
+    int count;
+
+    if (!stats_enabled())
+    {
+        return ret;
+    }
+
+    count = 0;
+    if (ret > 0 && lua_istable(state, -ret))
+    {
+        count = (int)lua_rawlen(state, -ret);
+    }
+    else if (ret > 0 && lua_isuserdata(state, -ret))
+    {
+        count = (int)luaL_len(state, -ret);
+    }
+
+    stats_record(probe, started, count, 0);
+    return ret;
 }
 
 //------------------------------------------------------------------------------
 static int find_files(lua_State* state)
 {
-    return find_files_impl(state, 0);
+    double started = stats_clock();
+    int ret = find_files_impl(state, 0);
+    return record_native(state, "native:find_files", started, ret);
 }
 
 //------------------------------------------------------------------------------
 static int find_dirs(lua_State* state)
 {
-    return find_files_impl(state, 1);
+    double started = stats_clock();
+    int ret = find_files_impl(state, 1);
+    return record_native(state, "native:find_dirs", started, ret);
+}
+
+//------------------------------------------------------------------------------
+static int execute(lua_State* state)
+{
+    double started = stats_clock();
+    int ret = lua_execute(state);
+    return record_native(state, "native:execute", started, ret);
+}
+
+//------------------------------------------------------------------------------
+static int execute_async(lua_State* state)
+{
+    double started = stats_clock();
+    int ret = lua_execute_async(state);
+    return record_native(state, "native:execute_async", started, ret);
+}
+
+//------------------------------------------------------------------------------
+static double get_lua_memory(lua_State* state)
+{
+    double kb = lua_gc(state, LUA_GCCOUNT, 0);
+    return kb + (lua_gc(state, LUA_GCCOUNTB, 0) / 1024.0);
+}
+
+//------------------------------------------------------------------------------
+static int stats_enabled_lua(lua_State* state)
+{
+    lua_pushboolean(state, stats_enabled());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int stats_clock_lua(lua_State* state)
+{
+    lua_pushnumber(state, stats_clock());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int stats_record_lua(lua_State* state)
+{
+    // Args are; probe name, the stats_clock() the probe started at, match count
+    // and the change in Lua's memory use (in KB).
+
+    const char* probe;
+    double started;
+    int matches;
+    double memory;
+
+    if (lua_gettop(state) < 2 || !lua_isstring(state, 1))
+    {
+        return 0;
+    }
+
+    probe = lua_tostring(state, 1);
+    started = lua_tonumber(state, 2);
+    matches = (int)luaL_optinteger(state, 3, 0);
+    memory = luaL_optnumber(state, 4, 0);
+
+    stats_record(probe, started, matches, memory);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int get_memory_stats(lua_State* state)
+{
+    // Returns how the Lua state's using memory; the heap's size as Lua sees it
+    // (KB), the allocator's view (bytes) and its pools, and the collector's
+    // state.
+
+    lua_pool_stats_t stats;
+    int i;
+
+    lua_createtable(state, 0, 8);
+    lua_pool_get_stats(&stats);
+
+    lua_pushnumber(state, get_lua_memory(state));
+    lua_setfield(state, -2, "heap");
+
+    lua_pushnumber(state, (lua_Number)stats.bytes);
+    lua_setfield(state, -2, "bytes");
+
+    lua_pushnumber(state, (lua_Number)stats.peak);
+    lua_setfield(state, -2, "peak");
+
+    lua_pushnumber(state, (lua_Number)stats.reserved);
+    lua_setfield(state, -2, "reserved");
+
+    lua_pushinteger(state, stats.large_allocs);
+    lua_setfield(state, -2, "large_allocs");
+
+    lua_createtable(state, LUA_POOL_CLASSES, 0);
+    for (i = 0; i < LUA_POOL_CLASSES; ++i)
+    {
+        lua_createtable(state, 0, 3);
+
+        lua_pushinteger(state, stats.classes[i].size);
+        lua_setfield(state, -2, "size");
+
+        lua_pushinteger(state, stats.classes[i].allocs);
+        lua_setfield(state, -2, "allocs");
+
+        lua_pushinteger(state, stats.classes[i].in_use);
+        lua_setfield(state, -2, "in_use");
+
+        lua_rawseti(state, -2, i + 1);
+    }
+    lua_setfield(state, -2, "pools");
+
+    lua_pushinteger(state, g_gc_base);
+    lua_setfield(state, -2, "gc_base");
+
+    lua_pushboolean(state, g_gc_wanted);
+    lua_setfield(state, -2, "gc_wanted");
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int get_stats(lua_State* state)
+{
+    // Returns a table of probe tables keyed by probe name. Passing true resets
+    // the stats once they've been collected.
+
+    int count;
+    int i;
+    int j;
+
+    count = stats_count();
+    lua_createtable(state, 0, count);
+    for (i = 0; i < count; ++i)
+    {
+        const stats_probe_t* probe = stats_get(i);
+
+        lua_createtable(state, 0, 9);
+
+        lua_pushinteger(state, probe->calls);
+        lua_setfield(state, -2, "calls");
+
+        lua_pushnumber(state, probe->total);
+        lua_setfield(state, -2, "total");
+
+        lua_pushnumber(state, probe->max);
+        lua_setfield(state, -2, "max");
+
+        lua_pushnumber(state, stats_percentile(probe, 50));
+        lua_setfield(state, -2, "p50");
+
+        lua_pushnumber(state, stats_percentile(probe, 90));
+        lua_setfield(state, -2, "p90");
+
+        lua_pushinteger(state, probe->matches);
+        lua_setfield(state, -2, "matches");
+
+        lua_pushnumber(state, probe->memory);
+        lua_setfield(state, -2, "memory");
+
+        lua_createtable(state, STATS_BUCKETS, 0);
+        for (j = 0; j < STATS_BUCKETS; ++j)
+        {
+            lua_pushinteger(state, probe->histogram[j]);
+            lua_rawseti(state, -2, j + 1);
+        }
+        lua_setfield(state, -2, "histogram");
+
+        lua_setfield(state, -2, probe->name);
+    }
+
+    if (lua_toboolean(state, 1))
+    {
+        stats_reset();
+    }
+
+    return 1;
 }
 
 //------------------------------------------------------------------------------
@@ -394,40 +829,75 @@ static int get_env(lua_State* state)
 //------------------------------------------------------------------------------
 static int get_env_var_names(lua_State* state)
 {
-    char* env_strings;
-    int i = 1;
+    const alias_table_t* table;
+    int i;
+
+    table = get_env_names();
 
-    lua_createtable(state, 0, 0);
-    env_strings = GetEnvironmentStrings();
-    if (env_strings != NULL)
+    lua_createtable(state, table->count, 0);
+    for (i = 0; i < table->count; ++i)
     {
-        char* string = env_strings;
+        lua_pushstring(state, table->aliases[i].name_utf8);
+        lua_rawseti(state, -2, i + 1);
+    }
 
-        while (*string)
-        {
-            char* eq = strchr(string, L'=');
-            if (eq != NULL)
-            {
-                size_t length = eq - string + 1;
-                char name[1024];
+    return 1;
+}
 
-                length = length < sizeof_array(name) ? length : sizeof_array(name);
-                --length;
-                if (length > 0)
-                {
-                    strncpy(name, string, length);
-                    name[length] = L'\0';
+//------------------------------------------------------------------------------
+static int get_env_var_matches(lua_State* state)
+{
+    // Returns "%name%" (lower cased) for each environment variable that starts
+    // with 'part', which should have already been through clink.lower().
+
+    const alias_table_t* table;
+    const char* part;
+    str_builder_t match;
+    int part_length;
+    int first;
+    int count;
+    int i;
+    int j;
 
-                    lua_pushstring(state, name);
-                    lua_rawseti(state, -2, i++);
-                }
-            }
+    if (lua_gettop(state) == 0 || !lua_isstring(state, 1))
+    {
+        return 0;
+    }
+
+    part = lua_tostring(state, 1);
+    part_length = (int)strlen(part);
 
-            string += strlen(string) + 1;
+    table = get_env_names();
+    count = alias_table_prefix(table, part, &first);
+
+    str_builder_init(&match);
+    lua_createtable(state, count, 0);
+    for (i = j = 0; i < count; ++i)
+    {
+        const alias_t* env = table->aliases + first + i;
+        char* c;
+
+        // The index always treats '-' and '_' as equal.
+        if (!_rl_completion_case_map &&
+            _strnicmp(env->name_utf8, part, part_length) != 0)
+        {
+            continue;
         }
 
-        FreeEnvironmentStrings(env_strings);
+        str_builder_clear(&match);
+        str_builder_append_c(&match, '%');
+        str_builder_append(&match, env->name_utf8);
+        str_builder_append_c(&match, '%');
+
+        for (c = match.data; *c; ++c)
+        {
+            *c = tolower((unsigned char)*c);
+        }
+
+        lua_pushstring(state, match.data);
+        lua_rawseti(state, -2, ++j);
     }
+    str_builder_free(&match);
 
     return 1;
 }
@@ -614,60 +1084,252 @@ static int get_cwd(lua_State* state)
 }
 
 //------------------------------------------------------------------------------
-static int get_console_aliases(lua_State* state)
+// Directory watches for clink.has_dir_changed(). Only a handful of directories
+// are watched at once; the oldest watch is dropped to make room for new ones.
+typedef struct
+{
+    HANDLE      dir;
+    OVERLAPPED  overlapped;
+    int         hash;
+    DWORD       buffer[1024];
+} dir_watch_t;
+
+static dir_watch_t      g_dir_watches[8];
+static int              g_next_dir_watch             = 0;
+
+//------------------------------------------------------------------------------
+static int read_dir_watch(dir_watch_t* watch)
+{
+    return ReadDirectoryChangesW(
+        watch->dir, watch->buffer, sizeof(watch->buffer), TRUE,
+        FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|
+        FILE_NOTIFY_CHANGE_LAST_WRITE,
+        NULL, &watch->overlapped, NULL
+    );
+}
+
+//------------------------------------------------------------------------------
+static void close_dir_watch(dir_watch_t* watch)
 {
-    char* buffer = NULL;
+    DWORD bytes;
 
-    do
+    if (watch->dir == NULL)
     {
-        int i;
-        int buffer_size;
-        char* alias;
+        return;
+    }
 
-        lua_createtable(state, 0, 0);
+    // The buffer is in use until the cancelled read completes.
+    CancelIo(watch->dir);
+    GetOverlappedResult(watch->dir, &watch->overlapped, &bytes, TRUE);
+
+    CloseHandle(watch->dir);
+    CloseHandle(watch->overlapped.hEvent);
+    watch->dir = NULL;
+}
+
+//------------------------------------------------------------------------------
+static int open_dir_watch(dir_watch_t* watch, const char* path)
+{
+    watch->dir = CreateFile(path, FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL
+    );
+
+    if (watch->dir == INVALID_HANDLE_VALUE)
+    {
+        watch->dir = NULL;
+        return 0;
+    }
+
+    memset(&watch->overlapped, 0, sizeof(watch->overlapped));
+    watch->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!read_dir_watch(watch))
+    {
+        close_dir_watch(watch);
+        return 0;
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int is_git_path(const WCHAR* name, int length)
+{
+    // Git updates files under .git (the index, lock files) even when it's only
+    // asked for status, which would otherwise invalidate a git prompt segment
+    // every time it's computed. Nested repositories and submodules have their
+    // own .git so any path component is checked, not just the first.
+
+    static const WCHAR git[] = L".git";
+    int start;
+    int i;
 
-#if !defined(__MINGW32__) && !defined(__MINGW64__)
-        // Get the aliases (aka. doskey macros).
-        buffer_size = GetConsoleAliasesLength((char*)rl_readline_name);
-        if (buffer_size == 0)
+    start = 0;
+    while (start < length)
+    {
+        int end = start;
+        while (end < length && name[end] != L'\\')
         {
-            break;
+            ++end;
         }
 
-        buffer = malloc(buffer_size + 1);
-        if (GetConsoleAliases(buffer, buffer_size, rl_readline_name) == 0)
+        if (end - start == 4)
         {
-            break;
+            for (i = 0; i < 4; ++i)
+            {
+                WCHAR c = name[start + i];
+                if (c >= L'A' && c <= L'Z')
+                {
+                    c += L'a' - L'A';
+                }
+
+                if (c != git[i])
+                {
+                    break;
+                }
+            }
+
+            if (i == 4)
+            {
+                return 1;
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int check_dir_watch(dir_watch_t* watch)
+{
+    // Drains the notifications that have arrived, re-arming the read after
+    // each batch. Returns non-zero if any were for something outside a .git directory.
+
+    int changed = 0;
+
+    while (WaitForSingleObject(watch->overlapped.hEvent, 0) == WAIT_OBJECT_0)
+    {
+        FILE_NOTIFY_INFORMATION* info;
+        DWORD bytes = 0;
+
+        if (!GetOverlappedResult(watch->dir, &watch->overlapped, &bytes, FALSE))
+        {
+            bytes = 0;
         }
 
-        buffer[buffer_size] = '\0';
+        // No bytes means the buffer overflowed and the details were lost.
+        if (bytes == 0)
+        {
+            changed = 1;
+        }
 
-        // Parse the result into a lua table.
-        alias = buffer;
-        i = 1;
-        while (*alias != '\0')
+        info = (FILE_NOTIFY_INFORMATION*)(watch->buffer);
+        while (bytes != 0 && !changed)
         {
-            char* c = strchr(alias, '=');
-            if (c == NULL)
+            int length = info->FileNameLength / sizeof(WCHAR);
+            changed = !is_git_path(info->FileName, length);
+
+            if (info->NextEntryOffset == 0)
             {
                 break;
             }
 
-            *c = '\0';
-            lua_pushstring(state, alias);
-            lua_rawseti(state, -2, i++);
+            info = (FILE_NOTIFY_INFORMATION*)((char*)info + info->NextEntryOffset);
+        }
 
-            ++c;
-            alias = c + strlen(c) + 1;
+        ResetEvent(watch->overlapped.hEvent);
+        if (!read_dir_watch(watch))
+        {
+            close_dir_watch(watch);
+            return 1;
         }
-#endif // !__MINGW32__ && !__MINGW64__
     }
-    while (0);
 
-    free(buffer);
+    return changed;
+}
+
+//------------------------------------------------------------------------------
+static int has_dir_changed(lua_State* state)
+{
+    // Returns true if anything in or below the given directory has changed
+    // since the last time this was asked about it, ignoring changes inside
+    // .git directories. The first call starts the watch.
+
+    const char* path;
+    dir_watch_t* watch;
+    int hash;
+    int i;
+
+    if (lua_gettop(state) == 0 || !lua_isstring(state, 1))
+    {
+        return 0;
+    }
+
+    path = lua_tostring(state, 1);
+    hash = hash_string(path);
+
+    for (i = 0; i < sizeof_array(g_dir_watches); ++i)
+    {
+        watch = g_dir_watches + i;
+        if (watch->dir != NULL && watch->hash == hash)
+        {
+            lua_pushboolean(state, check_dir_watch(watch));
+            return 1;
+        }
+    }
+
+    // Not watching this one yet.
+    watch = g_dir_watches + g_next_dir_watch;
+    g_next_dir_watch = (g_next_dir_watch + 1) % sizeof_array(g_dir_watches);
+
+    close_dir_watch(watch);
+    watch->hash = hash;
+    open_dir_watch(watch, path);
+
+    lua_pushboolean(state, 0);
     return 1;
 }
 
+//------------------------------------------------------------------------------
+static int get_console_aliases(lua_State* state)
+{
+    // Returns the names of the console's aliases (aka. doskey macros), or just
+    // those that start with the optional prefix. The alias cache's generation
+    // is also returned so callers can tell if the aliases have changed.
+
+    const alias_table_t* table;
+    const char* prefix;
+    int generation;
+    int first;
+    int count;
+    int i;
+
+    table = get_alias_cache(&generation);
+
+    prefix = (lua_gettop(state) > 0) ? lua_tostring(state, 1) : NULL;
+    if (prefix != NULL)
+    {
+        count = alias_table_prefix(table, prefix, &first);
+    }
+    else
+    {
+        first = 0;
+        count = table->count;
+    }
+
+    lua_createtable(state, count, 0);
+    for (i = 0; i < count; ++i)
+    {
+        lua_pushstring(state, table->aliases[first + i].name_utf8);
+        lua_rawseti(state, -2, i + 1);
+    }
+
+    lua_pushinteger(state, generation);
+    return 2;
+}
+
 //------------------------------------------------------------------------------
 static int get_screen_info(lua_State* state)
 {
@@ -711,30 +1373,43 @@ static int get_screen_info(lua_State* state)
 lua_State* initialise_lua()
 {
     static int once = 0;
-    int i;
     int path_hash;
     char buffer[1024];
+    str_builder_t script;
     struct luaL_Reg clink_native_methods[] = {
         { "chdir", change_dir },
-        { "execute", lua_execute },
+        { "execute", execute },
+        { "execute_async", execute_async },
         { "find_dirs", find_dirs },
         { "find_files", find_files },
+        { "fuzzy_rank", lua_fuzzy_rank },
+        { "fuzzy_score", lua_fuzzy_score },
         { "get_console_aliases", get_console_aliases },
         { "get_cwd", get_cwd },
         { "get_env", get_env },
+        { "get_env_var_matches", get_env_var_matches },
         { "get_env_var_names", get_env_var_names },
         { "get_host_process", get_host_process },
         { "get_rl_variable", get_rl_variable },
         { "get_screen_info", get_screen_info },
         { "get_setting_int", get_setting_int },
         { "get_setting_str", get_setting_str },
+        { "has_dir_changed", has_dir_changed },
         { "is_dir", is_dir },
+        { "is_prefix", is_prefix },
         { "is_rl_variable_true", is_rl_variable_true },
         { "lower", to_lowercase },
         { "matches_are_files", matches_are_files },
+        { "memory_stats", get_memory_stats },
+        { "poll_async", lua_poll_async },
         { "slash_translation", slash_translation },
+        { "stats", get_stats },
+        { "stats_clock", stats_clock_lua },
+        { "stats_enabled", stats_enabled_lua },
+        { "stats_record", stats_record_lua },
         { "suppress_char_append", suppress_char_append },
         { "suppress_quoting", suppress_quoting },
+        { "tokenise", tokenise },
         { NULL, NULL }
     };
 
@@ -744,7 +1419,8 @@ lua_State* initialise_lua()
     }
 
     // Initialise Lua.
-    g_lua = luaL_newstate();
+    g_lua = lua_newstate(lua_pool_alloc, NULL);
+    lua_atpanic(g_lua, panic);
     luaL_openlibs(g_lua);
 
     // Add our API.
@@ -762,17 +1438,17 @@ lua_State* initialise_lua()
     }
     else
     {
-        buffer[0] = '\0';
-        str_cat(buffer, g_inject_args.script_path, sizeof_array(buffer));
+        str_cpy(buffer, g_inject_args.script_path, sizeof_array(buffer));
     }
 
     path_hash = hash_string(buffer);
-    i = (int)strlen(buffer);
 
-    str_cat(buffer, "/clink.lua", sizeof_array(buffer));
-    load_lua_script(buffer);
+    str_builder_init(&script);
+    str_builder_append(&script, buffer);
+    str_builder_join_path(&script, "clink.lua");
+    load_lua_script(script.data);
+    str_builder_free(&script);
 
-    buffer[i] = '\0';
     load_lua_scripts(buffer);
 
     get_config_dir(buffer, sizeof(buffer));
@@ -787,6 +1463,12 @@ lua_State* initialise_lua()
         once = 1;
     }
 
+    // Start off with a clean heap and take over when the collector runs.
+    lua_gc(g_lua, LUA_GCCOLLECT, 0);
+    lua_gc(g_lua, LUA_GCSTOP, 0);
+    g_gc_base = lua_gc(g_lua, LUA_GCCOUNT, 0);
+    g_gc_wanted = 0;
+
     return g_lua;
 }
 
@@ -800,18 +1482,60 @@ void shutdown_lua()
 
     lua_close(g_lua);
     g_lua = NULL;
+
+    lua_pool_reset();
 }
 
 //------------------------------------------------------------------------------
-char** lua_generate_matches(const char* text, int start, int end)
+static void collect_match_info(lua_State* state, match_info_table_t* infos)
+{
+    // Copies the records clink.add_match{...} kept in the table on the top of
+    // the stack, which is keyed by the matches' text.
+
+    if (!lua_istable(state, -1))
+    {
+        return;
+    }
+
+    lua_pushnil(state);
+    while (lua_next(state, -2) != 0)
+    {
+        if (lua_type(state, -2) == LUA_TSTRING && lua_istable(state, -1))
+        {
+            const char* display;
+            const char* suffix;
+            int type;
+
+            lua_getfield(state, -1, "display");
+            lua_getfield(state, -2, "suffix");
+            lua_getfield(state, -3, "type");
+            display = lua_isstring(state, -3) ? lua_tostring(state, -3) : NULL;
+            suffix = lua_isstring(state, -2) ? lua_tostring(state, -2) : NULL;
+            type = match_info_type(lua_tostring(state, -1));
+
+            match_info_add(infos, lua_tostring(state, -5), display, suffix, type);
+            lua_pop(state, 3);
+        }
+
+        lua_pop(state, 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+static char** generate_matches(const char* text, int start, int end)
 {
     int match_count;
     int use_matches;
+    int ranked;
     int i;
     char** matches = NULL;
 
-    // Expose some of the readline state to lua.
-    lua_createtable(g_lua, 2, 0);
+    rl_sort_completion_matches = 1;
+    match_info_clear(get_match_infos());
+
+    // Expose some of the readline state to lua. The line's tokenised up to
+    // the point being completed, once, for all the generators to share.
+    lua_createtable(g_lua, 0, 3);
 
     lua_pushliteral(g_lua, "line_buffer");
     lua_pushstring(g_lua, rl_line_buffer);
@@ -821,6 +1545,10 @@ char** lua_generate_matches(const char* text, int start, int end)
     lua_pushinteger(g_lua, rl_point + 1);
     lua_rawset(g_lua, -3);
 
+    lua_pushliteral(g_lua, "tokens");
+    push_tokens(g_lua, rl_line_buffer, end);
+    lua_rawset(g_lua, -3);
+
     lua_setglobal(g_lua, "rl_state");
 
     // Call to Lua to generate matches.
@@ -864,8 +1592,58 @@ char** lua_generate_matches(const char* text, int start, int end)
 
         lua_pop(g_lua, 1);
     }
+    lua_pop(g_lua, 1);
+
+    // What's known about matches added as records is kept natively for when
+    // they're post-processed and displayed.
+    lua_pushliteral(g_lua, "match_info");
+    lua_rawget(g_lua, -2);
+    collect_match_info(g_lua, get_match_infos());
+    lua_pop(g_lua, 1);
+
+    // Ranked matches are displayed in the order they're in.
+    lua_pushliteral(g_lua, "matches_ranked");
+    lua_rawget(g_lua, -2);
+    ranked = lua_toboolean(g_lua, -1);
     lua_pop(g_lua, 2);
 
+    if (ranked)
+    {
+        rl_sort_completion_matches = 0;
+    }
+
+    return matches;
+}
+
+//------------------------------------------------------------------------------
+char** lua_generate_matches(const char* text, int start, int end)
+{
+    char** matches;
+    double started;
+    double memory;
+    int count;
+
+    stats_refresh();
+    if (!stats_enabled())
+    {
+        matches = generate_matches(text, start, end);
+        gc_after_activity();
+        return matches;
+    }
+
+    started = stats_clock();
+    memory = get_lua_memory(g_lua);
+
+    matches = generate_matches(text, start, end);
+
+    count = 0;
+    while (matches != NULL && matches[count] != NULL)
+    {
+        ++count;
+    }
+
+    stats_record("completion", started, count, get_lua_memory(g_lua) - memory);
+    gc_after_activity();
     return matches;
 }
 
@@ -878,29 +1656,109 @@ static int reload_lua_state(int count, int invoking_key)
 }
 
 //------------------------------------------------------------------------------
-void lua_filter_prompt(char* buffer, int buffer_size)
+void lua_filter_prompt(const char* prompt, void (*result)(const char*, int))
 {
-    const char* prompt;
+    const char* filtered;
+    size_t length;
+    double started;
+    double memory;
+
+    stats_refresh();
+    started = stats_clock();
+    memory = get_lua_memory(g_lua);
 
     // Call Lua to filter prompt
     lua_getglobal(g_lua, "clink");
     lua_pushliteral(g_lua, "filter_prompt");
     lua_rawget(g_lua, -2);
 
-    lua_pushstring(g_lua, buffer);
+    // If the filters fail the prompt's left unfiltered.
+    lua_pushstring(g_lua, prompt);
     if (lua_pcall(g_lua, 1, 1, 0) != 0)
     {
         puts(lua_tostring(g_lua, -1));
         lua_pop(g_lua, 2);
+
+        if (result != NULL)
+        {
+            result(prompt, (int)strlen(prompt));
+        }
         return;
     }
 
-    // Collect the filtered prompt.
-    prompt = lua_tostring(g_lua, -1);
-    buffer[0] = '\0';
-    str_cat(buffer, prompt, buffer_size);
+    if (stats_enabled())
+    {
+        memory = get_lua_memory(g_lua) - memory;
+        stats_record("prompt", started, 0, memory);
+    }
+
+    // Note if asynchronous filters were left running so idle polling only
+    // calls in to Lua when there's something to collect.
+    lua_pushliteral(g_lua, "prompt");
+    lua_rawget(g_lua, -3);
+    if (lua_istable(g_lua, -1))
+    {
+        lua_pushliteral(g_lua, "async_pending");
+        lua_rawget(g_lua, -2);
+        g_prompt_pending = (lua_istable(g_lua, -1) && lua_rawlen(g_lua, -1) > 0);
+        lua_pop(g_lua, 1);
+    }
+    lua_pop(g_lua, 1);
+
+    // Hand the filtered prompt over while it's still on Lua's stack.
+    filtered = lua_tolstring(g_lua, -1, &length);
+    if (filtered == NULL)
+    {
+        filtered = prompt;
+        length = strlen(prompt);
+    }
+
+    if (result != NULL)
+    {
+        result(filtered, (int)length);
+    }
 
     lua_pop(g_lua, 2);
+    gc_after_activity();
+}
+
+//------------------------------------------------------------------------------
+int lua_update_prompt(int* pending)
+{
+    // Collects the results of asynchronous prompt filters. Returns non-zero if
+    // the prompt needs filtering and drawing again. 'pending' is set if there
+    // are filters yet to finish.
+
+    int changed;
+
+    // Child processes that were started but are no longer being waited on are
+    // cleaned up here too, as this is called whenever Clink is idle.
+    reap_async_execs();
+
+    *pending = 0;
+    if (!g_prompt_pending)
+    {
+        return 0;
+    }
+
+    lua_getglobal(g_lua, "clink");
+    lua_pushliteral(g_lua, "update_prompt");
+    lua_rawget(g_lua, -2);
+
+    if (lua_pcall(g_lua, 0, 2, 0) != 0)
+    {
+        puts(lua_tostring(g_lua, -1));
+        lua_pop(g_lua, 2);
+        *pending = 0;
+        return 0;
+    }
+
+    changed = lua_toboolean(g_lua, -2);
+    *pending = lua_toboolean(g_lua, -1);
+    g_prompt_pending = *pending;
+
+    lua_pop(g_lua, 3);
+    return changed;
 }
 
 // vim: expandtab
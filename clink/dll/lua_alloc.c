@@ -0,0 +1,247 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "lua_alloc.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+typedef struct pool_link
+{
+    struct pool_link*   next;
+} pool_link_t;
+
+typedef struct
+{
+    pool_link_t*        free;
+    char*               carve;
+    char*               carve_end;
+    unsigned            allocs;
+    unsigned            in_use;
+} pool_class_t;
+
+//------------------------------------------------------------------------------
+#define POOL_CHUNK_SIZE (64 * 1024)
+#define POOL_MAX_SIZE   256
+
+static const unsigned   g_class_sizes[LUA_POOL_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256
+};
+
+static pool_class_t     g_classes[LUA_POOL_CLASSES];
+static pool_link_t*     g_chunks        = NULL;
+static size_t           g_bytes         = 0;
+static size_t           g_peak          = 0;
+static size_t           g_reserved      = 0;
+static unsigned         g_large_allocs  = 0;
+
+//------------------------------------------------------------------------------
+static int get_class(size_t size)
+{
+    // Maps sizes to the smallest class they fit in, in 16 byte steps.
+
+    static const unsigned char classes[] = {
+        0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+    };
+
+    return classes[(size + 15) >> 4];
+}
+
+//------------------------------------------------------------------------------
+static void* class_alloc(int index)
+{
+    pool_class_t* pool;
+    pool_link_t* chunk;
+    void* ptr;
+    unsigned size;
+
+    pool = g_classes + index;
+    size = g_class_sizes[index];
+
+    if (pool->free != NULL)
+    {
+        ptr = pool->free;
+        pool->free = pool->free->next;
+    }
+    else
+    {
+        // Carve a new block off the class' current chunk, starting a new one
+        // when it's used up. Chunks are kept until the Lua state is closed.
+        if (pool->carve + size > pool->carve_end)
+        {
+            chunk = malloc(POOL_CHUNK_SIZE);
+            if (chunk == NULL)
+            {
+                return NULL;
+            }
+
+            chunk->next = g_chunks;
+            g_chunks = chunk;
+            g_reserved += POOL_CHUNK_SIZE;
+
+            pool->carve = (char*)chunk + 16;
+            pool->carve_end = (char*)chunk + POOL_CHUNK_SIZE;
+        }
+
+        ptr = pool->carve;
+        pool->carve += size;
+    }
+
+    ++pool->allocs;
+    ++pool->in_use;
+    return ptr;
+}
+
+//------------------------------------------------------------------------------
+static void class_free(int index, void* ptr)
+{
+    pool_class_t* pool;
+    pool_link_t* link;
+
+    pool = g_classes + index;
+    link = (pool_link_t*)ptr;
+
+    link->next = pool->free;
+    pool->free = link;
+    --pool->in_use;
+}
+
+//------------------------------------------------------------------------------
+void* lua_pool_alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+{
+    // A lua_Alloc that serves the many small strings and tables Lua makes from
+    // size-class pools, and anything else from the CRT. Lua always passes the
+    // block's current size so no headers are needed to find a block's class.
+
+    void* new_ptr;
+    int old_class;
+    int new_class;
+
+    if (ptr == NULL)
+    {
+        osize = 0;
+    }
+
+    old_class = (ptr != NULL && osize <= POOL_MAX_SIZE) ? get_class(osize) : -1;
+    new_class = (nsize > 0 && nsize <= POOL_MAX_SIZE) ? get_class(nsize) : -1;
+
+    // Free.
+    if (nsize == 0)
+    {
+        if (old_class >= 0)
+        {
+            class_free(old_class, ptr);
+        }
+        else
+        {
+            free(ptr);
+        }
+
+        g_bytes -= osize;
+        return NULL;
+    }
+
+    // Still fits where it is?
+    if (ptr != NULL && old_class >= 0 && old_class == new_class)
+    {
+        g_bytes += nsize - osize;
+        return ptr;
+    }
+
+    // Neither size is pooled so the CRT can do it.
+    if (old_class < 0 && new_class < 0)
+    {
+        new_ptr = realloc(ptr, nsize);
+        if (new_ptr == NULL)
+        {
+            return NULL;
+        }
+
+        g_large_allocs += (ptr == NULL);
+    }
+    else
+    {
+        new_ptr = (new_class >= 0) ? class_alloc(new_class) : malloc(nsize);
+        if (new_ptr == NULL)
+        {
+            return NULL;
+        }
+
+        g_large_allocs += (new_class < 0);
+
+        if (ptr != NULL)
+        {
+            memcpy(new_ptr, ptr, (osize < nsize) ? osize : nsize);
+            if (old_class >= 0)
+            {
+                class_free(old_class, ptr);
+            }
+            else
+            {
+                free(ptr);
+            }
+        }
+    }
+
+    g_bytes += nsize - osize;
+    g_peak = (g_bytes > g_peak) ? g_bytes : g_peak;
+    return new_ptr;
+}
+
+//------------------------------------------------------------------------------
+void lua_pool_reset()
+{
+    // Releases the pools' memory. Only to be used once the Lua state using
+    // them has been closed.
+
+    while (g_chunks != NULL)
+    {
+        pool_link_t* next = g_chunks->next;
+        free(g_chunks);
+        g_chunks = next;
+    }
+
+    memset(g_classes, 0, sizeof(g_classes));
+    g_bytes = 0;
+    g_peak = 0;
+    g_reserved = 0;
+    g_large_allocs = 0;
+}
+
+//------------------------------------------------------------------------------
+void lua_pool_get_stats(lua_pool_stats_t* stats)
+{
+    int i;
+
+    stats->bytes = g_bytes;
+    stats->peak = g_peak;
+    stats->reserved = g_reserved;
+    stats->large_allocs = g_large_allocs;
+
+    for (i = 0; i < LUA_POOL_CLASSES; ++i)
+    {
+        stats->classes[i].size = g_class_sizes[i];
+        stats->classes[i].allocs = g_classes[i].allocs;
+        stats->classes[i].in_use = g_classes[i].in_use;
+    }
+}
+
+// vim: expandtab
@@ -22,6 +22,7 @@
 #include "pch.h"
 #include "shared/util.h"
 #include "shared/pipe.h"
+#include "shared/str_builder.h"
 
 #if defined(__MINGW32__) && !defined(__MINGW64__)
 #   define JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE 0x2000
@@ -95,10 +96,83 @@ static char* next_line(char* str)
 }
 
 //------------------------------------------------------------------------------
-int lua_execute(lua_State* state)
+static BOOL spawn_process(
+    const char* cmd,
+    STARTUPINFO* si,
+    PROCESS_INFORMATION* pi)
 {
     static const DWORD process_flags = NORMAL_PRIORITY_CLASS|CREATE_NO_WINDOW;
 
+    BOOL ok;
+
+    ok = CreateProcess(NULL, (char*)cmd, NULL, NULL, TRUE, process_flags, NULL,
+        NULL, si, pi
+    );
+    if (ok == FALSE)
+    {
+        // Did it fail because the executable wasn't found? Maybe it's a batch
+        // file? Best try running through the command processor.
+        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        {
+            str_builder_t buffer;
+
+            str_builder_init(&buffer);
+            str_builder_printf(&buffer, "cmd.exe /c %s", cmd);
+
+            ok = CreateProcess(NULL, buffer.data, NULL, NULL, TRUE,
+                process_flags, NULL, NULL, si, pi
+            );
+
+            str_builder_free(&buffer);
+        }
+    }
+
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+static void push_lines(lua_State* state, char* buffer)
+{
+    // Pushes a table of the lines in 'buffer'. The lines are split and counted
+    // first so the table can be created at its final size.
+
+    int line_count;
+    int i;
+    char* line;
+    char* next;
+
+    line_count = 0;
+    line = buffer;
+    do
+    {
+        next = next_line(line);
+        ++line_count;
+        line = next;
+    }
+    while (next);
+
+    lua_createtable(state, line_count, 0);
+
+    line = buffer;
+    for (i = 1; i <= line_count; ++i)
+    {
+        int length = (int)strlen(line);
+
+        lua_pushlstring(state, line, length);
+        lua_rawseti(state, -2, i);
+
+        // Step over the terminators next_line() left between the lines.
+        line += length;
+        while (i < line_count && *line == '\0')
+        {
+            ++line;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+int lua_execute(lua_State* state)
+{
     const char* cmd;
     int arg_count;
     BOOL ok;
@@ -147,33 +221,14 @@ int lua_execute(lua_State* state)
     si.hStdInput = pipe_stdin.read;
     si.dwFlags = STARTF_USESTDHANDLES;
 
-    ok = CreateProcess(NULL, (char*)cmd, NULL, NULL, TRUE, process_flags, NULL,
-        NULL, &si, &exec_state.pi
-    );
+    ok = spawn_process(cmd, &si, &exec_state.pi);
     if (ok == FALSE)
     {
-        // Did it fail because the executable wasn't found? Maybe it's a batch
-        // file? Best try running through the command processor.
-        if (GetLastError() == ERROR_FILE_NOT_FOUND)
-        {
-            char buffer[MAX_PATH];
-
-            str_cpy(buffer, "cmd.exe /c ", sizeof_array(buffer));
-            str_cat(buffer, cmd, sizeof_array(buffer));
-
-            ok = CreateProcess(NULL, buffer, NULL, NULL, TRUE, process_flags,
-                NULL, NULL, &si, &exec_state.pi
-            );
-        }
-
-        if (ok == FALSE)
-        {
-            destroy_pipe(&pipe_stdout);
-            destroy_pipe(&pipe_stderr);
-            destroy_pipe(&pipe_stdin);
-            CloseHandle(exec_state.job);
-            return 0;
-        }
+        destroy_pipe(&pipe_stdout);
+        destroy_pipe(&pipe_stderr);
+        destroy_pipe(&pipe_stdin);
+        CloseHandle(exec_state.job);
+        return 0;
     }
 
     AssignProcessToJobObject(exec_state.job, exec_state.pi.hProcess);
@@ -192,9 +247,6 @@ int lua_execute(lua_State* state)
     pipe_stderr.write = NULL;
     pipe_stdin.read = NULL;
 
-    // Create a lua table.
-    lua_newtable(state);
-
     // Read process' stdout, adding completed lines to Lua.
     {
         static const RESERVE = 4 * 1024 * 1024;
@@ -239,24 +291,8 @@ int lua_execute(lua_State* state)
             write += bytes_read;
         }
 
-        // Extract lines from the process's output.
-        {
-            int line_count = 0;
-            char* line = (char*)buffer;
-            char* next = NULL;
-
-            do
-            {
-                next = next_line(line);
-
-                lua_pushinteger(state, ++line_count);
-                lua_pushstring(state, line);
-                lua_rawset(state, -3);
-
-                line = next;
-            }
-            while (next);
-        }
+        // Extract lines from the process's output into a table.
+        push_lines(state, (char*)buffer);
 
         VirtualFree(buffer, 0, MEM_RELEASE);
     }
@@ -277,4 +313,237 @@ int lua_execute(lua_State* state)
     return 2;
 }
 
+//------------------------------------------------------------------------------
+// Asynchronous execution. A reader thread drains the child's stdout so the
+// process never stalls on a full pipe, and Lua polls for the result when it
+// wants it (typically while Clink's idle waiting for a key press).
+typedef struct
+{
+    int                 in_use;
+    HANDLE              process;
+    HANDLE              job;
+    HANDLE              thread;
+    HANDLE              pipe_read;
+    DWORD               start_tick;
+    DWORD               poll_tick;
+    int                 timeout;
+    char*               output;
+    int                 output_size;
+    int                 output_used;
+} async_exec_t;
+
+static async_exec_t     g_async_execs[16];
+
+#define ASYNC_EXEC_GRACE        5000
+
+//------------------------------------------------------------------------------
+static DWORD WINAPI async_thread_proc(async_exec_t* exec)
+{
+    while (1)
+    {
+        DWORD bytes_read;
+
+        // Grow the buffer if needed ("- 1" to keep a null terminator around).
+        if (exec->output_size - exec->output_used <= 1)
+        {
+            exec->output_size = max(exec->output_size * 2, 1024);
+            exec->output = realloc(exec->output, exec->output_size);
+        }
+
+        if (!ReadFile(exec->pipe_read, exec->output + exec->output_used,
+            exec->output_size - exec->output_used - 1, &bytes_read, NULL))
+        {
+            break;
+        }
+
+        exec->output_used += bytes_read;
+    }
+
+    exec->output[exec->output_used] = '\0';
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static void release_async_exec(async_exec_t* exec)
+{
+    CloseHandle(exec->thread);
+    CloseHandle(exec->pipe_read);
+    CloseHandle(exec->process);
+    CloseHandle(exec->job);
+    free(exec->output);
+
+    memset(exec, 0, sizeof(*exec));
+}
+
+//------------------------------------------------------------------------------
+void reap_async_execs()
+{
+    // Frees slots whose results nobody has asked for in a while, such as when
+    // the filter that started them failed or was dropped. Their processes are
+    // ended if they're still running.
+
+    DWORD now;
+    int i;
+
+    now = GetTickCount();
+    for (i = 0; i < sizeof_array(g_async_execs); ++i)
+    {
+        async_exec_t* exec = g_async_execs + i;
+
+        if (!exec->in_use)
+        {
+            continue;
+        }
+
+        if (now - exec->poll_tick <= (DWORD)exec->timeout + ASYNC_EXEC_GRACE)
+        {
+            continue;
+        }
+
+        TerminateJobObject(exec->job, (UINT)-1);
+        if (WaitForSingleObject(exec->thread, 100) == WAIT_OBJECT_0)
+        {
+            release_async_exec(exec);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+int lua_execute_async(lua_State* state)
+{
+    const char* cmd;
+    int arg_count;
+    int id;
+    STARTUPINFO si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    pipe_t pipe_stdout;
+    pipe_t pipe_stdin;
+    async_exec_t* exec;
+
+    // Get the command line to execute.
+    arg_count = lua_gettop(state);
+    if (arg_count == 0 || !lua_isstring(state, 1))
+    {
+        return 0;
+    }
+
+    cmd = lua_tostring(state, 1);
+
+    // Find a free slot.
+    reap_async_execs();
+    for (id = 0; id < sizeof_array(g_async_execs); ++id)
+    {
+        if (!g_async_execs[id].in_use)
+        {
+            break;
+        }
+    }
+
+    if (id >= sizeof_array(g_async_execs))
+    {
+        return 0;
+    }
+
+    exec = g_async_execs + id;
+    exec->timeout = 5000;
+    if (arg_count > 1 && lua_isnumber(state, 2))
+    {
+        exec->timeout = lua_tointeger(state, 2);
+    }
+
+    exec->job = create_job();
+    if (exec->job == NULL)
+    {
+        return 0;
+    }
+
+    // Launch the process. Stderr goes the same way as stdout.
+    create_pipe(WriteHandleInheritable, &pipe_stdout);
+    create_pipe(ReadHandleInheritable, &pipe_stdin);
+
+    si.hStdError = pipe_stdout.write;
+    si.hStdOutput = pipe_stdout.write;
+    si.hStdInput = pipe_stdin.read;
+    si.dwFlags = STARTF_USESTDHANDLES;
+
+    if (spawn_process(cmd, &si, &pi) == FALSE)
+    {
+        destroy_pipe(&pipe_stdout);
+        destroy_pipe(&pipe_stdin);
+        CloseHandle(exec->job);
+        exec->job = NULL;
+        return 0;
+    }
+
+    AssignProcessToJobObject(exec->job, pi.hProcess);
+    CloseHandle(pi.hThread);
+
+    destroy_pipe(&pipe_stdin);
+    CloseHandle(pipe_stdout.write);
+
+    exec->in_use = 1;
+    exec->process = pi.hProcess;
+    exec->pipe_read = pipe_stdout.read;
+    exec->start_tick = GetTickCount();
+    exec->poll_tick = exec->start_tick;
+    exec->thread = CreateThread(NULL, 0,
+        (LPTHREAD_START_ROUTINE)async_thread_proc, exec, 0, NULL
+    );
+
+    lua_pushinteger(state, id + 1);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int lua_poll_async(lua_State* state)
+{
+    // Returns nothing while the process is still running. Once it's finished
+    // the output lines and exit code are returned as clink.execute() does.
+
+    int id;
+    DWORD proc_ret;
+    async_exec_t* exec;
+
+    if (lua_gettop(state) == 0 || !lua_isnumber(state, 1))
+    {
+        return 0;
+    }
+
+    id = lua_tointeger(state, 1) - 1;
+    if (id < 0 || id >= sizeof_array(g_async_execs))
+    {
+        return 0;
+    }
+
+    exec = g_async_execs + id;
+    if (!exec->in_use)
+    {
+        return 0;
+    }
+
+    exec->poll_tick = GetTickCount();
+
+    // Out of time? Closing the job terminates the process and its children,
+    // which in turn closes the pipe and ends the reader thread.
+    if (GetTickCount() - exec->start_tick > (DWORD)exec->timeout)
+    {
+        TerminateJobObject(exec->job, (UINT)-1);
+    }
+
+    if (WaitForSingleObject(exec->thread, 0) != WAIT_OBJECT_0 ||
+        WaitForSingleObject(exec->process, 0) != WAIT_OBJECT_0)
+    {
+        return 0;
+    }
+
+    push_lines(state, exec->output);
+
+    proc_ret = -1;
+    GetExitCodeProcess(exec->process, &proc_ret);
+    lua_pushinteger(state, proc_ret);
+
+    release_async_exec(exec);
+    return 2;
+}
+
 // vim: expandtab
@@ -0,0 +1,197 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "shared/fuzzy.h"
+
+//------------------------------------------------------------------------------
+typedef struct
+{
+    const char*         str;
+    int                 length;
+    int                 score;
+    int                 slot;           // in the table of matches
+} ranked_t;
+
+static fuzzy_t          g_fuzzy;
+
+//------------------------------------------------------------------------------
+static int compare_ranked(const void* lhs, const void* rhs)
+{
+    // Best score first, then shortest, then by value so equal strings end up
+    // next to each other, then in the order given.
+
+    const ranked_t* a = (const ranked_t*)lhs;
+    const ranked_t* b = (const ranked_t*)rhs;
+    int order;
+
+    if (a->score != b->score)
+    {
+        return (a->score > b->score) ? -1 : 1;
+    }
+
+    if (a->length != b->length)
+    {
+        return (a->length < b->length) ? -1 : 1;
+    }
+
+    order = strcmp(a->str, b->str);
+    if (order != 0)
+    {
+        return order;
+    }
+
+    return a->slot - b->slot;
+}
+
+//------------------------------------------------------------------------------
+int lua_fuzzy_score(lua_State* state)
+{
+    // clink.fuzzy_score(needle, candidate); returns how well 'candidate'
+    // matches 'needle' as a subsequence, or nil if it doesn't.
+
+    const char* candidate;
+    size_t length;
+    int score;
+
+    if (lua_gettop(state) < 2 || !lua_isstring(state, 1) || !lua_isstring(state, 2))
+    {
+        return 0;
+    }
+
+    if (!fuzzy_set_needle(&g_fuzzy, lua_tostring(state, 1)))
+    {
+        return 0;
+    }
+
+    candidate = lua_tolstring(state, 2, &length);
+    if (!fuzzy_score(&g_fuzzy, candidate, (int)length, &score))
+    {
+        return 0;
+    }
+
+    lua_pushinteger(state, score);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int lua_fuzzy_rank(lua_State* state)
+{
+    // clink.fuzzy_rank(needle, candidates[, keep]); returns a table of the
+    // candidates that match 'needle', best first, followed by those that
+    // don't if 'keep' is true. 'candidates' can be anything that indexes like
+    // an array. Strings are kept in a table while they're sorted so those the
+    // candidates make on the fly don't get collected.
+
+    ranked_t* ranked;
+    int ranked_size;
+    int count;
+    int matches;
+    int slots;
+    int keep;
+    int is_table;
+    int i;
+
+    if (lua_gettop(state) < 2 || !lua_isstring(state, 1))
+    {
+        return 0;
+    }
+
+    keep = lua_toboolean(state, 3);
+    is_table = lua_istable(state, 2);
+
+    if (!fuzzy_set_needle(&g_fuzzy, lua_tostring(state, 1)))
+    {
+        return 0;
+    }
+
+    lua_len(state, 2);
+    count = lua_tointeger(state, -1);
+    lua_pop(state, 1);
+
+    ranked_size = (count > 0) ? count : 1;
+    ranked = (ranked_t*)malloc(ranked_size * sizeof(ranked_t));
+    if (ranked == NULL)
+    {
+        return 0;
+    }
+
+    lua_createtable(state, 0, 0);
+    slots = lua_gettop(state);
+
+    matches = 0;
+    for (i = 1; i <= count; ++i)
+    {
+        const char* candidate;
+        size_t length;
+        int score;
+
+        if (is_table)
+        {
+            lua_rawgeti(state, 2, i);
+        }
+        else
+        {
+            lua_pushinteger(state, i);
+            lua_gettable(state, 2);
+        }
+
+        candidate = lua_tolstring(state, -1, &length);
+        if (candidate == NULL)
+        {
+            lua_pop(state, 1);
+            continue;
+        }
+
+        if (!fuzzy_score(&g_fuzzy, candidate, (int)length, &score))
+        {
+            if (!keep)
+            {
+                lua_pop(state, 1);
+                continue;
+            }
+
+            score = INT_MIN;
+        }
+
+        ranked[matches].str = candidate;
+        ranked[matches].length = (int)length;
+        ranked[matches].score = score;
+        ranked[matches].slot = matches + 1;
+        ++matches;
+
+        lua_rawseti(state, slots, matches);
+    }
+
+    qsort(ranked, matches, sizeof(ranked_t), compare_ranked);
+
+    lua_createtable(state, matches, 0);
+    for (i = 0; i < matches; ++i)
+    {
+        lua_rawgeti(state, slots, ranked[i].slot);
+        lua_rawseti(state, -2, i + 1);
+    }
+
+    free(ranked);
+    return 1;
+}
+
+// vim: expandtab
@@ -0,0 +1,207 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "lua_strings.h"
+
+//------------------------------------------------------------------------------
+#define PACKED_META     "clink_packed_strings"
+
+typedef struct
+{
+    int                 count;
+    int                 offsets[1];     // count + 1 of them, then the blob
+} packed_t;
+
+//------------------------------------------------------------------------------
+void lua_strings_init(lua_strings_t* strings)
+{
+    str_builder_init(&strings->blob);
+    strings->offsets = NULL;
+    strings->count = 0;
+    strings->size = 0;
+}
+
+//------------------------------------------------------------------------------
+void lua_strings_free(lua_strings_t* strings)
+{
+    str_builder_free(&strings->blob);
+    free(strings->offsets);
+    lua_strings_init(strings);
+}
+
+//------------------------------------------------------------------------------
+void lua_strings_add(lua_strings_t* strings, const char* str, int length)
+{
+    // Strings are stored back to back in the blob, so each one's length is
+    // the distance to the next one's offset. Strings are dropped rather than
+    // half added if memory runs out.
+
+    int* offsets;
+    int start;
+
+    if (strings->count >= strings->size)
+    {
+        int size = (strings->size > 0) ? strings->size * 2 : 64;
+
+        offsets = realloc(strings->offsets, size * sizeof(int));
+        if (offsets == NULL)
+        {
+            return;
+        }
+
+        strings->offsets = offsets;
+        strings->size = size;
+    }
+
+    if (length < 0)
+    {
+        length = (int)strlen(str);
+    }
+
+    start = strings->blob.length;
+    if (!str_builder_reserve(&strings->blob, start + length))
+    {
+        return;
+    }
+
+    str_builder_append_n(&strings->blob, str, length);
+
+    strings->offsets[strings->count] = start;
+    ++strings->count;
+}
+
+//------------------------------------------------------------------------------
+static const char* get_packed(const packed_t* packed, int i, int* length)
+{
+    const char* blob;
+    int offset;
+
+    blob = (const char*)(packed->offsets + packed->count + 1);
+    offset = packed->offsets[i];
+
+    *length = packed->offsets[i + 1] - offset;
+    return blob + offset;
+}
+
+//------------------------------------------------------------------------------
+static int packed_index(lua_State* state)
+{
+    const packed_t* packed;
+    const char* str;
+    int length;
+    int i;
+
+    packed = (const packed_t*)luaL_checkudata(state, 1, PACKED_META);
+
+    i = lua_isnumber(state, 2) ? (int)lua_tointeger(state, 2) : 0;
+    if (i < 1 || i > packed->count)
+    {
+        return 0;
+    }
+
+    str = get_packed(packed, i - 1, &length);
+    lua_pushlstring(state, str, length);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int packed_len(lua_State* state)
+{
+    const packed_t* packed;
+
+    packed = (const packed_t*)luaL_checkudata(state, 1, PACKED_META);
+    lua_pushinteger(state, packed->count);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int packed_next(lua_State* state)
+{
+    const packed_t* packed;
+    const char* str;
+    int length;
+    int i;
+
+    packed = (const packed_t*)luaL_checkudata(state, 1, PACKED_META);
+
+    i = (int)luaL_checkinteger(state, 2);
+    if (i < 0 || i >= packed->count)
+    {
+        return 0;
+    }
+
+    str = get_packed(packed, i, &length);
+    lua_pushinteger(state, i + 1);
+    lua_pushlstring(state, str, length);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+static int packed_ipairs(lua_State* state)
+{
+    luaL_checkudata(state, 1, PACKED_META);
+
+    lua_pushcfunction(state, packed_next);
+    lua_pushvalue(state, 1);
+    lua_pushinteger(state, 0);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+void lua_strings_push(lua_State* state, const lua_strings_t* strings)
+{
+    // Pushes a single userdata holding a copy of the strings, which Lua only
+    // makes strings from as they're indexed.
+
+    static const luaL_Reg methods[] = {
+        { "__index", packed_index },
+        { "__len", packed_len },
+        { "__ipairs", packed_ipairs },
+        { NULL, NULL }
+    };
+
+    packed_t* packed;
+    int offsets_size;
+    int i;
+
+    offsets_size = (strings->count + 1) * sizeof(int);
+
+    packed = lua_newuserdata(state,
+        sizeof(int) + offsets_size + strings->blob.length);
+
+    packed->count = strings->count;
+    for (i = 0; i < strings->count; ++i)
+    {
+        packed->offsets[i] = strings->offsets[i];
+    }
+    packed->offsets[i] = strings->blob.length;
+
+    memcpy(packed->offsets + i + 1, strings->blob.data, strings->blob.length);
+
+    if (luaL_newmetatable(state, PACKED_META))
+    {
+        luaL_setfuncs(state, methods, 0);
+    }
+    lua_setmetatable(state, -2);
+}
+
+// vim: expandtab
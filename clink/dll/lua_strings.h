@@ -0,0 +1,50 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LUA_STRINGS_H
+#define LUA_STRINGS_H
+
+#include "shared/str_builder.h"
+
+struct lua_State;
+
+//------------------------------------------------------------------------------
+// Collects strings natives return to Lua in a single blob, so they can be
+// pushed as one userdata that indexes like an array (t[i], #t, and ipairs(t))
+// but can't be modified. Large listings then cross into Lua without a table
+// slot and an interned string per entry.
+typedef struct
+{
+    str_builder_t   blob;
+    int*            offsets;
+    int             count;
+    int             size;
+} lua_strings_t;
+
+//------------------------------------------------------------------------------
+void                    lua_strings_init(lua_strings_t* strings);
+void                    lua_strings_free(lua_strings_t* strings);
+void                    lua_strings_add(lua_strings_t* strings, const char* str, int length);
+void                    lua_strings_push(struct lua_State* state, const lua_strings_t* strings);
+
+#endif // LUA_STRINGS_H
+
+// vim: expandtab
@@ -0,0 +1,277 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "match_info.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+static match_info_table_t   g_match_infos;   // zeroed is initialised
+
+//------------------------------------------------------------------------------
+static unsigned int hash_text(const char* text)
+{
+    // FNV-1a, with \ hashed as / so translated matches hash the same.
+    unsigned int hash = 2166136261u;
+    for (; *text; ++text)
+    {
+        unsigned char c = (unsigned char)*text;
+        hash ^= (c == '\\') ? '/' : c;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+static int same_text(const char* lhs, const char* rhs)
+{
+    for (; *lhs && *rhs; ++lhs, ++rhs)
+    {
+        char l = (*lhs == '\\') ? '/' : *lhs;
+        char r = (*rhs == '\\') ? '/' : *rhs;
+        if (l != r)
+        {
+            return 0;
+        }
+    }
+
+    return (*lhs == *rhs);
+}
+
+//------------------------------------------------------------------------------
+static char* copy_str(const char* str)
+{
+    char* copy;
+
+    if (str == NULL)
+    {
+        return NULL;
+    }
+
+    copy = malloc(strlen(str) + 1);
+    if (copy != NULL)
+    {
+        strcpy(copy, str);
+    }
+
+    return copy;
+}
+
+//------------------------------------------------------------------------------
+static int find_slot(const match_info_table_t* table, const char* text,
+    unsigned int hash)
+{
+    // Returns the slot holding 'text', or the empty slot it would go in.
+    int mask = table->slot_count - 1;
+    int i = hash & mask;
+
+    while (table->slots[i] >= 0)
+    {
+        const match_info_t* info = table->infos + table->slots[i];
+        if (info->hash == hash && same_text(info->text, text))
+        {
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+//------------------------------------------------------------------------------
+static int grow(match_info_table_t* table)
+{
+    // Keeps the slots at most half full, rehashing when they're resized. Both
+    // arrays are allocated before either is swapped in so the table's left as
+    // it was if either fails.
+    match_info_t* infos;
+    int* slots;
+    int slot_count;
+    int size;
+    int i;
+
+    if (table->count < table->size)
+    {
+        return 1;
+    }
+
+    size = (table->size > 0) ? table->size * 2 : 32;
+    slot_count = size * 2;
+    slots = malloc(slot_count * sizeof(*slots));
+    if (slots == NULL)
+    {
+        return 0;
+    }
+
+    infos = realloc(table->infos, size * sizeof(*infos));
+    if (infos == NULL)
+    {
+        free(slots);
+        return 0;
+    }
+
+    table->infos = infos;
+    table->size = size;
+
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    memset(slots, 0xff, slot_count * sizeof(*slots));
+
+    for (i = 0; i < table->count; ++i)
+    {
+        const match_info_t* info = table->infos + i;
+        table->slots[find_slot(table, info->text, info->hash)] = i;
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void match_info_init(match_info_table_t* table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+//------------------------------------------------------------------------------
+void match_info_free(match_info_table_t* table)
+{
+    match_info_clear(table);
+    free(table->infos);
+    free(table->slots);
+    match_info_init(table);
+}
+
+//------------------------------------------------------------------------------
+void match_info_clear(match_info_table_t* table)
+{
+    // Empties the table, keeping its memory for the next completion.
+    int i;
+
+    for (i = 0; i < table->count; ++i)
+    {
+        match_info_t* info = table->infos + i;
+        free(info->text);
+        free(info->display);
+        free(info->suffix);
+    }
+
+    table->count = 0;
+    if (table->slots != NULL)
+    {
+        memset(table->slots, 0xff, table->slot_count * sizeof(*table->slots));
+    }
+}
+
+//------------------------------------------------------------------------------
+int match_info_add(match_info_table_t* table, const char* text,
+    const char* display, const char* suffix, int type)
+{
+    // Adding a match that's already in the table replaces what's known
+    // about it.
+    match_info_t* info;
+    unsigned int hash;
+    int slot;
+
+    if (!grow(table))
+    {
+        return 0;
+    }
+
+    hash = hash_text(text);
+    slot = find_slot(table, text, hash);
+    if (table->slots[slot] >= 0)
+    {
+        info = table->infos + table->slots[slot];
+        free(info->display);
+        free(info->suffix);
+    }
+    else
+    {
+        info = table->infos + table->count;
+        info->text = copy_str(text);
+        info->hash = hash;
+        if (info->text == NULL)
+        {
+            return 0;
+        }
+
+        table->slots[slot] = table->count;
+        ++table->count;
+    }
+
+    info->display = copy_str(display);
+    info->suffix = copy_str(suffix);
+    info->type = type;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+const match_info_t* match_info_find(const match_info_table_t* table,
+    const char* text)
+{
+    int slot;
+
+    if (table->count == 0 || text == NULL)
+    {
+        return NULL;
+    }
+
+    slot = find_slot(table, text, hash_text(text));
+    if (table->slots[slot] < 0)
+    {
+        return NULL;
+    }
+
+    return table->infos + table->slots[slot];
+}
+
+//------------------------------------------------------------------------------
+int match_info_type(const char* name)
+{
+    static const char* names[] = { "file", "dir", "exe", "alias" };
+    static const int types[] = {
+        MATCH_TYPE_FILE, MATCH_TYPE_DIR, MATCH_TYPE_EXE, MATCH_TYPE_ALIAS
+    };
+    int i;
+
+    for (i = 0; name != NULL && i < (int)sizeof_array(names); ++i)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return types[i];
+        }
+    }
+
+    return MATCH_TYPE_NONE;
+}
+
+//------------------------------------------------------------------------------
+match_info_table_t* get_match_infos()
+{
+    // The records for the current completion, filled in as matches are
+    // collected from Lua.
+    return &g_match_infos;
+}
+
+// vim: expandtab
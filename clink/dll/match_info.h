@@ -0,0 +1,70 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MATCH_INFO_H
+#define MATCH_INFO_H
+
+//------------------------------------------------------------------------------
+// What's known about matches added as records with clink.add_match{...}. The
+// matches themselves reach Readline as plain strings so this is kept to one
+// side, keyed by a match's text, and looked up as matches are post-processed
+// and displayed. Keys treat / and \ as the same so they still find matches
+// after slash translation.
+enum
+{
+    MATCH_TYPE_NONE,
+    MATCH_TYPE_FILE,
+    MATCH_TYPE_DIR,
+    MATCH_TYPE_EXE,
+    MATCH_TYPE_ALIAS
+};
+
+typedef struct
+{
+    char*           text;
+    char*           display;        // NULL to display the match as normal
+    char*           suffix;         // one char or "", NULL for the usual one
+    int             type;
+    unsigned int    hash;
+} match_info_t;
+
+typedef struct
+{
+    match_info_t*   infos;
+    int*            slots;          // indices into infos, -1 if empty
+    int             count;
+    int             size;
+    int             slot_count;     // a power of two
+} match_info_table_t;
+
+//------------------------------------------------------------------------------
+void                    match_info_init(match_info_table_t* table);
+void                    match_info_free(match_info_table_t* table);
+void                    match_info_clear(match_info_table_t* table);
+int                     match_info_add(match_info_table_t* table, const char* text, const char* display, const char* suffix, int type);
+const match_info_t*     match_info_find(const match_info_table_t* table, const char* text);
+int                     match_info_type(const char* name);
+
+match_info_table_t*     get_match_infos();
+
+#endif // MATCH_INFO_H
+
+// vim: expandtab
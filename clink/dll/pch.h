@@ -52,8 +52,10 @@
 // Defined by tests to automate input.
 #ifndef GETWCH_IMPL
 #   define GETWCH_IMPL getc_internal
+#   define GETWCH_PENDING_IMPL getc_internal_pending
 #else
     int GETWCH_IMPL();
+    int GETWCH_PENDING_IMPL();
 #endif
 
 #endif // PCH_H
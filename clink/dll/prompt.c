@@ -20,11 +20,12 @@
  */
 
 #include "pch.h"
+#include "ansi.h"
+#include "shared/str_builder.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
-const char*         find_next_ansi_code(const char*, int*);
-void                lua_filter_prompt(char*, int);
+void                lua_filter_prompt(const char*, void (*)(const char*, int));
 
 //------------------------------------------------------------------------------
 #define MR(x)                        L##x L"\x08"
@@ -99,6 +100,12 @@ char* detect_tagged_prompt(const char* buffer, int length)
     return NULL;
 }
 
+//------------------------------------------------------------------------------
+// Filtered prompts are built in a buffer that's kept from one prompt to the
+// next, so once it's grown to fit there's no further allocation.
+static str_builder_t    g_prompt;
+static int              g_prompt_init           = 0;
+
 //------------------------------------------------------------------------------
 void free_prompt(void* buffer)
 {
@@ -106,86 +113,117 @@ void free_prompt(void* buffer)
 }
 
 //------------------------------------------------------------------------------
-static int parse_backspaces(char* prompt, int n)
+static void transform_prompt(const char* in_prompt, int in_length)
 {
-    // This function does not null terminate!
+    // Copies the prompt from Lua into the prompt buffer in one pass. ANSI codes
+    // are surrounded with Readline's markers for invisible characters and
+    // backspaces remove the preceding character (but never across a marker).
+
+    ansi_state_t state;
+    ansi_span_t span;
+    char* out;
+    int length;
 
-    char* write;
-    char* read;
+    // Most prompts have no codes and are no bigger once transformed. Spans that
+    // are codes reserve room for their markers as they're found.
+    str_builder_reserve(&g_prompt, in_length);
 
-    write = prompt;
-    read = prompt;
-    while (*read && read < (prompt + n))
+    length = 0;
+    ansi_begin(&state, 0);
+    while (ansi_next(in_prompt, &state, &span))
     {
-        if (*read == '\b')
+        const char* read;
+        const char* end;
+        int floor;
+        int is_code;
+
+        // The builder only keeps the first 'length' bytes if it has to move.
+        is_code = (span.type != ANSI_SPAN_TEXT);
+        g_prompt.length = length;
+        if (!str_builder_reserve(&g_prompt, length + span.length + 2))
+        {
+            break;
+        }
+
+        out = g_prompt.data;
+        if (is_code)
+        {
+            out[length++] = '\001';
+        }
+
+        floor = length;
+        read = in_prompt + span.offset;
+        end = read + span.length;
+        for (; read < end; ++read)
         {
-            if (write > prompt)
+            char c = *read;
+            if (c != '\b')
+            {
+                out[length++] = c;
+                continue;
+            }
+
+            // Remove a whole utf-8 sequence, not just its last byte.
+            while (length > floor)
             {
-                --write;
+                --length;
+                if ((out[length] & 0xc0) != 0x80)
+                {
+                    break;
+                }
             }
         }
-        else
+
+        if (is_code)
         {
-            *write = *read;
-            ++write;
+            out[length++] = '\002';
         }
-
-        ++read;
     }
 
-    return write - prompt;
+    g_prompt.length = length;
+    g_prompt.data[length] = '\0';
 }
 
 //------------------------------------------------------------------------------
-char* filter_prompt(const char* in_prompt)
+const char* filter_prompt_shared(const char* in_prompt)
 {
-    static const int buf_size = 0x4000;
+    // Returns the filtered prompt in the shared buffer. It's only valid until
+    // the prompt is next filtered so it must not be held on to.
 
-    char* next;
-    char* out_prompt;
-    char* lua_prompt;
-
-    // Allocate the buffers. We'll allocate once and divide it in two.
-    out_prompt = malloc(buf_size * 2);
-    lua_prompt = out_prompt + buf_size;
-
-    // Get the prompt from Readline and pass it to Clink's filter framework
-    // in Lua.
-    lua_prompt[0] = '\0';
-    str_cat(lua_prompt, in_prompt, buf_size);
-
-    lua_filter_prompt(lua_prompt, buf_size);
-
-    // Scan for ansi codes and surround them with Readline's markers for
-    // invisible characters.
-    out_prompt[0] ='\0';
-    next = lua_prompt;
-    while (*next)
+    if (!g_prompt_init)
     {
-        int len;
-        int ansi_size;
-        char* ansi_code;
-
-        ansi_code = (char*)find_next_ansi_code(next, &ansi_size);
+        str_builder_init(&g_prompt);
+        g_prompt_init = 1;
+    }
 
-        len = parse_backspaces(next, ansi_code - next);
-        str_cat_n(out_prompt, next, buf_size, len);
+    // Pass the prompt through to Clink's filter framework in Lua.
+    str_builder_clear(&g_prompt);
+    lua_filter_prompt(in_prompt, transform_prompt);
+    return g_prompt.data;
+}
 
-        if (*ansi_code)
-        {
-            static const char* tags[] = { "\001", "\002" };
+//------------------------------------------------------------------------------
+const char* get_filtered_prompt()
+{
+    // The prompt as it was last filtered, which may be since the caller asked
+    // for it to be. Valid until the prompt's next filtered.
 
-            len = parse_backspaces(ansi_code, ansi_size);
+    return g_prompt_init ? g_prompt.data : NULL;
+}
 
-            str_cat(out_prompt, tags[0], buf_size);
-            str_cat_n(out_prompt, ansi_code, buf_size, len);
-            str_cat(out_prompt, tags[1], buf_size);
-        }
+//------------------------------------------------------------------------------
+char* filter_prompt(const char* in_prompt)
+{
+    // As filter_prompt_shared() but the caller owns the result and releases it
+    // with free_prompt().
 
-        next = ansi_code + ansi_size;
-    }
+    const char* filtered;
+    char* out;
 
-    return out_prompt;
+    filtered = filter_prompt_shared(in_prompt);
+    out = malloc(g_prompt.length + 1);
+    memcpy(out, filtered, g_prompt.length + 1);
+    return out;
 }
 
 //------------------------------------------------------------------------------
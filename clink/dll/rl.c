@@ -20,13 +20,15 @@
  */
 
 #include "pch.h"
+#include "match_info.h"
+#include "stats.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
 void                initialise_lua();
 char**              lua_generate_matches(const char*, int, int);
 char**              lua_match_display_filter(char**, int);
-void                lua_filter_prompt(char*, int);
+void                lua_filter_prompt(const char*, void (*)(const char*, int));
 void                initialise_rl_scroller();
 void                move_cursor(int, int);
 void*               initialise_clink_settings();
@@ -34,7 +36,8 @@ int                 getc_impl(FILE* stream);
 int                 get_clink_setting_int(const char*);
 void                get_config_dir(char*, int);
 void                clink_register_rl_funcs();
-char*               filter_prompt(const char*);
+const char*         filter_prompt_shared(const char*);
+const char*         get_filtered_prompt();
 void*               extract_prompt(int);
 void                free_prompt(void*);
 static int          completion_shim_impl(int, int, int (*)(int, int));
@@ -42,11 +45,16 @@ int                 rl_complete(int, int);
 int                 rl_menu_complete(int, int);
 int                 rl_backward_menu_complete(int, int);
 void                load_history();
-void                save_history();
-void                add_to_history(const char*);
+int                 add_to_history(const char*);
+void                add_to_shared_history(const char*);
+void                capture_history_exit_code();
+char**              get_ranked_history(int*);
 int                 expand_from_history(const char*, char**);
 int                 history_expand_control(char*, int);
 void                initialise_fwrite();
+int                 load_inputrc_snapshot();
+void                begin_inputrc_snapshot();
+void                end_inputrc_snapshot();
 
 int                 g_slash_translation             = 0;
 extern int          rl_visible_stats;
@@ -56,6 +64,7 @@ extern const char*  rl_filename_quote_characters;
 extern int          rl_catch_signals;
 extern int          _rl_complete_mark_directories;
 extern char*        _rl_comment_begin;
+static const char*  g_unfiltered_prompt             = NULL;
 
 //------------------------------------------------------------------------------
 // This ensures the cursor is visible as printing to the console usually makes
@@ -157,6 +166,30 @@ static void quote_matches(char** matches)
     }
 }
 
+//------------------------------------------------------------------------------
+static void apply_match_suffix(char** matches)
+{
+    // A single match added as a record with a suffix decides what's appended
+    // after it's inserted, in place of Readline's usual character. Readline
+    // only appends one character so that's all a suffix can be.
+
+    const match_info_t* info;
+
+    if (matches[0] == NULL || matches[1] != NULL)
+    {
+        return;
+    }
+
+    info = match_info_find(get_match_infos(), matches[0]);
+    if (info == NULL || info->suffix == NULL)
+    {
+        return;
+    }
+
+    rl_completion_append_character = info->suffix[0];
+    rl_completion_suppress_append = (info->suffix[0] == '\0');
+}
+
 //------------------------------------------------------------------------------
 static int postprocess_matches(char** matches)
 {
@@ -164,6 +197,8 @@ static int postprocess_matches(char** matches)
     int need_quote;
     int first_needs_quotes;
 
+    apply_match_suffix(matches);
+
     if (g_slash_translation >= 0)
     {
         switch (g_slash_translation)
@@ -284,6 +319,7 @@ char** match_display_filter(char** matches, int match_count)
 {
     int i;
     char** new_matches;
+    const match_info_table_t* infos;
 
     ++match_count;
 
@@ -296,20 +332,29 @@ char** match_display_filter(char** matches, int match_count)
     }
 
     // The matches need to be processed so needless path information is removed
-    // (this is caused by the \ and / hurdles).
+    // (this is caused by the \ and / hurdles). Matches added as records say
+    // how they're displayed and what they are, so they don't need a stat.
+    infos = get_match_infos();
     new_matches = (char**)calloc(1, match_count * sizeof(char*));
     for (i = 0; i < match_count; ++i)
     {
+        const match_info_t* info;
         int is_dir = 0;
         int len;
         char* base = NULL;
-        
+
+        info = (i > 0) ? match_info_find(infos, matches[i]) : NULL;
+        if (info != NULL && info->display != NULL)
+        {
+            new_matches[i] = malloc(strlen(info->display) + 1);
+            strcpy(new_matches[i], info->display);
+            continue;
+        }
+
         // If matches are files then strip off the path and establish if they
         // are directories.
         if (rl_filename_completion_desired)
         {
-            DWORD file_attrib;
-
             base = strrchr(matches[i], '\\');
             if (base == NULL)
             {
@@ -317,10 +362,19 @@ char** match_display_filter(char** matches, int match_count)
             }
 
             // Is this a dir?
-            file_attrib = GetFileAttributes(matches[i]);
-            if (file_attrib != INVALID_FILE_ATTRIBUTES)
+            if (info != NULL && info->type != MATCH_TYPE_NONE)
             {
-                is_dir = !!(file_attrib & FILE_ATTRIBUTE_DIRECTORY);
+                is_dir = (info->type == MATCH_TYPE_DIR);
+            }
+            else
+            {
+                DWORD file_attrib;
+
+                file_attrib = GetFileAttributes(matches[i]);
+                if (file_attrib != INVALID_FILE_ATTRIBUTES)
+                {
+                    is_dir = !!(file_attrib & FILE_ATTRIBUTE_DIRECTORY);
+                }
             }
         }
         base = (base == NULL) ? matches[i] : base + 1;
@@ -348,6 +402,9 @@ static void display_matches(char** matches, int match_count, int longest)
     wchar_t buffer[512];
     int show_matches = 2;
     int match_colour;
+    double started;
+
+    started = stats_clock();
 
     // Process matches and recalculate the longest match length.
     new_matches = match_display_filter(matches, match_count);
@@ -359,6 +416,8 @@ static void display_matches(char** matches, int match_count, int longest)
         longest = (len > longest) ? len : longest;
     }
 
+    hooked_fflush(NULL);
+
     std_out_handle = GetStdHandle(STD_OUTPUT_HANDLE);
     GetConsoleScreenBufferInfo(std_out_handle, &csbi);
 
@@ -436,7 +495,9 @@ static void display_matches(char** matches, int match_count, int longest)
         rl_crlf();
     }
 
-    // Reset console colour back to normal.
+    // Reset console colour back to normal, once the matches have been written
+    // out in the match colour.
+    hooked_fflush(NULL);
     SetConsoleTextAttribute(std_out_handle, csbi.wAttributes);
     rl_forced_update_display();
     rl_display_fixed = 1;
@@ -447,6 +508,11 @@ static void display_matches(char** matches, int match_count, int longest)
         free(new_matches[i]);
     }
     free(new_matches);
+
+    if (stats_enabled())
+    {
+        stats_record("display_matches", started, match_count, 0);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -486,8 +552,15 @@ static int initialise_hook()
     clink_register_rl_funcs();
     initialise_rl_scroller();
 
-    rl_re_read_init_file(0, 0);
-    read_profile_inputrc();
+    // Parsing the inputrc files is skipped if a snapshot of a previous parse
+    // is still valid.
+    if (!load_inputrc_snapshot())
+    {
+        begin_inputrc_snapshot();
+        rl_re_read_init_file(0, 0);
+        read_profile_inputrc();
+        end_inputrc_snapshot();
+    }
 
     rl_visible_stats = 0;               // serves no purpose under win32.
 
@@ -495,6 +568,72 @@ static int initialise_hook()
     return 0;
 }
 
+//------------------------------------------------------------------------------
+void refresh_prompt()
+{
+    // Called when asynchronous prompt filters have new results. The prompt is
+    // filtered again and if it's different it's redrawn in place.
+
+    extern int _rl_last_v_pos;
+    extern int _rl_vis_botlin;
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    HANDLE handle;
+    COORD pos;
+    DWORD written;
+    const char* prepared_prompt;
+    const char* c;
+    int cell_count;
+    int rows;
+
+    // Nothing to do if the prompt was already on screen when we were called,
+    // or if Readline's displaying something else (e.g. i-search) instead.
+    if (g_unfiltered_prompt == NULL || rl_display_prompt != rl_prompt)
+    {
+        return;
+    }
+
+    // Readline takes a copy of the prompt so the shared buffer's enough here.
+    prepared_prompt = filter_prompt_shared(g_unfiltered_prompt);
+    if (prepared_prompt == NULL || strcmp(prepared_prompt, rl_prompt) == 0)
+    {
+        return;
+    }
+
+    // Readline draws all but the prompt's last line once, above its first row.
+    rows = 0;
+    for (c = rl_prompt; *c; ++c)
+    {
+        rows += (*c == '\n');
+    }
+
+    // Clear from the prompt's first line down to the line's last row.
+    hooked_fflush(NULL);
+
+    handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    GetConsoleScreenBufferInfo(handle, &csbi);
+
+    pos.X = 0;
+    pos.Y = csbi.dwCursorPosition.Y - _rl_last_v_pos - rows;
+    if (pos.Y < 0)
+    {
+        pos.Y = 0;
+    }
+
+    cell_count = csbi.dwCursorPosition.Y - pos.Y;
+    cell_count += _rl_vis_botlin - _rl_last_v_pos + 1;
+    cell_count *= csbi.dwSize.X;
+
+    FillConsoleOutputCharacterW(handle, ' ', cell_count, pos, &written);
+    FillConsoleOutputAttribute(handle, csbi.wAttributes, cell_count, pos,
+        &written);
+    SetConsoleCursorPosition(handle, pos);
+
+    // And draw everything again.
+    rl_set_prompt(prepared_prompt);
+    rl_forced_update_display();
+}
+
 //------------------------------------------------------------------------------
 static char* call_readline_impl(const char* prompt)
 {
@@ -502,7 +641,8 @@ static char* call_readline_impl(const char* prompt)
     int expand_result;
     char* text;
     char* expanded;
-    char* prepared_prompt;
+    char* extracted_prompt;
+    const char* prepared_prompt;
     char cwd_cache[MAX_PATH];
 
     // Make sure that EOL wrap is on. Readline's told the terminal supports it.
@@ -521,40 +661,47 @@ static char* call_readline_impl(const char* prompt)
 
         load_history();
         history_inhibit_expansion_function = history_expand_control;
+        rl_history_rank_hook = get_ranked_history;
 
         rl_catch_signals = 0;
+        rl_inhibit_init_file = 1;
         rl_startup_hook = initialise_hook;
         initialised = 1;
     }
 
+    // Note how whatever the last line ran went.
+    capture_history_exit_code();
+
     // If no prompt was provided assume the line is prompted already and
     // extract it. If a prompt was provided filter it through Lua.
-    prepared_prompt = NULL;
+    extracted_prompt = NULL;
     if (prompt == NULL)
     {
-        prepared_prompt = extract_prompt(1);
+        extracted_prompt = extract_prompt(1);
 
         // Even though we're not going to display filtered result the extracted
         // prompt is run through Lua. This is a little bit of a hack, but helps
         // to keep behaviour consistent.
-        if (prepared_prompt != NULL)
+        if (extracted_prompt != NULL)
         {
-            char buffer[1024];
-
-            str_cpy(buffer, prepared_prompt, sizeof(buffer));
-            lua_filter_prompt(buffer, sizeof_array(buffer));
+            lua_filter_prompt(extracted_prompt, NULL);
         }
     }
     else
     {
-        prepared_prompt = filter_prompt(prompt);
+        filter_prompt_shared(prompt);
     }
 
+    g_unfiltered_prompt = prompt;
+
     GetCurrentDirectory(sizeof_array(cwd_cache), cwd_cache);
 
     do
     {
-        // Call readline
+        // Call readline. The filtered prompt's borrowed from the shared buffer
+        // (Readline copies it) so it's fetched each time round as
+        // refresh_prompt() may have filtered it again since.
+        prepared_prompt = prompt ? get_filtered_prompt() : extracted_prompt;
         rl_already_prompted = (prompt == NULL);
         text = readline(prepared_prompt ? prepared_prompt : "");
         if (!text)
@@ -577,20 +724,18 @@ static char* call_readline_impl(const char* prompt)
             }
         }
 
-        // Should we read the history from disk.
+        // Should we share the history with other sessions as we go?
         if (get_clink_setting_int("history_io"))
-        {
-            load_history();
-            add_to_history(text);
-            save_history();
-        }
+            add_to_shared_history(text);
         else
             add_to_history(text);
     }
     while (!text || expand_result == 2);
 
 call_readline_epilogue:
-    free_prompt(prepared_prompt);
+    g_unfiltered_prompt = NULL;
+    hooked_fflush(NULL);
+    free_prompt(extracted_prompt);
     SetCurrentDirectory(cwd_cache);
     return text;
 }
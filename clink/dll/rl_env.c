@@ -20,6 +20,8 @@
  */
 
 #include "pch.h"
+#include "env_names.h"
+#include "shared/str_builder.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
@@ -110,6 +112,7 @@ static void apply_env(const env_block_t* block)
     free_env(&to_clear);
 
     apply_env_impl(block, 0);
+    invalidate_env_names();
 }
 
 //------------------------------------------------------------------------------
@@ -118,43 +121,39 @@ void prepare_env_for_inputrc()
     // Give readline a chance to find the inputrc by modifying the
     // environment slightly.
 
-    char buffer[1024];
+    char dll_dir[MAX_PATH];
+    str_builder_t buffer;
     void* env_handle;
     env_block_t env_block;
 
     capture_env(&env_block);
+    str_builder_init(&buffer);
 
     // HOME is where Readline will expand ~ to.
     if (getenv("home") == NULL)
     {
-        static const char home_eq[] = "HOME=";
-        int size = sizeof_array(home_eq);
-
-        strcpy(buffer, home_eq);
+        str_builder_append(&buffer, "HOME=");
         if (getenv("homedrive") && getenv("homepath"))
         {
-            str_cat(buffer, getenv("homedrive"), sizeof_array(buffer));
-            str_cat(buffer, getenv("homepath"), sizeof_array(buffer));
+            str_builder_append(&buffer, getenv("homedrive"));
+            str_builder_append(&buffer, getenv("homepath"));
         }
         else if (getenv("userprofile"))
         {
-            str_cat(buffer, getenv("userprofile"), sizeof_array(buffer));
+            str_builder_append(&buffer, getenv("userprofile"));
         }
 
-        putenv(buffer);
+        putenv(buffer.data);
     }
 
     // INPUTRC is the path where looks for it's configuration file.
-    {
-        static const char inputrc_eq[] = "INPUTRC=";
-        int size = sizeof_array(inputrc_eq);
+    get_dll_dir(dll_dir, sizeof_array(dll_dir));
 
-        strcpy(buffer, inputrc_eq);
-        get_dll_dir(buffer + size - 1, sizeof_array(buffer) - size);
-        str_cat(buffer, "/clink_inputrc_base", sizeof_array(buffer));
+    str_builder_clear(&buffer);
+    str_builder_printf(&buffer, "INPUTRC=%s/clink_inputrc_base", dll_dir);
+    putenv(buffer.data);
 
-        putenv(buffer);
-    }
+    str_builder_free(&buffer);
 
     apply_env(&env_block);
     free_env(&env_block);
@@ -20,140 +20,49 @@
  */
 
 #include "pch.h"
+#include "ansi.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
-const wchar_t*      find_next_ansi_code_w(const wchar_t*, int*);
 int                 get_clink_setting_int(const char*);
-int                 parse_ansi_code_w(const wchar_t*, int*, int);
-
-//------------------------------------------------------------------------------
-static int ansi_to_attr(int colour)
-{
-    static const int map[] = { 0, 4, 2, 6, 1, 5, 3, 7 };
-    return map[colour & 7];
-}
-
-//------------------------------------------------------------------------------
-static int fwrite_ansi_code(const wchar_t* code, int current, int defaults)
-{
-    int i, n;
-    int params[32];
-    HANDLE handle;
-    int attr;
-
-    i = parse_ansi_code_w(code, params, sizeof_array(params));
-    if (i != 'm')
-        return current;
-
-    handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    attr = current;
-
-    // Count the number of parameters the code has.
-    n = 0;
-    while (n < sizeof_array(params) && params[n] >= 0)
-    {
-        ++n;
-    }
-
-    // Process each code that is supported.
-    for (i = 0; i < n; ++i)
-    {
-        int param = params[i];
-
-        if (param == 0) // reset
-        {
-            attr = defaults;
-        }
-        else if (param == 1) // fg intensity (bright)
-        {
-            attr |= 0x08;
-        }
-        else if (param == 2 || param == 22) // fg intensity (normal)
-        {
-            attr &= ~0x08;
-        }
-        else if (param == 4) // bg intensity (bright)
-        {
-            attr |= 0x80;
-        }
-        else if (param == 24) // bg intensity (normal)
-        {
-            attr &= ~0x80;
-        }
-        else if ((unsigned int)param - 30 < 8) // fg colour
-        {
-            attr = (attr & 0xf8) | ansi_to_attr(param - 30);
-        }
-        else if (param == 39) // default fg colour
-        {
-            attr = (attr & 0xf8) | (defaults & 0x07);
-        }
-        else if ((unsigned int)param - 40 < 8) // bg colour
-        {
-            attr = (attr & 0x8f) | (ansi_to_attr(param - 40) << 4);
-        }
-        else if (param == 49) // default bg colour
-        {
-            attr = (attr & 0x8f) | (defaults & 0x70);
-        }
-        else if (param == 38 || param == 48) // extended colour (skipped)
-        {
-            // format = param;5;[0-255] or param;2;r;g;b
-            ++i;
-            if (i >= n)
-                break;
-
-            switch (params[i])
-            {
-            case 2: i += 3; break;
-            case 5: i += 1; break;
-            }
-
-            continue;
-        }
-    }
-
-    SetConsoleTextAttribute(handle, attr);
-    return attr;
-}
 
 //------------------------------------------------------------------------------
 void fwrite_hook(wchar_t* str)
 {
-    const wchar_t* next;
     HANDLE handle;
     DWORD written;
     CONSOLE_SCREEN_BUFFER_INFO csbi;
-    int attr_def;
+    ansi_state_t state;
+    ansi_span_t span;
     int attr_cur;
 
     handle = GetStdHandle(STD_OUTPUT_HANDLE);
     GetConsoleScreenBufferInfo(handle, &csbi);
 
-    attr_def = csbi.wAttributes;
-    attr_cur = attr_def;
-    next = str;
-    while (*next)
+    ansi_begin(&state, csbi.wAttributes);
+    attr_cur = state.attr;
+    while (ansi_next_w(str, &state, &span))
     {
-        int ansi_size;
-        const wchar_t* ansi_code;
-
-        ansi_code = find_next_ansi_code_w(next, &ansi_size);
-
-        // Dispatch console write
-        WriteConsoleW(handle, next, ansi_code - next, &written, NULL);
-
-        // Process ansi code.
-        if (*ansi_code)
+        switch (span.type)
         {
-            attr_cur = fwrite_ansi_code(ansi_code, attr_cur, attr_def);
-        }
+        case ANSI_SPAN_TEXT:
+            WriteConsoleW(handle, str + span.offset, span.length, &written, NULL);
+            break;
 
-        next = ansi_code + ansi_size;
+        case ANSI_SPAN_SGR:
+            if (state.attr != attr_cur)
+            {
+                attr_cur = state.attr;
+                SetConsoleTextAttribute(handle, attr_cur);
+            }
+            break;
+        }
     }
 
-    SetConsoleTextAttribute(handle, attr_def);
+    if (attr_cur != state.defaults)
+    {
+        SetConsoleTextAttribute(handle, state.defaults);
+    }
 }
 
 //------------------------------------------------------------------------------
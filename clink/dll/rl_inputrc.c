@@ -0,0 +1,751 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+int                 _rl_find_funmap_entry(const char*);
+
+#define SNAPSHOT_MAGIC      0x49434c43  // 'CLCI'
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_MAX_MAPS   256
+#define SNAPSHOT_NAMED_MAPS 5
+
+//------------------------------------------------------------------------------
+// A snapshot of the keymaps and variables that result from parsing the
+// inputrc files. It is keyed by the content hashes of every file the parser
+// tried to read (present or not) so any edit causes a reparse. Functions are
+// stored by name and resolved back to pointers when the snapshot is loaded.
+//
+//  int magic, version
+//  str build, readline_name, terminal_name, HOME, INPUTRC
+//  int files_size  { str path, int size, int hash }...
+//  int vars_size   { str name, str value }...
+//  int func_count  { str name }...
+//  int macro_count { str macro }...
+//  int keymap_count, entries[keymap_count * KEYMAP_SIZE]
+//
+// Strings are stored as an int length (-1 for NULL) followed by the string's
+// characters and a terminator, so they can be used in place once loaded.
+// Entries are a keymap entry's type in the top 8 bits and an index into the
+// funcs, macros, or keymaps in the bottom 24 (plus one for functions, with
+// zero being a NULL function).
+
+//------------------------------------------------------------------------------
+typedef struct
+{
+    char*           data;
+    int             size;
+    int             capacity;
+} blob_t;
+
+typedef struct
+{
+    const char*     read;
+    const char*     end;
+    int             ok;
+} reader_t;
+
+static blob_t       g_files;
+static blob_t       g_vars;
+static int          g_recording         = 0;
+
+//------------------------------------------------------------------------------
+static void get_snapshot_file_name(char* buffer, int size)
+{
+    get_config_dir(buffer, size);
+    str_cat(buffer, "/inputrc_snapshot", size);
+}
+
+//------------------------------------------------------------------------------
+static unsigned int hash_data(const char* data, int size)
+{
+    unsigned int hash = 2166136261u;
+
+    while (size-- > 0)
+    {
+        hash ^= (unsigned char)*data++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+static void blob_write(blob_t* blob, const void* data, int size)
+{
+    if (blob->size + size > blob->capacity)
+    {
+        int capacity = blob->capacity ? blob->capacity : 1024;
+        while (capacity < blob->size + size)
+        {
+            capacity <<= 1;
+        }
+
+        blob->data = realloc(blob->data, capacity);
+        blob->capacity = capacity;
+    }
+
+    memcpy(blob->data + blob->size, data, size);
+    blob->size += size;
+}
+
+//------------------------------------------------------------------------------
+static void blob_write_int(blob_t* blob, int value)
+{
+    blob_write(blob, &value, sizeof(value));
+}
+
+//------------------------------------------------------------------------------
+static void blob_write_str(blob_t* blob, const char* str)
+{
+    int length = (str != NULL) ? (int)strlen(str) : -1;
+
+    blob_write_int(blob, length);
+    if (str != NULL)
+    {
+        blob_write(blob, str, length + 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+static void blob_free(blob_t* blob)
+{
+    free(blob->data);
+    blob->data = NULL;
+    blob->size = 0;
+    blob->capacity = 0;
+}
+
+//------------------------------------------------------------------------------
+static int read_int(reader_t* reader)
+{
+    int value = 0;
+
+    if (!reader->ok || reader->end - reader->read < (int)sizeof(value))
+    {
+        reader->ok = 0;
+        return 0;
+    }
+
+    memcpy(&value, reader->read, sizeof(value));
+    reader->read += sizeof(value);
+    return value;
+}
+
+//------------------------------------------------------------------------------
+static const char* read_str(reader_t* reader)
+{
+    const char* str;
+    int length;
+
+    length = read_int(reader);
+    if (!reader->ok || length < 0)
+    {
+        return NULL;
+    }
+
+    if (reader->end - reader->read <= length || reader->read[length] != '\0')
+    {
+        reader->ok = 0;
+        return NULL;
+    }
+
+    str = reader->read;
+    reader->read += length + 1;
+    return str;
+}
+
+//------------------------------------------------------------------------------
+static void read_blob(reader_t* reader, reader_t* blob)
+{
+    int size;
+
+    size = read_int(reader);
+    if (size < 0 || reader->end - reader->read < size)
+    {
+        reader->ok = 0;
+    }
+
+    blob->ok = reader->ok;
+    blob->read = reader->read;
+    blob->end = reader->ok ? reader->read + size : reader->read;
+
+    reader->read = blob->end;
+}
+
+//------------------------------------------------------------------------------
+static int str_equals(const char* lhs, const char* rhs)
+{
+    if (lhs == NULL || rhs == NULL)
+    {
+        return (lhs == rhs);
+    }
+
+    return (strcmp(lhs, rhs) == 0);
+}
+
+//------------------------------------------------------------------------------
+static void get_key_strings(const char** strings)
+{
+    strings[0] = __DATE__ " " __TIME__;
+    strings[1] = rl_readline_name;
+    strings[2] = rl_terminal_name;
+    strings[3] = getenv("HOME");
+    strings[4] = getenv("INPUTRC");
+}
+
+//------------------------------------------------------------------------------
+static int file_matches(const char* path, int size, unsigned int hash)
+{
+    FILE* in;
+    char* data;
+    int length;
+    int ok;
+
+    // Readline reads init files in text mode, and so do we.
+    in = fopen(path, "r");
+    if (in == NULL)
+    {
+        return (size < 0);
+    }
+
+    fseek(in, 0, SEEK_END);
+    length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    data = malloc(length + 1);
+    length = (int)fread(data, 1, length, in);
+    fclose(in);
+
+    ok = (length == size) && (hash_data(data, length) == hash);
+
+    free(data);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+static void on_init_file_read(const char* path, const char* buffer, size_t size)
+{
+    blob_write_str(&g_files, path);
+    blob_write_int(&g_files, (buffer != NULL) ? (int)size : -1);
+    blob_write_int(&g_files, (buffer != NULL) ? hash_data(buffer, (int)size) : 0);
+}
+
+//------------------------------------------------------------------------------
+static void on_init_file_variable(const char* name, const char* value)
+{
+    blob_write_str(&g_vars, name);
+    blob_write_str(&g_vars, value);
+}
+
+//------------------------------------------------------------------------------
+static void get_named_keymaps(Keymap* keymaps)
+{
+    keymaps[0] = emacs_standard_keymap;
+    keymaps[1] = emacs_meta_keymap;
+    keymaps[2] = emacs_ctlx_keymap;
+    keymaps[3] = vi_insertion_keymap;
+    keymaps[4] = vi_movement_keymap;
+}
+
+//------------------------------------------------------------------------------
+static int find_funmap_index(rl_command_func_t* func)
+{
+    int i;
+
+    for (i = 0; funmap[i] != NULL; ++i)
+    {
+        if (funmap[i]->function == func)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+static int write_keymaps(blob_t* out)
+{
+    Keymap keymaps[SNAPSHOT_MAX_MAPS];
+    int keymap_count;
+    int* func_slots;
+    int funmap_count;
+    int func_count;
+    int macro_count;
+    blob_t funcs = { 0 };
+    blob_t macros = { 0 };
+    blob_t entries = { 0 };
+    int ok;
+    int i, j;
+
+    get_named_keymaps(keymaps);
+    keymap_count = SNAPSHOT_NAMED_MAPS;
+
+    // funmap index -> index in the snapshot's function table plus one.
+    for (funmap_count = 0; funmap[funmap_count] != NULL; ++funmap_count);
+    func_slots = calloc(funmap_count + 1, sizeof(*func_slots));
+    func_count = 0;
+    macro_count = 0;
+
+    // Nested keymaps are appended to 'keymaps' as they are found, so the loop
+    // visits them too.
+    ok = 1;
+    for (i = 0; ok && i < keymap_count; ++i)
+    {
+        Keymap map = keymaps[i];
+
+        for (j = 0; j < KEYMAP_SIZE; ++j)
+        {
+            int value = 0;
+            int type = map[j].type;
+
+            switch (type)
+            {
+            case ISFUNC:
+                if (map[j].function != NULL)
+                {
+                    int k = find_funmap_index(map[j].function);
+                    if (k < 0)
+                    {
+                        LOG_INFO("Unnamed function bound at %d/%d.", i, j);
+                        ok = 0;
+                        break;
+                    }
+
+                    if (func_slots[k] == 0)
+                    {
+                        blob_write_str(&funcs, funmap[k]->name);
+                        func_slots[k] = ++func_count;
+                    }
+
+                    value = func_slots[k];
+                }
+                break;
+
+            case ISKMAP:
+                for (value = 0; value < keymap_count; ++value)
+                {
+                    if (keymaps[value] == (Keymap)(map[j].function))
+                    {
+                        break;
+                    }
+                }
+
+                if (value == keymap_count)
+                {
+                    if (keymap_count >= SNAPSHOT_MAX_MAPS)
+                    {
+                        ok = 0;
+                        break;
+                    }
+
+                    keymaps[keymap_count++] = (Keymap)(map[j].function);
+                }
+                break;
+
+            case ISMACR:
+                blob_write_str(&macros, (const char*)(map[j].function));
+                value = macro_count++;
+                break;
+
+            default:
+                ok = 0;
+                break;
+            }
+
+            if (!ok)
+            {
+                break;
+            }
+
+            blob_write_int(&entries, (type << 24) | (value & 0xffffff));
+        }
+    }
+
+    if (ok)
+    {
+        blob_write_int(out, func_count);
+        blob_write(out, funcs.data, funcs.size);
+        blob_write_int(out, macro_count);
+        blob_write(out, macros.data, macros.size);
+        blob_write_int(out, keymap_count);
+        blob_write(out, entries.data, entries.size);
+    }
+
+    free(func_slots);
+    blob_free(&funcs);
+    blob_free(&macros);
+    blob_free(&entries);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+static void save_inputrc_snapshot()
+{
+    int i;
+    FILE* out;
+    blob_t blob = { 0 };
+    const char* key_strings[5];
+    char file_name[MAX_PATH];
+    char temp_name[MAX_PATH];
+
+    blob_write_int(&blob, SNAPSHOT_MAGIC);
+    blob_write_int(&blob, SNAPSHOT_VERSION);
+
+    get_key_strings(key_strings);
+    for (i = 0; i < sizeof_array(key_strings); ++i)
+    {
+        blob_write_str(&blob, key_strings[i]);
+    }
+
+    blob_write_int(&blob, g_files.size);
+    blob_write(&blob, g_files.data, g_files.size);
+    blob_write_int(&blob, g_vars.size);
+    blob_write(&blob, g_vars.data, g_vars.size);
+
+    if (!write_keymaps(&blob))
+    {
+        blob_free(&blob);
+        return;
+    }
+
+    // Write to a temporary file first so other sessions starting at the same
+    // time never see a partially written snapshot.
+    get_snapshot_file_name(file_name, sizeof_array(file_name));
+    _snprintf(temp_name, sizeof_array(temp_name), "%s_%d", file_name,
+        GetCurrentProcessId());
+    temp_name[sizeof_array(temp_name) - 1] = '\0';
+
+    out = fopen(temp_name, "wb");
+    if (out != NULL)
+    {
+        i = (fwrite(blob.data, blob.size, 1, out) == 1);
+        fclose(out);
+
+        if (!i || !MoveFileEx(temp_name, file_name, MOVEFILE_REPLACE_EXISTING))
+        {
+            unlink(temp_name);
+        }
+    }
+
+    blob_free(&blob);
+}
+
+//------------------------------------------------------------------------------
+static void discard_keymaps()
+{
+    // Frees the macros and nested keymaps the current bindings own, before a
+    // snapshot overwrites them. Nested maps are collected first as they may be
+    // shared, or bound back to one of the named maps which aren't ours to free.
+    Keymap* keymaps;
+    int keymap_count;
+    int capacity;
+    int i, j, k;
+
+    capacity = SNAPSHOT_MAX_MAPS;
+    keymaps = malloc(capacity * sizeof(*keymaps));
+    get_named_keymaps(keymaps);
+    keymap_count = SNAPSHOT_NAMED_MAPS;
+
+    for (i = 0; i < keymap_count; ++i)
+    {
+        Keymap map = keymaps[i];
+
+        for (j = 0; j < KEYMAP_SIZE; ++j)
+        {
+            switch (map[j].type)
+            {
+            case ISKMAP:
+                for (k = 0; k < keymap_count; ++k)
+                {
+                    if (keymaps[k] == (Keymap)(map[j].function))
+                    {
+                        break;
+                    }
+                }
+
+                if (k == keymap_count && map[j].function != NULL)
+                {
+                    if (keymap_count >= capacity)
+                    {
+                        capacity <<= 1;
+                        keymaps = realloc(keymaps, capacity * sizeof(*keymaps));
+                    }
+
+                    keymaps[keymap_count++] = (Keymap)(map[j].function);
+                }
+                break;
+
+            case ISMACR:
+                free((char*)(map[j].function));
+                break;
+            }
+
+            map[j].type = ISFUNC;
+            map[j].function = NULL;
+        }
+    }
+
+    for (i = SNAPSHOT_NAMED_MAPS; i < keymap_count; ++i)
+    {
+        free(keymaps[i]);
+    }
+
+    free(keymaps);
+}
+
+//------------------------------------------------------------------------------
+static int apply_snapshot(reader_t* reader)
+{
+    int i, j;
+    int func_count;
+    int macro_count;
+    int keymap_count;
+    int size;
+    rl_command_func_t** funcs;
+    const char** macros;
+    Keymap keymaps[SNAPSHOT_MAX_MAPS];
+    const char* key_strings[5];
+    const char* entries;
+    reader_t files;
+    reader_t vars;
+    int ok;
+
+    // Check the snapshot was made by this build in the same environment.
+    if (read_int(reader) != SNAPSHOT_MAGIC || read_int(reader) != SNAPSHOT_VERSION)
+    {
+        return 0;
+    }
+
+    get_key_strings(key_strings);
+    for (i = 0; i < sizeof_array(key_strings); ++i)
+    {
+        const char* str = read_str(reader);
+        if (!reader->ok || !str_equals(str, key_strings[i]))
+        {
+            return 0;
+        }
+    }
+
+    // Check none of the files have changed.
+    read_blob(reader, &files);
+    while (files.ok && files.read < files.end)
+    {
+        const char* path = read_str(&files);
+        int size = read_int(&files);
+        unsigned int hash = (unsigned int)read_int(&files);
+
+        if (!files.ok || path == NULL || !file_matches(path, size, hash))
+        {
+            return 0;
+        }
+    }
+
+    read_blob(reader, &vars);
+
+    // Resolve the function names back to pointers and collect the macros.
+    func_count = read_int(reader);
+    if (!reader->ok || func_count < 0 || func_count > reader->end - reader->read)
+    {
+        return 0;
+    }
+
+    funcs = malloc((func_count + 1) * sizeof(*funcs));
+    funcs[0] = NULL;
+    for (i = 1; i <= func_count && reader->ok; ++i)
+    {
+        const char* name = read_str(reader);
+        int k = (name != NULL) ? _rl_find_funmap_entry(name) : -1;
+
+        reader->ok &= (k >= 0);
+        funcs[i] = reader->ok ? funmap[k]->function : NULL;
+    }
+
+    macro_count = read_int(reader);
+    ok = reader->ok && macro_count >= 0;
+    ok = ok && (macro_count <= reader->end - reader->read);
+    macros = malloc((ok ? macro_count + 1 : 1) * sizeof(*macros));
+    for (i = 0; ok && i < macro_count; ++i)
+    {
+        macros[i] = read_str(reader);
+        ok = reader->ok && (macros[i] != NULL);
+    }
+
+    // Validate the keymap entries before anything is modified.
+    keymap_count = read_int(reader);
+    ok = ok && reader->ok;
+    ok = ok && (keymap_count >= SNAPSHOT_NAMED_MAPS);
+    ok = ok && (keymap_count <= SNAPSHOT_MAX_MAPS);
+    size = keymap_count * KEYMAP_SIZE * (int)sizeof(int);
+    ok = ok && (reader->end - reader->read == size);
+
+    entries = reader->read;
+    for (i = 0; ok && i < keymap_count * KEYMAP_SIZE; ++i)
+    {
+        int entry;
+        int value;
+
+        memcpy(&entry, entries + i * sizeof(int), sizeof(entry));
+        value = entry & 0xffffff;
+
+        switch (entry >> 24)
+        {
+        case ISFUNC:    ok = (value <= func_count);     break;
+        case ISKMAP:    ok = (value < keymap_count);    break;
+        case ISMACR:    ok = (value < macro_count);     break;
+        default:        ok = 0;                         break;
+        }
+    }
+
+    if (ok)
+    {
+        // Replay the variables that were set.
+        while (vars.ok && vars.read < vars.end)
+        {
+            const char* name = read_str(&vars);
+            const char* value = read_str(&vars);
+
+            if (vars.ok && name != NULL)
+            {
+                rl_variable_bind(name, value);
+            }
+        }
+
+        // Restore the keymaps, releasing what the ones they replace owned.
+        discard_keymaps();
+        get_named_keymaps(keymaps);
+        for (i = SNAPSHOT_NAMED_MAPS; i < keymap_count; ++i)
+        {
+            keymaps[i] = rl_make_bare_keymap();
+        }
+
+        for (i = 0; i < keymap_count; ++i)
+        {
+            for (j = 0; j < KEYMAP_SIZE; ++j)
+            {
+                int entry;
+                int value;
+                KEYMAP_ENTRY* out = keymaps[i] + j;
+
+                memcpy(&entry, entries, sizeof(entry));
+                entries += sizeof(entry);
+                value = entry & 0xffffff;
+
+                out->type = entry >> 24;
+                switch (out->type)
+                {
+                case ISFUNC:
+                    out->function = funcs[value];
+                    break;
+
+                case ISKMAP:
+                    out->function = (rl_command_func_t*)(keymaps[value]);
+                    break;
+
+                case ISMACR:
+                    out->function = (rl_command_func_t*)malloc(strlen(macros[value]) + 1);
+                    strcpy((char*)(out->function), macros[value]);
+                    break;
+                }
+            }
+        }
+
+        rl_set_keymap_from_edit_mode();
+    }
+
+    free(funcs);
+    free(macros);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int load_inputrc_snapshot()
+{
+    int ok;
+    int size;
+    FILE* in;
+    char* data;
+    reader_t reader;
+    char file_name[MAX_PATH];
+
+    get_snapshot_file_name(file_name, sizeof_array(file_name));
+    in = fopen(file_name, "rb");
+    if (in == NULL)
+    {
+        return 0;
+    }
+
+    // One read of the whole snapshot. Strings are then used in place.
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    data = malloc(size + 1);
+    size = (int)fread(data, 1, size, in);
+    fclose(in);
+
+    reader.read = data;
+    reader.end = data + size;
+    reader.ok = 1;
+
+    ok = apply_snapshot(&reader);
+    if (!ok)
+    {
+        LOG_INFO("Inputrc snapshot is out of date or invalid.");
+    }
+
+    free(data);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+void begin_inputrc_snapshot()
+{
+    blob_free(&g_files);
+    blob_free(&g_vars);
+
+    rl_init_file_read_hook = on_init_file_read;
+    rl_init_file_variable_hook = on_init_file_variable;
+    g_recording = 1;
+}
+
+//------------------------------------------------------------------------------
+void end_inputrc_snapshot()
+{
+    if (!g_recording)
+    {
+        return;
+    }
+
+    rl_init_file_read_hook = NULL;
+    rl_init_file_variable_hook = NULL;
+    g_recording = 0;
+
+    save_inputrc_snapshot();
+
+    blob_free(&g_files);
+    blob_free(&g_vars);
+}
+
+// vim: expandtab
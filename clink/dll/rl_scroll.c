@@ -115,6 +115,8 @@ void enter_scroll_mode(int scroll_one_page)
     CONSOLE_SCREEN_BUFFER_INFO csbi;
     HANDLE handle;
 
+    hooked_fflush(NULL);
+
     handle = GetStdHandle(STD_OUTPUT_HANDLE);
     GetConsoleScreenBufferInfo(handle, &csbi);
 
@@ -51,6 +51,16 @@ static const setting_decl_t g_settings_decl[] = {
         SETTING_TYPE_INT,
         0, "-1"
     },
+    {
+        "match_fuzzy",
+        "Match the typed characters anywhere in order",
+        "When non-zero, completions match if they contain what's been typed "
+        "as a subsequence (\"fb\" matches \"foo_bar\") and are listed best "
+        "match first. Matches where the characters start words or run on "
+        "from each other rank highest.",
+        SETTING_TYPE_BOOL,
+        0, "0"
+    },
     {
         "exec_match_style",
         "Executable match style",
@@ -111,16 +121,28 @@ static const setting_decl_t g_settings_decl[] = {
         "If a line is a duplicate of an existing history entry Clink will "
         "erase the duplicate when this is set 2. A value of 1 will not add "
         "duplicates to the history and a value of 0 will always add lines. "
-        "Note that history is not deduplicated when reading/writing to disk.",
+        "When non-zero the history file is also deduplicated whenever it is "
+        "trimmed to 'history_file_lines'.",
         SETTING_TYPE_ENUM,
         "Always add\0Ignore\0Erase previous",
         "2"
     },
     {
         "history_io",
-        "Read/write history file each line edited",
-        "When non-zero the history will be read from disk before editing a "
-        "new line and written to disk afterwards.",
+        "Share history with other sessions line by line",
+        "When non-zero each line is appended to the history file as it is "
+        "entered, after first picking up any lines other sessions have added "
+        "since.",
+        SETTING_TYPE_BOOL,
+        0, "0"
+    },
+    {
+        "history_rank",
+        "Rank history searches by frequency and directory",
+        "When non-zero, prefix and incremental history searches started from "
+        "the current line offer each distinct line once, best first. Lines run "
+        "often and recently rank higher, and more so when they were run from "
+        "the current directory.",
         SETTING_TYPE_BOOL,
         0, "0"
     },
@@ -154,6 +176,24 @@ static const setting_decl_t g_settings_decl[] = {
         "Paste unchanged\0Strip\0As space",
         "2"
     },
+    {
+        "alias_cache",
+        "Cache the console's aliases",
+        "Console aliases (aka. doskey macros) are read once and then only read "
+        "again when a doskey command's been run or they've obviously changed. "
+        "Set this to 0 to read them each time they're used.",
+        SETTING_TYPE_BOOL,
+        0, "1"
+    },
+    {
+        "profile",
+        "Profile match generators and prompt filters",
+        "When enabled Clink times each match generator, prompt filter, and "
+        "some of its natives. The results can be read from Lua with "
+        "clink.stats() or listed with Readline's show-clink-stats command.",
+        SETTING_TYPE_BOOL,
+        0, "0"
+    },
     {
         "ansi_code_support",
         "Enables basic ANSI escape code support",
@@ -20,8 +20,11 @@
  */
 
 #include "pch.h"
+#include "aliases.h"
 #include "shell.h"
 #include "dll_hooks.h"
+#include "env_names.h"
+#include "shared/str_builder.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
@@ -368,6 +371,8 @@ static BOOL WINAPI set_env_var(
 {
     BOOL ret = SetEnvironmentVariableW(name, value);
 
+    invalidate_env_names();
+
     if (_wcsicmp(name, L"prompt") == 0)
     {
         tag_prompt();
@@ -443,26 +448,25 @@ static int cmd_initialise(void* base)
     // Add an alias to Clink so it can be run from anywhere. Similar to adding
     // it to the path but this way we can add the config path too.
     {
-        #define BUF_SIZE 512
-
-        char dll_path[BUF_SIZE];
-        char cfg_path[BUF_SIZE];
-        char buffer[BUF_SIZE];
+        char dll_path[MAX_PATH];
+        char cfg_path[MAX_PATH];
+        str_builder_t buffer;
 
-        get_dll_dir(dll_path, BUF_SIZE);
-        get_config_dir(cfg_path, BUF_SIZE);
+        get_dll_dir(dll_path, sizeof_array(dll_path));
+        get_config_dir(cfg_path, sizeof_array(cfg_path));
 
-        strcpy(buffer, "\"");
-        str_cat(buffer, dll_path, BUF_SIZE);
-        str_cat(buffer, "/clink_" AS_STR(PLATFORM) ".exe\" --cfgdir \"", BUF_SIZE);
-        str_cat(buffer, cfg_path, BUF_SIZE);
-        str_cat(buffer, "\" $*", BUF_SIZE);
+        str_builder_init(&buffer);
+        str_builder_printf(&buffer,
+            "\"%s/clink_" AS_STR(PLATFORM) ".exe\" --cfgdir \"%s\" $*",
+            dll_path, cfg_path
+        );
 
 #if !defined(__MINGW32__) && !defined(__MINGW64__)
-        AddConsoleAlias("clink", buffer, (char*)rl_readline_name);
+        AddConsoleAlias("clink", buffer.data, (char*)rl_readline_name);
+        invalidate_alias_cache();
 #endif // !__MINGW32__ && !__MINGW64__
 
-        #undef BUF_SIZE
+        str_builder_free(&buffer);
     }
 
     return 1;
@@ -0,0 +1,262 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "stats.h"
+#include "shared/util.h"
+
+//------------------------------------------------------------------------------
+int                     get_clink_setting_int(const char*);
+
+static stats_probe_t    g_probes[64];
+static int              g_probe_count   = 0;
+static int              g_enabled       = 0;
+
+//------------------------------------------------------------------------------
+void stats_refresh()
+{
+    // Called as each completion or prompt starts so the rest of the time it is
+    // just a flag that's checked.
+    g_enabled = get_clink_setting_int("profile");
+}
+
+//------------------------------------------------------------------------------
+int stats_enabled()
+{
+    return g_enabled;
+}
+
+//------------------------------------------------------------------------------
+double stats_clock()
+{
+    static double ms_per_tick = 0.0;
+    LARGE_INTEGER now;
+
+    if (ms_per_tick == 0.0)
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        ms_per_tick = 1000.0 / (double)freq.QuadPart;
+    }
+
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * ms_per_tick;
+}
+
+//------------------------------------------------------------------------------
+static stats_probe_t* find_probe(const char* name)
+{
+    stats_probe_t* probe;
+    int i;
+
+    for (i = 0; i < g_probe_count; ++i)
+    {
+        if (strcmp(g_probes[i].name, name) == 0)
+        {
+            return g_probes + i;
+        }
+    }
+
+    if (g_probe_count >= (int)sizeof_array(g_probes))
+    {
+        return NULL;
+    }
+
+    probe = g_probes + g_probe_count;
+    memset(probe, 0, sizeof(*probe));
+    str_cpy(probe->name, name, sizeof_array(probe->name));
+
+    ++g_probe_count;
+    return probe;
+}
+
+//------------------------------------------------------------------------------
+static int get_bucket(double ms)
+{
+    // Bucket 0 is under 1/16ms and each one after doubles, so the last covers
+    // anything over 64ms.
+
+    int i;
+    double limit;
+
+    limit = 1.0 / 16.0;
+    for (i = 0; i < STATS_BUCKETS - 1; ++i, limit *= 2.0)
+    {
+        if (ms < limit)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+//------------------------------------------------------------------------------
+void stats_record(const char* name, double start, int matches, double memory)
+{
+    stats_probe_t* probe;
+    double ms;
+    unsigned samples;
+    int i;
+
+    probe = find_probe(name);
+    if (probe == NULL)
+    {
+        return;
+    }
+
+    ms = stats_clock() - start;
+
+    ++probe->calls;
+    probe->total += ms;
+    probe->max = (ms > probe->max) ? ms : probe->max;
+    probe->matches += matches;
+    probe->memory += memory;
+
+    // The histogram rolls; once it's full the counts are halved so it favours
+    // the more recent calls.
+    samples = 0;
+    for (i = 0; i < STATS_BUCKETS; ++i)
+    {
+        samples += probe->histogram[i];
+    }
+
+    if (samples >= 256)
+    {
+        for (i = 0; i < STATS_BUCKETS; ++i)
+        {
+            probe->histogram[i] /= 2;
+        }
+    }
+
+    ++probe->histogram[get_bucket(ms)];
+}
+
+//------------------------------------------------------------------------------
+double stats_percentile(const stats_probe_t* probe, int percent)
+{
+    // Returns the upper limit of the histogram bucket that the percentile of
+    // recent calls falls in (or the slowest call if that's less).
+
+    unsigned samples;
+    unsigned total;
+    double limit;
+    int i;
+
+    samples = 0;
+    for (i = 0; i < STATS_BUCKETS; ++i)
+    {
+        samples += probe->histogram[i];
+    }
+
+    total = 0;
+    limit = 1.0 / 16.0;
+    for (i = 0; i < STATS_BUCKETS - 1; ++i, limit *= 2.0)
+    {
+        total += probe->histogram[i];
+        if (total * 100 >= samples * percent)
+        {
+            break;
+        }
+    }
+
+    return (i < STATS_BUCKETS - 1 && limit < probe->max) ? limit : probe->max;
+}
+
+//------------------------------------------------------------------------------
+int stats_count()
+{
+    return g_probe_count;
+}
+
+//------------------------------------------------------------------------------
+const stats_probe_t* stats_get(int index)
+{
+    if (index < 0 || index >= g_probe_count)
+    {
+        return NULL;
+    }
+
+    return g_probes + index;
+}
+
+//------------------------------------------------------------------------------
+void stats_reset()
+{
+    g_probe_count = 0;
+}
+
+//------------------------------------------------------------------------------
+int show_clink_stats(int count, int invoking_key)
+{
+    char** collector;
+    int longest;
+    int i;
+
+    collector = malloc(sizeof(char*) * (g_probe_count + 2));
+    collector[0] = "";
+
+    collector[1] = malloc(128);
+    sprintf(collector[1], "%-40s %7s %9s %9s %9s %9s %8s %9s", "probe",
+        "calls", "avg ms", "p50 ms", "p90 ms", "max ms", "matches", "lua kb");
+
+    for (i = 0; i < g_probe_count; ++i)
+    {
+        const stats_probe_t* probe = g_probes + i;
+        double calls = (probe->calls > 0) ? probe->calls : 1;
+
+        collector[i + 2] = malloc(256);
+        sprintf(collector[i + 2],
+            "%-40.40s %7u %9.3f %9.3f %9.3f %9.3f %8.1f %9.1f",
+            probe->name,
+            probe->calls,
+            probe->total / calls,
+            stats_percentile(probe, 50),
+            stats_percentile(probe, 90),
+            probe->max,
+            probe->matches / calls,
+            probe->memory / calls
+        );
+    }
+
+    longest = 0;
+    for (i = 1; i < g_probe_count + 2; ++i)
+    {
+        int l = (int)strlen(collector[i]);
+        longest = (l > longest) ? l : longest;
+    }
+
+    if (rl_completion_display_matches_hook != NULL)
+    {
+        rl_filename_completion_desired = 0;
+        rl_completion_display_matches_hook(collector, g_probe_count + 1,
+            longest);
+    }
+
+    for (i = 1; i < g_probe_count + 2; ++i)
+    {
+        free(collector[i]);
+    }
+    free(collector);
+    return 0;
+}
+
+// vim: expandtab
@@ -0,0 +1,51 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+//------------------------------------------------------------------------------
+#define STATS_BUCKETS   12
+
+typedef struct
+{
+    char            name[64];
+    unsigned        calls;
+    double          total;          // milliseconds
+    double          max;
+    unsigned        matches;
+    double          memory;         // Lua heap delta in KB
+    unsigned        histogram[STATS_BUCKETS];
+} stats_probe_t;
+
+//------------------------------------------------------------------------------
+void                    stats_refresh();
+int                     stats_enabled();
+double                  stats_clock();
+void                    stats_record(const char* probe, double start, int matches, double memory);
+int                     stats_count();
+const stats_probe_t*    stats_get(int index);
+double                  stats_percentile(const stats_probe_t* probe, int percent);
+void                    stats_reset();
+
+#endif // STATS_H
+
+// vim: expandtab
@@ -0,0 +1,175 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "shared/util.h"
+#include "shared/history_db.h"
+
+//------------------------------------------------------------------------------
+static void print_usage()
+{
+    extern const char* g_clink_header;
+
+    const char* help[] = {
+        "export [--timestamps]",    "Writes the history to stdout as text.",
+        "import <file>",            "Appends the lines of a text history file.",
+    };
+
+    puts(g_clink_header);
+    puts("  Usage: history <command>\n");
+    puts_help(help, sizeof_array(help));
+    puts("  Timestamps are written and read as readline does, as '#<seconds>'");
+    puts("  lines ahead of each entry.\n");
+}
+
+//------------------------------------------------------------------------------
+static int open_history(history_db_t* db, history_file_t* file)
+{
+    char file_name[512];
+
+    get_history_db_file_name(file_name, sizeof_array(file_name));
+    if (!history_db_open(file_name, file))
+    {
+        printf("ERROR: Unable to open history file '%s'.\n", file_name);
+        return 0;
+    }
+
+    // If this made the history file, bring over the text history earlier
+    // versions wrote as a Clink session would have done.
+    if (file->created)
+    {
+        history_db_import_legacy(file);
+    }
+
+    history_db_init(db);
+    history_db_sync(db, file, 0);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int export_history(int timestamps)
+{
+    history_buffer_t out;
+    history_file_t file;
+    history_db_t db;
+
+    if (!open_history(&db, &file))
+    {
+        return 0;
+    }
+
+    history_db_close(&file);
+
+    history_buffer_init(&out);
+    history_db_export_text(&db, &out, timestamps);
+    fwrite(out.data, 1, out.length, stdout);
+
+    history_buffer_free(&out);
+    history_db_free(&db);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int import_history(const char* text_file)
+{
+    history_buffer_t records;
+    history_file_t file;
+    history_db_t imported;
+    history_db_t db;
+    FILE* in;
+    char* data;
+    long size;
+    int ok;
+    int i;
+
+    in = fopen(text_file, "rb");
+    if (in == NULL)
+    {
+        printf("ERROR: Unable to open '%s'.\n", text_file);
+        return 0;
+    }
+
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    data = (size >= 0) ? malloc(size + 1) : NULL;
+    size = (data != NULL) ? (long)fread(data, 1, size, in) : 0;
+    fclose(in);
+
+    history_db_init(&imported);
+    history_db_import_text(&imported, data, size);
+    free(data);
+
+    if (!open_history(&db, &file))
+    {
+        history_db_free(&imported);
+        return 0;
+    }
+
+    history_buffer_init(&records);
+    for (i = 0; i < imported.entry_count; ++i)
+    {
+        history_db_add(&db, &records, history_db_line(&imported, i),
+            imported.entries[i].time, NULL, 0, 0);
+    }
+
+    ok = history_db_append(&db, &file, &records);
+    history_db_close(&file);
+
+    if (ok)
+    {
+        printf("Imported %d lines.\n", imported.entry_count);
+    }
+    else
+    {
+        puts("ERROR: Failed to write to the history file.");
+    }
+
+    history_buffer_free(&records);
+    history_db_free(&imported);
+    history_db_free(&db);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int history(int argc, char** argv)
+{
+    int ret;
+
+    ret = 0;
+    if (argc < 2 || _stricmp(argv[1], "export") == 0)
+    {
+        ret = export_history(argc > 2 && _stricmp(argv[2], "--timestamps") == 0);
+    }
+    else if (_stricmp(argv[1], "import") == 0 && argc > 2)
+    {
+        ret = import_history(argv[2]);
+    }
+    else
+    {
+        print_usage();
+    }
+
+    return !ret;
+}
+
+// vim: expandtab
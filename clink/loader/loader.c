@@ -27,6 +27,7 @@ int g_in_clink_context;
 int inject(int, char**);
 int autorun(int, char**);
 int set(int, char**);
+int history(int, char**);
 
 //------------------------------------------------------------------------------
 static void show_usage()
@@ -37,6 +38,7 @@ static void show_usage()
         "inject",   "Injects Clink into a process.",
         "autorun",  "Manage Clink's entry in cmd.exe's autorun.",
         "set",      "Adjust Clink's settings.",
+        "history",  "Export or import Clink's history.",
         "",         "('<verb> --help' for more details).",
     };
 
@@ -56,7 +58,8 @@ static int dispatch_verb(const char* verb, int argc, char** argv)
     } handlers[] = {
         "inject", inject,
         "autorun", autorun,
-        "set", set
+        "set", set,
+        "history", history
     };
 
     int i;
@@ -31,6 +31,10 @@ local new_sub_parser
 local parser_go_impl
 local merge_parsers
 
+-- Option tables that are cached and shared between flattenings. Copies of
+-- these are handed out by the parser's methods.
+local cached_opts           = setmetatable({}, { __mode = "k" })
+
 local parser_meta_table     = {}
 local sub_parser_meta_table = {}
 
@@ -76,6 +80,11 @@ local function parser_is_flag(parser, part)
     return prefix == "-" or prefix == "/"
 end
 
+--------------------------------------------------------------------------------
+local function parser_invalidate(parser)
+    parser.flattened = {}
+end
+
 --------------------------------------------------------------------------------
 local function parser_add_arguments(parser, ...)
     for _, i in ipairs({...}) do
@@ -100,6 +109,7 @@ local function parser_add_arguments(parser, ...)
         end
     end
 
+    parser_invalidate(parser)
     return parser
 end
 
@@ -136,6 +146,7 @@ local function parser_add_flags(parser, ...)
         table.insert(parser.flags, i)
     end
 
+    parser_invalidate(parser)
     return parser
 end
 
@@ -146,7 +157,45 @@ local function parser_set_flags(parser, ...)
 end
 
 --------------------------------------------------------------------------------
-local function parser_flatten_argument(parser, index, func_thunk)
+local function parser_plan_argument(arg_opts)
+    -- Runs of static options (strings, numbers, and sub-parser keys) are
+    -- converted once into tables of strings. Functions are kept in place so
+    -- they are still called each time the argument is flattened.
+    local plan = {}
+    local run
+    for _, i in ipairs(arg_opts) do
+        local t = type(i)
+        if t == "function" then
+            table.insert(plan, i)
+            run = nil
+        else
+            local opt
+            if is_sub_parser(i) then
+                opt = i.key
+            elseif t == "string" or t == "number" then
+                opt = tostring(i)
+            end
+
+            if opt ~= nil then
+                if not run then
+                    run = {}
+                    table.insert(plan, run)
+                end
+
+                table.insert(run, opt)
+            end
+        end
+    end
+
+    if #plan == 0 then
+        table.insert(plan, {})
+    end
+
+    return plan
+end
+
+--------------------------------------------------------------------------------
+local function flatten_argument_impl(parser, index, func_thunk)
     -- Sanity check the 'index' param to make sure it's valid.
     if type(index) == "number" then
         if index <= 0 or index > #parser.arguments then
@@ -154,35 +203,47 @@ local function parser_flatten_argument(parser, index, func_thunk)
         end
     end
 
-    -- index == nil is a special case that returns the parser's flags
-    local opts = {}
-    local arg_opts
-    if index == nil then
-        arg_opts = parser.flags
-    else
-        arg_opts = parser.arguments[index]
+    -- index == nil is a special case that returns the parser's flags. Plans
+    -- are cached until the parser is next modified.
+    local key = index or 0
+    local plan = parser.flattened[key]
+    if plan == nil then
+        local arg_opts
+        if index == nil then
+            arg_opts = parser.flags
+        else
+            arg_opts = parser.arguments[index]
+        end
+
+        plan = parser_plan_argument(arg_opts)
+        parser.flattened[key] = plan
     end
 
-    -- Convert each argument option into a string and collect them in a table.
-    for _, i in ipairs(arg_opts) do
-        if is_sub_parser(i) then
-            table.insert(opts, i.key)
-        else
-            local t = type(i)
-            if t == "function" then
-                local results = func_thunk(i)
-                local t = type(results)
-                if not results then
-                    return parser.use_file_matching
-                elseif t == "boolean" then
-                    return (results and parser.use_file_matching)
-                elseif t == "table" then
-                    for _, j in ipairs(results) do
-                        table.insert(opts, j)
-                    end
+    -- An argument without functions always flattens to the same options, so
+    -- the cached table is returned as is.
+    if #plan == 1 and type(plan[1]) == "table" then
+        cached_opts[plan[1]] = true
+        return plan[1]
+    end
+
+    -- Collect the static runs and the results of each function in order.
+    local opts = {}
+    for _, i in ipairs(plan) do
+        if type(i) == "function" then
+            local results = func_thunk(i)
+            local t = type(results)
+            if not results then
+                return parser.use_file_matching
+            elseif t == "boolean" then
+                return (results and parser.use_file_matching)
+            elseif t == "table" then
+                for _, j in ipairs(results) do
+                    table.insert(opts, j)
                 end
-            elseif t == "string" or t == "number" then
-                table.insert(opts, tostring(i))
+            end
+        else
+            for _, j in ipairs(i) do
+                table.insert(opts, j)
             end
         end
     end
@@ -190,6 +251,25 @@ local function parser_flatten_argument(parser, index, func_thunk)
     return opts
 end
 
+--------------------------------------------------------------------------------
+local function copy_cached_opts(opts)
+    if not cached_opts[opts] then
+        return opts
+    end
+
+    local copy = {}
+    for i, j in ipairs(opts) do
+        copy[i] = j
+    end
+
+    return copy
+end
+
+--------------------------------------------------------------------------------
+local function parser_flatten_argument(parser, index, func_thunk)
+    return copy_cached_opts(flatten_argument_impl(parser, index, func_thunk))
+end
+
 --------------------------------------------------------------------------------
 local function parser_go_args(parser, state)
     local exhausted_args = false
@@ -278,7 +358,7 @@ local function parser_go_args(parser, state)
         return func(part)
     end
 
-    return parser:flatten_argument(arg_index, func_thunk)
+    return flatten_argument_impl(parser, arg_index, func_thunk)
 end
 
 --------------------------------------------------------------------------------
@@ -288,7 +368,7 @@ local function parser_go_flags(parser, state)
     -- Advance parts state.
     state.part_index = state.part_index + 1
     if state.part_index > #state.parts then
-        return parser:flatten_argument()
+        return flatten_argument_impl(parser)
     end
 
     for _, arg_opt in ipairs(parser.flags) do
@@ -367,7 +447,7 @@ local function parser_go(parser, parts)
         depth = 1,
     }
 
-    return parser_go_impl(parser, state)
+    return copy_cached_opts(parser_go_impl(parser, state))
 end
 
 --------------------------------------------------------------------------------
@@ -497,6 +577,7 @@ function clink.arg.new_parser(...)
     parser.precise = false
     parser.use_file_matching = true
     parser.loop_point = 0
+    parser.flattened = {}
 
     setmetatable(parser, parser_meta_table)
 
@@ -515,6 +596,8 @@ end
 function merge_parsers(lhs, rhs)
     -- Merging parsers is not a trivial matter and this implementation is far
     -- from correct. It is however sufficient for the majority of cases.
+    parser_invalidate(lhs)
+    parser_invalidate(rhs)
 
     -- Merge flags.
     for _, rflag in ipairs(rhs.flags) do
@@ -579,30 +662,43 @@ function clink.arg.register_parser(cmd, parser)
     end
 end
 
+--------------------------------------------------------------------------------
+function clink.arg.get_parser(cmd)
+    return parsers[cmd:lower()]
+end
+
 --------------------------------------------------------------------------------
 local function argument_match_generator(text, first, last)
-    local leading = rl_state.line_buffer:sub(1, first - 1):lower()
-
-    -- Extract the command.
-    local cmd_l, cmd_r
-    if leading:find("^%s*\"") then
-        -- Command appears to be surround by quotes.
-        cmd_l, cmd_r = leading:find("%b\"\"")
-        if cmd_l and cmd_r then
-            cmd_l = cmd_l + 1
-            cmd_r = cmd_r - 1
+    -- Find the command, which must come before the word being completed.
+    local tokens = rl_state.tokens
+    local cmd_index
+    for i, token in ipairs(tokens) do
+        if token.command then
+            if token.last >= last then
+                return false
+            end
+
+            cmd_index = i
+            break
         end
-    else
-        -- No quotes so the first, longest, non-whitespace word is extracted.
-        cmd_l, cmd_r = leading:find("[^%s]+")
     end
 
-    if not cmd_l or not cmd_r then
+    if not cmd_index then
+        return false
+    end
+
+    -- Redirections are left for file completion.
+    local current = tokens[#tokens]
+    if current.target and current.last >= last then
+        return false
+    end
+
+    if current.type == "redirect" and not current.text:find("&%d$") then
         return false
     end
 
     local regex = "[\\/:]*([^\\/:.]+)(%.*[%l]*)%s*$"
-    local _, _, cmd, ext = leading:sub(cmd_l, cmd_r):lower():find(regex)
+    local _, _, cmd, ext = tokens[cmd_index].text:lower():find(regex)
 
     -- Check to make sure the extension extracted is in pathext.
     if ext and ext ~= "" then
@@ -617,31 +713,22 @@ local function argument_match_generator(text, first, last)
         return false
     end
 
-    -- Split the command line into parts.
-    local str = rl_state.line_buffer:sub(cmd_r + 2, last)
+    -- The command's arguments are the words that follow it, less operators
+    -- and the files they redirect to.
     local parts = {}
-    for _, sub_str in ipairs(clink.quote_split(str, "\"")) do
-        -- Quoted strings still have their quotes. Look for those type of
-        -- strings, strip the quotes and add it completely.
-        if sub_str:sub(1, 1) == "\"" then
-            local l, r = sub_str:find("\"[^\"]+")
-            if l then
-                local part = sub_str:sub(l + 1, r)
-                table.insert(parts, part)
-            end
-        else
-            -- Extract non-whitespace parts.
-            for _, r, part in function () return sub_str:find("^%s*([^%s]+)") end do
-                table.insert(parts, part)
-                sub_str = sub_str:sub(r + 1)
-            end
+    local part_last = 0
+    for i = cmd_index + 1, #tokens do
+        local token = tokens[i]
+        if token.type == "word" and not token.target then
+            table.insert(parts, token.text)
+            part_last = token.last
         end
     end
 
-    -- If 'text' is empty then add it as a part as it would have been skipped
-    -- by the split loop above.
-    if text == "" then
-        table.insert(parts, text)
+    -- If the word being completed is yet to be started (or readline's started
+    -- a new one after a break character) then add it as an empty part.
+    if part_last < last or (text == "" and parts[#parts] ~= "") then
+        table.insert(parts, "")
     end
 
     -- Extend rl_state with match generation state; text, first, and last.
@@ -656,9 +743,15 @@ local function argument_match_generator(text, first, last)
         return not ret
     end
 
-    -- Iterate through the matches the parser returned and collect matches.
+    -- Iterate through the matches the parser returned and collect matches,
+    -- which may be strings or records.
     for _, match in ipairs(ret) do
-        if clink.is_match(needle, match) then
+        local match_text = match
+        if type(match) == "table" then
+            match_text = match.text
+        end
+
+        if clink.is_match(needle, match_text) then
             clink.add_match(match)
         end
     end
@@ -22,10 +22,15 @@
 
 --------------------------------------------------------------------------------
 clink.matches = {}
+clink.match_info = {}
+clink.matches_ranked = false
 clink.generators = {}
 
 clink.prompt = {}
 clink.prompt.filters = {}
+clink.prompt.async_cache = {}
+clink.prompt.async_pending = {}
+clink.prompt.dir_generations = {}
 
 --------------------------------------------------------------------------------
 function clink.compute_lcd(text, list)
@@ -117,36 +122,105 @@ end
 
 --------------------------------------------------------------------------------
 function clink.adjust_for_separator(buffer, point, first, last)
-    local seps = nil
-    if clink.get_host_process() == "cmd.exe" then
-        seps = "|&"
+    if clink.get_host_process() ~= "cmd.exe" then
+        return buffer, point, first, last
     end
 
-    if seps then
-        -- Find any valid command separators and if found, manipulate the
-        -- completion state a little bit.
-        local leading = buffer:sub(1, first - 1)
+    -- Find the last command separator before the word being completed. The
+    -- tokeniser has already taken care of quotes and escapes.
+    local tokens = rl_state.tokens
+    local sep = nil
+    for i, token in ipairs(tokens) do
+        if token.first >= first then
+            break
+        end
+
+        if token.type == "separator" then
+            sep = i
+        end
+    end
 
-        -- regex is: <sep> <not_seps> <eol>
-        local regex = "["..seps.."]([^"..seps.."]*)$"
-        local sep_found, _, post_sep = leading:find(regex)
+    if not sep then
+        return buffer, point, first, last
+    end
 
-        if sep_found and not clink.is_point_in_quote(leading, sep_found) then
-            local delta = #leading - #post_sep
-            buffer = buffer:sub(delta + 1)
-            first = first - delta
-            last = last - delta
-            point = point - delta
+    -- Manipulate the completion state so it's as if the command after the
+    -- separator were the whole line.
+    local delta = tokens[sep].last
+    buffer = buffer:sub(delta + 1)
+    first = first - delta
+    last = last - delta
+    point = point - delta
 
-            if first < 1 then
-                first = 1
-            end
-        end
+    if first < 1 then
+        first = 1
+    end
+
+    local adjusted = {}
+    for i = sep + 1, #tokens do
+        local token = tokens[i]
+        token.first = token.first - delta
+        token.last = token.last - delta
+        table.insert(adjusted, token)
     end
+    rl_state.tokens = adjusted
 
     return buffer, point, first, last
 end
 
+--------------------------------------------------------------------------------
+local function get_probe_name(kind, func)
+    -- Names a generator or filter after where it was defined for profiling.
+    -- Anything else that's callable (e.g. a table with a __call metamethod)
+    -- gets a generic name.
+    if type(func) ~= "function" then
+        return kind..":"..type(func)
+    end
+
+    local info = debug.getinfo(func, "S")
+    local source = info.short_src:match("[^\\/]*$")
+    return kind..":"..source..":"..info.linedefined
+end
+
+--------------------------------------------------------------------------------
+local function profile_call(entry, ...)
+    local memory = collectgarbage("count")
+    local match_count = #clink.matches
+    local started = clink.stats_clock()
+
+    local ret = entry.f(...)
+
+    clink.stats_record(
+        entry.probe,
+        started,
+        #clink.matches - match_count,
+        collectgarbage("count") - memory
+    )
+
+    return ret
+end
+
+--------------------------------------------------------------------------------
+-- Set from the 'match_fuzzy' setting each time matches are generated.
+local fuzzy_matching = false
+
+--------------------------------------------------------------------------------
+local function rank_matches(text)
+    -- Orders fuzzy matches best first (any that don't match stay, last) for
+    -- Readline to show as they are. Returns the match list's LCD, which is
+    -- just the text if any of the matches don't start with it.
+    clink.matches = clink.fuzzy_rank(text, clink.matches, true)
+    clink.matches_ranked = true
+
+    for _, match in ipairs(clink.matches) do
+        if not clink.is_prefix(text, match) then
+            return text
+        end
+    end
+
+    return clink.compute_lcd(text, clink.matches)
+end
+
 --------------------------------------------------------------------------------
 function clink.generate_matches(text, first, last)
     local line_buffer
@@ -163,10 +237,21 @@ function clink.generate_matches(text, first, last)
     rl_state.point = point
 
     clink.matches = {}
+    clink.match_info = {}
+    clink.matches_ranked = false
     clink.match_display_filter = nil
+    fuzzy_matching = clink.get_setting_int("match_fuzzy") > 0
 
+    local profile = clink.stats_enabled()
     for _, generator in ipairs(clink.generators) do
-        if generator.f(text, first, last) == true then
+        local ret
+        if profile then
+            ret = profile_call(generator, text, first, last)
+        else
+            ret = generator.f(text, first, last)
+        end
+
+        if ret == true then
             if #clink.matches > 1 then
                 -- Catch instances where there's many entries of a single match
                 if clink.is_single_match(clink.matches) then
@@ -176,7 +261,12 @@ function clink.generate_matches(text, first, last)
 
                 -- First entry in the match list should be the user's input,
                 -- modified here to be the lowest common denominator.
-                local lcd = clink.compute_lcd(text, clink.matches)
+                local lcd
+                if fuzzy_matching then
+                    lcd = rank_matches(text)
+                else
+                    lcd = clink.compute_lcd(text, clink.matches)
+                end
                 table.insert(clink.matches, 1, lcd)
             end
 
@@ -190,8 +280,17 @@ end
 --------------------------------------------------------------------------------
 function clink.add_match(match)
     if type(match) == "table" then
+        -- A table with text is a record describing a single match, which is
+        -- added as its text with the rest kept to one side for Clink to use
+        -- when the matches are displayed. Any other table is a list.
+        if match.text ~= nil then
+            table.insert(clink.matches, match.text)
+            clink.match_info[match.text] = match
+            return
+        end
+
         for _, i in ipairs(match) do
-            table.insert(clink.matches, i)
+            clink.add_match(i)
         end
 
         return
@@ -206,7 +305,8 @@ function clink.register_match_generator(func, priority)
         priority = 999
     end
 
-    table.insert(clink.generators, {f=func, p=priority})
+    local probe = get_probe_name("generator", func)
+    table.insert(clink.generators, {f=func, p=priority, probe=probe})
     table.sort(clink.generators, function(a, b) return a["p"] < b["p"] end)
 end
 
@@ -216,10 +316,11 @@ function clink.is_match(needle, candidate)
         error("Nil needle value when calling clink.is_match()", 2)
     end
 
-    if clink.lower(candidate:sub(1, #needle)) == clink.lower(needle) then
-        return true
+    if fuzzy_matching then
+        return clink.fuzzy_score(needle, candidate) ~= nil
     end
-    return false
+
+    return clink.is_prefix(needle, candidate)
 end
 
 --------------------------------------------------------------------------------
@@ -250,6 +351,10 @@ function clink.match_words(text, words)
     return clink.match_count() - count
 end
 
+--------------------------------------------------------------------------------
+local dir_record = { type = "dir" }
+local file_record = { type = "file" }
+
 --------------------------------------------------------------------------------
 function clink.match_files(pattern, full_path, find_func)
     -- Fill out default values
@@ -265,9 +370,10 @@ function clink.match_files(pattern, full_path, find_func)
         pattern = "*"
     end
 
-    -- Glob files.
+    -- Glob files. The results are only iterated so they can come back packed,
+    -- along with which are directories so they needn't be checked later.
     pattern = pattern:gsub("/", "\\")
-    local glob = find_func(pattern, true)
+    local glob, types = find_func(pattern, true, true, true)
 
     -- Get glob's base.
     local base = ""
@@ -279,9 +385,12 @@ function clink.match_files(pattern, full_path, find_func)
     -- Match them.
     local count = clink.match_count()
 
-    for _, i in ipairs(glob) do
+    for n, i in ipairs(glob) do
         local full = base..i
         clink.add_match(full)
+        if types then
+            clink.match_info[full] = (types:sub(n, n) == "d") and dir_record or file_record
+        end
     end
 
     return clink.match_count() - count
@@ -346,10 +455,207 @@ function clink.prompt.register_filter(filter, priority)
         priority = 999
     end
 
-    table.insert(clink.prompt.filters, {f=filter, p=priority})
+    local probe = get_probe_name("filter", filter)
+    table.insert(clink.prompt.filters, {f=filter, p=priority, probe=probe})
     table.sort(clink.prompt.filters, function(a, b) return a["p"] < b["p"] end)
 end
 
+--------------------------------------------------------------------------------
+local function get_dir_generation(dir)
+    local generation = clink.prompt.dir_generations[dir] or 0
+    if clink.has_dir_changed(dir) then
+        generation = generation + 1
+    end
+
+    clink.prompt.dir_generations[dir] = generation
+    return generation
+end
+
+--------------------------------------------------------------------------------
+local function get_async_entry(async, cwd)
+    local cache = clink.prompt.async_cache[cwd]
+    if not cache then
+        cache = {}
+        clink.prompt.async_cache[cwd] = cache
+    end
+
+    return cache, cache[async]
+end
+
+--------------------------------------------------------------------------------
+local function is_async_entry_fresh(async, cwd, entry)
+    if not entry then
+        return false
+    end
+
+    if async.ttl and os.time() - entry.time >= async.ttl then
+        return false
+    end
+
+    -- Anything that changed since the filter started may not be reflected in
+    -- its result.
+    if async.watch and entry.generation ~= get_dir_generation(cwd) then
+        return false
+    end
+
+    return true
+end
+
+--------------------------------------------------------------------------------
+local function resume_async(pending, ...)
+    -- Returns true once the async filter's coroutine has finished.
+    local ok, ret = coroutine.resume(pending.co, ...)
+    if not ok then
+        print(ret)
+        return true
+    end
+
+    if coroutine.status(pending.co) ~= "dead" then
+        if type(ret) ~= "function" then
+            print("Async prompt filters should only yield via await()")
+            return true
+        end
+
+        pending.poll = ret
+        return false
+    end
+
+    local cache = get_async_entry(pending.async, pending.cwd)
+    cache[pending.async] = {
+        value = ret and tostring(ret) or pending.async.placeholder,
+        time = os.time(),
+        generation = pending.generation,
+    }
+
+    return true
+end
+
+--------------------------------------------------------------------------------
+local function start_async(async, cwd)
+    for _, pending in ipairs(clink.prompt.async_pending) do
+        if pending.async == async and pending.cwd == cwd then
+            return
+        end
+    end
+
+    local pending = {
+        async = async,
+        cwd = cwd,
+        co = coroutine.create(async.f),
+    }
+
+    if async.watch then
+        pending.generation = get_dir_generation(cwd)
+    end
+
+    -- Filters that don't wait on anything finish here and now.
+    if not resume_async(pending, cwd) then
+        table.insert(clink.prompt.async_pending, pending)
+    end
+end
+
+--------------------------------------------------------------------------------
+function clink.prompt.register_async_filter(filter, priority, options)
+    -- 'filter' is run as a coroutine with the cwd as its argument and returns
+    -- a segment string. It can wait on slow work without blocking the prompt
+    -- via clink.prompt.await() or clink.prompt.execute_async(). Until it has
+    -- finished the segment's cached value for the cwd (or a placeholder) is
+    -- given to 'options.apply' which should add it to clink.prompt.value.
+    -- Cached values are recomputed after 'options.ttl' seconds and, if
+    -- 'options.watch' is set, when anything under the cwd changes after the
+    -- filter started. Changes inside .git directories are ignored.
+    options = options or {}
+
+    local async = {
+        f = filter,
+        ttl = options.ttl,
+        watch = options.watch,
+        placeholder = options.placeholder or "",
+        apply = options.apply or function(segment)
+            clink.prompt.value = clink.prompt.value..segment
+        end,
+    }
+
+    local function async_filter()
+        local cwd = clink.get_cwd()
+
+        local _, entry = get_async_entry(async, cwd)
+        if not is_async_entry_fresh(async, cwd, entry) then
+            start_async(async, cwd)
+            _, entry = get_async_entry(async, cwd)
+        end
+
+        return async.apply(entry and entry.value or async.placeholder)
+    end
+
+    clink.prompt.register_filter(async_filter, priority)
+
+    -- Profile it under the name of the filter it wraps.
+    for _, entry in ipairs(clink.prompt.filters) do
+        if entry.f == async_filter then
+            entry.probe = get_probe_name("filter", filter)
+        end
+    end
+end
+
+--------------------------------------------------------------------------------
+function clink.prompt.await(poll)
+    -- Suspends an async filter until 'poll' returns something other than nil
+    -- or false. Whatever 'poll' returned is then returned to the filter.
+    local _, is_main = coroutine.running()
+    if is_main then
+        error("clink.prompt.await() called outside of an async filter", 2)
+    end
+
+    return coroutine.yield(poll)
+end
+
+--------------------------------------------------------------------------------
+function clink.prompt.execute_async(cmd, timeout)
+    -- As clink.execute() but suspends the calling async filter while it runs.
+    local _, is_main = coroutine.running()
+    if is_main then
+        return clink.execute(cmd, timeout)
+    end
+
+    local id = clink.execute_async(cmd, timeout)
+    if not id then
+        return nil
+    end
+
+    return clink.prompt.await(function() return clink.poll_async(id) end)
+end
+
+--------------------------------------------------------------------------------
+function clink.update_prompt()
+    -- Polls pending async filters. Returns two booleans; if any finished for
+    -- the current directory (so the prompt wants filtering again), and if any
+    -- are still pending.
+    local changed = false
+    local cwd = clink.get_cwd()
+    local pending_list = clink.prompt.async_pending
+
+    local i = 1
+    while i <= #pending_list do
+        local pending = pending_list[i]
+        local results = table.pack(pending.poll())
+        local done = false
+
+        if results[1] then
+            done = resume_async(pending, table.unpack(results, 1, results.n))
+        end
+
+        if done then
+            table.remove(pending_list, i)
+            changed = changed or (pending.cwd == cwd)
+        else
+            i = i + 1
+        end
+    end
+
+    return changed, #pending_list > 0
+end
+
 --------------------------------------------------------------------------------
 function clink.filter_prompt(prompt)
     local function add_ansi_codes(p)
@@ -396,8 +702,16 @@ function clink.filter_prompt(prompt)
 
     clink.prompt.value = prompt
 
+    local profile = clink.stats_enabled()
     for _, filter in ipairs(clink.prompt.filters) do
-        if filter.f() == true then
+        local ret
+        if profile then
+            ret = profile_call(filter)
+        else
+            ret = filter.f()
+        end
+
+        if ret == true then
             return add_ansi_codes(clink.prompt.value)
         end
     end
@@ -20,6 +20,9 @@
 -- SOFTWARE.
 --
 
+--------------------------------------------------------------------------------
+local dir_record = { type = "dir" }
+
 --------------------------------------------------------------------------------
 function dir_match_generator_impl(text)
     -- Strip off any path components that may be on text.
@@ -35,12 +38,15 @@ function dir_match_generator_impl(text)
     local mask = text.."*"
 
     -- Find matches.
-    for _, dir in ipairs(clink.find_dirs(mask, true)) do
+    for _, dir in ipairs(clink.find_dirs(mask, true, true)) do
         local file = prefix..dir
 
         if include_dots or (dir ~= "." and dir ~= "..") then
             if clink.is_match(text, file) then
-                table.insert(matches, prefix..dir)
+                -- They're known to be directories, so displaying them
+                -- needn't check.
+                table.insert(matches, file)
+                clink.match_info[file] = dir_record
             end
         end
     end
@@ -26,23 +26,12 @@ local special_env_vars = {
     "cmdextversion", "cmdcmdline", "highestnumanodenumber"
 }
 
---------------------------------------------------------------------------------
-local function env_vars_display_filter(matches)
-    local to_display = {}
-    for _, m in ipairs(matches) do
-        local _, _, out = m:find("(%%[^%%]+%%)$")
-        table.insert(to_display, out)
-    end
-
-    return to_display
-end
-
 --------------------------------------------------------------------------------
 local function env_vars_find_matches(candidates, prefix, part)
-    local part_len = #part
     for _, name in ipairs(candidates) do
-        if clink.lower(name:sub(1, part_len)) == part then
-            clink.add_match(prefix..'%'..name:lower()..'%')
+        if clink.is_prefix(part, name) then
+            local match = '%'..name:lower()..'%'
+            clink.add_match({ text = prefix..match, display = match })
         end
     end
 end
@@ -73,12 +62,13 @@ local function env_vars_match_generator(text, first, last)
     i = i - first
     local prefix = text:sub(1, i)
 
-    env_vars_find_matches(clink.get_env_var_names(), prefix, part)
+    -- Matches are displayed without the prefix.
+    for _, match in ipairs(clink.get_env_var_matches(part)) do
+        clink.add_match({ text = prefix..match, display = match })
+    end
     env_vars_find_matches(special_env_vars, prefix, part)
 
     if clink.match_count() >= 1 then
-        clink.match_display_filter = env_vars_display_filter
-
         clink.suppress_char_append()
         clink.suppress_quoting()
 
@@ -58,13 +58,14 @@ end
 local function exec_find_dirs(pattern, case_map)
     local ret = {}
 
-    for _, dir in ipairs(clink.find_dirs(pattern, case_map)) do
+    for _, dir in ipairs(clink.find_dirs(pattern, case_map, true)) do
         if dir ~= "." and dir ~= ".." then
             table.insert(ret, dir)
         end
     end
 
-    return ret
+    -- They're all directories.
+    return ret, string.rep("d", #ret)
 end
 
 --------------------------------------------------------------------------------
@@ -82,10 +83,18 @@ local function exec_match_generator(text, first, last)
             return false
         end
     else
-        local leading = rl_state.line_buffer:sub(1, first - 1)
-        local is_first = leading:find("^%s*\"*$")
-        if not is_first then
-            return false
+        local tokens = rl_state.tokens
+        local current = tokens[#tokens]
+        if current and current.last >= last then
+            if not current.command then
+                return false
+            end
+        else
+            for _, token in ipairs(tokens) do
+                if token.command then
+                    return false
+                end
+            end
         end
     end
 
@@ -106,7 +115,7 @@ local function exec_match_generator(text, first, last)
         end
 
         -- Add console aliases as matches.
-        local aliases = clink.get_console_aliases()
+        local aliases = clink.get_console_aliases(text)
         clink.match_words(text, aliases)
 
         paths = get_environment_paths();
@@ -131,10 +140,10 @@ local function exec_match_generator(text, first, last)
     local suffices = clink.split(clink.get_env("pathext"), ";")
     for _, suffix in ipairs(suffices) do
         for _, path in ipairs(paths) do
-            local files = clink.find_files(path.."*"..suffix, false)
+            local files = clink.find_files(path.."*"..suffix, false, true)
             for _, file in ipairs(files) do
                 if clink.is_match(text_name, file) then
-                    clink.add_match(text_dir..file)
+                    clink.add_match({ text = text_dir..file, type = "exe" })
                 end
             end
         end
@@ -0,0 +1,437 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "fuzzy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#   define FUZZY_SSE2
+#   include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// A matched character scores SCORE_MATCH plus a bonus if it starts a word (or
+// a camelCase hump). One that follows the previous match directly gets at
+// least BONUS_CONSECUTIVE, and at least the bonus of the character that
+// started the run, so "fb" beats "foo_bar". The needle's first character gets
+// twice its bonus. Every character skipped between two matches costs
+// GAP_PENALTY.
+#define SCORE_MATCH         16
+#define SCORE_NONE          (-0x20000000)
+#define BONUS_BOUNDARY      8
+#define BONUS_CAMEL         6
+#define BONUS_CONSECUTIVE   4
+#define BONUS_FIRST         2
+#define GAP_PENALTY         1
+
+//------------------------------------------------------------------------------
+static int fold(int c)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c | 0x20;
+    }
+
+    return (c == '/') ? '\\' : c;
+}
+
+//------------------------------------------------------------------------------
+static int unfold(int c)
+{
+    // The other character that folds to 'c', or 'c' if there isn't one.
+
+    if (c >= 'a' && c <= 'z')
+    {
+        return c & ~0x20;
+    }
+
+    return (c == '\\') ? '/' : c;
+}
+
+//------------------------------------------------------------------------------
+static int get_bonus(const char* candidate, int i)
+{
+    int prev;
+    int c;
+
+    if (i == 0)
+    {
+        return BONUS_BOUNDARY;
+    }
+
+    prev = candidate[i - 1];
+    switch (prev)
+    {
+    case ' ':
+    case '\\':
+    case '/':
+    case '.':
+    case '_':
+    case '-':
+    case ':':
+        return BONUS_BOUNDARY;
+    }
+
+    c = candidate[i];
+    if (prev >= 'a' && prev <= 'z' && c >= 'A' && c <= 'Z')
+    {
+        return BONUS_CAMEL;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void fuzzy_init(fuzzy_t* fuzzy)
+{
+    memset(fuzzy, 0, sizeof(*fuzzy));
+}
+
+//------------------------------------------------------------------------------
+void fuzzy_free(fuzzy_t* fuzzy)
+{
+    free(fuzzy->needle);
+    free(fuzzy->rows);
+    fuzzy_init(fuzzy);
+}
+
+//------------------------------------------------------------------------------
+int fuzzy_set_needle(fuzzy_t* fuzzy, const char* needle)
+{
+    unsigned char* grown;
+    int length;
+    int i;
+
+    length = (int)strlen(needle);
+    if (length >= fuzzy->needle_size)
+    {
+        grown = realloc(fuzzy->needle, length + 1);
+        if (grown == NULL)
+        {
+            return 0;
+        }
+
+        fuzzy->needle = grown;
+        fuzzy->needle_size = length + 1;
+    }
+
+    for (i = 0; i < length; ++i)
+    {
+        fuzzy->needle[i] = (unsigned char)fold((unsigned char)needle[i]);
+    }
+
+    fuzzy->needle[length] = '\0';
+    fuzzy->needle_length = length;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int fuzzy_has_simd()
+{
+#if defined(FUZZY_SSE2) && defined(_M_IX86)
+    static int has_sse2 = -1;
+
+    if (has_sse2 < 0)
+    {
+        has_sse2 = !!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    }
+
+    return has_sse2;
+#elif defined(FUZZY_SSE2)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+int fuzzy_prefilter_scalar(const fuzzy_t* fuzzy, const char* candidate,
+    int length)
+{
+    int i;
+    int j;
+
+    // Greedily finding each needle character after the last is enough to
+    // tell if the needle's a subsequence.
+    j = 0;
+    for (i = 0; i < fuzzy->needle_length; ++i)
+    {
+        while (j < length && fold((unsigned char)candidate[j]) != fuzzy->needle[i])
+        {
+            ++j;
+        }
+
+        if (j >= length)
+        {
+            return 0;
+        }
+
+        ++j;
+    }
+
+    return 1;
+}
+
+#if defined(FUZZY_SSE2)
+//------------------------------------------------------------------------------
+static int lowest_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+//------------------------------------------------------------------------------
+static int prefilter_sse2(const fuzzy_t* fuzzy, const char* candidate,
+    int length)
+{
+    // As fuzzy_prefilter_scalar() but compares sixteen characters at a time
+    // against both characters that fold to the needle's, finishing the tail
+    // of the candidate a character at a time.
+
+    int i;
+    int j;
+
+    j = 0;
+    for (i = 0; i < fuzzy->needle_length; ++i)
+    {
+        __m128i lower;
+        __m128i upper;
+        unsigned mask;
+        int c;
+
+        c = fuzzy->needle[i];
+        lower = _mm_set1_epi8((char)c);
+        upper = _mm_set1_epi8((char)unfold(c));
+
+        mask = 0;
+        while (j + 16 <= length)
+        {
+            __m128i chunk;
+
+            chunk = _mm_loadu_si128((const __m128i*)(candidate + j));
+            mask = _mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(chunk, lower),
+                _mm_cmpeq_epi8(chunk, upper)));
+
+            if (mask)
+            {
+                break;
+            }
+
+            j += 16;
+        }
+
+        if (mask)
+        {
+            j += lowest_bit(mask) + 1;
+            continue;
+        }
+
+        while (j < length && fold((unsigned char)candidate[j]) != c)
+        {
+            ++j;
+        }
+
+        if (j >= length)
+        {
+            return 0;
+        }
+
+        ++j;
+    }
+
+    return 1;
+}
+#endif // FUZZY_SSE2
+
+//------------------------------------------------------------------------------
+int fuzzy_prefilter(const fuzzy_t* fuzzy, const char* candidate, int length)
+{
+#if defined(FUZZY_SSE2)
+    if (fuzzy_has_simd())
+    {
+        return prefilter_sse2(fuzzy, candidate, length);
+    }
+#endif
+
+    return fuzzy_prefilter_scalar(fuzzy, candidate, length);
+}
+
+//------------------------------------------------------------------------------
+int fuzzy_score(fuzzy_t* fuzzy, const char* candidate, int length, int* score)
+{
+    // Returns non-zero if 'candidate' matches, setting 'score' to its best
+    // alignment's score. Row 'i' of the table holds, for each position in the
+    // candidate, the best score of the needle up to 'i' with 'i' matched at
+    // that position, and the bonus of the run of consecutive matches it ends.
+    // Only the previous row's needed to fill the next, and positions before
+    // the needle's first character can be skipped.
+
+    int* prev;
+    int* cur;
+    int* prev_run;
+    int* cur_run;
+    int* info;
+    int* swap;
+    int start;
+    int count;
+    int best;
+    int i;
+    int j;
+
+    *score = 0;
+    if (!fuzzy_prefilter(fuzzy, candidate, length))
+    {
+        return 0;
+    }
+
+    if (fuzzy->needle_length == 0)
+    {
+        return 1;
+    }
+
+    start = 0;
+    while (start < length &&
+        fold((unsigned char)candidate[start]) != fuzzy->needle[0])
+    {
+        ++start;
+    }
+
+    if (start >= length)
+    {
+        return 0;
+    }
+
+    count = length - start;
+    if (count * 5 > fuzzy->row_size)
+    {
+        int* grown;
+
+        grown = realloc(fuzzy->rows, count * 5 * sizeof(int));
+        if (grown == NULL)
+        {
+            return 1;
+        }
+
+        fuzzy->rows = grown;
+        fuzzy->row_size = count * 5;
+    }
+
+    prev = fuzzy->rows;
+    cur = prev + count;
+    prev_run = cur + count;
+    cur_run = prev_run + count;
+    info = cur_run + count;
+
+    // Each position's folded character and bonus are worked out once.
+    for (j = 0; j < count; ++j)
+    {
+        int c = fold((unsigned char)candidate[start + j]);
+        int bonus = get_bonus(candidate, start + j);
+
+        info[j] = c | (bonus << 8);
+        prev[j] = (c == fuzzy->needle[0])
+            ? SCORE_MATCH + bonus * BONUS_FIRST
+            : SCORE_NONE;
+        prev_run[j] = bonus;
+    }
+
+    for (i = 1; i < fuzzy->needle_length; ++i)
+    {
+        int gap;
+        int c;
+
+        // 'gap' is the best score of the row above ending two or more
+        // characters back, less the cost of the gap to here. Unmatched
+        // positions are far enough below zero that they can take part in
+        // the sums without being checked for.
+        c = fuzzy->needle[i];
+        gap = SCORE_NONE;
+        cur[0] = SCORE_NONE;
+        cur_run[0] = 0;
+        for (j = 1; j < count; ++j)
+        {
+            int diagonal;
+            int bonus;
+            int run;
+
+            diagonal = prev[j - 1];
+            if ((info[j] & 0xff) == c)
+            {
+                bonus = info[j] >> 8;
+                run = prev_run[j - 1];
+                run = (bonus > run) ? bonus : run;
+                run = (BONUS_CONSECUTIVE > run) ? BONUS_CONSECUTIVE : run;
+
+                if (diagonal + run >= gap + bonus)
+                {
+                    cur[j] = diagonal + run + SCORE_MATCH;
+                    cur_run[j] = run;
+                }
+                else
+                {
+                    cur[j] = gap + bonus + SCORE_MATCH;
+                    cur_run[j] = bonus;
+                }
+            }
+            else
+            {
+                // The next row reads this position's run when it looks back
+                // along the diagonal, so it must be set even if unmatched.
+                cur[j] = SCORE_NONE;
+                cur_run[j] = 0;
+            }
+
+            gap = ((diagonal > gap) ? diagonal : gap) - GAP_PENALTY;
+        }
+
+        swap = prev;
+        prev = cur;
+        cur = swap;
+
+        swap = prev_run;
+        prev_run = cur_run;
+        cur_run = swap;
+    }
+
+    best = SCORE_NONE;
+    for (j = 0; j < count; ++j)
+    {
+        if (prev[j] > best)
+        {
+            best = prev[j];
+        }
+    }
+
+    *score = best;
+    return 1;
+}
+
+// vim: expandtab
@@ -0,0 +1,52 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+//------------------------------------------------------------------------------
+// Subsequence matching; a candidate matches when the needle's characters all
+// appear in it in order, ignoring case and treating / and \ as the same. Each
+// candidate's first checked by a cheap scan that only answers whether it
+// matches (vectorised where SSE2's available). Candidates that pass are then
+// scored by the best alignment of the needle, which favours characters at the
+// start of words and runs of consecutive characters, and penalises gaps.
+typedef struct
+{
+    unsigned char*      needle;         // folded
+    int                 needle_length;
+    int                 needle_size;
+    int*                rows;           // scoring scratch, five rows
+    int                 row_size;
+} fuzzy_t;
+
+//------------------------------------------------------------------------------
+void                    fuzzy_init(fuzzy_t* fuzzy);
+void                    fuzzy_free(fuzzy_t* fuzzy);
+int                     fuzzy_set_needle(fuzzy_t* fuzzy, const char* needle);
+int                     fuzzy_has_simd();
+int                     fuzzy_prefilter(const fuzzy_t* fuzzy, const char* candidate, int length);
+int                     fuzzy_prefilter_scalar(const fuzzy_t* fuzzy, const char* candidate, int length);
+int                     fuzzy_score(fuzzy_t* fuzzy, const char* candidate, int length, int* score);
+
+#endif // FUZZY_H
+
+// vim: expandtab
@@ -0,0 +1,1499 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "history_db.h"
+#include "util.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+#define HDB_MAGIC           0x42484c43  // "CLHB"
+#define HDB_VERSION         1
+#define HDB_HEADER_SIZE     32
+#define HDB_LOCK_OFFSET     0x7fffffff
+
+enum
+{
+    HDB_CWD = 1,
+    HDB_ENTRY,
+    HDB_EXIT,
+    HDB_INDEX,
+};
+
+typedef struct
+{
+    const unsigned char*    read;
+    const unsigned char*    end;
+    int                     ok;
+} reader_t;
+
+typedef struct
+{
+    unsigned                magic;
+    unsigned                version;
+    unsigned                generation;
+    unsigned                live;
+    unsigned                index_offset;
+} header_t;
+
+//------------------------------------------------------------------------------
+void history_buffer_init(history_buffer_t* buffer)
+{
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->size = 0;
+    buffer->failed = 0;
+}
+
+//------------------------------------------------------------------------------
+void history_buffer_free(history_buffer_t* buffer)
+{
+    free(buffer->data);
+    history_buffer_init(buffer);
+}
+
+//------------------------------------------------------------------------------
+static int buffer_reserve(history_buffer_t* buffer, int extra)
+{
+    // Once a write's failed the buffer stays failed so callers need only check
+    // at the end.
+
+    char* data;
+    int size;
+
+    if (buffer->failed)
+    {
+        return 0;
+    }
+
+    if (buffer->length + extra <= buffer->size)
+    {
+        return 1;
+    }
+
+    size = (buffer->size > 0) ? buffer->size : 256;
+    while (size < buffer->length + extra)
+    {
+        if (size > 0x3fffffff)
+        {
+            buffer->failed = 1;
+            return 0;
+        }
+
+        size *= 2;
+    }
+
+    data = realloc(buffer->data, size);
+    if (data == NULL)
+    {
+        buffer->failed = 1;
+        return 0;
+    }
+
+    buffer->data = data;
+    buffer->size = size;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static void buffer_write(history_buffer_t* buffer, const void* data, int length)
+{
+    if (length > 0 && buffer_reserve(buffer, length))
+    {
+        memcpy(buffer->data + buffer->length, data, length);
+        buffer->length += length;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void buffer_write_byte(history_buffer_t* buffer, int value)
+{
+    if (buffer_reserve(buffer, 1))
+    {
+        buffer->data[buffer->length++] = (char)value;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void buffer_write_varint(history_buffer_t* buffer, unsigned value)
+{
+    while (value >= 0x80)
+    {
+        buffer_write_byte(buffer, (value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+
+    buffer_write_byte(buffer, value);
+}
+
+//------------------------------------------------------------------------------
+static unsigned zigzag(int value)
+{
+    return ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+}
+
+//------------------------------------------------------------------------------
+static int unzigzag(unsigned value)
+{
+    return (int)((value >> 1) ^ (0u - (value & 1)));
+}
+
+//------------------------------------------------------------------------------
+static unsigned read_varint(reader_t* reader)
+{
+    unsigned value;
+    int shift;
+
+    value = 0;
+    for (shift = 0; shift < 35; shift += 7)
+    {
+        unsigned c;
+
+        if (reader->read >= reader->end)
+        {
+            break;
+        }
+
+        c = *reader->read++;
+        value |= (c & 0x7f) << shift;
+        if (!(c & 0x80))
+        {
+            return value;
+        }
+    }
+
+    reader->ok = 0;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static const char* read_bytes(reader_t* reader, unsigned length)
+{
+    const char* bytes;
+
+    if (!reader->ok || length > (unsigned)(reader->end - reader->read))
+    {
+        reader->ok = 0;
+        return NULL;
+    }
+
+    bytes = (const char*)reader->read;
+    reader->read += length;
+    return bytes;
+}
+
+//------------------------------------------------------------------------------
+static unsigned get_u32(const char* data)
+{
+    const unsigned char* c = (const unsigned char*)data;
+    return c[0] | (c[1] << 8) | (c[2] << 16) | ((unsigned)c[3] << 24);
+}
+
+//------------------------------------------------------------------------------
+static void put_u32(char* data, unsigned value)
+{
+    data[0] = (char)(value);
+    data[1] = (char)(value >> 8);
+    data[2] = (char)(value >> 16);
+    data[3] = (char)(value >> 24);
+}
+
+//------------------------------------------------------------------------------
+static int read_header(const char* data, int length, header_t* header)
+{
+    if (length < HDB_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    header->magic = get_u32(data);
+    header->version = get_u32(data + 4);
+    header->generation = get_u32(data + 8);
+    header->live = get_u32(data + 12);
+    header->index_offset = get_u32(data + 16);
+
+    return (header->magic == HDB_MAGIC && header->version == HDB_VERSION);
+}
+
+//------------------------------------------------------------------------------
+static void write_header(char* data, const header_t* header)
+{
+    memset(data, 0, HDB_HEADER_SIZE);
+    put_u32(data, HDB_MAGIC);
+    put_u32(data + 4, HDB_VERSION);
+    put_u32(data + 8, header->generation);
+    put_u32(data + 12, header->live);
+    put_u32(data + 16, header->index_offset);
+}
+
+//------------------------------------------------------------------------------
+static unsigned hash_folded(const char* str)
+{
+    unsigned hash = 2166136261u;
+    while (*str)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)*str++);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+static int equals_folded(const char* lhs, const char* rhs)
+{
+    while (*lhs && tolower((unsigned char)*lhs) == tolower((unsigned char)*rhs))
+    {
+        ++lhs;
+        ++rhs;
+    }
+
+    return (*lhs == *rhs);
+}
+
+//------------------------------------------------------------------------------
+void history_db_init(history_db_t* db)
+{
+    memset(db, 0, sizeof(*db));
+    history_buffer_init(&db->strings);
+}
+
+//------------------------------------------------------------------------------
+void history_db_free(history_db_t* db)
+{
+    history_buffer_free(&db->strings);
+    free(db->entries);
+    free(db->cwds);
+    free(db->cwd_last);
+    free(db->cwd_slots);
+    history_db_init(db);
+}
+
+//------------------------------------------------------------------------------
+void history_db_clear(history_db_t* db)
+{
+    // Empties the database but keeps its memory around to be reused.
+
+    int i;
+
+    db->strings.length = 0;
+    db->strings.failed = 0;
+    db->entry_count = 0;
+    db->first_ordinal = 0;
+    db->cwd_count = 0;
+    db->last_time = 0;
+    db->generation = 0;
+    db->offset = 0;
+
+    for (i = 0; i < db->cwd_slot_count; ++i)
+    {
+        db->cwd_slots[i] = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+const char* history_db_line(const history_db_t* db, int index)
+{
+    return db->strings.data + db->entries[index].line;
+}
+
+//------------------------------------------------------------------------------
+const char* history_db_cwd(const history_db_t* db, int cwd)
+{
+    if (cwd < 0 || cwd >= db->cwd_count)
+    {
+        return NULL;
+    }
+
+    return db->strings.data + db->cwds[cwd];
+}
+
+//------------------------------------------------------------------------------
+static int add_string(history_db_t* db, const char* str, int length)
+{
+    int offset = db->strings.length;
+
+    buffer_write(&db->strings, str, length);
+    buffer_write_byte(&db->strings, '\0');
+    return db->strings.failed ? -1 : offset;
+}
+
+//------------------------------------------------------------------------------
+static int grow_array(void** array, int* size, int count, int item_size)
+{
+    void* grown;
+    int new_size;
+
+    if (count < *size)
+    {
+        return 1;
+    }
+
+    new_size = (*size > 0) ? *size * 2 : 64;
+    grown = realloc(*array, new_size * item_size);
+    if (grown == NULL)
+    {
+        return 0;
+    }
+
+    *array = grown;
+    *size = new_size;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int insert_cwd_slot(history_db_t* db, int cwd)
+{
+    // Cwds are hashed case-insensitively with linear probing. The table's kept
+    // at most half full.
+
+    unsigned mask;
+    unsigned slot;
+
+    if (db->cwd_count * 2 >= db->cwd_slot_count)
+    {
+        int* slots;
+        int count;
+        int i;
+
+        count = (db->cwd_slot_count > 0) ? db->cwd_slot_count * 2 : 64;
+        slots = calloc(count, sizeof(int));
+        if (slots == NULL)
+        {
+            return 0;
+        }
+
+        free(db->cwd_slots);
+        db->cwd_slots = slots;
+        db->cwd_slot_count = count;
+
+        for (i = 0; i < cwd; ++i)
+        {
+            insert_cwd_slot(db, i);
+        }
+    }
+
+    mask = db->cwd_slot_count - 1;
+    slot = hash_folded(history_db_cwd(db, cwd)) & mask;
+    while (db->cwd_slots[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    db->cwd_slots[slot] = cwd + 1;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int history_db_find_cwd(const history_db_t* db, const char* cwd)
+{
+    unsigned mask;
+    unsigned slot;
+
+    if (db->cwd_slot_count == 0)
+    {
+        return -1;
+    }
+
+    mask = db->cwd_slot_count - 1;
+    slot = hash_folded(cwd) & mask;
+    while (db->cwd_slots[slot])
+    {
+        int id = db->cwd_slots[slot] - 1;
+        if (equals_folded(history_db_cwd(db, id), cwd))
+        {
+            return id;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+static int add_cwd(history_db_t* db, const char* cwd, int length)
+{
+    int offset;
+
+    // 'cwds' and 'cwd_last' are the same size so they grow together.
+    if (db->cwd_count >= db->cwd_size)
+    {
+        int size = db->cwd_size;
+        int* last;
+
+        if (!grow_array((void**)&db->cwds, &size, db->cwd_count, sizeof(int)))
+        {
+            return -1;
+        }
+
+        last = realloc(db->cwd_last, size * sizeof(int));
+        if (last == NULL)
+        {
+            return -1;
+        }
+
+        db->cwd_last = last;
+        db->cwd_size = size;
+    }
+
+    offset = add_string(db, cwd, length);
+    if (offset < 0)
+    {
+        return -1;
+    }
+
+    db->cwds[db->cwd_count] = offset;
+    db->cwd_last[db->cwd_count] = -1;
+    ++db->cwd_count;
+
+    if (!insert_cwd_slot(db, db->cwd_count - 1))
+    {
+        --db->cwd_count;
+        return -1;
+    }
+
+    return db->cwd_count - 1;
+}
+
+//------------------------------------------------------------------------------
+static int add_entry(history_db_t* db, const char* line, int length,
+    unsigned time, int cwd, int exit_code, int has_exit_code)
+{
+    history_entry_t* entry;
+    int offset;
+
+    if (!grow_array((void**)&db->entries, &db->entry_size, db->entry_count,
+        sizeof(history_entry_t)))
+    {
+        return -1;
+    }
+
+    offset = add_string(db, line, length);
+    if (offset < 0)
+    {
+        return -1;
+    }
+
+    cwd = (cwd >= 0 && cwd < db->cwd_count) ? cwd : -1;
+
+    entry = db->entries + db->entry_count;
+    entry->line = offset;
+    entry->length = length;
+    entry->time = time;
+    entry->cwd = cwd;
+    entry->exit_code = exit_code;
+    entry->has_exit_code = has_exit_code;
+    entry->prev_in_cwd = -1;
+
+    if (cwd >= 0)
+    {
+        entry->prev_in_cwd = db->cwd_last[cwd];
+        db->cwd_last[cwd] = db->entry_count;
+    }
+
+    db->last_time = time;
+    return db->entry_count++;
+}
+
+//------------------------------------------------------------------------------
+static int decode_record(history_db_t* db, reader_t* reader)
+{
+    // Returns zero if the record's incomplete or isn't one we understand.
+
+    const char* bytes;
+    unsigned length;
+    int type;
+
+    if (reader->read >= reader->end)
+    {
+        return 0;
+    }
+
+    type = *reader->read++;
+    switch (type)
+    {
+    case HDB_CWD:
+        length = read_varint(reader);
+        bytes = read_bytes(reader, length);
+        if (bytes == NULL || add_cwd(db, bytes, length) < 0)
+        {
+            return 0;
+        }
+        return 1;
+
+    case HDB_ENTRY:
+        {
+            int delta = unzigzag(read_varint(reader));
+            int cwd = (int)read_varint(reader) - 1;
+            unsigned exit_code = read_varint(reader);
+
+            length = read_varint(reader);
+            bytes = read_bytes(reader, length);
+            if (bytes == NULL)
+            {
+                return 0;
+            }
+
+            return add_entry(db, bytes, length, db->last_time + delta, cwd,
+                exit_code ? unzigzag(exit_code - 1) : 0, exit_code != 0) >= 0;
+        }
+
+    case HDB_EXIT:
+        {
+            int back = (int)read_varint(reader);
+            int exit_code = unzigzag(read_varint(reader));
+            int index = db->entry_count - back;
+
+            if (!reader->ok)
+            {
+                return 0;
+            }
+
+            if (back > 0 && index >= 0)
+            {
+                db->entries[index].exit_code = exit_code;
+                db->entries[index].has_exit_code = 1;
+            }
+        }
+        return 1;
+
+    case HDB_INDEX:
+        length = read_varint(reader);
+        return (read_bytes(reader, length) != NULL);
+    }
+
+    reader->ok = 0;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int history_db_decode(history_db_t* db, const char* data, int length)
+{
+    // Decodes as many whole records from 'data' as there are, returning how
+    // many bytes they took.
+
+    reader_t reader;
+    const unsigned char* consumed;
+
+    reader.read = (const unsigned char*)data;
+    reader.end = reader.read + length;
+    reader.ok = 1;
+
+    consumed = reader.read;
+    while (decode_record(db, &reader))
+    {
+        consumed = reader.read;
+    }
+
+    return (int)(consumed - (const unsigned char*)data);
+}
+
+//------------------------------------------------------------------------------
+static int seek_to_tail(history_db_t* db, const char* data, int length,
+    unsigned index_offset, int tail, reader_t* reader)
+{
+    // Uses the index a compaction left to skip entries older than the newest
+    // 'tail' of them. Every cwd comes before the first entry so they're read
+    // first. Returns zero if the index can't be used.
+
+    reader_t index;
+    unsigned entry_count;
+    unsigned block_count;
+    unsigned block;
+    unsigned offset;
+    unsigned base_time;
+    unsigned i;
+
+    if (index_offset < HDB_HEADER_SIZE || index_offset >= (unsigned)length)
+    {
+        return 0;
+    }
+
+    index.read = (const unsigned char*)data + index_offset;
+    index.end = (const unsigned char*)data + length;
+    index.ok = (*index.read++ == HDB_INDEX);
+
+    read_varint(&index);
+    entry_count = read_varint(&index);
+    block_count = read_varint(&index);
+    if (!index.ok || entry_count <= (unsigned)tail)
+    {
+        return 0;
+    }
+
+    block = (entry_count - tail) / HISTORY_DB_BLOCK;
+    if (block == 0 || block >= block_count)
+    {
+        return 0;
+    }
+
+    offset = 0;
+    base_time = 0;
+    for (i = 0; i <= block && index.ok; ++i)
+    {
+        offset = read_varint(&index);
+        base_time = read_varint(&index);
+    }
+
+    if (!index.ok || offset < HDB_HEADER_SIZE || offset >= index_offset)
+    {
+        return 0;
+    }
+
+    while (reader->read < reader->end && *reader->read == HDB_CWD)
+    {
+        if (!decode_record(db, reader))
+        {
+            return 0;
+        }
+    }
+
+    db->first_ordinal = block * HISTORY_DB_BLOCK;
+    db->last_time = base_time;
+    reader->read = (const unsigned char*)data + offset;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int history_db_load(history_db_t* db, const char* data, int length, int tail)
+{
+    // Loads a whole file in to an empty database. If 'tail' is positive then
+    // entries may be skipped so long as at least that many of the newest are
+    // loaded. Returns how far in to 'data' was read, or zero if it isn't one
+    // of our files.
+
+    reader_t reader;
+    header_t header;
+
+    if (!read_header(data, length, &header))
+    {
+        return 0;
+    }
+
+    reader.read = (const unsigned char*)data + HDB_HEADER_SIZE;
+    reader.end = (const unsigned char*)data + length;
+    reader.ok = 1;
+
+    if (tail > 0 && header.index_offset)
+    {
+        const unsigned char* start = reader.read;
+        if (!seek_to_tail(db, data, length, header.index_offset, tail, &reader))
+        {
+            history_db_clear(db);
+            reader.read = start;
+            reader.ok = 1;
+        }
+    }
+
+    return (int)(reader.read - (const unsigned char*)data) +
+        history_db_decode(db, (const char*)reader.read,
+            (int)(reader.end - reader.read));
+}
+
+//------------------------------------------------------------------------------
+static void write_cwd(history_buffer_t* out, const char* cwd)
+{
+    int length = (int)strlen(cwd);
+
+    buffer_write_byte(out, HDB_CWD);
+    buffer_write_varint(out, length);
+    buffer_write(out, cwd, length);
+}
+
+//------------------------------------------------------------------------------
+static void write_entry(history_buffer_t* out, const char* line, int length,
+    int delta, int cwd, int exit_code, int has_exit_code)
+{
+    buffer_write_byte(out, HDB_ENTRY);
+    buffer_write_varint(out, zigzag(delta));
+    buffer_write_varint(out, cwd + 1);
+    buffer_write_varint(out, has_exit_code ? zigzag(exit_code) + 1 : 0);
+    buffer_write_varint(out, length);
+    buffer_write(out, line, length);
+}
+
+//------------------------------------------------------------------------------
+int history_db_add(history_db_t* db, history_buffer_t* out, const char* line,
+    unsigned time, const char* cwd, int exit_code, int has_exit_code)
+{
+    // Adds an entry, writing the records for it to 'out' to be appended to the
+    // file. The database must be up to date with the file. Returns the entry's
+    // ordinal or -1 if it couldn't be added.
+
+    int length;
+    int cwd_id;
+
+    cwd_id = -1;
+    if (cwd != NULL && *cwd)
+    {
+        cwd_id = history_db_find_cwd(db, cwd);
+        if (cwd_id < 0)
+        {
+            cwd_id = add_cwd(db, cwd, (int)strlen(cwd));
+            if (cwd_id < 0)
+            {
+                return -1;
+            }
+
+            write_cwd(out, cwd);
+        }
+    }
+
+    length = (int)strlen(line);
+    write_entry(out, line, length, (int)(time - db->last_time), cwd_id,
+        exit_code, has_exit_code);
+
+    if (add_entry(db, line, length, time, cwd_id, exit_code,
+        has_exit_code) < 0)
+    {
+        return -1;
+    }
+
+    return db->first_ordinal + db->entry_count - 1;
+}
+
+//------------------------------------------------------------------------------
+void history_db_set_exit(history_db_t* db, history_buffer_t* out, int ordinal,
+    int exit_code)
+{
+    int index;
+
+    index = ordinal - db->first_ordinal;
+    if (index < 0 || index >= db->entry_count)
+    {
+        return;
+    }
+
+    db->entries[index].exit_code = exit_code;
+    db->entries[index].has_exit_code = 1;
+
+    buffer_write_byte(out, HDB_EXIT);
+    buffer_write_varint(out, db->entry_count - index);
+    buffer_write_varint(out, zigzag(exit_code));
+}
+
+//------------------------------------------------------------------------------
+static int select_entries(const history_db_t* db, int* keep, int max_entries,
+    int dedupe)
+{
+    // Picks up to 'max_entries' of the newest entries, dropping older duplicate
+    // lines if 'dedupe' is set. They're written to the end of 'keep' (which
+    // has room for every entry) oldest first. Returns how many were kept or -1
+    // if memory ran out.
+
+    int* seen;
+    unsigned mask;
+    int kept;
+    int i;
+
+    seen = NULL;
+    mask = 0;
+    if (dedupe)
+    {
+        for (mask = 64; mask < (unsigned)db->entry_count * 2; mask <<= 1);
+
+        seen = calloc(mask, sizeof(int));
+        if (seen == NULL)
+        {
+            return -1;
+        }
+
+        --mask;
+    }
+
+    kept = 0;
+    for (i = db->entry_count - 1; i >= 0 && kept < max_entries; --i)
+    {
+        if (seen != NULL)
+        {
+            const char* line = history_db_line(db, i);
+            unsigned slot = 2166136261u;
+            const char* c;
+
+            for (c = line; *c; ++c)
+            {
+                slot = (slot ^ (unsigned char)*c) * 16777619u;
+            }
+
+            slot &= mask;
+            while (seen[slot] &&
+                strcmp(history_db_line(db, seen[slot] - 1), line) != 0)
+            {
+                slot = (slot + 1) & mask;
+            }
+
+            if (seen[slot])
+            {
+                continue;
+            }
+
+            seen[slot] = i + 1;
+        }
+
+        ++kept;
+        keep[db->entry_count - kept] = i;
+    }
+
+    free(seen);
+    return kept;
+}
+
+//------------------------------------------------------------------------------
+int history_db_write(const history_db_t* db, history_buffer_t* out,
+    unsigned generation, int max_entries, int dedupe)
+{
+    // Writes a whole file holding the newest 'max_entries' entries (or all of
+    // them if it's not positive), with an index of blocks of entries at the
+    // end. Returns how many entries were written or -1 on failure.
+
+    history_buffer_t index;
+    header_t header;
+    int* keep;
+    int* remap;
+    int cwd_count;
+    int base;
+    int kept;
+    int first;
+    unsigned last_time;
+    int i;
+
+    keep = malloc((db->entry_count + 1) * sizeof(int));
+    remap = malloc((db->cwd_count + 1) * sizeof(int));
+    if (keep == NULL || remap == NULL)
+    {
+        free(keep);
+        free(remap);
+        return -1;
+    }
+
+    max_entries = (max_entries > 0) ? max_entries : db->entry_count;
+    kept = select_entries(db, keep, max_entries, dedupe);
+    first = db->entry_count - kept;
+
+    // The header's filled in once the index's offset is known.
+    base = out->length;
+    if (buffer_reserve(out, HDB_HEADER_SIZE))
+    {
+        out->length += HDB_HEADER_SIZE;
+    }
+
+    // Only the cwds kept entries use are written, renumbered in order of use.
+    for (i = 0; i < db->cwd_count; ++i)
+    {
+        remap[i] = -1;
+    }
+
+    cwd_count = 0;
+    for (i = first; i < db->entry_count && kept >= 0; ++i)
+    {
+        int cwd = db->entries[keep[i]].cwd;
+        if (cwd >= 0 && remap[cwd] < 0)
+        {
+            remap[cwd] = cwd_count++;
+            write_cwd(out, history_db_cwd(db, cwd));
+        }
+    }
+
+    // Entries, noting where each block of them starts.
+    history_buffer_init(&index);
+    last_time = 0;
+    for (i = first; i < db->entry_count && kept >= 0; ++i)
+    {
+        const history_entry_t* entry = db->entries + keep[i];
+
+        if ((i - first) % HISTORY_DB_BLOCK == 0)
+        {
+            buffer_write_varint(&index, out->length - base);
+            buffer_write_varint(&index, last_time);
+        }
+
+        write_entry(out, history_db_line(db, keep[i]), entry->length,
+            (int)(entry->time - last_time),
+            (entry->cwd >= 0) ? remap[entry->cwd] : -1, entry->exit_code,
+            entry->has_exit_code);
+
+        last_time = entry->time;
+    }
+
+    header.index_offset = out->length - base;
+    buffer_write_byte(out, HDB_INDEX);
+    {
+        history_buffer_t counts;
+
+        history_buffer_init(&counts);
+        buffer_write_varint(&counts, kept);
+        buffer_write_varint(&counts, (kept + HISTORY_DB_BLOCK - 1) /
+            HISTORY_DB_BLOCK);
+
+        buffer_write_varint(out, counts.length + index.length);
+        buffer_write(out, counts.data, counts.length);
+        buffer_write(out, index.data, index.length);
+
+        out->failed |= counts.failed;
+        history_buffer_free(&counts);
+    }
+
+    out->failed |= index.failed;
+    history_buffer_free(&index);
+    free(keep);
+    free(remap);
+
+    if (kept < 0 || out->failed)
+    {
+        return -1;
+    }
+
+    header.generation = generation;
+    header.live = 1;
+    write_header(out->data + base, &header);
+    return kept;
+}
+
+//------------------------------------------------------------------------------
+int history_db_search(const history_db_t* db, const char* needle, int cwd,
+    int from)
+{
+    // Finds the newest entry older than index 'from' that contains 'needle',
+    // only looking at entries run in 'cwd' if it isn't -1. Returns the entry's
+    // index or -1.
+
+    int i;
+
+    from = (from < db->entry_count) ? from : db->entry_count;
+    if (cwd < 0)
+    {
+        for (i = from - 1; i >= 0; --i)
+        {
+            if (strstr(history_db_line(db, i), needle) != NULL)
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    if (cwd >= db->cwd_count)
+    {
+        return -1;
+    }
+
+    // Searches usually carry on from the previous match, which is in 'cwd' so
+    // the chain's joined straight away.
+    i = (from >= db->entry_count) ? db->cwd_last[cwd] : from - 1;
+    while (i >= 0 && db->entries[i].cwd != cwd)
+    {
+        --i;
+    }
+
+    for (; i >= 0; i = db->entries[i].prev_in_cwd)
+    {
+        if (strstr(history_db_line(db, i), needle) != NULL)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+static int parse_timestamp(const char* line, int length, unsigned* time)
+{
+    // Readline writes "#<seconds>" lines ahead of entries when it's saving
+    // timestamps, which is the format we export too.
+
+    unsigned value;
+    int i;
+
+    if (length < 2 || line[0] != '#')
+    {
+        return 0;
+    }
+
+    value = 0;
+    for (i = 1; i < length; ++i)
+    {
+        if (line[i] < '0' || line[i] > '9')
+        {
+            return 0;
+        }
+
+        value = (value * 10) + (line[i] - '0');
+    }
+
+    *time = value;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void history_db_import_text(history_db_t* db, const char* text, int length)
+{
+    // Adds each non-empty line of a text history file as an entry. The header
+    // line Clink's text history files had is skipped.
+
+    const char* line;
+    const char* read;
+    const char* end;
+    unsigned time;
+    int header;
+
+    time = 0;
+    line = text;
+    end = text + length;
+    for (read = text; read <= end; ++read)
+    {
+        const char* eol;
+
+        if (read < end && *read != '\n')
+        {
+            continue;
+        }
+
+        eol = (read > line && read[-1] == '\r') ? read - 1 : read;
+        header = (line == text && eol - line > 15 &&
+            strncmp(line, "#clink history ", 15) == 0);
+
+        if (!header && eol > line &&
+            !parse_timestamp(line, (int)(eol - line), &time))
+        {
+            add_entry(db, line, (int)(eol - line), time, -1, 0, 0);
+            time = 0;
+        }
+
+        line = read + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+void history_db_export_text(const history_db_t* db, history_buffer_t* out,
+    int timestamps)
+{
+    int i;
+
+    for (i = 0; i < db->entry_count; ++i)
+    {
+        const history_entry_t* entry = db->entries + i;
+
+        if (timestamps && entry->time)
+        {
+            char stamp[16];
+
+            sprintf(stamp, "#%u\n", entry->time);
+            buffer_write(out, stamp, (int)strlen(stamp));
+        }
+
+        buffer_write(out, history_db_line(db, i), entry->length);
+        buffer_write_byte(out, '\n');
+    }
+}
+
+//------------------------------------------------------------------------------
+void get_history_db_file_name(char* buffer, int size)
+{
+    get_config_dir(buffer, size);
+    if (buffer[0])
+    {
+        str_cat(buffer, "/.history_db", size);
+    }
+}
+
+//------------------------------------------------------------------------------
+static int write_file_header(HANDLE handle, unsigned generation, int live)
+{
+    char data[HDB_HEADER_SIZE];
+    header_t header;
+    DWORD written;
+
+    header.generation = generation;
+    header.live = live;
+    header.index_offset = 0;
+    write_header(data, &header);
+
+    written = 0;
+    SetFilePointer(handle, 0, NULL, FILE_BEGIN);
+    WriteFile(handle, data, HDB_HEADER_SIZE, &written, NULL);
+    return (written == HDB_HEADER_SIZE);
+}
+
+//------------------------------------------------------------------------------
+static char* read_file_bytes(HANDLE handle, DWORD from, DWORD to)
+{
+    // Returns a copy of the file's bytes in [from, to), or NULL if they
+    // couldn't be read.
+
+    char* buffer;
+    DWORD size;
+    DWORD bytes_read;
+
+    size = to - from;
+    buffer = malloc(size + 1);
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    bytes_read = 0;
+    SetFilePointer(handle, from, NULL, FILE_BEGIN);
+    if (size > 0 && (!ReadFile(handle, buffer, size, &bytes_read, NULL) ||
+        bytes_read != size))
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+//------------------------------------------------------------------------------
+void history_db_close(history_file_t* file)
+{
+    OVERLAPPED overlapped = { 0 };
+
+    overlapped.OffsetHigh = HDB_LOCK_OFFSET;
+    UnlockFileEx(file->handle, 0, 1, 0, &overlapped);
+    CloseHandle(file->handle);
+}
+
+//------------------------------------------------------------------------------
+int history_db_open(const char* file_name, history_file_t* file)
+{
+    // Opens and locks the history file. The lock's a byte range well past any
+    // plausible end of the file so it only serialises Clink sessions and never
+    // gets in the way of reading or writing the file's contents. If the file
+    // was compacted while we waited for the lock the new one's opened instead.
+
+    int i;
+
+    for (i = 0; i < 8; ++i)
+    {
+        OVERLAPPED overlapped = { 0 };
+        char data[HDB_HEADER_SIZE];
+        header_t header;
+        DWORD bytes_read;
+
+        file->handle = CreateFile(file_name, GENERIC_READ|GENERIC_WRITE,
+            FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file->handle == INVALID_HANDLE_VALUE)
+        {
+            return 0;
+        }
+
+        overlapped.OffsetHigh = HDB_LOCK_OFFSET;
+        if (!LockFileEx(file->handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0,
+            &overlapped))
+        {
+            CloseHandle(file->handle);
+            return 0;
+        }
+
+        file->created = 0;
+        file->generation = 0;
+
+        bytes_read = 0;
+        SetFilePointer(file->handle, 0, NULL, FILE_BEGIN);
+        ReadFile(file->handle, data, HDB_HEADER_SIZE, &bytes_read, NULL);
+
+        // New files get a header straight away.
+        if (bytes_read == 0 && GetFileSize(file->handle, NULL) == 0)
+        {
+            if (!write_file_header(file->handle, 1, 1))
+            {
+                history_db_close(file);
+                return 0;
+            }
+
+            file->generation = 1;
+            file->created = 1;
+            return 1;
+        }
+
+        // Leave alone anything that isn't one of our files.
+        if (!read_header(data, bytes_read, &header))
+        {
+            history_db_close(file);
+            return 0;
+        }
+
+        file->generation = header.generation;
+        if (header.live)
+        {
+            return 1;
+        }
+
+        history_db_close(file);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int history_db_sync(history_db_t* db, history_file_t* file, int tail)
+{
+    // Catches up with entries other sessions have appended since we last
+    // looked. If the file's been compacted since (or it looks to have been
+    // truncated by something else) it's reloaded, keeping at least 'tail' of
+    // the newest entries. Returns non-zero if the database was reloaded.
+
+    DWORD size;
+    char* data;
+
+    size = GetFileSize(file->handle, NULL);
+    if (size == INVALID_FILE_SIZE)
+    {
+        return 0;
+    }
+
+    if (file->generation != db->generation || size < db->offset ||
+        db->offset < HDB_HEADER_SIZE)
+    {
+        data = read_file_bytes(file->handle, 0, size);
+        if (data == NULL)
+        {
+            return 0;
+        }
+
+        history_db_clear(db);
+        db->offset = history_db_load(db, data, size, tail);
+        db->generation = file->generation;
+        free(data);
+        return 1;
+    }
+
+    if (size > db->offset)
+    {
+        data = read_file_bytes(file->handle, db->offset, size);
+        if (data != NULL)
+        {
+            db->offset += history_db_decode(db, data, size - db->offset);
+            free(data);
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int history_db_append(history_db_t* db, history_file_t* file,
+    const history_buffer_t* records)
+{
+    // Appends records from history_db_add() and friends as one write, so a
+    // reader never sees half of them. If they can't be written 'db' no longer
+    // matches the file so it's marked to be reloaded by the next sync.
+
+    DWORD size;
+    DWORD written;
+    int ok;
+
+    if (records->length == 0 && !records->failed)
+    {
+        return 1;
+    }
+
+    size = GetFileSize(file->handle, NULL);
+    written = 0;
+    ok = !records->failed;
+    if (ok)
+    {
+        SetFilePointer(file->handle, 0, NULL, FILE_END);
+        ok = WriteFile(file->handle, records->data, records->length, &written,
+            NULL);
+        ok = ok && (written == (DWORD)records->length);
+    }
+
+    // If we were up to date before appending we still are afterwards.
+    if (ok && size == db->offset)
+    {
+        db->offset += written;
+    }
+    else
+    {
+        db->generation = 0;
+    }
+
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int history_db_import_legacy(history_file_t* file)
+{
+    // Carries over the text history file earlier versions wrote. Whichever
+    // part of Clink creates the history file (see 'created') calls this, so
+    // it happens once and before anything else is appended. The old file's
+    // left for earlier versions to use. Returns how many lines were imported.
+
+    history_buffer_t records;
+    history_db_t legacy;
+    history_db_t db;
+    HANDLE handle;
+    DWORD size;
+    char buffer[512];
+    char* data;
+    int count;
+
+    get_config_dir(buffer, sizeof_array(buffer));
+    if (!buffer[0])
+    {
+        return 0;
+    }
+
+    str_cat(buffer, "/.history", sizeof_array(buffer));
+    handle = CreateFile(buffer, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    size = GetFileSize(handle, NULL);
+    data = (size != INVALID_FILE_SIZE) ? read_file_bytes(handle, 0, size) : NULL;
+    CloseHandle(handle);
+    if (data == NULL)
+    {
+        return 0;
+    }
+
+    history_db_init(&legacy);
+    history_db_import_text(&legacy, data, size);
+    free(data);
+
+    history_db_init(&db);
+    history_db_sync(&db, file, 0);
+
+    history_buffer_init(&records);
+    for (count = 0; count < legacy.entry_count; ++count)
+    {
+        history_db_add(&db, &records, history_db_line(&legacy, count),
+            legacy.entries[count].time, NULL, 0, 0);
+    }
+
+    if (!history_db_append(&db, file, &records))
+    {
+        count = 0;
+    }
+
+    history_buffer_free(&records);
+    history_db_free(&db);
+    history_db_free(&legacy);
+    return count;
+}
+
+//------------------------------------------------------------------------------
+static int write_generation(const char* file_name, history_file_t* file,
+    const history_buffer_t* contents)
+{
+    // Writes 'contents' alongside the history file and swaps it in, retiring
+    // 'file'. If the rename can't be done (another program might have the file
+    // open) the file's rewritten in place instead, under the lock.
+
+    char temp_name[512];
+    HANDLE out;
+    DWORD written;
+    int ok;
+
+    _snprintf(temp_name, sizeof_array(temp_name), "%s_%d", file_name,
+        GetCurrentProcessId());
+    temp_name[sizeof_array(temp_name) - 1] = '\0';
+
+    out = CreateFile(temp_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (out != INVALID_HANDLE_VALUE)
+    {
+        written = 0;
+        ok = WriteFile(out, contents->data, contents->length, &written, NULL);
+        ok = ok && (written == (DWORD)contents->length);
+        CloseHandle(out);
+
+        if (ok && MoveFileEx(temp_name, file_name, MOVEFILE_REPLACE_EXISTING))
+        {
+            write_file_header(file->handle, file->generation, 0);
+            SetEndOfFile(file->handle);
+            return 1;
+        }
+
+        unlink(temp_name);
+    }
+
+    written = 0;
+    SetFilePointer(file->handle, 0, NULL, FILE_BEGIN);
+    ok = WriteFile(file->handle, contents->data, contents->length, &written,
+        NULL);
+    SetEndOfFile(file->handle);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+int history_db_compact(const char* file_name, history_file_t* file,
+    int max_entries, int slack, int dedupe)
+{
+    // Writes the next generation of the history file if it has more than
+    // 'slack' entries too many. Returns non-zero if it did.
+
+    history_buffer_t contents;
+    history_db_t db;
+    DWORD size;
+    char* data;
+    int ok;
+
+    if (max_entries <= 0)
+    {
+        return 0;
+    }
+
+    size = GetFileSize(file->handle, NULL);
+    if (size == INVALID_FILE_SIZE)
+    {
+        return 0;
+    }
+
+    data = read_file_bytes(file->handle, 0, size);
+    if (data == NULL)
+    {
+        return 0;
+    }
+
+    ok = 0;
+    history_db_init(&db);
+    history_db_load(&db, data, size, 0);
+    free(data);
+
+    if (db.entry_count - slack > max_entries)
+    {
+        history_buffer_init(&contents);
+        if (history_db_write(&db, &contents, file->generation + 1, max_entries,
+            dedupe) >= 0)
+        {
+            ok = write_generation(file_name, file, &contents);
+        }
+
+        history_buffer_free(&contents);
+    }
+
+    history_db_free(&db);
+    return ok;
+}
+
+// vim: expandtab
@@ -0,0 +1,113 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HISTORY_DB_H
+#define HISTORY_DB_H
+
+//------------------------------------------------------------------------------
+// Clink's history file. It starts with a fixed size header and is followed by
+// a stream of records that sessions only ever append to;
+//
+//  cwd     varint length, bytes            - interns a directory, ids from 0
+//  entry   zigzag time delta, varint cwd+1, varint exit (0 is unknown, else
+//          zigzag code+1), varint length, bytes
+//  exit    varint entries back, zigzag code - sets an earlier entry's code
+//  index   varint length, payload          - skipped when streaming
+//
+// Times are seconds since the epoch, each relative to the previous entry's.
+// Compaction writes every cwd first, then entries, then an index of blocks of
+// entries so loading can skip to the newest ones.
+typedef struct
+{
+    char*               data;
+    int                 length;
+    int                 size;
+    int                 failed;
+} history_buffer_t;
+
+typedef struct
+{
+    int                 line;           // offset in to 'strings'
+    int                 length;
+    unsigned            time;
+    int                 cwd;            // -1 if unknown
+    int                 exit_code;
+    int                 has_exit_code;
+    int                 prev_in_cwd;    // previous entry with the same cwd or -1
+} history_entry_t;
+
+typedef struct
+{
+    history_buffer_t    strings;
+    history_entry_t*    entries;
+    int                 entry_count;
+    int                 entry_size;
+    int                 first_ordinal;  // file ordinal of entries[0]
+    int*                cwds;           // offsets in to 'strings'
+    int*                cwd_last;       // newest entry in each cwd or -1
+    int                 cwd_count;
+    int                 cwd_size;
+    int*                cwd_slots;      // hash of cwd ids + 1
+    int                 cwd_slot_count;
+    unsigned            last_time;
+    unsigned            generation;     // of the file this mirrors
+    unsigned            offset;         // how far in to the file has been read
+} history_db_t;
+
+typedef struct
+{
+    void*               handle;
+    unsigned            generation;
+    int                 created;        // set if opening made a new file
+} history_file_t;
+
+#define HISTORY_DB_BLOCK    1024
+
+//------------------------------------------------------------------------------
+void                    history_buffer_init(history_buffer_t* buffer);
+void                    history_buffer_free(history_buffer_t* buffer);
+
+void                    history_db_init(history_db_t* db);
+void                    history_db_free(history_db_t* db);
+void                    history_db_clear(history_db_t* db);
+const char*             history_db_line(const history_db_t* db, int index);
+const char*             history_db_cwd(const history_db_t* db, int cwd);
+int                     history_db_find_cwd(const history_db_t* db, const char* cwd);
+int                     history_db_decode(history_db_t* db, const char* data, int length);
+int                     history_db_load(history_db_t* db, const char* data, int length, int tail);
+int                     history_db_add(history_db_t* db, history_buffer_t* out, const char* line, unsigned time, const char* cwd, int exit_code, int has_exit_code);
+void                    history_db_set_exit(history_db_t* db, history_buffer_t* out, int ordinal, int exit_code);
+int                     history_db_write(const history_db_t* db, history_buffer_t* out, unsigned generation, int max_entries, int dedupe);
+int                     history_db_search(const history_db_t* db, const char* needle, int cwd, int from);
+void                    history_db_import_text(history_db_t* db, const char* text, int length);
+void                    history_db_export_text(const history_db_t* db, history_buffer_t* out, int timestamps);
+
+void                    get_history_db_file_name(char* buffer, int size);
+int                     history_db_open(const char* file_name, history_file_t* file);
+void                    history_db_close(history_file_t* file);
+int                     history_db_sync(history_db_t* db, history_file_t* file, int tail);
+int                     history_db_append(history_db_t* db, history_file_t* file, const history_buffer_t* records);
+int                     history_db_import_legacy(history_file_t* file);
+int                     history_db_compact(const char* file_name, history_file_t* file, int max_entries, int slack, int dedupe);
+
+#endif // HISTORY_DB_H
+
+// vim: expandtab
@@ -0,0 +1,449 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "history_rank.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+// An occurrence's weight halves every HALF_LIFE entries, or every CWD_HALF_LIFE
+// of the search directory's entries for its directory bonus, which counts
+// CWD_WEIGHT times as much.
+#define HALF_LIFE           1000
+#define CWD_HALF_LIFE       100
+#define CWD_WEIGHT          8.0
+#define MIN_WEIGHT          1e-200
+
+//------------------------------------------------------------------------------
+static unsigned hash_line(const char* line)
+{
+    unsigned hash = 2166136261u;
+    while (*line)
+    {
+        hash ^= (unsigned char)*line++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+static int grow(void** array, int* size, int count, int item_size)
+{
+    void* grown;
+    int new_size;
+
+    if (count < *size)
+    {
+        return 1;
+    }
+
+    new_size = (*size > 0) ? *size * 2 : 256;
+    grown = realloc(*array, new_size * item_size);
+    if (grown == NULL)
+    {
+        return 0;
+    }
+
+    *array = grown;
+    *size = new_size;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void history_rank_init(history_rank_t* rank)
+{
+    memset(rank, 0, sizeof(*rank));
+    rank->scored_cwd = -1;
+}
+
+//------------------------------------------------------------------------------
+void history_rank_free(history_rank_t* rank)
+{
+    free(rank->strings);
+    free(rank->items);
+    free(rank->slots);
+    free(rank->occurrences);
+    free(rank->cwds);
+    free(rank->order);
+    history_rank_init(rank);
+}
+
+//------------------------------------------------------------------------------
+void history_rank_clear(history_rank_t* rank)
+{
+    // Forgets every line but keeps the memory to be reused.
+
+    int i;
+
+    rank->strings_length = 0;
+    rank->item_count = 0;
+    rank->occurrence_count = 0;
+    rank->order_count = 0;
+    rank->scored_cwd = -1;
+
+    for (i = 0; i < rank->slot_count; ++i)
+    {
+        rank->slots[i] = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+const char* history_rank_line(const history_rank_t* rank, int index)
+{
+    // Returns the line ranked 'index' (zero's the best) by the last scoring.
+
+    if (index < 0 || index >= rank->order_count)
+    {
+        return NULL;
+    }
+
+    return rank->strings + rank->items[rank->order[index]].line;
+}
+
+//------------------------------------------------------------------------------
+static int insert_slot(history_rank_t* rank, int item)
+{
+    unsigned mask;
+    unsigned slot;
+
+    if (item * 2 >= rank->slot_count)
+    {
+        int* slots;
+        int count;
+        int i;
+
+        count = (rank->slot_count > 0) ? rank->slot_count * 2 : 512;
+        slots = calloc(count, sizeof(int));
+        if (slots == NULL)
+        {
+            return 0;
+        }
+
+        free(rank->slots);
+        rank->slots = slots;
+        rank->slot_count = count;
+
+        for (i = 0; i < item; ++i)
+        {
+            insert_slot(rank, i);
+        }
+    }
+
+    mask = rank->slot_count - 1;
+    slot = hash_line(rank->strings + rank->items[item].line) & mask;
+    while (rank->slots[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    rank->slots[slot] = item + 1;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int find_item(const history_rank_t* rank, const char* line)
+{
+    unsigned mask;
+    unsigned slot;
+
+    if (rank->slot_count == 0)
+    {
+        return -1;
+    }
+
+    mask = rank->slot_count - 1;
+    slot = hash_line(line) & mask;
+    while (rank->slots[slot])
+    {
+        int item = rank->slots[slot] - 1;
+        if (strcmp(rank->strings + rank->items[item].line, line) == 0)
+        {
+            return item;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+static int add_item(history_rank_t* rank, const char* line)
+{
+    int length;
+    int item;
+
+    length = (int)strlen(line) + 1;
+    while (rank->strings_length + length > rank->strings_size)
+    {
+        char* strings;
+        int size;
+
+        size = (rank->strings_size > 0) ? rank->strings_size * 2 : 4096;
+        strings = realloc(rank->strings, size);
+        if (strings == NULL)
+        {
+            return -1;
+        }
+
+        rank->strings = strings;
+        rank->strings_size = size;
+    }
+
+    if (!grow((void**)&rank->items, &rank->item_size, rank->item_count,
+        sizeof(history_rank_item_t)))
+    {
+        return -1;
+    }
+
+    item = rank->item_count;
+    rank->items[item].line = rank->strings_length;
+    rank->items[item].last = -1;
+    rank->items[item].score = 0;
+
+    memcpy(rank->strings + rank->strings_length, line, length);
+    rank->strings_length += length;
+
+    if (!insert_slot(rank, item))
+    {
+        rank->strings_length -= length;
+        return -1;
+    }
+
+    ++rank->item_count;
+    return item;
+}
+
+//------------------------------------------------------------------------------
+int history_rank_add(history_rank_t* rank, const char* line, int cwd)
+{
+    // Adds an occurrence of 'line', run in directory 'cwd' (an id of the
+    // caller's choosing or -1). Returns zero if memory ran out.
+
+    int item;
+    int size;
+
+    item = find_item(rank, line);
+    if (item < 0)
+    {
+        item = add_item(rank, line);
+        if (item < 0)
+        {
+            return 0;
+        }
+    }
+
+    size = rank->occurrence_size;
+    if (!grow((void**)&rank->occurrences, &size, rank->occurrence_count,
+        sizeof(int)))
+    {
+        return 0;
+    }
+
+    if (size != rank->occurrence_size)
+    {
+        int* cwds = realloc(rank->cwds, size * sizeof(int));
+        if (cwds == NULL)
+        {
+            return 0;
+        }
+
+        rank->cwds = cwds;
+        rank->occurrence_size = size;
+    }
+
+    rank->items[item].last = rank->occurrence_count;
+    rank->occurrences[rank->occurrence_count] = item;
+    rank->cwds[rank->occurrence_count] = cwd;
+    ++rank->occurrence_count;
+
+    // Scores are stale now.
+    rank->order_count = 0;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int sort_by_score(history_rank_t* rank)
+{
+    // A stable radix sort of 'order' by score, best first, so ties stay in the
+    // order they were found in. The scores are sorted as floats, whose bits
+    // order the same as they do as unsigned ints when they're positive.
+
+    union { float f; unsigned u; } score;
+    unsigned* keys;
+    unsigned* keys_out;
+    int* order;
+    int* order_out;
+    int count;
+    int total;
+    int shift;
+    int i;
+
+    count = rank->item_count;
+    keys = malloc(count * sizeof(unsigned) * 2);
+    order_out = malloc(count * sizeof(int));
+    if (keys == NULL || order_out == NULL)
+    {
+        free(keys);
+        free(order_out);
+        return 0;
+    }
+
+    order = rank->order;
+    keys_out = keys + count;
+    for (i = 0; i < count; ++i)
+    {
+        score.f = (float)rank->items[rank->order[i]].score;
+        keys[i] = ~score.u;
+    }
+
+    for (shift = 0; shift < 32; shift += 8)
+    {
+        int offsets[256];
+        unsigned* swap_keys;
+        int* swap_order;
+
+        memset(offsets, 0, sizeof(offsets));
+        for (i = 0; i < count; ++i)
+        {
+            ++offsets[(keys[i] >> shift) & 0xff];
+        }
+
+        if (offsets[(keys[0] >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+
+        total = 0;
+        for (i = 0; i < 256; ++i)
+        {
+            int n = offsets[i];
+            offsets[i] = total;
+            total += n;
+        }
+
+        for (i = 0; i < count; ++i)
+        {
+            int j = offsets[(keys[i] >> shift) & 0xff]++;
+            keys_out[j] = keys[i];
+            order_out[j] = rank->order[i];
+        }
+
+        swap_keys = keys;
+        keys = keys_out;
+        keys_out = swap_keys;
+
+        swap_order = rank->order;
+        rank->order = order_out;
+        order_out = swap_order;
+    }
+
+    // An odd number of passes leaves the result in the scratch buffer.
+    if (rank->order != order)
+    {
+        memcpy(order, rank->order, count * sizeof(int));
+        order_out = rank->order;
+        rank->order = order;
+    }
+
+    free((keys < keys_out) ? keys : keys_out);
+    free(order_out);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int history_rank_score(history_rank_t* rank, int cwd)
+{
+    // Scores every line for searches made from 'cwd' and orders them best
+    // first (the most recently run first when scores tie), unless nothing's
+    // changed since last time. Returns how many lines were ordered.
+
+    double decay;
+    double cwd_decay;
+    double weight;
+    double cwd_weight;
+    int count;
+    int i;
+
+    if (rank->order_count == rank->item_count && rank->scored_cwd == cwd)
+    {
+        return rank->order_count;
+    }
+
+    rank->order_count = 0;
+    while (rank->order_size < rank->item_count)
+    {
+        if (!grow((void**)&rank->order, &rank->order_size, rank->order_size,
+            sizeof(int)))
+        {
+            return 0;
+        }
+    }
+
+    for (i = 0; i < rank->item_count; ++i)
+    {
+        rank->items[i].score = -1;
+    }
+
+    // One pass from newest to oldest, the weights decaying as it goes and
+    // lines going in to 'order' as they're first seen. Ancient occurrences
+    // stop counting rather than slowing things down as denormals.
+    decay = pow(2.0, -1.0 / HALF_LIFE);
+    cwd_decay = pow(2.0, -1.0 / CWD_HALF_LIFE);
+    weight = 1.0;
+    cwd_weight = CWD_WEIGHT;
+    count = 0;
+    for (i = rank->occurrence_count - 1; i >= 0; --i)
+    {
+        int item_id = rank->occurrences[i];
+        history_rank_item_t* item = rank->items + item_id;
+
+        if (item->score < 0)
+        {
+            item->score = 0;
+            rank->order[count++] = item_id;
+        }
+
+        item->score += weight;
+        weight = (weight > MIN_WEIGHT) ? weight * decay : 0;
+
+        if (cwd >= 0 && rank->cwds[i] == cwd)
+        {
+            item->score += cwd_weight;
+            cwd_weight = (cwd_weight > MIN_WEIGHT) ? cwd_weight * cwd_decay : 0;
+        }
+    }
+
+    if (count > 0 && !sort_by_score(rank))
+    {
+        return 0;
+    }
+
+    rank->order_count = count;
+    rank->scored_cwd = cwd;
+    return rank->order_count;
+}
+
+// vim: expandtab
@@ -0,0 +1,68 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HISTORY_RANK_H
+#define HISTORY_RANK_H
+
+//------------------------------------------------------------------------------
+// Ranks the distinct lines of the history for searching. Every occurrence of a
+// line adds to its score, weighted by how recent it is, and occurrences in the
+// directory searches are made from count for more, weighted by how recent they
+// are amongst that directory's own entries. Occurrences are added oldest first
+// as the history grows, and scoring is redone only when something's changed.
+typedef struct
+{
+    int                 line;           // offset in to 'strings'
+    int                 last;           // newest occurrence
+    double              score;
+} history_rank_item_t;
+
+typedef struct
+{
+    char*               strings;
+    int                 strings_length;
+    int                 strings_size;
+    history_rank_item_t* items;
+    int                 item_count;
+    int                 item_size;
+    int*                slots;          // hash of item ids + 1
+    int                 slot_count;
+    int*                occurrences;    // item of each occurrence, oldest first
+    int*                cwds;           // cwd id of each occurrence or -1
+    int                 occurrence_count;
+    int                 occurrence_size;
+    int*                order;          // item ids, best first
+    int                 order_count;
+    int                 order_size;
+    int                 scored_cwd;
+} history_rank_t;
+
+//------------------------------------------------------------------------------
+void                    history_rank_init(history_rank_t* rank);
+void                    history_rank_free(history_rank_t* rank);
+void                    history_rank_clear(history_rank_t* rank);
+int                     history_rank_add(history_rank_t* rank, const char* line, int cwd);
+int                     history_rank_score(history_rank_t* rank, int cwd);
+const char*             history_rank_line(const history_rank_t* rank, int index);
+
+#endif // HISTORY_RANK_H
+
+// vim: expandtab
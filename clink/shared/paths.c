@@ -20,6 +20,7 @@
  */
 
 #include "pch.h"
+#include "str_builder.h"
 #include "util.h"
 
 //------------------------------------------------------------------------------
@@ -74,18 +75,24 @@ void get_dll_dir(char* buffer, int size)
 void get_config_dir(char* buffer, int size)
 {
     static int once = 1;
+    str_builder_t dir;
 
     // Maybe the user specified an alternative location?
+    str_builder_init(&dir);
     if (g_config_dir_override != NULL)
     {
-        str_cpy(buffer, g_config_dir_override, size);
+        str_builder_append(&dir, g_config_dir_override);
     }
     else
     {
         get_dll_dir(buffer, size);
-        str_cat(buffer, ".\\profile", size);
+        str_builder_append(&dir, buffer);
+        str_builder_append(&dir, ".\\profile");
     }
 
+    str_builder_copy(&dir, buffer, size);
+    str_builder_free(&dir);
+
     // Try and create the directory if it doesn't already exist. Just this once.
     if (once)
     {
@@ -111,18 +118,26 @@ void get_log_dir(char* buffer, int size)
     // Just the once, get user's appdata folder.
     if (log_dir[0] == 1)
     {
-        if (SHGetFolderPath(0, CSIDL_LOCAL_APPDATA, NULL, 0, log_dir) != S_OK)
-        {
-            const char* str;
-            if ((str = getenv("USERPROFILE")) == NULL)
-            {
-                GetTempPath(sizeof_array(log_dir), log_dir);
-            }
+        str_builder_t dir;
 
-            str_cpy(log_dir, str, sizeof_array(log_dir));
+        str_builder_init(&dir);
+        if (SHGetFolderPath(0, CSIDL_LOCAL_APPDATA, NULL, 0, log_dir) == S_OK)
+        {
+            str_builder_append(&dir, log_dir);
+        }
+        else if (getenv("USERPROFILE") != NULL)
+        {
+            str_builder_append(&dir, getenv("USERPROFILE"));
+        }
+        else
+        {
+            GetTempPath(sizeof_array(log_dir), log_dir);
+            str_builder_append(&dir, log_dir);
         }
 
-        str_cat(log_dir, "./clink", sizeof_array(log_dir));
+        str_builder_append(&dir, "./clink");
+        str_builder_copy(&dir, log_dir, sizeof_array(log_dir));
+        str_builder_free(&dir);
     }
 
     str_cpy(buffer, log_dir, size);
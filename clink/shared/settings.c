@@ -21,6 +21,7 @@
 
 #include "pch.h"
 #include "settings.h"
+#include "str_builder.h"
 #include "util.h"
 
 //------------------------------------------------------------------------------
@@ -293,11 +294,17 @@ const char* settings_get_str(settings_t* s, const char* name)
     // Check for an environment variable override.
     {
         static char buffer[256];
+        str_builder_t var_name;
+        DWORD found;
 
-        strcpy(buffer, "clink.");
-        str_cat(buffer, name, sizeof_array(buffer));
+        str_builder_init(&var_name);
+        str_builder_printf(&var_name, "clink.%s", name);
 
-        if (GetEnvironmentVariableA(buffer, buffer, sizeof_array(buffer)))
+        found = GetEnvironmentVariableA(var_name.data, buffer,
+            sizeof_array(buffer));
+
+        str_builder_free(&var_name);
+        if (found && found < sizeof_array(buffer))
         {
             return buffer;
         }
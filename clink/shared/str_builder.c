@@ -0,0 +1,226 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pch.h"
+#include "str_builder.h"
+
+//------------------------------------------------------------------------------
+void str_builder_init(str_builder_t* sb)
+{
+    sb->data = sb->local;
+    sb->data[0] = '\0';
+    sb->length = 0;
+    sb->size = sizeof(sb->local);
+}
+
+//------------------------------------------------------------------------------
+void str_builder_free(str_builder_t* sb)
+{
+    if (sb->data != sb->local)
+    {
+        free(sb->data);
+    }
+
+    str_builder_init(sb);
+}
+
+//------------------------------------------------------------------------------
+void str_builder_clear(str_builder_t* sb)
+{
+    str_builder_truncate(sb, 0);
+}
+
+//------------------------------------------------------------------------------
+void str_builder_truncate(str_builder_t* sb, int length)
+{
+    if (length < 0)
+    {
+        length = 0;
+    }
+
+    if (length < sb->length)
+    {
+        sb->length = length;
+        sb->data[length] = '\0';
+    }
+}
+
+//------------------------------------------------------------------------------
+int str_builder_reserve(str_builder_t* sb, int size)
+{
+    // Makes sure there's room for a string of 'size' characters (excluding the
+    // terminator). Returns zero if the memory couldn't be had.
+
+    char* data;
+    int new_size;
+
+    if (size < 0)
+    {
+        return 0;
+    }
+
+    if (size < sb->size)
+    {
+        return 1;
+    }
+
+    new_size = sb->size;
+    while (new_size <= size)
+    {
+        if (new_size > 0x3fffffff)
+        {
+            return 0;
+        }
+
+        new_size *= 2;
+    }
+
+    if (sb->data == sb->local)
+    {
+        data = malloc(new_size);
+        if (data != NULL)
+        {
+            memcpy(data, sb->local, sb->length + 1);
+        }
+    }
+    else
+    {
+        data = realloc(sb->data, new_size);
+    }
+
+    if (data == NULL)
+    {
+        return 0;
+    }
+
+    sb->data = data;
+    sb->size = new_size;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void str_builder_append_n(str_builder_t* sb, const char* str, int n)
+{
+    // Appends up to 'n' characters of 'str', stopping early at its terminator.
+    // If memory runs out as much as fits is appended.
+
+    int i;
+
+    for (i = 0; i < n && str[i]; ++i);
+    n = i;
+
+    if (!str_builder_reserve(sb, sb->length + n))
+    {
+        n = sb->size - sb->length - 1;
+    }
+
+    memcpy(sb->data + sb->length, str, n);
+    sb->length += n;
+    sb->data[sb->length] = '\0';
+}
+
+//------------------------------------------------------------------------------
+void str_builder_append(str_builder_t* sb, const char* str)
+{
+    if (str != NULL)
+    {
+        str_builder_append_n(sb, str, (int)strlen(str));
+    }
+}
+
+//------------------------------------------------------------------------------
+void str_builder_append_c(str_builder_t* sb, char c)
+{
+    str_builder_append_n(sb, &c, 1);
+}
+
+//------------------------------------------------------------------------------
+void str_builder_printf(str_builder_t* sb, const char* format, ...)
+{
+    int length;
+    va_list v;
+
+    va_start(v, format);
+    length = _vscprintf(format, v);
+    va_end(v);
+
+    if (length <= 0 || !str_builder_reserve(sb, sb->length + length))
+    {
+        return;
+    }
+
+    va_start(v, format);
+    vsnprintf(sb->data + sb->length, length + 1, format, v);
+    va_end(v);
+
+    sb->length += length;
+    sb->data[sb->length] = '\0';
+}
+
+//------------------------------------------------------------------------------
+void str_builder_join_path(str_builder_t* sb, const char* path)
+{
+    // Appends 'path' with exactly one separator between it and what's already
+    // in the builder.
+
+    if (path == NULL)
+    {
+        return;
+    }
+
+    if (sb->length > 0)
+    {
+        char c = sb->data[sb->length - 1];
+        if (c != '\\' && c != '/')
+        {
+            str_builder_append_c(sb, '\\');
+        }
+
+        while (*path == '\\' || *path == '/')
+        {
+            ++path;
+        }
+    }
+
+    str_builder_append(sb, path);
+}
+
+//------------------------------------------------------------------------------
+int str_builder_copy(const str_builder_t* sb, char* dest, int max)
+{
+    // Copies the built string to a fixed size buffer. Returns zero if it had
+    // to be truncated to fit.
+
+    int n;
+
+    if (max <= 0)
+    {
+        return 0;
+    }
+
+    n = (sb->length < max) ? sb->length : max - 1;
+    memcpy(dest, sb->data, n);
+    dest[n] = '\0';
+
+    return (n == sb->length);
+}
+
+// vim: expandtab
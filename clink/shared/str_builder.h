@@ -0,0 +1,53 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STR_BUILDER_H
+#define STR_BUILDER_H
+
+//------------------------------------------------------------------------------
+// Builds strings up by appending to them, keeping track of the length so each
+// append doesn't have to find the end of the string again. Short strings live
+// in 'local' and longer ones move to the heap. As 'data' can point in to the
+// builder itself they must not be copied by value.
+typedef struct
+{
+    char*   data;                   // always null terminated
+    int     length;
+    int     size;
+    char    local[128];
+} str_builder_t;
+
+//------------------------------------------------------------------------------
+void    str_builder_init(str_builder_t* sb);
+void    str_builder_free(str_builder_t* sb);
+void    str_builder_clear(str_builder_t* sb);
+void    str_builder_truncate(str_builder_t* sb, int length);
+int     str_builder_reserve(str_builder_t* sb, int size);
+void    str_builder_append(str_builder_t* sb, const char* str);
+void    str_builder_append_n(str_builder_t* sb, const char* str, int n);
+void    str_builder_append_c(str_builder_t* sb, char c);
+void    str_builder_printf(str_builder_t* sb, const char* format, ...);
+void    str_builder_join_path(str_builder_t* sb, const char* path);
+int     str_builder_copy(const str_builder_t* sb, char* dest, int max);
+
+#endif // STR_BUILDER_H
+
+// vim: expandtab
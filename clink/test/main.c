@@ -20,7 +20,17 @@
  */
 
 #include "pch.h"
+#include "aliases.h"
+#include "ansi.h"
+#include "env_names.h"
+#include "compat/casefold.h"
+#include "compat/columns.h"
+#include "compat/width.h"
 #include "getopt.h"
+#include "shared/fuzzy.h"
+#include "shared/history_db.h"
+#include "shared/history_rank.h"
+#include "shared/str_builder.h"
 #include "shared/util.h"
 
 //------------------------------------------------------------------------------
@@ -29,11 +39,24 @@ void                clear_history();
 lua_State*          initialise_lua();
 int                 call_readline_w(const wchar_t*, wchar_t*, unsigned);
 char**              match_display_filter(char**, int);
+char*               filter_prompt(const char*);
+void                free_prompt(void*);
 extern void         (*g_alt_fwrite_hook)(wchar_t*);
+extern int          g_fwrite_call_count;
+extern int          g_fwrite_flush_count;
 void                set_config_dir_override(const char* dir);
+double              stats_clock();
+int                 hooked_wcwidth(wchar_t);
+int                 hooked_fwrite(const void*, int, int, void*);
+int                 hooked_fflush(void*);
+int                 load_inputrc_snapshot();
+void                begin_inputrc_snapshot();
+void                end_inputrc_snapshot();
 
 static const char*  g_getc_automatic    = NULL;
 static char*        g_caught_matches    = NULL;
+static int          g_caught_longest    = 0;
+static str_builder_t g_caught_output;
 
 //------------------------------------------------------------------------------
 int getwch_automatic(int* alt)
@@ -54,94 +77,1575 @@ int getwch_automatic(int* alt)
     return '\n';
 }
 
+//------------------------------------------------------------------------------
+int getwch_automatic_pending()
+{
+    return (g_getc_automatic != NULL && *g_getc_automatic != '\0');
+}
+
 //------------------------------------------------------------------------------
 static void match_catch(char** matches, int match_count, int longest)
 {
     int i;
-    char* write;
+    char* write;
+
+    free(g_caught_matches);
+    g_caught_matches = malloc((longest * 2) * match_count);
+
+    matches = match_display_filter(matches, match_count);
+
+    write = g_caught_matches;
+    for (i = 1; i <= match_count; ++i)
+    {
+        strcpy(write, matches[i]);
+        write += strlen(write) + 1;
+
+        free(matches[i]);
+    }
+
+    free(matches);
+    *write = '\0';
+}
+
+//------------------------------------------------------------------------------
+static void stdout_catch(wchar_t* buffer)
+{
+    int length = (int)wcslen(buffer);
+    int bytes;
+    char* utf8;
+
+    if (length > g_caught_longest)
+    {
+        g_caught_longest = length;
+    }
+
+    // Keep what was written so tests can compare output byte for byte.
+    bytes = WideCharToMultiByte(CP_UTF8, 0, buffer, length, NULL, 0, NULL, NULL);
+    utf8 = malloc(bytes + 1);
+    WideCharToMultiByte(CP_UTF8, 0, buffer, length, utf8, bytes, NULL, NULL);
+    str_builder_append_n(&g_caught_output, utf8, bytes);
+    free(utf8);
+}
+
+//------------------------------------------------------------------------------
+static int clear_history_lua(lua_State* lua)
+{
+    clear_history();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int inputrc_snapshot_lua(lua_State* lua)
+{
+    // With a path the inputrc file is parsed and a snapshot of the result
+    // saved. Without one the saved snapshot is loaded; returns if it applied.
+
+    if (lua_gettop(lua) > 0 && lua_isstring(lua, 1))
+    {
+        begin_inputrc_snapshot();
+        rl_read_init_file(lua_tostring(lua, 1));
+        end_inputrc_snapshot();
+        return 0;
+    }
+
+    lua_pushboolean(lua, load_inputrc_snapshot());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int funmap_bench_lua(lua_State* lua)
+{
+    // Times an inputrc of 'count' bindings that cycle through every function
+    // name readline knows. Returns milliseconds to parse the bindings, then to
+    // look the names up 100 times over via funmap's index and with a linear
+    // scan of funmap (as readline did before), and how many of those lookups
+    // found a function via the index and via the scan.
+
+    const char** names;
+    Keymap saved_keymap;
+    Keymap keymap;
+    double started;
+    char line[128];
+    int name_count;
+    int indexed;
+    int scanned;
+    int count;
+    int pass;
+    int i;
+    int j;
+
+    count = lua_tointeger(lua, 1);
+    if (count < 1)
+    {
+        return 0;
+    }
+
+    rl_initialize_funmap();
+    names = rl_funmap_names();
+    name_count = 0;
+    while (names[name_count] != NULL)
+    {
+        ++name_count;
+    }
+
+    // Bind into a keymap of our own so the tests that follow are unaffected.
+    saved_keymap = rl_get_keymap();
+    keymap = rl_make_bare_keymap();
+    rl_set_keymap(keymap);
+
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        sprintf(line, "\"\\C-x%c%c\": %s", 'a' + (i % 26), 'a' + (i / 26 % 26),
+            names[i % name_count]);
+        rl_parse_and_bind(line);
+    }
+    lua_pushnumber(lua, stats_clock() - started);
+
+    rl_set_keymap(saved_keymap);
+    rl_discard_keymap(keymap);
+    free(keymap);
+
+    indexed = 0;
+    started = stats_clock();
+    for (pass = 0; pass < 100; ++pass)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            indexed += (rl_named_function(names[i % name_count]) != NULL);
+        }
+    }
+    lua_pushnumber(lua, stats_clock() - started);
+
+    scanned = 0;
+    started = stats_clock();
+    for (pass = 0; pass < 100; ++pass)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            for (j = 0; funmap[j] != NULL; ++j)
+            {
+                if (_stricmp(funmap[j]->name, names[i % name_count]) == 0)
+                {
+                    ++scanned;
+                    break;
+                }
+            }
+        }
+    }
+    lua_pushnumber(lua, stats_clock() - started);
+
+    lua_pushinteger(lua, indexed);
+    lua_pushinteger(lua, scanned);
+
+    free((void*)names);
+    return 5;
+}
+
+//------------------------------------------------------------------------------
+static int call_readline_lua(lua_State* lua)
+{
+    HANDLE handle;
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    wchar_t output[1024];
+    char utf8[sizeof_array(output)];
+    char* read;
+    int i;
+
+    // Save the console's cursor position incase readline moves it.
+    handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    GetConsoleScreenBufferInfo(handle, &csbi);
+
+    // Check we've got at least one string argument.
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    g_getc_automatic = lua_tostring(lua, 1);
+
+    g_fwrite_call_count = 0;
+    g_fwrite_flush_count = 0;
+    g_caught_longest = 0;
+    str_builder_clear(&g_caught_output);
+
+    // Call Readline.
+    g_alt_fwrite_hook = stdout_catch;
+    rl_completion_display_matches_hook = match_catch;
+    call_readline_w(L"", output, sizeof_array(output));
+
+    // Get output.
+    WideCharToMultiByte(CP_UTF8, 0, output, -1, utf8, sizeof(utf8), NULL, NULL);
+    lua_pushstring(lua, utf8);
+
+    // Collect matches "displayed" by readline.
+    lua_createtable(lua, 0, 0);
+
+    i = 1;
+    read = g_caught_matches;
+    while (read && *read != '\0')
+    {
+        lua_pushstring(lua, read);
+        lua_rawseti(lua, -2, i);
+
+        ++i;
+        read += strlen(read) + 1;
+    }
+
+    free(g_caught_matches);
+    g_caught_matches = NULL;
+
+    SetConsoleCursorPosition(handle, csbi.dwCursorPosition);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+static int get_fwrite_stats_lua(lua_State* lua)
+{
+    // Output statistics for the last call_readline().
+    lua_pushinteger(lua, g_fwrite_call_count);
+    lua_pushinteger(lua, g_fwrite_flush_count);
+    lua_pushinteger(lua, g_caught_longest);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+static int fwrite_output_lua(lua_State* lua)
+{
+    // Everything the last call_readline() wrote to the console.
+    lua_pushlstring(lua, g_caught_output.data, g_caught_output.length);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int redisplay_cache_lua(lua_State* lua)
+{
+    rl_redisplay_cache = lua_toboolean(lua, 1);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int fwrite_batch_lua(lua_State* lua)
+{
+    // Drives the buffered console writer directly. Each character of the
+    // script is written on its own except '|', which flushes. Returns the
+    // write and flush counts, the longest flush and everything flushed.
+
+    const char* script;
+    void (*hook)(wchar_t*);
+
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    hook = g_alt_fwrite_hook;
+    g_alt_fwrite_hook = stdout_catch;
+    g_fwrite_call_count = 0;
+    g_fwrite_flush_count = 0;
+    g_caught_longest = 0;
+    str_builder_clear(&g_caught_output);
+
+    for (script = lua_tostring(lua, 1); *script != '\0'; ++script)
+    {
+        if (*script == '|')
+        {
+            hooked_fflush(NULL);
+        }
+        else
+        {
+            hooked_fwrite(script, 1, 1, NULL);
+        }
+    }
+
+    g_alt_fwrite_hook = hook;
+
+    lua_pushinteger(lua, g_fwrite_call_count);
+    lua_pushinteger(lua, g_fwrite_flush_count);
+    lua_pushinteger(lua, g_caught_longest);
+    lua_pushlstring(lua, g_caught_output.data, g_caught_output.length);
+    return 4;
+}
+
+//------------------------------------------------------------------------------
+static int alias_table_lua(lua_State* lua)
+{
+    // Parses a buffer as GetConsoleAliasesW() would return it (albeit in utf-8
+    // here). Returns "name=text" for each alias in index order. Optionally the
+    // aliases can be filtered with ("prefix", prefix) or ("find", name).
+
+    alias_table_t table;
+    wchar_t* buffer;
+    const char* utf8;
+    const char* op;
+    const char* arg;
+    size_t utf8_size;
+    int first;
+    int count;
+    int chars;
+    int i;
+
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    utf8 = lua_tolstring(lua, 1, &utf8_size);
+    op = luaL_optstring(lua, 2, "");
+    arg = luaL_optstring(lua, 3, "");
+
+    chars = MultiByteToWideChar(CP_UTF8, 0, utf8, (int)utf8_size, NULL, 0);
+    buffer = malloc((chars + 1) * sizeof(wchar_t));
+    MultiByteToWideChar(CP_UTF8, 0, utf8, (int)utf8_size, buffer, chars);
+
+    alias_table_init(&table);
+    alias_table_parse(&table, buffer, chars);
+    free(buffer);
+
+    first = 0;
+    count = table.count;
+    if (strcmp(op, "prefix") == 0)
+    {
+        count = alias_table_prefix(&table, arg, &first);
+    }
+    else if (strcmp(op, "find") == 0)
+    {
+        const alias_t* alias = alias_table_find(&table, arg);
+        first = alias ? (int)(alias - table.aliases) : 0;
+        count = !!alias;
+    }
+
+    lua_createtable(lua, count, 0);
+    for (i = 0; i < count; ++i)
+    {
+        const alias_t* alias = table.aliases + first + i;
+        char text[1024];
+
+        WideCharToMultiByte(CP_UTF8, 0, alias->text, -1, text, sizeof(text),
+            NULL, NULL);
+
+        lua_pushfstring(lua, "%s=%s", alias->name_utf8, text);
+        lua_rawseti(lua, -2, i + 1);
+    }
+
+    alias_table_free(&table);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int ansi_spans_lua(lua_State* lua)
+{
+    // Describes how a string's broken up; text as is, SGR codes as the
+    // resulting attributes "<xx>", and other codes as "<>".
+    const char* str;
+    ansi_state_t state;
+    ansi_span_t span;
+    luaL_Buffer out;
+    char attr[8];
+
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    str = lua_tostring(lua, 1);
+    ansi_begin(&state, luaL_optint(lua, 2, 0x07));
+
+    luaL_buffinit(lua, &out);
+    while (ansi_next(str, &state, &span))
+    {
+        switch (span.type)
+        {
+        case ANSI_SPAN_TEXT:
+            luaL_addlstring(&out, str + span.offset, span.length);
+            break;
+
+        case ANSI_SPAN_CODE:
+            luaL_addstring(&out, "<>");
+            break;
+
+        case ANSI_SPAN_SGR:
+            sprintf(attr, "<%02x>", state.attr);
+            luaL_addstring(&out, attr);
+            break;
+        }
+    }
+
+    luaL_pushresult(&out);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int columns_layout_lua(lua_State* lua)
+{
+    // Lays out items of the given widths in columns. Args are a table of
+    // widths, the screen width and whether to fill rows first. Returns the
+    // rows, the columns and a table of the column widths.
+
+    columns_t columns;
+    int* widths;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) < 3 || !lua_istable(lua, 1) || !lua_isnumber(lua, 2))
+    {
+        return 0;
+    }
+
+    count = (int)lua_rawlen(lua, 1);
+    widths = malloc((count + 1) * sizeof(int));
+    for (i = 0; i < count; ++i)
+    {
+        lua_rawgeti(lua, 1, i + 1);
+        widths[i] = lua_tointeger(lua, -1);
+        lua_pop(lua, 1);
+    }
+
+    columns_init(&columns);
+    columns_layout(&columns, widths, count, lua_tointeger(lua, 2), 2,
+        lua_toboolean(lua, 3));
+
+    lua_pushinteger(lua, columns.rows);
+    lua_pushinteger(lua, columns.columns);
+    lua_createtable(lua, columns.columns, 0);
+    for (i = 0; i < columns.columns; ++i)
+    {
+        lua_pushinteger(lua, columns.widths[i]);
+        lua_rawseti(lua, -2, i + 1);
+    }
+
+    columns_free(&columns);
+    free(widths);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+static int filter_prompt_lua(lua_State* lua)
+{
+    // The prompt as it's given to Readline.
+    char* prompt;
+
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    prompt = filter_prompt(lua_tostring(lua, 1));
+    lua_pushstring(lua, prompt);
+    free_prompt(prompt);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int str_builder_lua(lua_State* lua)
+{
+    // Runs a list of operations on a str_builder_t; { "append", "abc" }, etc.
+    // Returns the result, its length, whether it's left the builder's local
+    // buffer, and if a size was given the result of copying it to a buffer of
+    // that size along with whether it fit.
+
+    str_builder_t sb;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) == 0 || !lua_istable(lua, 1))
+    {
+        return 0;
+    }
+
+    str_builder_init(&sb);
+
+    count = (int)lua_rawlen(lua, 1);
+    for (i = 1; i <= count; ++i)
+    {
+        const char* op;
+        const char* arg;
+
+        lua_rawgeti(lua, 1, i);
+
+        lua_rawgeti(lua, -1, 1);
+        op = lua_tostring(lua, -1);
+        lua_pop(lua, 1);
+
+        lua_rawgeti(lua, -1, 2);
+        arg = lua_tostring(lua, -1);
+        lua_pop(lua, 1);
+
+        if (strcmp(op, "append") == 0)
+        {
+            str_builder_append(&sb, arg);
+        }
+        else if (strcmp(op, "append_n") == 0)
+        {
+            lua_rawgeti(lua, -1, 3);
+            str_builder_append_n(&sb, arg, lua_tointeger(lua, -1));
+            lua_pop(lua, 1);
+        }
+        else if (strcmp(op, "append_c") == 0)
+        {
+            str_builder_append_c(&sb, arg[0]);
+        }
+        else if (strcmp(op, "printf") == 0)
+        {
+            // Up to two string arguments or a single integer one.
+            lua_rawgeti(lua, -1, 3);
+            lua_rawgeti(lua, -2, 4);
+            if (lua_type(lua, -2) == LUA_TNUMBER)
+            {
+                str_builder_printf(&sb, arg, lua_tointeger(lua, -2));
+            }
+            else
+            {
+                str_builder_printf(&sb, arg, lua_tostring(lua, -2),
+                    lua_tostring(lua, -1));
+            }
+            lua_pop(lua, 2);
+        }
+        else if (strcmp(op, "join_path") == 0)
+        {
+            str_builder_join_path(&sb, arg);
+        }
+        else if (strcmp(op, "truncate") == 0)
+        {
+            str_builder_truncate(&sb, atoi(arg));
+        }
+        else if (strcmp(op, "clear") == 0)
+        {
+            str_builder_clear(&sb);
+        }
+
+        lua_pop(lua, 1);
+    }
+
+    lua_pushlstring(lua, sb.data, sb.length);
+    lua_pushinteger(lua, sb.length);
+    lua_pushboolean(lua, sb.data != sb.local);
+
+    if (lua_isnumber(lua, 2))
+    {
+        int size = lua_tointeger(lua, 2);
+        char* buffer = malloc(size + 1);
+        int fit = str_builder_copy(&sb, buffer, size);
+
+        lua_pushstring(lua, (size > 0) ? buffer : "");
+        lua_pushboolean(lua, fit);
+        free(buffer);
+    }
+    else
+    {
+        lua_pushnil(lua);
+        lua_pushnil(lua);
+    }
+
+    str_builder_free(&sb);
+    return 5;
+}
+
+//------------------------------------------------------------------------------
+static void reload_history_db(history_db_t* db, const history_buffer_t* file,
+    int tail)
+{
+    history_db_clear(db);
+    history_db_load(db, file->data, file->length, tail);
+}
+
+//------------------------------------------------------------------------------
+static int history_db_lua(lua_State* lua)
+{
+    // Runs a list of operations on a history database, mirroring it as a file
+    // in memory; { "add", "line", time, "cwd", exit_code }, etc. Returns the
+    // database exported as text with timestamps, its entry count and a table
+    // of the results of the "search", "exit_of" and "cwd_of" operations.
+
+    history_buffer_t file;
+    history_buffer_t text;
+    history_db_t db;
+    int results;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) == 0 || !lua_istable(lua, 1))
+    {
+        return 0;
+    }
+
+    history_db_init(&db);
+    history_buffer_init(&file);
+    history_db_write(&db, &file, 1, 0, 0);
+
+    lua_createtable(lua, 0, 0);
+    results = lua_gettop(lua);
+
+    count = (int)lua_rawlen(lua, 1);
+    for (i = 1; i <= count; ++i)
+    {
+        const char* op;
+        const char* arg;
+        int arg2;
+        int arg3;
+
+        lua_rawgeti(lua, 1, i);
+        lua_rawgeti(lua, -1, 1);
+        lua_rawgeti(lua, -2, 2);
+        lua_rawgeti(lua, -3, 3);
+        lua_rawgeti(lua, -4, 4);
+        lua_rawgeti(lua, -5, 5);
+        op = lua_tostring(lua, -5);
+        arg = lua_tostring(lua, -4);
+        arg2 = lua_tointeger(lua, -3);
+        arg3 = lua_tointeger(lua, -1);
+
+        if (strcmp(op, "import") == 0)
+        {
+            history_db_import_text(&db, arg, (int)strlen(arg));
+            history_buffer_free(&file);
+            history_db_write(&db, &file, 1, 0, 0);
+        }
+        else if (strcmp(op, "add") == 0)
+        {
+            history_db_add(&db, &file, arg, arg2, lua_tostring(lua, -2), arg3,
+                !lua_isnil(lua, -1));
+        }
+        else if (strcmp(op, "exit") == 0)
+        {
+            history_db_set_exit(&db, &file, atoi(arg), arg2);
+        }
+        else if (strcmp(op, "write") == 0)
+        {
+            history_buffer_free(&file);
+            history_db_write(&db, &file, 1, atoi(arg), arg2);
+            reload_history_db(&db, &file, 0);
+        }
+        else if (strcmp(op, "reload") == 0)
+        {
+            reload_history_db(&db, &file, arg ? atoi(arg) : 0);
+        }
+        else if (strcmp(op, "search") == 0)
+        {
+            int cwd = lua_isnil(lua, -3) ? -1 : history_db_find_cwd(&db,
+                lua_tostring(lua, -3));
+            int from = lua_isnil(lua, -2) ? db.entry_count : lua_tointeger(lua, -2);
+            int found = -1;
+
+            if (cwd >= 0 || lua_isnil(lua, -3))
+            {
+                found = history_db_search(&db, arg, cwd, from);
+            }
+
+            lua_pushinteger(lua, found);
+            lua_rawseti(lua, results, (int)lua_rawlen(lua, results) + 1);
+        }
+        else if (strcmp(op, "exit_of") == 0)
+        {
+            const history_entry_t* entry = db.entries + atoi(arg);
+
+            if (entry->has_exit_code)
+            {
+                lua_pushinteger(lua, entry->exit_code);
+            }
+            else
+            {
+                lua_pushboolean(lua, 0);
+            }
+            lua_rawseti(lua, results, (int)lua_rawlen(lua, results) + 1);
+        }
+        else if (strcmp(op, "cwd_of") == 0)
+        {
+            const char* cwd = history_db_cwd(&db, db.entries[atoi(arg)].cwd);
+
+            lua_pushstring(lua, cwd ? cwd : "");
+            lua_rawseti(lua, results, (int)lua_rawlen(lua, results) + 1);
+        }
+
+        lua_pop(lua, 6);
+    }
+
+    history_buffer_init(&text);
+    history_db_export_text(&db, &text, 1);
+
+    lua_pushlstring(lua, text.data ? text.data : "", text.length);
+    lua_pushinteger(lua, db.entry_count);
+    lua_pushvalue(lua, results);
+
+    history_buffer_free(&text);
+    history_buffer_free(&file);
+    history_db_free(&db);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+static int history_db_bench_lua(lua_State* lua)
+{
+    // Times the history database on 'count' generated entries spread over 50
+    // directories. Returns milliseconds to parse them as text, to load the
+    // compacted file in full, to load just the newest 10k via its index, to
+    // search every entry for a substring and to search one directory ten
+    // times, followed by how many entries the full and newest 10k loads had.
+
+    history_buffer_t scratch;
+    history_buffer_t text;
+    history_buffer_t file;
+    history_db_t db;
+    double started;
+    char line[96];
+    char cwd[32];
+    int loaded;
+    int count;
+    int cwd_id;
+    int tail;
+    int i;
+
+    count = lua_tointeger(lua, 1);
+    if (count < 1)
+    {
+        return 0;
+    }
+
+    history_db_init(&db);
+    history_buffer_init(&scratch);
+    history_buffer_init(&text);
+    history_buffer_init(&file);
+
+    for (i = 0; i < count; ++i)
+    {
+        sprintf(line, "git commit -m \"change %d\" --author=someone%d", i, i % 50);
+        sprintf(cwd, "c:\\src\\project%d", i % 50);
+        history_db_add(&db, &scratch, line, 1600000000 + i, cwd, 0, 0);
+        scratch.length = 0;
+    }
+
+    history_db_write(&db, &file, 1, 0, 0);
+    history_db_export_text(&db, &text, 1);
+    history_db_clear(&db);
+
+    started = stats_clock();
+    history_db_import_text(&db, text.data, text.length);
+    lua_pushnumber(lua, stats_clock() - started);
+    history_db_clear(&db);
+
+    started = stats_clock();
+    history_db_load(&db, file.data, file.length, 0);
+    lua_pushnumber(lua, stats_clock() - started);
+    loaded = db.entry_count;
+    history_db_clear(&db);
+
+    started = stats_clock();
+    history_db_load(&db, file.data, file.length, 10000);
+    lua_pushnumber(lua, stats_clock() - started);
+    tail = db.entry_count;
+    history_db_clear(&db);
+    history_db_load(&db, file.data, file.length, 0);
+
+    started = stats_clock();
+    history_db_search(&db, "change 0\"", -1, db.entry_count);
+    lua_pushnumber(lua, stats_clock() - started);
+
+    started = stats_clock();
+    cwd_id = history_db_find_cwd(&db, "c:\\src\\project7");
+    for (i = 0; i < 10; ++i)
+    {
+        history_db_search(&db, "nowhere", cwd_id, db.entry_count);
+    }
+    lua_pushnumber(lua, stats_clock() - started);
+
+    lua_pushinteger(lua, loaded);
+    lua_pushinteger(lua, tail);
+
+    history_buffer_free(&file);
+    history_buffer_free(&text);
+    history_buffer_free(&scratch);
+    history_db_free(&db);
+    return 7;
+}
+
+//------------------------------------------------------------------------------
+static void push_history_text(lua_State* lua, const history_db_t* db)
+{
+    // Pushes the database's lines as "line\n", or "line @cwd\n" for entries
+    // that have a cwd.
+
+    str_builder_t text;
+    int i;
+
+    str_builder_init(&text);
+    for (i = 0; i < db->entry_count; ++i)
+    {
+        const char* cwd = history_db_cwd(db, db->entries[i].cwd);
+
+        str_builder_append(&text, history_db_line(db, i));
+        if (cwd != NULL)
+        {
+            str_builder_append(&text, " @");
+            str_builder_append(&text, cwd);
+        }
+        str_builder_append(&text, "\n");
+    }
+
+    lua_pushstring(lua, text.data ? text.data : "");
+    str_builder_free(&text);
+}
+
+//------------------------------------------------------------------------------
+static int history_share_lua(lua_State* lua)
+{
+    // Plays back sessions sharing a history file on disk, each with its own
+    // database. Ops are { writer, "line", "cwd" } to append a line as the
+    // shared history does or { writer } to just catch up with the file.
+    // Returns the file's lines and a table of the lines each writer has.
+
+    history_db_t writers[4];
+    history_file_t file;
+    history_db_t db;
+    const char* file_name;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) < 2 || !lua_isstring(lua, 1) || !lua_istable(lua, 2))
+    {
+        return 0;
+    }
+
+    file_name = lua_tostring(lua, 1);
+    unlink(file_name);
+
+    for (i = 0; i < sizeof_array(writers); ++i)
+    {
+        history_db_init(writers + i);
+    }
+
+    count = (int)lua_rawlen(lua, 2);
+    for (i = 1; i <= count; ++i)
+    {
+        history_buffer_t records;
+        const char* line;
+        int writer;
+
+        lua_rawgeti(lua, 2, i);
+        lua_rawgeti(lua, -1, 1);
+        lua_rawgeti(lua, -2, 2);
+        lua_rawgeti(lua, -3, 3);
+        writer = lua_tointeger(lua, -3) - 1;
+        line = lua_tostring(lua, -2);
+
+        if (writer >= 0 && writer < sizeof_array(writers) &&
+            history_db_open(file_name, &file))
+        {
+            history_db_sync(writers + writer, &file, 0);
+            if (line != NULL)
+            {
+                history_buffer_init(&records);
+                history_db_add(writers + writer, &records, line, i,
+                    lua_tostring(lua, -1), 0, 0);
+                history_db_append(writers + writer, &file, &records);
+                history_buffer_free(&records);
+            }
+
+            history_db_close(&file);
+        }
+
+        lua_pop(lua, 4);
+    }
+
+    // What a new session would read.
+    history_db_init(&db);
+    if (history_db_open(file_name, &file))
+    {
+        history_db_sync(&db, &file, 0);
+        history_db_close(&file);
+    }
+
+    push_history_text(lua, &db);
+    history_db_free(&db);
+
+    lua_createtable(lua, sizeof_array(writers), 0);
+    for (i = 0; i < sizeof_array(writers); ++i)
+    {
+        push_history_text(lua, writers + i);
+        lua_rawseti(lua, -2, i + 1);
+        history_db_free(writers + i);
+    }
+
+    unlink(file_name);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+typedef struct
+{
+    const char*         file_name;
+    int                 id;
+    int                 lines;
+    int                 max_history;
+    int                 failures;
+    int                 deferred;
+    int                 compactions;
+    double              compact_ms;
+    history_db_t        db;
+} stress_writer_t;
+
+//------------------------------------------------------------------------------
+static DWORD WINAPI history_stress_thread(stress_writer_t* writer)
+{
+    // Appends lines as add_to_shared_history() does, compacting the file in
+    // line rather than on another thread once it's grown past the slack.
+
+    int slack;
+    int i;
+
+    slack = (writer->max_history / 4 > 16) ? writer->max_history / 4 : 16;
+    for (i = 0; i < writer->lines; ++i)
+    {
+        history_buffer_t records;
+        history_file_t file;
+        char line[32];
+
+        // If the file's been compacted more times than history_db_open() will
+        // follow while it waited, a session keeps the line for later. Here
+        // it's tried again.
+        if (!history_db_open(writer->file_name, &file))
+        {
+            if (++writer->deferred > writer->lines)
+            {
+                ++writer->failures;
+                break;
+            }
+
+            --i;
+            continue;
+        }
+
+        sprintf(line, "%d %d", writer->id, i);
+        history_db_sync(&writer->db, &file, writer->max_history);
+
+        history_buffer_init(&records);
+        if (history_db_add(&writer->db, &records, line, i, NULL, 0, 0) < 0 ||
+            !history_db_append(&writer->db, &file, &records))
+        {
+            ++writer->failures;
+        }
+
+        history_buffer_free(&records);
+        history_db_close(&file);
+
+        if (writer->max_history > 0 && writer->db.first_ordinal +
+            writer->db.entry_count - slack > writer->max_history &&
+            history_db_open(writer->file_name, &file))
+        {
+            double started = stats_clock();
+            if (history_db_compact(writer->file_name, &file,
+                writer->max_history, slack, 0))
+            {
+                ++writer->compactions;
+            }
+            writer->compact_ms += stats_clock() - started;
+
+            history_db_close(&file);
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int check_stress_order(const history_db_t* db, int writer_count)
+{
+    // Each writer's lines must be whole and in the order it wrote them.
+
+    int last[16];
+    int i;
+
+    for (i = 0; i < writer_count; ++i)
+    {
+        last[i] = -1;
+    }
+
+    for (i = 0; i < db->entry_count; ++i)
+    {
+        int id;
+        int n;
+
+        if (sscanf(history_db_line(db, i), "%d %d", &id, &n) != 2 ||
+            id < 0 || id >= writer_count || n <= last[id])
+        {
+            return 0;
+        }
+
+        last[id] = n;
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int check_stress_view(const history_db_t* db, const history_db_t* file)
+{
+    // A writer's database, once caught up, must be the file's newest lines.
+
+    int offset;
+    int i;
 
-    free(g_caught_matches);
-    g_caught_matches = malloc((longest * 2) * match_count);
+    offset = file->entry_count - db->entry_count;
+    if (offset < 0)
+    {
+        return 0;
+    }
 
-    matches = match_display_filter(matches, match_count);
+    for (i = 0; i < db->entry_count; ++i)
+    {
+        if (strcmp(history_db_line(db, i), history_db_line(file, offset + i)))
+        {
+            return 0;
+        }
+    }
 
-    write = g_caught_matches;
-    for (i = 1; i <= match_count; ++i)
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int history_stress_lua(lua_State* lua)
+{
+    // Runs writers on their own threads appending to one history file on
+    // disk. Returns the number of lines the file ends up with, whether each
+    // writer's lines are in order, whether every writer's database agrees
+    // with the file, how many appends failed or had to wait for a later
+    // open, how many compactions were done, and the time per append and per
+    // compaction in microseconds.
+
+    stress_writer_t writers[16];
+    HANDLE threads[16];
+    history_file_t file;
+    history_db_t db;
+    const char* file_name;
+    double started;
+    double elapsed;
+    double compact_ms;
+    int writer_count;
+    int lines;
+    int max_history;
+    int failures;
+    int deferred;
+    int compactions;
+    int consistent;
+    int i;
+
+    if (lua_gettop(lua) < 4 || !lua_isstring(lua, 1))
     {
-        strcpy(write, matches[i]);
-        write += strlen(write) + 1;
+        return 0;
+    }
 
-        free(matches[i]);
+    file_name = lua_tostring(lua, 1);
+    writer_count = lua_tointeger(lua, 2);
+    lines = lua_tointeger(lua, 3);
+    max_history = lua_tointeger(lua, 4);
+    if (writer_count < 1 || writer_count > sizeof_array(writers) || lines < 1)
+    {
+        return 0;
     }
 
-    free(matches);
-    *write = '\0';
+    unlink(file_name);
+
+    for (i = 0; i < writer_count; ++i)
+    {
+        memset(writers + i, 0, sizeof(writers[i]));
+        writers[i].file_name = file_name;
+        writers[i].id = i;
+        writers[i].lines = lines;
+        writers[i].max_history = max_history;
+        history_db_init(&writers[i].db);
+    }
+
+    started = stats_clock();
+    for (i = 0; i < writer_count; ++i)
+    {
+        threads[i] = CreateThread(NULL, 0,
+            (LPTHREAD_START_ROUTINE)history_stress_thread, writers + i, 0,
+            NULL);
+    }
+
+    for (i = 0; i < writer_count; ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    elapsed = stats_clock() - started;
+
+    // Read the file as a new session would and check each writer against it.
+    history_db_init(&db);
+    consistent = 0;
+    if (history_db_open(file_name, &file))
+    {
+        history_db_sync(&db, &file, 0);
+
+        consistent = 1;
+        for (i = 0; i < writer_count; ++i)
+        {
+            history_db_sync(&writers[i].db, &file, max_history);
+            consistent = consistent && check_stress_view(&writers[i].db, &db);
+        }
+
+        history_db_close(&file);
+    }
+
+    failures = 0;
+    deferred = 0;
+    compactions = 0;
+    compact_ms = 0.0;
+    for (i = 0; i < writer_count; ++i)
+    {
+        failures += writers[i].failures;
+        deferred += writers[i].deferred;
+        compactions += writers[i].compactions;
+        compact_ms += writers[i].compact_ms;
+        history_db_free(&writers[i].db);
+    }
+
+    lua_pushinteger(lua, db.entry_count);
+    lua_pushboolean(lua, check_stress_order(&db, writer_count));
+    lua_pushboolean(lua, consistent);
+    lua_pushinteger(lua, failures);
+    lua_pushinteger(lua, deferred);
+    lua_pushinteger(lua, compactions);
+    lua_pushnumber(lua, elapsed * 1000.0 / (writer_count * lines));
+    lua_pushnumber(lua, compactions ? compact_ms * 1000.0 / compactions : 0.0);
+
+    history_db_free(&db);
+    unlink(file_name);
+    return 8;
 }
 
 //------------------------------------------------------------------------------
-static void stdout_catch(wchar_t* buffer)
+static int history_rank_lua(lua_State* lua)
 {
+    // Runs a list of operations on a history rank; { "add", "line", cwd } and
+    // { "score", cwd } where cwds are integer ids or nil. Returns a table with
+    // the lines each "score" ordered, best first.
+
+    history_rank_t rank;
+    int results;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) == 0 || !lua_istable(lua, 1))
+    {
+        return 0;
+    }
+
+    history_rank_init(&rank);
+
+    lua_createtable(lua, 0, 0);
+    results = lua_gettop(lua);
+
+    count = (int)lua_rawlen(lua, 1);
+    for (i = 1; i <= count; ++i)
+    {
+        const char* op;
+        int cwd;
+
+        lua_rawgeti(lua, 1, i);
+        lua_rawgeti(lua, -1, 1);
+        lua_rawgeti(lua, -2, 2);
+        lua_rawgeti(lua, -3, 3);
+        op = lua_tostring(lua, -3);
+
+        if (strcmp(op, "add") == 0)
+        {
+            cwd = lua_isnil(lua, -1) ? -1 : lua_tointeger(lua, -1);
+            history_rank_add(&rank, lua_tostring(lua, -2), cwd);
+        }
+        else if (strcmp(op, "score") == 0)
+        {
+            int n;
+            int j;
+
+            cwd = lua_isnil(lua, -2) ? -1 : lua_tointeger(lua, -2);
+            n = history_rank_score(&rank, cwd);
+
+            lua_createtable(lua, n, 0);
+            for (j = 0; j < n; ++j)
+            {
+                lua_pushstring(lua, history_rank_line(&rank, j));
+                lua_rawseti(lua, -2, j + 1);
+            }
+            lua_rawseti(lua, results, (int)lua_rawlen(lua, results) + 1);
+        }
+
+        lua_pop(lua, 4);
+    }
+
+    history_rank_free(&rank);
+    return 1;
 }
 
 //------------------------------------------------------------------------------
-static int clear_history_lua(lua_State* lua)
+static int casefold_lua(lua_State* lua)
 {
-    clear_history();
-    return 0;
+    // Runs the case folding primitives and their scalar versions on 'a' and
+    // 'b' with a limit and flags. Returns prefix, prefix_scalar, compare,
+    // compare_scalar, lower(a) and lower_scalar(a).
+
+    const char* a;
+    const char* b;
+    char* lowered;
+    size_t length;
+    int limit;
+    int flags;
+
+    if (lua_gettop(lua) < 4 || !lua_isstring(lua, 1) || !lua_isstring(lua, 2))
+    {
+        return 0;
+    }
+
+    a = lua_tolstring(lua, 1, &length);
+    b = lua_tostring(lua, 2);
+    limit = lua_tointeger(lua, 3);
+    flags = lua_tointeger(lua, 4);
+
+    lua_pushinteger(lua, casefold_prefix(a, b, limit, flags));
+    lua_pushinteger(lua, casefold_prefix_scalar(a, b, limit, flags));
+    lua_pushinteger(lua, casefold_compare(a, b, limit, flags));
+    lua_pushinteger(lua, casefold_compare_scalar(a, b, limit, flags));
+
+    lowered = malloc(length + 1);
+    casefold_lower(lowered, a, (int)length, flags);
+    lua_pushlstring(lua, lowered, length);
+    casefold_lower_scalar(lowered, a, (int)length, flags);
+    lua_pushlstring(lua, lowered, length);
+    free(lowered);
+
+    return 6;
 }
 
 //------------------------------------------------------------------------------
-static int call_readline_lua(lua_State* lua)
+static int casefold_bench_lua(lua_State* lua)
 {
-    HANDLE handle;
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    wchar_t output[1024];
-    char utf8[sizeof_array(output)];
-    char* read;
+    // Times 'count' compares and lowerings of strings 'length' long that only
+    // differ in case. Returns nanoseconds per call for casefold_compare(), its
+    // scalar version, casefold_lower() and its scalar version.
+
+    char* a;
+    char* b;
+    char* out;
+    double started;
+    int length;
+    int count;
+    int sink;
     int i;
 
-    // Save the console's cursor position incase readline moves it.
-    handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    GetConsoleScreenBufferInfo(handle, &csbi);
-
-    // Check we've got at least one string argument.
-    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    if (lua_gettop(lua) < 2 || !lua_isnumber(lua, 1) || !lua_isnumber(lua, 2))
     {
         return 0;
     }
 
-    g_getc_automatic = lua_tostring(lua, 1);
+    length = lua_tointeger(lua, 1);
+    count = lua_tointeger(lua, 2);
 
-    // Call Readline.
-    g_alt_fwrite_hook = stdout_catch;
-    rl_completion_display_matches_hook = match_catch;
-    call_readline_w(L"", output, sizeof_array(output));
+    a = malloc(length + 1);
+    b = malloc(length + 1);
+    out = malloc(length + 1);
+    for (i = 0; i < length; ++i)
+    {
+        a[i] = "abcdEFGH-_xyz"[i % 13];
+        b[i] = "ABCDefgh-_XYZ"[i % 13];
+    }
+    a[length] = b[length] = '\0';
 
-    // Get output.
-    WideCharToMultiByte(CP_UTF8, 0, output, -1, utf8, sizeof(utf8), NULL, NULL);
-    lua_pushstring(lua, utf8);
+    sink = 0;
 
-    // Collect matches "displayed" by readline.
-    lua_createtable(lua, 0, 0);
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        sink += casefold_compare(a, b, length, CASEFOLD_CASE);
+    }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
 
-    i = 1;
-    read = g_caught_matches;
-    while (read && *read != '\0')
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
     {
-        lua_pushstring(lua, read);
-        lua_rawseti(lua, -2, i);
+        sink += casefold_compare_scalar(a, b, length, CASEFOLD_CASE);
+    }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
 
-        ++i;
-        read += strlen(read) + 1;
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        casefold_lower(out, a, length, CASEFOLD_MAP);
+        sink += out[0];
     }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
 
-    free(g_caught_matches);
-    g_caught_matches = NULL;
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        casefold_lower_scalar(out, a, length, CASEFOLD_MAP);
+        sink += out[0];
+    }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
 
-    SetConsoleCursorPosition(handle, csbi.dwCursorPosition);
+    free(out);
+    free(b);
+    free(a);
+
+    lua_pushinteger(lua, sink);
+    return 5;
+}
+
+//------------------------------------------------------------------------------
+static int width_ascii_lua(lua_State* lua)
+{
+    // Measures a string with width_ascii() and its scalar version, counting
+    // control characters as 'control_width' columns.
+
+    const char* str;
+    size_t length;
+    int control_width;
+
+    if (lua_gettop(lua) < 2 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    str = lua_tolstring(lua, 1, &length);
+    control_width = lua_tointeger(lua, 2);
+
+    lua_pushinteger(lua, width_ascii(str, (int)length, control_width));
+    lua_pushinteger(lua, width_ascii_scalar(str, (int)length, control_width));
     return 2;
 }
 
+//------------------------------------------------------------------------------
+static int width_bench_lua(lua_State* lua)
+{
+    // Times 'count' measurements of an ASCII string 'length' long. Returns
+    // nanoseconds per call for width_ascii() and its scalar version.
+
+    char* str;
+    double started;
+    int length;
+    int count;
+    int sink;
+    int i;
+
+    if (lua_gettop(lua) < 2 || !lua_isnumber(lua, 1) || !lua_isnumber(lua, 2))
+    {
+        return 0;
+    }
+
+    length = lua_tointeger(lua, 1);
+    count = lua_tointeger(lua, 2);
+
+    str = malloc(length + 1);
+    for (i = 0; i < length; ++i)
+    {
+        str[i] = "abc_DEF\\x.y-z 012"[i % 17];
+    }
+    str[length] = '\0';
+
+    sink = 0;
+
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        sink += width_ascii(str, length, 2);
+    }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
+
+    started = stats_clock();
+    for (i = 0; i < count; ++i)
+    {
+        sink += width_ascii_scalar(str, length, 2);
+    }
+    lua_pushnumber(lua, (stats_clock() - started) * 1000000.0 / count);
+
+    free(str);
+
+    lua_pushinteger(lua, sink);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+static int wcwidth_table_lua(lua_State* lua)
+{
+    // Checks the widths hooked_wcwidth() keeps in its table against asking
+    // Windows directly, for every character in the BMP. Each character is
+    // looked up twice so both the first look up and the kept width are
+    // checked. Returns the number of mismatches.
+
+    int mismatches;
+    int i;
+
+    mismatches = 0;
+    for (i = 1; i < 0x10000; ++i)
+    {
+        wchar_t wc;
+        int expected;
+
+        wc = (wchar_t)i;
+        expected = WideCharToMultiByte(CP_ACP, 0, &wc, 1, NULL, 0, NULL, NULL);
+        mismatches += (hooked_wcwidth(wc) != expected);
+        mismatches += (hooked_wcwidth(wc) != expected);
+    }
+
+    lua_pushinteger(lua, mismatches);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int fuzzy_prefilters_lua(lua_State* lua)
+{
+    // Runs the scalar and the dispatched (SIMD where there is it) prefilters
+    // over a table of candidates. Returns each one's verdicts as a string of
+    // 1s and 0s, and whether SIMD was used.
+
+    str_builder_t scalar;
+    str_builder_t simd;
+    fuzzy_t fuzzy;
+    int count;
+    int i;
+
+    if (lua_gettop(lua) < 2 || !lua_isstring(lua, 1) || !lua_istable(lua, 2))
+    {
+        return 0;
+    }
+
+    fuzzy_init(&fuzzy);
+    fuzzy_set_needle(&fuzzy, lua_tostring(lua, 1));
+    str_builder_init(&scalar);
+    str_builder_init(&simd);
+
+    count = (int)lua_rawlen(lua, 2);
+    for (i = 1; i <= count; ++i)
+    {
+        const char* candidate;
+        size_t length;
+
+        lua_rawgeti(lua, 2, i);
+        candidate = lua_tolstring(lua, -1, &length);
+        str_builder_append(&scalar, fuzzy_prefilter_scalar(&fuzzy, candidate,
+            (int)length) ? "1" : "0");
+        str_builder_append(&simd, fuzzy_prefilter(&fuzzy, candidate,
+            (int)length) ? "1" : "0");
+        lua_pop(lua, 1);
+    }
+
+    lua_pushstring(lua, scalar.data);
+    lua_pushstring(lua, simd.data);
+    lua_pushboolean(lua, fuzzy_has_simd());
+
+    str_builder_free(&simd);
+    str_builder_free(&scalar);
+    fuzzy_free(&fuzzy);
+    return 3;
+}
+
+//------------------------------------------------------------------------------
+static double time_fuzzy(lua_State* lua, int paths, int count, fuzzy_t* fuzzy,
+    int mode, int* matched)
+{
+    double started;
+    int score;
+    int i;
+
+    *matched = 0;
+    started = stats_clock();
+    for (i = 1; i <= count; ++i)
+    {
+        const char* candidate;
+        size_t length;
+        int ok;
+
+        lua_rawgeti(lua, paths, i);
+        candidate = lua_tolstring(lua, -1, &length);
+        switch (mode)
+        {
+        case 0:     ok = fuzzy_prefilter_scalar(fuzzy, candidate, (int)length); break;
+        case 1:     ok = fuzzy_prefilter(fuzzy, candidate, (int)length);        break;
+        default:    ok = fuzzy_score(fuzzy, candidate, (int)length, &score);    break;
+        }
+
+        *matched += !!ok;
+        lua_pop(lua, 1);
+    }
+
+    return stats_clock() - started;
+}
+
+//------------------------------------------------------------------------------
+static int fuzzy_bench_lua(lua_State* lua)
+{
+    // Times the fuzzy matcher over 'count' made up paths for 'needle'. Returns
+    // milliseconds for the scalar prefilter, the dispatched prefilter, scoring
+    // and clink.fuzzy_rank(), and how many paths matched.
+
+    static const char* parts[] = {
+        "src", "include", "clink", "readline", "lua", "test", "docs", "build",
+        "Release", "Debug", "shared", "dll", "loader", "objects", "CMakeFiles",
+    };
+
+    str_builder_t path;
+    fuzzy_t fuzzy;
+    const char* needle;
+    double started;
+    int matched;
+    int count;
+    int paths;
+    int i;
+
+    if (lua_gettop(lua) < 2 || !lua_isnumber(lua, 1) || !lua_isstring(lua, 2))
+    {
+        return 0;
+    }
+
+    count = lua_tointeger(lua, 1);
+    needle = lua_tostring(lua, 2);
+
+    srand(7);
+    str_builder_init(&path);
+    lua_createtable(lua, count, 0);
+    paths = lua_gettop(lua);
+    for (i = 1; i <= count; ++i)
+    {
+        char file[32];
+        int depth;
+        int j;
+
+        str_builder_clear(&path);
+        depth = 2 + rand() % 5;
+        for (j = 0; j < depth; ++j)
+        {
+            str_builder_append(&path, parts[rand() % sizeof_array(parts)]);
+            str_builder_append(&path, "\\");
+        }
+
+        sprintf(file, "file_%d.%s", rand() % 1000, (rand() & 1) ? "c" : "h");
+        str_builder_append(&path, file);
+
+        lua_pushstring(lua, path.data);
+        lua_rawseti(lua, paths, i);
+    }
+    str_builder_free(&path);
+
+    fuzzy_init(&fuzzy);
+    fuzzy_set_needle(&fuzzy, needle);
+
+    lua_pushnumber(lua, time_fuzzy(lua, paths, count, &fuzzy, 0, &matched));
+    lua_pushnumber(lua, time_fuzzy(lua, paths, count, &fuzzy, 1, &matched));
+    lua_pushnumber(lua, time_fuzzy(lua, paths, count, &fuzzy, 2, &matched));
+
+    fuzzy_free(&fuzzy);
+
+    lua_getglobal(lua, "clink");
+    lua_getfield(lua, -1, "fuzzy_rank");
+    lua_remove(lua, -2);
+    lua_pushstring(lua, needle);
+    lua_pushvalue(lua, paths);
+    started = stats_clock();
+    lua_call(lua, 2, 0);
+    lua_pushnumber(lua, stats_clock() - started);
+
+    lua_pushinteger(lua, matched);
+    return 5;
+}
+
 //------------------------------------------------------------------------------
 int get_cwd(lua_State* lua)
 {
@@ -191,6 +1695,28 @@ int mk_dir(lua_State* lua)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+static int set_env_lua(lua_State* lua)
+{
+    // Sets (or clears if there's no value) an environment variable as cmd.exe
+    // would; through the hook that invalidates the environment's name index.
+
+    const char* name;
+    const char* value;
+
+    if (lua_gettop(lua) == 0 || !lua_isstring(lua, 1))
+    {
+        return 0;
+    }
+
+    name = lua_tostring(lua, 1);
+    value = lua_isstring(lua, 2) ? lua_tostring(lua, 2) : NULL;
+
+    SetEnvironmentVariable(name, value);
+    invalidate_env_names();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 int rm_dir(lua_State* lua)
 {
@@ -227,6 +1753,7 @@ int main(int argc, char** argv)
     lua_State* lua;
     int no_colour;
     int verbose;
+    int bench;
     int arg;
 
     struct option options[] = {
@@ -234,6 +1761,7 @@ int main(int argc, char** argv)
         { "verbose",    no_argument,        NULL, 'v' },
         { "nocolour",   no_argument,        NULL, 'n' },
         { "test",       required_argument,  NULL, 't' },
+        { "bench",      no_argument,        NULL, 'b' },
         { NULL,         0,                  NULL, 0 }
     };
 
@@ -241,10 +1769,11 @@ int main(int argc, char** argv)
     specific_test = "";
     no_colour = 0;
     verbose = 0;
+    bench = 0;
     scripts_path = NULL;
     if (argc > 1)
     {
-        while ((arg = getopt_long(argc, argv, "+svnt", options, NULL)) != -1)
+        while ((arg = getopt_long(argc, argv, "+svntb", options, NULL)) != -1)
         {
             switch (arg)
             {
@@ -264,6 +1793,10 @@ int main(int argc, char** argv)
                     specific_test = optarg;
                     break;
 
+                case 'b':
+                    bench = 1;
+                    break;
+
                 default:
                     return 0;
             }
@@ -276,10 +1809,11 @@ int main(int argc, char** argv)
         extern const char* g_clink_header;
 
         puts(g_clink_header);
-        puts("Usage: --scripts=<scripts_path> [--test=X[.Y]] [--verbose]");
+        puts("Usage: --scripts=<scripts_path> [--test=X[.Y]] [--verbose] [--bench]");
         puts("");
         puts("  scripts : path to the Lua test scripts");
         puts("     test : run group or individual test (e.g. --test=5.4)");
+        puts("    bench : also run the (slow) benchmarks");
         return 0;
     }
 
@@ -290,6 +1824,7 @@ int main(int argc, char** argv)
     }
 
     set_config_dir_override("c:\\");
+    str_builder_init(&g_caught_output);
 
     prepare_env_for_inputrc();
     rl_readline_name = "cmd.exe";
@@ -298,12 +1833,36 @@ int main(int argc, char** argv)
     lua = initialise_lua();
     {
         struct luaL_Reg native_methods[] = {
-            { "call_readline", call_readline_lua },
-            { "ch_dir",        ch_dir },
-            { "clear_history", clear_history_lua },
-            { "get_cwd",       get_cwd },
-            { "mk_dir",        mk_dir },
-            { "rm_dir",        rm_dir },
+            { "alias_table",      alias_table_lua },
+            { "ansi_spans",       ansi_spans_lua },
+            { "call_readline",    call_readline_lua },
+            { "casefold",         casefold_lua },
+            { "casefold_bench",   casefold_bench_lua },
+            { "ch_dir",           ch_dir },
+            { "clear_history",    clear_history_lua },
+            { "columns_layout",   columns_layout_lua },
+            { "filter_prompt",    filter_prompt_lua },
+            { "funmap_bench",     funmap_bench_lua },
+            { "fuzzy_bench",      fuzzy_bench_lua },
+            { "fuzzy_prefilters", fuzzy_prefilters_lua },
+            { "fwrite_batch",     fwrite_batch_lua },
+            { "fwrite_output",    fwrite_output_lua },
+            { "get_cwd",          get_cwd },
+            { "get_fwrite_stats", get_fwrite_stats_lua },
+            { "history_db",       history_db_lua },
+            { "history_db_bench", history_db_bench_lua },
+            { "history_rank",     history_rank_lua },
+            { "history_share",    history_share_lua },
+            { "history_stress",   history_stress_lua },
+            { "inputrc_snapshot", inputrc_snapshot_lua },
+            { "mk_dir",           mk_dir },
+            { "redisplay_cache",  redisplay_cache_lua },
+            { "rm_dir",           rm_dir },
+            { "set_env",          set_env_lua },
+            { "str_builder",      str_builder_lua },
+            { "wcwidth_table",    wcwidth_table_lua },
+            { "width_ascii",      width_ascii_lua },
+            { "width_bench",      width_bench_lua },
             { NULL, NULL }
         };
 
@@ -317,6 +1876,9 @@ int main(int argc, char** argv)
     lua_pushinteger(lua, no_colour);
     lua_setglobal(lua, "no_colour");
 
+    lua_pushinteger(lua, bench);
+    lua_setglobal(lua, "bench");
+
     lua_pushstring(lua, specific_test);
     lua_setglobal(lua, "specific_test");
 
@@ -133,25 +133,31 @@ local function call_readline_outer(input, flattened)
 end
 
 --------------------------------------------------------------------------------
-local function test_runner(name, input, expected_out, expected_matches)
+local function skip_test()
     test_id = test_id + 1
 
-    -- Skip test?
-    if specific_test ~= "" then
-        local should_run = false
-        local tid = tostring(test_sid)
-        if specific_test == tid then
-            should_run = true
-        end
+    if specific_test == "" then
+        return false
+    end
 
-        tid = tid.."."..tostring(test_id)
-        if specific_test == tid then
-            should_run = true
-        end
+    local tid = tostring(test_sid)
+    if specific_test == tid then
+        return false
+    end
 
-        if not should_run then
-            return
-        end
+    tid = tid.."."..tostring(test_id)
+    if specific_test == tid then
+        return false
+    end
+
+    return true
+end
+
+--------------------------------------------------------------------------------
+local function test_runner(name, input, expected_out, expected_matches)
+    -- Skip test?
+    if skip_test() then
+        return
     end
 
     clear_history()
@@ -160,7 +166,9 @@ local function test_runner(name, input, expected_out, expected_matches)
     local output, matches, input = call_readline_outer(input)
 
     -- Check Readline's output.
-    if expected_out and expected_out ~= output then
+    if type(expected_out) == "function" then
+        passed = expected_out(output) and true or false
+    elseif expected_out and expected_out ~= output then
         passed = false
     end
 
@@ -202,7 +210,11 @@ local function test_runner(name, input, expected_out, expected_matches)
         end
 
         print(colour(5).."\n    -- Expected --")
-        print(colour(5).."       Output: "..(expected_out or "<no_test>").."_")
+        local expected_str = expected_out or "<no_test>"
+        if type(expected_out) == "function" then
+            expected_str = "<function>"
+        end
+        print(colour(5).."       Output: "..expected_str.."_")
         for _, i in ipairs(expected_matches or {}) do
             print(colour(5).."      Matches: "..i)
         end
@@ -212,6 +224,25 @@ local function test_runner(name, input, expected_out, expected_matches)
     end
 end
 
+--------------------------------------------------------------------------------
+local function value_test_runner(name, value, expected)
+    if skip_test() then
+        return
+    end
+
+    local passed = (value == expected)
+    print_result(name, passed)
+
+    if not passed or verbose ~= 0 then
+        print(colour(5).."\n    -- Results --")
+        print(colour(5).."        Value: "..tostring(value).."_")
+        print(colour(5).."\n    -- Expected --")
+        print(colour(5).."        Value: "..tostring(expected).."_")
+        print("")
+        error("Test failed...")
+    end
+end
+
 --------------------------------------------------------------------------------
 function clink.test.test_fs(fs_table, secret)
     local path = test_fs_path..os.tmpname()
@@ -236,6 +267,14 @@ function clink.test.test_output(name, input, expected)
     pcall_test_runner(name, input, expected, nil)
 end
 
+--------------------------------------------------------------------------------
+function clink.test.test_value(name, value, expected)
+    local ok = pcall(value_test_runner, name, value, expected)
+    if not ok then
+        all_passed = false
+    end
+end
+
 --------------------------------------------------------------------------------
 function clink.test.test_matches(name, input, expected)
     if not expected then
@@ -304,6 +343,25 @@ function clink.test.run()
     run_test("test_args")
     run_test("test_merge")
     run_test("test_history")
+    run_test("test_fwrite")
+    run_test("test_redisplay")
+    run_test("test_ansi")
+    run_test("test_paste")
+    run_test("test_prompt")
+    run_test("test_str_builder")
+    run_test("test_aliases")
+    run_test("test_tokens")
+    run_test("test_stats")
+    run_test("test_history_db")
+    run_test("test_history_share")
+    run_test("test_history_rank")
+    run_test("test_fuzzy")
+    run_test("test_casefold")
+    run_test("test_width")
+    run_test("test_columns")
+    run_test("test_records")
+    run_test("test_flatten")
+    run_test("test_inputrc")
 
     ch_dir(scripts_path)
     rm_dir(test_fs_path)
@@ -0,0 +1,83 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function aliases(buffer, op, arg)
+    return table.concat(alias_table(buffer, op, arg), "|")
+end
+
+local test_value = clink.test.test_value
+
+--------------------------------------------------------------------------------
+-- Buffers as GetConsoleAliasesW() returns them.
+local captured = {
+    "ls=dir $*\0gs=git status\0..=cd ..\0",
+    "LL=dir /w $*\0ll=dir /b\0",
+    "git-log=git log --oneline\0git_lg=git lg\0gd=git diff\0",
+    "set=set a=b\0x==\0",
+    "=nameless\0no_equals\0ok=1\0",
+    "caf\xc3\xa9=echo caf\xc3\xa9\0",
+    "",
+    "a=1\0\0b=2\0",
+    "a_b=underscore\0a-b=dash\0",
+}
+
+test_value("Parse", aliases(captured[1]), "..=cd ..|gs=git status|ls=dir $*")
+test_value("Empty text", aliases("e=\0"), "e=")
+test_value("Equals in text", aliases(captured[4]), "set=set a=b|x==")
+test_value("Malformed", aliases(captured[5]), "ok=1")
+test_value("Unicode", aliases(captured[6]), "caf\xc3\xa9=echo caf\xc3\xa9")
+test_value("Nothing", aliases(captured[7]), "")
+test_value("Terminated", aliases(captured[8]), "a=1")
+test_value("Dashes", aliases(captured[3]),
+    "gd=git diff|git_lg=git lg|git-log=git log --oneline")
+
+--------------------------------------------------------------------------------
+test_value("Find", aliases(captured[1], "find", "gs"), "gs=git status")
+test_value("Find case", aliases(captured[1], "find", "GS"), "gs=git status")
+test_value("Find missing", aliases(captured[1], "find", "g"), "")
+test_value("Find longer", aliases(captured[1], "find", "gss"), "")
+test_value("Find unicode", aliases(captured[6], "find", "caf\xc3\xa9"),
+    "caf\xc3\xa9=echo caf\xc3\xa9")
+
+--------------------------------------------------------------------------------
+test_value("Prefix", aliases(captured[1], "prefix", "g"), "gs=git status")
+test_value("Prefix case", aliases(captured[2], "prefix", "L"),
+    "LL=dir /w $*|ll=dir /b")
+test_value("Prefix all", aliases(captured[1], "prefix", ""),
+    "..=cd ..|gs=git status|ls=dir $*")
+test_value("Prefix none", aliases(captured[1], "prefix", "z"), "")
+test_value("Prefix exact", aliases(captured[1], "prefix", "ls"), "ls=dir $*")
+test_value("Prefix too long", aliases(captured[1], "prefix", "lsx"), "")
+test_value("Prefix dash", aliases(captured[3], "prefix", "git-"),
+    "git_lg=git lg|git-log=git log --oneline")
+test_value("Find dash", aliases(captured[3], "find", "git-log"),
+    "git-log=git log --oneline")
+test_value("Find not dash", aliases(captured[3], "find", "git_log"), "")
+test_value("Find dash case", aliases(captured[9], "find", "A-B"), "a-b=dash")
+test_value("Find underscore", aliases(captured[9], "find", "a_B"),
+    "a_b=underscore")
+test_value("Prefix both", aliases(captured[9], "prefix", "a-"),
+    "a-b=dash|a_b=underscore")
+test_value("Prefix dot", aliases(captured[1], "prefix", "."), "..=cd ..")
+
+-- vim: expandtab
@@ -0,0 +1,84 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+-- Each case is (input, expected) where SGR codes are replaced by the console
+-- attributes they produce "<xx>" and other escape codes by "<>". Attributes
+-- start as 0x07.
+local corpus = {
+    -- Plain text and basic SGR.
+    { "plain text",                         "plain text" },
+    { "a\x1b[31mred\x1b[0m",                "a<04>red<07>" },
+    { "\x1b[1;32;44mx",                     "<1a>x" },
+    { "\x1b[1m\x1b[22m",                    "<0f><07>" },
+    { "\x1b[4m\x1b[24m",                    "<87><07>" },
+    { "\x1b[m",                             "<07>" },
+    { "\x1b[;1m",                           "<0f>" },
+    { "\x1b[33;41m\x1b[39m\x1b[49m",        "<46><47><07>" },
+    { "\x1b[91;103m",                       "<ec>" },
+    { "\x1b[123m",                          "<07>" },
+
+    -- 256-colour.
+    { "\x1b[38;5;1m",                       "<04>" },
+    { "\x1b[38;5;9m",                       "<0c>" },
+    { "\x1b[38;5;21m",                      "<09>" },
+    { "\x1b[38;5;196m",                     "<0c>" },
+    { "\x1b[38;5;244m",                     "<08>" },
+    { "\x1b[38;5;255m",                     "<0f>" },
+    { "\x1b[48;5;2m",                       "<27>" },
+    { "\x1b[38;5;2;1m",                     "<0a>" },
+
+    -- Truecolour.
+    { "\x1b[38;2;250;10;10m",               "<0c>" },
+    { "\x1b[38;2;0;0;100m",                 "<01>" },
+    { "\x1b[48;2;0;0;255m",                 "<97>" },
+    { "\x1b[38;2;0;200;0;44m",              "<1a>" },
+
+    -- Other sequences.
+    { "\x1b[?25hx",                         "<>x" },
+    { "\x1b[2Jx",                           "<>x" },
+    { "\x1b]0;title\x07x",                  "<>x" },
+    { "\x1b]0;title\x1b\\x",                "<>x" },
+    { "\x1bPdata\x1b\\x",                   "<>x" },
+    { "\xc2\x9b31mx",                       "<04>x" },
+
+    -- Things that aren't escape sequences.
+    { "\x1bx",                              "\x1bx" },
+    { "\x1b\x1b[31m",                       "\x1b<04>" },
+    { "\x1b[31",                            "\x1b[31" },
+    { "\xe2\x80\x9b31m",                    "\xe2\x80\x9b31m" },
+    { "\x1b[3\x011m",                       "\x1b[3\x011m" },
+    { "\x1b[3\x1b[32m",                     "\x1b[3<02>" },
+}
+
+for i, case in ipairs(corpus) do
+    clink.test.test_value("ANSI "..i, ansi_spans(case[1]), case[2])
+end
+
+--------------------------------------------------------------------------------
+clink.test.test_value(
+    "ANSI defaults",
+    ansi_spans("\x1b[31m\x1b[0m", 0x1e),
+    "<1c><1e>"
+)
+
+-- vim: expandtab
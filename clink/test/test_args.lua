@@ -222,6 +222,23 @@ clink.test.test_matches(
     { "two", "three" }
 )
 
+clink.test.test_matches(
+    "Escaped separator",
+    "nullcmd ^& argcmd "
+)
+
+clink.test.test_matches(
+    "Redirect to handle",
+    "argcmd 2>&1 t",
+    { "two", "three" }
+)
+
+clink.test.test_matches(
+    "Redirect first",
+    "> nul argcmd t",
+    { "two", "three" }
+)
+
 clink.test.test_output(
     "Not separator",
     "argcmd three four \"  &&foobar\" f",
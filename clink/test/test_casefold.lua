@@ -0,0 +1,85 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+test_value("is_prefix", clink.is_prefix("Foo", "foobar"), true)
+test_value("is_prefix empty", clink.is_prefix("", "foo"), true)
+test_value("is_prefix longer", clink.is_prefix("foobar", "foo"), false)
+test_value("is_prefix mismatch", clink.is_prefix("fob", "foobar"), false)
+test_value("is_prefix long", clink.is_prefix(
+    "C:\\Program Files\\Common Files\\Microsoft",
+    "c:\\program files\\common files\\microsoft shared"), true)
+test_value("lower", clink.lower("ABC def GHIJKLMNOPQRSTUVWXYZ 0123"),
+    "abc def ghijklmnopqrstuvwxyz 0123")
+
+--------------------------------------------------------------------------------
+-- The SIMD primitives have to agree with the scalar ones. Strings differ in
+-- case and sometimes in a character, run across a few 16 byte blocks and have
+-- the odd byte with the high bit set which forces the scalar fallback.
+math.randomseed(1)
+local alphabet = "aAbB-_zZ09\\.~\xe9"
+local function make_string(length)
+    local chars = {}
+    for i = 1, length do
+        local k = math.random(1, #alphabet)
+        table.insert(chars, alphabet:sub(k, k))
+    end
+    return table.concat(chars)
+end
+
+local function sign(x)
+    return (x > 0 and 1) or (x < 0 and -1) or 0
+end
+
+local failures = 0
+for i = 1, 4000 do
+    local a = make_string(math.random(0, 70))
+    local b = a:upper()
+    if #b > 0 and math.random(1, 2) == 1 then
+        local k = math.random(1, #b)
+        b = b:sub(1, k - 1)..make_string(1)..b:sub(k + 1)
+    end
+    if math.random(1, 4) == 1 then
+        b = b:sub(1, math.random(0, #b))
+    end
+
+    local limit = math.random(0, 80)
+    local flags = math.random(1, 3)
+    local prefix, prefix_s, compare, compare_s, lower, lower_s =
+        casefold(a, b, limit, flags)
+
+    if prefix ~= prefix_s or sign(compare) ~= sign(compare_s) or lower ~= lower_s then
+        failures = failures + 1
+    end
+end
+test_value("SIMD agrees with scalar", failures, 0)
+
+--------------------------------------------------------------------------------
+if bench ~= 0 then
+    for _, length in ipairs({ 8, 24, 120 }) do
+        local compare, compare_s, lower, lower_s = casefold_bench(length, 100000)
+        print(string.format(
+            "    %d bytes; compare %.0fns (scalar %.0fns), lower %.0fns (scalar %.0fns)",
+            length, compare, compare_s, lower, lower_s
+        ))
+    end
+end
@@ -0,0 +1,119 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+-- Rows when every column is as wide as the widest item, as Readline used to.
+local function fixed_rows(widths, screen_width)
+    local longest = 0
+    for _, width in ipairs(widths) do
+        longest = math.max(longest, width)
+    end
+
+    local columns = math.floor(screen_width / (longest + 2))
+    if columns ~= 1 and columns * (longest + 2) == screen_width then
+        columns = columns - 1
+    end
+    columns = math.max(columns, 1)
+
+    return math.ceil(#widths / columns)
+end
+
+--------------------------------------------------------------------------------
+-- Checks a layout holds every item in a column at least as wide as it and
+-- that rows fit on the screen.
+local function check_layout(widths, screen_width, horizontal)
+    local rows, columns, column_widths = columns_layout(widths, screen_width, horizontal)
+    if #widths == 0 then
+        return rows == 0
+    end
+
+    if rows * columns < #widths or #column_widths ~= columns then
+        return false
+    end
+
+    local total = 0
+    for j = 1, columns do
+        total = total + column_widths[j] + 2
+    end
+    if columns > 1 and total >= screen_width then
+        return false
+    end
+
+    for i = 1, #widths do
+        local j
+        if horizontal then
+            j = ((i - 1) % columns) + 1
+        else
+            j = math.floor((i - 1) / rows) + 1
+        end
+        if column_widths[j] == nil or widths[i] > column_widths[j] then
+            return false
+        end
+    end
+
+    return rows <= fixed_rows(widths, screen_width)
+end
+
+--------------------------------------------------------------------------------
+test_value("Layout empty", columns_layout({}, 80, false), 0)
+test_value("Layout one", columns_layout({ 10 }, 80, false), 1)
+test_value("Layout too wide", columns_layout({ 100, 5, 5 }, 80, false), 3)
+test_value("Layout one row", columns_layout({ 5, 5, 5 }, 80, true), 1)
+test_value("Layout fits", columns_layout({ 37, 37 }, 80, false), 1)
+test_value("Layout would wrap", columns_layout({ 38, 38 }, 80, false), 2)
+test_value("Layout long one", columns_layout({ 70, 4, 4, 4, 4, 4, 4, 4, 4, 4 }, 80, false), 5)
+
+--------------------------------------------------------------------------------
+-- Synthetic listings; uniform names, names with one long outlier, and a long
+-- tailed spread like real directories have. Each layout has to be valid and
+-- never need more rows than equal width columns.
+math.randomseed(1)
+local distributions = {
+    uniform = function() return math.random(4, 12) end,
+    outlier = function() return (math.random(1, 500) == 1) and 70 or math.random(3, 10) end,
+    tailed  = function() return math.floor(4 + 40 * math.random() ^ 6) end,
+    equal   = function() return 12 end,
+}
+
+for name, distribution in pairs(distributions) do
+    local valid = true
+    local rows, rows_fixed = 0, 0
+    for _, count in ipairs({ 1, 7, 50, 500, 3000 }) do
+        for _, screen_width in ipairs({ 40, 80, 120 }) do
+            for _, horizontal in ipairs({ false, true }) do
+                local widths = {}
+                for i = 1, count do
+                    table.insert(widths, distribution())
+                end
+
+                valid = valid and check_layout(widths, screen_width, horizontal)
+                rows = rows + columns_layout(widths, screen_width, horizontal)
+                rows_fixed = rows_fixed + fixed_rows(widths, screen_width)
+            end
+        end
+    end
+
+    test_value("Layout "..name, valid, true)
+    if verbose ~= 0 then
+        print(string.format("    %s; %d rows (equal width columns %d)", name, rows, rows_fixed))
+    end
+end
@@ -66,4 +66,32 @@ for _, i in ipairs({"cd", "rd", "rmdir", "md", "mkdir", "pushd"}) do
     )
 end
 
+--------------------------------------------------------------------------------
+local function join(list)
+    local out = {}
+    for _, i in ipairs(list) do
+        table.insert(out, i)
+    end
+
+    return table.concat(out, "|")
+end
+
+for _, i in ipairs({"find_files", "find_dirs"}) do
+    local find = clink[i]
+    local plain = find("*", false)
+    local packed = find("*", false, true)
+
+    clink.test.test_value("Packed type: "..i, type(packed), "userdata")
+    clink.test.test_value("Packed length: "..i, #packed, #plain)
+    clink.test.test_value("Packed ipairs: "..i, join(packed), join(plain))
+    clink.test.test_value("Packed index: "..i, packed[#plain], plain[#plain])
+    clink.test.test_value("Packed out of range: "..i, packed[#plain + 1], nil)
+    clink.test.test_value("Packed non-integer: "..i, packed.name, nil)
+    clink.test.test_value("Packed read-only: "..i, pcall(function()
+        packed[1] = "x"
+    end), false)
+end
+
+clink.test.test_value("Packed empty", #clink.find_files("no_such_*", false, true), 0)
+
 -- vim: expandtab
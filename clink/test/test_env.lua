@@ -21,13 +21,15 @@
 --
 
 --------------------------------------------------------------------------------
-function clink.get_env_var_names()
-    return {
-        "simple",
-        "case_map",
-        "dash-1",
-        "dash_2",
-    }
+local env_vars = {
+    "simple",
+    "case_map",
+    "dash-1",
+    "dash_2",
+}
+
+for _, name in ipairs(env_vars) do
+    set_env(name, "x")
 end
 
 clink.test.test_output(
@@ -77,4 +79,28 @@ clink.test.test_matches(
     "nullcmd %null_env_var%"
 )
 
+clink.test.test_output(
+    "Upper case",
+    "nullcmd %SIMP",
+    "nullcmd %simple%"
+)
+
+set_env("simple_2", "x")
+clink.test.test_matches(
+    "Index updated",
+    "nullcmd %simp",
+    { "%simple%", "%simple_2%" }
+)
+
+set_env("simple_2")
+clink.test.test_output(
+    "Index updated again",
+    "nullcmd %simp",
+    "nullcmd %simple%"
+)
+
+for _, name in ipairs(env_vars) do
+    set_env(name)
+end
+
 -- vim: expandtab
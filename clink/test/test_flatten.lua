@@ -0,0 +1,161 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+local calls = 0
+local function counted(word)
+    calls = calls + 1
+    return { "fn"..calls }
+end
+
+local function flat(parser, index, thunk)
+    local ret = parser:flatten_argument(index, thunk)
+    if type(ret) ~= "table" then
+        return ret
+    end
+
+    return table.concat(ret, " ")
+end
+
+local function thunk(func)
+    return func("")
+end
+
+--------------------------------------------------------------------------------
+local p = clink.arg.new_parser()
+p:set_arguments(
+    { "one", "two" .. clink.arg.new_parser(), 3 },
+    { "a", counted, "b" },
+    { function() return false end }
+)
+p:set_flags("-x", "-y")
+
+test_value("Static", flat(p, 1), "one two 3")
+test_value("Static copied", p:flatten_argument(1) ~= p:flatten_argument(1), true)
+table.insert(p:flatten_argument(1), "extra")
+test_value("Static unshared", flat(p, 1), "one two 3")
+test_value("Dynamic", flat(p, 2, thunk), "a fn1 b")
+test_value("Dynamic called again", flat(p, 2, thunk), "a fn2 b")
+test_value("Dynamic file matching", flat(p, 3, thunk), true)
+p:disable_file_matching()
+test_value("Dynamic no file matching", flat(p, 3, thunk), false)
+test_value("Out of range", flat(p, 4), false)
+test_value("Flags", flat(p), "-x -y")
+
+-- Modifying the parser drops what was cached.
+p:add_flags("-z")
+test_value("Add flags", flat(p), "-x -y -z")
+p:set_flags("-w")
+test_value("Set flags", flat(p), "-w")
+p:add_arguments({ "four" })
+test_value("Add arguments", flat(p, 4), "four")
+p:set_arguments({ "five" })
+test_value("Set arguments", flat(p, 1), "five")
+test_value("Set arguments range", flat(p, 2), false)
+
+--------------------------------------------------------------------------------
+clink.arg.register_parser("flatcmd", clink.arg.new_parser({ "alpha", "beta" }))
+local q = clink.arg.get_parser("flatcmd")
+test_value("Merge before", flat(q, 1), "alpha beta")
+clink.arg.register_parser("flatcmd", clink.arg.new_parser({ "gamma" }))
+test_value("Merge after", flat(q, 1), "alpha beta gamma")
+table.insert(q:go({ "" }), "delta")
+test_value("Go unshared", table.concat(q:go({ "" }), " "), "alpha beta gamma")
+clink.test.test_matches("Merge matches", "flatcmd ", { "alpha", "beta", "gamma" })
+
+--------------------------------------------------------------------------------
+-- Flattens every argument of every parser reachable from the git, go, and p4
+-- parsers. Functions aren't called; they may run external commands.
+local function collect(parser, out, seen)
+    if seen[parser] then
+        return
+    end
+
+    seen[parser] = true
+    table.insert(out, parser)
+
+    local slots = { parser.flags }
+    for _, arg_opts in ipairs(parser.arguments) do
+        table.insert(slots, arg_opts)
+    end
+
+    for _, arg_opts in ipairs(slots) do
+        for _, arg_opt in ipairs(arg_opts) do
+            if type(arg_opt) == "table" and arg_opt.parser then
+                collect(arg_opt.parser, out, seen)
+            end
+        end
+    end
+end
+
+local function no_call(func)
+    return {}
+end
+
+local function flatten_all(all)
+    local count = 0
+    for _, parser in ipairs(all) do
+        for i = 0, #parser.arguments do
+            local ret = parser:flatten_argument((i > 0) and i or nil, no_call)
+            if type(ret) == "table" then
+                count = count + #ret
+            end
+        end
+    end
+
+    return count
+end
+
+for _, cmd in ipairs({ "git", "go", "p4" }) do
+    local all = {}
+    collect(clink.arg.get_parser(cmd), all, {})
+
+    local cold, warm = 0, 0
+    local cold_count, warm_count
+    local iterations = 200
+    for i = 1, iterations do
+        for _, parser in ipairs(all) do
+            parser.flattened = {}
+        end
+
+        local started = clink.stats_clock()
+        cold_count = flatten_all(all)
+        cold = cold + clink.stats_clock() - started
+
+        started = clink.stats_clock()
+        warm_count = flatten_all(all)
+        warm = warm + clink.stats_clock() - started
+    end
+
+    test_value("Cached "..cmd, warm_count, cold_count)
+    if verbose ~= 0 then
+        print(string.format(
+            "    %s; %d parsers, %d options, %.1fus uncached, %.1fus cached",
+            cmd, #all, warm_count, 1000 * cold / iterations,
+            1000 * warm / iterations
+        ))
+    end
+end
+
+-- vim: expandtab
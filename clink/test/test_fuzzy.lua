@@ -0,0 +1,126 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function rank(needle, candidates, keep)
+    return table.concat(clink.fuzzy_rank(needle, candidates, keep), " ")
+end
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+test_value("Score no match", clink.fuzzy_score("xyz", "abc"), nil)
+test_value("Score out of order", clink.fuzzy_score("ba", "abc"), nil)
+test_value("Score empty", clink.fuzzy_score("", "abc"), 0)
+test_value("Score case", clink.fuzzy_score("ABC", "abc"), clink.fuzzy_score("abc", "ABC"))
+test_value("Score non-ASCII", clink.fuzzy_score("\xe9t", "abcdefghijklmnop\xe9t") ~= nil, true)
+test_value("Score non-ASCII start", clink.fuzzy_score("\xe9t", "\xe9abcdefghijklmnopt") ~= nil, true)
+test_value("Score non-ASCII missing", clink.fuzzy_score("\xe9t", "abcdefghijklmnop\xe9"), nil)
+test_value("Score slashes", clink.fuzzy_score("a/b", "a\\b"), clink.fuzzy_score("a\\b", "a\\b"))
+
+local words = { "afxbx", "foobar", "fb", "nothing", "foo_bar", "fooBar" }
+test_value("Rank", rank("fb", words), "fb foo_bar fooBar foobar afxbx")
+test_value("Rank keep", rank("fb", words, true), "fb foo_bar fooBar foobar afxbx nothing")
+test_value("Rank consecutive", rank("dll", { "d_l_l", "xdll", "dll_x" }), "dll_x d_l_l xdll")
+test_value("Rank duplicates", rank("ab", { "ab", "a_b", "ab" }), "ab ab a_b")
+test_value("Rank empty", rank("", { "b", "a" }), "a b")
+
+--------------------------------------------------------------------------------
+-- The SIMD prefilter has to agree with the scalar one. Candidates are long
+-- enough to cross a few 16 byte blocks and use characters that fold, and
+-- some that are outside ASCII.
+math.randomseed(1)
+local alphabet = "aAbB/\\c.Cx_ \xe9\xc9"
+local candidates = {}
+for i = 1, 4000 do
+    local candidate = {}
+    for j = 1, math.random(0, 70) do
+        local k = math.random(1, #alphabet)
+        table.insert(candidate, alphabet:sub(k, k))
+    end
+    table.insert(candidates, table.concat(candidate))
+end
+
+for _, needle in ipairs({ "", "a", "ab", "B/c", "xx_", "c.c.c.c", "abcabcabc", "\xe9", "a\xe9b", "\xc9\xc9" }) do
+    local scalar, simd = fuzzy_prefilters(needle, candidates)
+    test_value("Prefilter \""..needle.."\"", simd, scalar)
+end
+
+--------------------------------------------------------------------------------
+if bench ~= 0 then
+    local scalar, simd, score, ranked, matched = fuzzy_bench(100000, "rlc")
+    test_value("Bench matched", matched > 0, true)
+    print(string.format(
+        "    100k paths; prefilter %.1fms (scalar %.1fms), score %.1fms, rank %.1fms",
+        simd, scalar, score, ranked
+    ))
+end
+
+--------------------------------------------------------------------------------
+-- Completion with the 'match_fuzzy' setting on.
+local old_getter = clink.get_setting_int
+function clink.get_setting_int(name)
+    if name == "match_fuzzy" then
+        return 1
+    end
+
+    return old_getter(name)
+end
+
+local old_names = clink.get_env_var_names
+function clink.get_env_var_names()
+    return {
+        "simple",
+        "sample_var",
+        "dash-1",
+        "other",
+    }
+end
+
+clink.test.test_matches(
+    "Fuzzy matches",
+    "set smp",
+    { "simple", "sample_var" }
+)
+
+clink.test.test_output(
+    "Fuzzy single",
+    "set dh1",
+    "set dash-1"
+)
+
+clink.test.test_output(
+    "Fuzzy keeps text",
+    "set smp",
+    "set smp"
+)
+
+clink.test.test_output(
+    "Fuzzy prefix lcd",
+    "set s",
+    "set s"
+)
+
+clink.get_setting_int = old_getter
+clink.get_env_var_names = old_names
+
+-- vim: expandtab
@@ -0,0 +1,55 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+local long_line = string.rep("0123456789", 250)
+
+--------------------------------------------------------------------------------
+clink.test.test_output(
+    "Long write",
+    { long_line, "!!" },
+    function(output)
+        -- History expansion echoes the expanded line in one write.
+        local _, _, longest = get_fwrite_stats()
+        return longest > #long_line
+    end
+)
+
+--------------------------------------------------------------------------------
+-- Writes are gathered until a flush, which writes them out in one go. Flushing
+-- with nothing gathered writes nothing.
+local calls, flushes, longest, output = fwrite_batch("abc|de||f|")
+test_value("Batched writes", calls, 6)
+test_value("Batched flushes", flushes, 3)
+test_value("Batched longest", longest, 3)
+test_value("Batched output", output, "abcdef")
+
+calls, flushes, longest = fwrite_batch(string.rep("x", 5000).."|y")
+test_value("Batched growth", flushes, 1)
+test_value("Batched growth longest", longest, 5000)
+
+-- The 'y' left over from above goes out with the next flush.
+calls, flushes, longest, output = fwrite_batch("z|")
+test_value("Batched left over", output, "yz")
+
+-- vim: expandtab
@@ -0,0 +1,110 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function text(ops)
+    return (history_db(ops))
+end
+
+local function count(ops)
+    return select(2, history_db(ops))
+end
+
+local function results(ops)
+    return select(3, history_db(ops))
+end
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+local legacy = "#clink history 00000002 live\r\nls\r\n\r\n#1600000000\r\ndir /w\r\n"
+test_value("Import", text({ {"import", legacy} }), "ls\n#1600000000\ndir /w\n")
+test_value("Import count", count({ {"import", legacy} }), 2)
+test_value("Import not timestamp", text({ {"import", "#12ab\n"} }), "#12ab\n")
+
+local adds = {
+    {"add", "cd src", 100, "c:\\src"},
+    {"add", "make", 90, "C:\\SRC", -2},
+    {"add", "ls", 200, "d:\\"},
+    {"add", "nowhere", 201},
+}
+
+local function with(...)
+    local ops = {}
+    for _, op in ipairs(adds) do table.insert(ops, op) end
+    for _, op in ipairs({...}) do table.insert(ops, op) end
+    return ops
+end
+
+test_value("Add", text(adds), "#100\ncd src\n#90\nmake\n#200\nls\n#201\nnowhere\n")
+test_value("Reload", text(with({"reload"})), text(adds))
+test_value("Reload count", count(with({"reload"})), 4)
+
+local r = results(with({"reload"}, {"exit_of", 0}, {"exit_of", 1}, {"cwd_of", 1}, {"cwd_of", 3}))
+test_value("Exit unknown", r[1], false)
+test_value("Exit code", r[2], -2)
+test_value("Cwd folded", r[3], "c:\\src")
+test_value("Cwd none", r[4], "")
+
+r = results(with({"exit", 0, 7}, {"reload"}, {"exit_of", 0}, {"exit", 2, 1}, {"write", 0, 0}, {"exit_of", 2}))
+test_value("Exit record", r[1], 7)
+test_value("Exit written", r[2], 1)
+
+r = results(with({"search", "s"}, {"search", "s", nil, 2}, {"search", "s", "C:\\Src"}, {"search", "x"}, {"search", "l", "e:\\"}))
+test_value("Search", r[1], 2)
+test_value("Search from", r[2], 0)
+test_value("Search cwd", r[3], 0)
+test_value("Search missing", r[4], -1)
+test_value("Search unknown cwd", r[5], -1)
+
+--------------------------------------------------------------------------------
+local many = {}
+for i = 1, 3000 do
+    table.insert(many, {"add", "cmd "..(i % 1000), 1000 + i, "c:\\"..(i % 3)})
+end
+
+local function with_many(...)
+    local ops = {}
+    for _, op in ipairs(many) do table.insert(ops, op) end
+    for _, op in ipairs({...}) do table.insert(ops, op) end
+    return ops
+end
+
+test_value("Write max", count(with_many({"write", 100, 0})), 100)
+test_value("Write dedupe", count(with_many({"write", 0, 1})), 1000)
+test_value("Write order", text(with_many({"write", 2, 1})), "#3999\ncmd 999\n#4000\ncmd 0\n")
+test_value("Tail load", count(with_many({"write", 0, 0}, {"reload", 100})), 3000 - 2048)
+test_value("Tail then add", count(with_many({"write", 0, 0}, {"add", "x", 5000}, {"reload", 100})), 3001 - 2048)
+test_value("Tail none", count(with_many({"write", 0, 0}, {"reload", 0})), 3000)
+
+--------------------------------------------------------------------------------
+if bench ~= 0 then
+    local parse, load, tail_load, search, cwd_search, loaded, tail = history_db_bench(1000000)
+    test_value("Bench loaded", loaded, 1000000)
+    test_value("Bench tail", tail >= 10000 and tail < 10000 + 1024, true)
+    print(string.format(
+        "    1M entries; text parse %.0fms, load %.0fms, newest 10k %.1fms, search %.0fms, cwd search x10 %.0fms",
+        parse, load, tail_load, search, cwd_search
+    ))
+end
+
+-- vim: expandtab
@@ -0,0 +1,67 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function ranked(ops)
+    local out = {}
+    for _, lines in ipairs(history_rank(ops)) do
+        table.insert(out, table.concat(lines, " "))
+    end
+    return table.concat(out, "|")
+end
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+test_value("Empty", ranked({ {"score"} }), "")
+test_value("Recency", ranked({ {"add", "a"}, {"add", "b"}, {"add", "c"}, {"score"} }), "c b a")
+test_value("Distinct", ranked({ {"add", "a"}, {"add", "b"}, {"add", "a"}, {"score"} }), "a b")
+
+local often = {}
+for i = 1, 5 do table.insert(often, {"add", "x"}) end
+table.insert(often, {"add", "y"})
+table.insert(often, {"score"})
+test_value("Frequency", ranked(often), "x y")
+
+local dirs = {
+    {"add", "make", 1},
+    {"add", "ls", 0},
+    {"add", "dir", 0},
+    {"add", "cls"},
+}
+
+local function with(...)
+    local ops = {}
+    for _, op in ipairs(dirs) do table.insert(ops, op) end
+    for _, op in ipairs({...}) do table.insert(ops, op) end
+    return ops
+end
+
+test_value("No cwd", ranked(with({"score"})), "cls dir ls make")
+test_value("Cwd", ranked(with({"score", 1})), "make cls dir ls")
+test_value("Other cwd", ranked(with({"score", 0})), "dir ls cls make")
+test_value("Unknown cwd", ranked(with({"score", 7})), "cls dir ls make")
+test_value("Cached", ranked(with({"score", 1}, {"score", 1})), "make cls dir ls|make cls dir ls")
+test_value("Rescored", ranked(with({"score", 1}, {"score", 0})), "make cls dir ls|dir ls cls make")
+test_value("Added", ranked(with({"score"}, {"add", "ls", 1}, {"score"})), "cls dir ls make|ls cls dir make")
+
+-- vim: expandtab
@@ -0,0 +1,97 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local file_name = "shared_history_db"
+
+local function share(ops)
+    return history_share(file_name, ops)
+end
+
+local function writer(n, ops)
+    return select(2, share(ops))[n]
+end
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+local interleaved = { {1, "a1"}, {2, "b1"}, {1, "a2"}, {2, "b2"}, {1, "a3"} }
+test_value("Interleaved", share(interleaved), "a1\nb1\na2\nb2\na3\n")
+test_value("Interleaved first", writer(1, interleaved), "a1\nb1\na2\nb2\na3\n")
+test_value("Interleaved second", writer(2, interleaved), "a1\nb1\na2\nb2\n")
+
+local behind = { {1, "a1"}, {2, "b1"}, {2, "b2"}, {2, "b3"}, {1, "a2"} }
+test_value("Catch up", share(behind), "a1\nb1\nb2\nb3\na2\n")
+test_value("Catch up first", writer(1, behind), "a1\nb1\nb2\nb3\na2\n")
+test_value("Catch up second", writer(2, behind), "a1\nb1\nb2\nb3\n")
+
+local synced = { {1, "a1"}, {2, "b1"}, {1} }
+test_value("Sync only", writer(1, synced), share(synced))
+test_value("Untouched", writer(3, synced), "")
+
+-- Directories are interned once per file, whichever writer saw them first.
+local cwds = {
+    {1, "a", "c:\\x"},
+    {2, "b", "c:\\y"},
+    {1, "c", "c:\\y"},
+    {2, "d", "c:\\x"},
+}
+local with_cwds = "a @c:\\x\nb @c:\\y\nc @c:\\y\nd @c:\\x\n"
+test_value("Cwds", share(cwds), with_cwds)
+test_value("Cwds first", writer(1, cwds), "a @c:\\x\nb @c:\\y\nc @c:\\y\n")
+test_value("Cwds second", writer(2, cwds), with_cwds)
+
+local same = { {1, "dir"}, {2, "dir"}, {1, "dir"} }
+test_value("Same line", share(same), "dir\ndir\ndir\n")
+
+--------------------------------------------------------------------------------
+-- Writers on their own threads, as sessions in separate processes would be.
+local function stress(writers, lines, max_history)
+    return history_stress(file_name, writers, lines, max_history)
+end
+
+local count, in_order, consistent, failures = stress(4, 200, 0)
+test_value("Stress count", count, 800)
+test_value("Stress order", in_order, true)
+test_value("Stress consistent", consistent, true)
+test_value("Stress failures", failures, 0)
+
+-- Capped at 100 lines the file's compacted once it's 25 over.
+local compactions
+count, in_order, consistent, failures, _, compactions = stress(4, 200, 100)
+test_value("Compact count", count >= 100 and count <= 125, true)
+test_value("Compact order", in_order, true)
+test_value("Compact consistent", consistent, true)
+test_value("Compact failures", failures, 0)
+test_value("Compacted", compactions > 0, true)
+
+if bench ~= 0 then
+    for _, args in ipairs({ {16, 1000, 0}, {8, 2000, 1000} }) do
+        local _, _, _, _, deferred, compactions, append, compact = stress(table.unpack(args))
+        print(string.format(
+            "    %d x %d lines, cap %d; append %.1fus, %d compactions %.0fus, %d deferred",
+            args[1], args[2], args[3], append, compactions, compact, deferred
+        ))
+    end
+end
+
+-- vim: expandtab
@@ -0,0 +1,59 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+local function write_inputrc(content)
+    local out = io.open("snapshot_inputrc", "wb")
+    out:write(content)
+    out:close()
+end
+
+--------------------------------------------------------------------------------
+local content = 'set bell-style none\n"\\C-xq": "quoted"\n'
+write_inputrc(content)
+inputrc_snapshot("snapshot_inputrc")
+
+test_value("Snapshot loads", inputrc_snapshot(), true)
+test_value("Snapshot reloads", inputrc_snapshot(), true)
+
+write_inputrc(content..'"\\C-xw": "more"\n')
+test_value("Snapshot invalidated by edit", inputrc_snapshot(), false)
+
+write_inputrc(content)
+test_value("Snapshot valid once reverted", inputrc_snapshot(), true)
+
+os.remove("snapshot_inputrc")
+test_value("Snapshot invalidated by removal", inputrc_snapshot(), false)
+
+--------------------------------------------------------------------------------
+if bench ~= 0 then
+    local parse, indexed, scanned, found, found_scan = funmap_bench(500)
+    test_value("Bench found", found, found_scan)
+    print(string.format(
+        "    500 bindings; parse %.1fms, 50k lookups %.1fms (linear scan %.1fms)",
+        parse, indexed, scanned
+    ))
+end
+
+-- vim: expandtab
@@ -0,0 +1,59 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+-- The scripted input's always pending so consecutive text keys get inserted
+-- together, as they would be when pasted.
+local pasted = "0123456789abcdefghijklmnopqrstuvwxyz"
+
+--------------------------------------------------------------------------------
+clink.test.test_output(
+    "Paste",
+    pasted,
+    pasted
+)
+
+--------------------------------------------------------------------------------
+clink.test.test_output(
+    "Paste undone in one go",
+    pasted.."\x1a",
+    ""
+)
+
+--------------------------------------------------------------------------------
+clink.test.test_output(
+    "Control keys in order",
+    "abc\x01xyz\x05!",
+    "xyzabc!"
+)
+
+--------------------------------------------------------------------------------
+clink.test.test_output(
+    "One redisplay",
+    string.rep(pasted, 20),
+    function(output)
+        local _, flushes = get_fwrite_stats()
+        return flushes <= 8
+    end
+)
+
+-- vim: expandtab
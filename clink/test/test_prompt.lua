@@ -0,0 +1,191 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local saved_filters = clink.prompt.filters
+clink.prompt.filters = {}
+clink.prompt.async_cache = {}
+clink.prompt.async_pending = {}
+
+local function filter(prompt)
+    return clink.filter_prompt(prompt or "p>")
+end
+
+--------------------------------------------------------------------------------
+-- Filters that don't wait on anything are applied straight away.
+clink.prompt.register_async_filter(function(cwd)
+    return "[sync]"
+end)
+
+clink.test.test_value("Immediate", filter(), "p>[sync]")
+clink.prompt.filters = {}
+
+--------------------------------------------------------------------------------
+-- Placeholder until the filter's finished, then its result.
+local ready = false
+local calls = 0
+
+clink.prompt.register_async_filter(function(cwd)
+    calls = calls + 1
+    return clink.prompt.await(function() return ready and cwd:sub(-4) end)
+end, nil, { placeholder = "..." })
+
+clink.test.test_value("Placeholder", filter(), "p>...")
+clink.test.test_value("Pending", select(2, clink.update_prompt()), true)
+
+ready = true
+clink.test.test_value("Changed", clink.update_prompt(), true)
+clink.test.test_value("Finished", filter(), "p>"..clink.get_cwd():sub(-4))
+clink.test.test_value("Not pending", select(2, clink.update_prompt()), false)
+clink.test.test_value("Cached", calls, 1)
+
+-- Segments are cached per directory.
+ready = false
+ch_dir("dir1")
+clink.test.test_value("New cwd placeholder", filter(), "p>...")
+ready = true
+clink.update_prompt()
+clink.test.test_value("New cwd", filter(), "p>dir1")
+clink.test.test_value("New cwd called", calls, 2)
+
+ch_dir("..")
+clink.test.test_value("Old cwd cached", filter(), "p>"..clink.get_cwd():sub(-4))
+clink.test.test_value("Old cwd not called", calls, 2)
+clink.prompt.filters = {}
+
+--------------------------------------------------------------------------------
+-- Expired values are still shown while they're recomputed.
+local value = "one"
+clink.prompt.register_async_filter(function(cwd)
+    return clink.prompt.await(function() return ready and value end)
+end, nil, { ttl = 0, apply = function(segment)
+    clink.prompt.value = segment..clink.prompt.value
+end })
+
+ready = false
+clink.test.test_value("TTL placeholder", filter(), "p>")
+ready = true
+clink.update_prompt()
+clink.test.test_value("TTL value", filter(), "onep>")
+
+ready = false
+value = "two"
+clink.test.test_value("TTL stale", filter(), "onep>")
+ready = true
+clink.update_prompt()
+clink.test.test_value("TTL refreshed", filter(), "twop>")
+clink.prompt.filters = {}
+
+--------------------------------------------------------------------------------
+-- Watched segments are recomputed if anything changes after they started,
+-- including while they are still running.
+local dir_changed = false
+clink.has_dir_changed = function(dir)
+    local changed = dir_changed
+    dir_changed = false
+    return changed
+end
+
+calls = 0
+ready = true
+clink.prompt.register_async_filter(function(cwd)
+    calls = calls + 1
+    return clink.prompt.await(function() return ready and "w" end)
+end, nil, { watch = true })
+
+filter()
+clink.update_prompt()
+clink.test.test_value("Watch value", filter(), "p>w")
+clink.test.test_value("Watch unchanged", calls, 1)
+
+dir_changed = true
+filter()
+clink.test.test_value("Watch changes", calls, 2)
+clink.update_prompt()
+
+ready = false
+dir_changed = true
+filter()
+dir_changed = true
+ready = true
+clink.update_prompt()
+filter()
+clink.test.test_value("Watch changes while running", calls, 4)
+clink.update_prompt()
+clink.prompt.filters = {}
+
+--------------------------------------------------------------------------------
+-- Processes run in the background.
+clink.prompt.register_async_filter(function(cwd)
+    local lines = clink.prompt.execute_async("cmd.exe /c echo async")
+    return lines[1]
+end)
+
+filter()
+local timeout = os.time() + 5
+while select(2, clink.update_prompt()) and os.time() < timeout do
+end
+
+clink.test.test_value("Execute", filter(), "p>async")
+
+--------------------------------------------------------------------------------
+-- The prompt as Readline gets it; codes wrapped in \001 and \002 markers and
+-- backspaces applied.
+clink.prompt.filters = {}
+
+local corpus = {
+    -- Short enough to start in the prompt buffer's local storage but its
+    -- markers push it out, so it must come before anything grows the buffer.
+    { ("\x1b[1mx"):rep(20),                 ("\001\x1b[1m\002x"):rep(20) },
+    { "",                                   "" },
+    { "C:\\>",                              "C:\\>" },
+    { "line1\nline2>",                      "line1\nline2>" },
+    { "\x1b[31mred\x1b[0m>",                "\001\x1b[31m\002red\001\x1b[0m\002>" },
+    { "\x1b[1m\x1b[32m",                    "\001\x1b[1m\002\001\x1b[32m\002" },
+    { "\x1b]0;title\x07>",                  "\001\x1b]0;title\x07\002>" },
+    { "ab\bc",                              "ac" },
+    { "ab\b\b\bc",                          "c" },
+    { "\b\bx",                              "x" },
+    { "a\x1b[1m\bb",                        "a\001\x1b[1m\002b" },
+    { "x\xc3\xa9\by",                       "xy" },
+    { "x\xe2\x82\xac\b\by",                 "y" },
+    { ("x"):rep(40000),                     ("x"):rep(40000) },
+    { ("\x1b[1mab"):rep(5000),              ("\001\x1b[1m\002ab"):rep(5000) },
+    { "short",                              "short" },
+}
+
+for i, case in ipairs(corpus) do
+    clink.test.test_value("Corpus "..i, filter_prompt(case[1]), case[2])
+end
+
+--------------------------------------------------------------------------------
+-- A filter that fails leaves the prompt as it was.
+clink.prompt.filters = {}
+clink.prompt.register_filter(function() error("failed filter") end)
+clink.test.test_value("Failed filter", filter_prompt("C:\\>"), "C:\\>")
+
+--------------------------------------------------------------------------------
+clink.prompt.filters = saved_filters
+clink.prompt.async_cache = {}
+clink.prompt.async_pending = {}
+
+-- vim: expandtab
@@ -0,0 +1,108 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+--------------------------------------------------------------------------------
+local records = {
+    { text = "alpha_one", display = "one" },
+    { text = "alpha_two", display = "two" },
+    { text = "beta", suffix = "=" },
+    { text = "gamma", suffix = "" },
+    "alpha_plain",
+}
+
+local function record_generator(text, first, last)
+    if not rl_state.line_buffer:find("^reccmd ") then
+        return false
+    end
+
+    for _, record in ipairs(records) do
+        local match_text = record
+        if type(record) == "table" then
+            match_text = record.text
+        end
+
+        if clink.is_match(text, match_text) then
+            clink.add_match(record)
+        end
+    end
+
+    return true
+end
+
+clink.register_match_generator(record_generator, 1)
+
+--------------------------------------------------------------------------------
+clink.test.test_matches(
+    "Record display",
+    "reccmd alpha",
+    { "one", "two", "alpha_plain" }
+)
+
+clink.test.test_output(
+    "Record inserts text",
+    "reccmd alpha_o",
+    "reccmd alpha_one "
+)
+
+clink.test.test_output(
+    "Record suffix",
+    "reccmd be",
+    "reccmd beta="
+)
+
+clink.test.test_output(
+    "Record no suffix",
+    "reccmd ga",
+    "reccmd gamma"
+)
+
+clink.test.test_output(
+    "String match",
+    "reccmd alpha_p",
+    "reccmd alpha_plain "
+)
+
+--------------------------------------------------------------------------------
+-- Parsers can return records too, and lists passed to clink.add_match() can
+-- mix them with strings.
+local p = clink.arg.new_parser()
+p:set_arguments({
+    function(word)
+        return { { text = "delta_one", display = "d1" }, "delta_two" }
+    end
+})
+clink.arg.register_parser("recargs", p)
+
+clink.test.test_matches(
+    "Parser records",
+    "recargs delta",
+    { "d1", "delta_two" }
+)
+
+clink.matches = {}
+clink.match_info = {}
+clink.add_match({ "x", { text = "y", type = "dir" }, "z" })
+test_value("Record list", table.concat(clink.matches, " "), "x y z")
+test_value("Record list info", clink.match_info.y.type, "dir")
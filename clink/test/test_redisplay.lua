@@ -0,0 +1,53 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+-- Runs the input with rl_redisplay() resuming from the first changed row, and
+-- again drawing the whole line each time. Both must write the same bytes.
+local function same_output(name, input)
+    redisplay_cache(true)
+    local line = call_readline(input)
+    local cached = fwrite_output()
+
+    redisplay_cache(false)
+    local uncached_line = call_readline(input)
+    local uncached = fwrite_output()
+
+    redisplay_cache(true)
+    test_value(name, line == uncached_line and cached == uncached, true)
+end
+
+--------------------------------------------------------------------------------
+-- Lines long enough to wrap over several rows, edited at the end, in the
+-- middle and at the start.
+local long = string.rep("abcdefghij", 40)
+
+same_output("Edit at end", long.."\b\b!x\by")
+same_output("Edit in middle", long..string.rep("\002", 150).."XY\bZ")
+same_output("Edit at start", long.."\001Q\004\004\004R")
+same_output("Cursor moves", long.."\001\006\006\006\005\002\002")
+same_output("Delete across rows", long..string.rep("\b", 120).."!")
+same_output("Grow across rows", "abc"..string.rep("\002x", 200))
+
+-- vim: expandtab
@@ -0,0 +1,100 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function histogram_total(probe)
+    local total = 0
+    for _, count in ipairs(probe.histogram) do
+        total = total + count
+    end
+
+    return total
+end
+
+local test_value = clink.test.test_value
+
+--------------------------------------------------------------------------------
+clink.stats(true)
+clink.stats_record("test:probe", clink.stats_clock() - 2, 3, 1.5)
+clink.stats_record("test:probe", clink.stats_clock(), 1, 0.5)
+
+local probe = clink.stats(true)["test:probe"]
+test_value("Calls", probe.calls, 2)
+test_value("Matches", probe.matches, 4)
+test_value("Memory", probe.memory, 2)
+test_value("Max", probe.max >= 2, true)
+test_value("Total", probe.total >= probe.max, true)
+test_value("Histogram", histogram_total(probe), 2)
+test_value("Histogram 2-4ms", probe.histogram[7], 1)
+test_value("p50", probe.p50, 1 / 16)
+test_value("p90", probe.p90, probe.max)
+test_value("Reset", next(clink.stats()), nil)
+
+--------------------------------------------------------------------------------
+for i = 1, 300 do
+    clink.stats_record("test:rolling", clink.stats_clock())
+end
+
+probe = clink.stats(true)["test:rolling"]
+test_value("Rolling calls", probe.calls, 300)
+test_value("Rolling histogram", histogram_total(probe), 172)
+
+--------------------------------------------------------------------------------
+test_value("Disabled", clink.stats_enabled(), false)
+
+--------------------------------------------------------------------------------
+local saved_generators = clink.generators
+clink.generators = {}
+
+local callable = setmetatable({}, { __call = function() return false end })
+local ok = pcall(clink.register_match_generator, callable)
+test_value("Callable generator", ok, true)
+test_value("Callable probe", clink.generators[1].probe, "generator:table")
+
+clink.generators = saved_generators
+
+--------------------------------------------------------------------------------
+local function pool_allocs(memory)
+    local allocs = 0
+    for _, pool in ipairs(memory.pools) do
+        allocs = allocs + pool.allocs
+    end
+
+    return allocs
+end
+
+local memory = clink.memory_stats()
+test_value("Memory heap", memory.heap * 1024, memory.bytes)
+test_value("Memory peak", memory.peak >= memory.bytes, true)
+test_value("Memory pools", #memory.pools, 8)
+
+local allocs = pool_allocs(memory)
+local garbage = {}
+for i = 1, 100 do
+    garbage[i] = { i }
+end
+
+memory = clink.memory_stats()
+test_value("Memory pooled", pool_allocs(memory) - allocs >= 100, true)
+test_value("Memory reserved", memory.reserved > 0, true)
+
+-- vim: expandtab
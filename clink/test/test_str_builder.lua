@@ -0,0 +1,89 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function value(ops)
+    return (str_builder(ops))
+end
+
+local function length(ops)
+    return select(2, str_builder(ops))
+end
+
+local function on_heap(ops)
+    return select(3, str_builder(ops))
+end
+
+--------------------------------------------------------------------------------
+local test_value = clink.test.test_value
+
+test_value("Empty", value({}), "")
+test_value("Append", value({ {"append", "abc"}, {"append", "def"} }), "abcdef")
+test_value("Length", length({ {"append", "abc"}, {"append", "def"} }), 6)
+test_value("Append char", value({ {"append", "ab"}, {"append_c", "c"} }), "abc")
+
+test_value("Append n", value({ {"append_n", "abcdef", 3} }), "abc")
+test_value("Append n short", value({ {"append_n", "ab", 10} }), "ab")
+test_value("Append n zero", value({ {"append_n", "ab", 0} }), "")
+test_value("Append n negative", value({ {"append_n", "ab", -1} }), "")
+
+test_value("Truncate", value({ {"append", "abcdef"}, {"truncate", "2"} }), "ab")
+test_value("Truncate longer", value({ {"append", "abc"}, {"truncate", "9"} }), "abc")
+test_value("Truncate negative", value({ {"append", "abc"}, {"truncate", "-1"} }), "")
+test_value("Clear", value({ {"append", "abc"}, {"clear"}, {"append", "d"} }), "d")
+
+test_value("Printf", value({ {"printf", "%s-%s", "a", "b"} }), "a-b")
+test_value("Printf int", value({ {"append", "x="}, {"printf", "%d", 42} }), "x=42")
+
+test_value("Join", value({ {"append", "c:\\dir"}, {"join_path", "file"} }), "c:\\dir\\file")
+test_value("Join seps", value({ {"append", "c:\\dir\\"}, {"join_path", "\\file"} }), "c:\\dir\\file")
+test_value("Join slash", value({ {"append", "c:/dir/"}, {"join_path", "file"} }), "c:/dir/file")
+test_value("Join empty", value({ {"join_path", "file"} }), "file")
+test_value("Join nothing", value({ {"append", "dir"}, {"join_path", ""} }), "dir\\")
+
+--------------------------------------------------------------------------------
+-- Spilling from the local buffer to the heap.
+local x127 = ("x"):rep(127)
+local x100k = ("x"):rep(100000)
+
+test_value("Local", on_heap({ {"append", x127} }), false)
+test_value("Spill", on_heap({ {"append", x127}, {"append_c", "y"} }), true)
+test_value("Spill value", value({ {"append", x127}, {"append_c", "y"} }), x127.."y")
+test_value("Large", length({ {"append", "a"}, {"append", x100k} }), 100001)
+test_value("Large value", value({ {"append", x100k}, {"append", "b"} }), x100k.."b")
+test_value("Large printf", length({ {"append", "a"}, {"printf", "%s", x100k} }), 100001)
+test_value("Large truncate", value({ {"append", x100k}, {"truncate", "3"} }), "xxx")
+
+--------------------------------------------------------------------------------
+-- Copying out to fixed size buffers.
+local function copy(size)
+    local _, _, _, out, fit = str_builder({ {"append", "abcdef"} }, size)
+    return out..(fit and "+" or "-")
+end
+
+test_value("Copy fits", copy(7), "abcdef+")
+test_value("Copy roomy", copy(64), "abcdef+")
+test_value("Copy truncated", copy(6), "abcde-")
+test_value("Copy tiny", copy(1), "-")
+test_value("Copy none", copy(0), "-")
+
+-- vim: expandtab
@@ -0,0 +1,101 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+local function tokens(line)
+    -- Tokens are flattened to "<type><flags>:<text>" and joined with ';'. Type
+    -- is the first letter of the token's type and flags are c(ommand),
+    -- t(arget), q(uoted), and o(pen quote).
+    local out = {}
+    for _, token in ipairs(clink.tokenise(line)) do
+        local flags = (token.command and "c" or "")
+        flags = flags..(token.target and "t" or "")
+        flags = flags..(token.quoted and "q" or "")
+        flags = flags..(token.open_quote and "o" or "")
+        table.insert(out, token.type:sub(1, 1)..flags..":"..token.text)
+    end
+
+    return table.concat(out, ";")
+end
+
+--------------------------------------------------------------------------------
+local function spans(line)
+    local out = {}
+    for _, token in ipairs(clink.tokenise(line)) do
+        table.insert(out, token.first.."-"..token.last)
+    end
+
+    return table.concat(out, " ")
+end
+
+local test_value = clink.test.test_value
+
+--------------------------------------------------------------------------------
+test_value("Empty", tokens(""), "")
+test_value("Whitespace", tokens(" \t "), "")
+test_value("Command", tokens("dir"), "wc:dir")
+test_value("Arguments", tokens("  dir  /w\t/b "), "wc:dir;w:/w;w:/b")
+test_value("Spans", spans(" dir  \"a b\"c d"), "2-4 7-12 14-14")
+
+--------------------------------------------------------------------------------
+test_value("Quoted", tokens("cd \"program files\""), "wc:cd;wq:program files")
+test_value("Quoted command", tokens("\"c:\\my dir\\x.exe\" arg"),
+    "wcq:c:\\my dir\\x.exe;w:arg")
+test_value("Quote mid-word", tokens("echo a\"b c\"d e"), "wc:echo;wq:ab cd;w:e")
+test_value("Empty quotes", tokens("\"\""), "wcq:")
+test_value("Adjacent quotes", tokens("echo a\"\"b"), "wc:echo;wq:ab")
+test_value("Open quote", tokens("echo \"a & b"), "wc:echo;wqo:a & b")
+test_value("Just a quote", tokens("echo \""), "wc:echo;wqo:")
+test_value("Operators in quotes", tokens("echo \"a&b|c>d\""),
+    "wc:echo;wq:a&b|c>d")
+
+--------------------------------------------------------------------------------
+test_value("Escaped &", tokens("echo a ^& b"), "wc:echo;w:a;w:&;w:b")
+test_value("Escaped space", tokens("echo a^ b"), "wc:echo;w:a b")
+test_value("Escaped quote", tokens("echo ^\"a b^\""), "wc:echo;w:\"a;w:b\"")
+test_value("Escaped caret", tokens("echo a^^b"), "wc:echo;w:a^b")
+test_value("Caret in quotes", tokens("echo \"a^b\""), "wc:echo;wq:a^b")
+test_value("Trailing caret", tokens("echo ab^"), "wc:echo;w:ab")
+test_value("Escaped >", tokens("echo 1^>2"), "wc:echo;w:1>2")
+
+--------------------------------------------------------------------------------
+test_value("&", tokens("a&b"), "wc:a;s:&;wc:b")
+test_value("&&", tokens("a && b"), "wc:a;s:&&;wc:b")
+test_value("|", tokens("a|b"), "wc:a;s:|;wc:b")
+test_value("||", tokens("a ||b"), "wc:a;s:||;wc:b")
+test_value("&&&", tokens("a&&&b"), "wc:a;s:&&;s:&;wc:b")
+test_value("Trailing separator", tokens("a && "), "wc:a;s:&&")
+test_value("Pipeline", tokens("type x | sort | more"),
+    "wc:type;w:x;s:|;wc:sort;s:|;wc:more")
+
+--------------------------------------------------------------------------------
+test_value(">", tokens("dir > out.txt"), "wc:dir;r:>;wt:out.txt")
+test_value(">>", tokens("dir>>out.txt"), "wc:dir;r:>>;wt:out.txt")
+test_value("<", tokens("< in.txt sort"), "r:<;wt:in.txt;wc:sort")
+test_value("Handle", tokens("cmd 2>nul"), "wc:cmd;r:2>;wt:nul")
+test_value("Not handle", tokens("cmd a2>nul"), "wc:cmd;w:a2;r:>;wt:nul")
+test_value("Duplicate", tokens("cmd 2>&1 | more"), "wc:cmd;r:2>&1;s:|;wc:more")
+test_value("Duplicate >&", tokens("echo x >&2"), "wc:echo;w:x;r:>&2")
+test_value("Redirect then args", tokens("cmd >x y"), "wc:cmd;r:>;wt:x;w:y")
+test_value("Quoted target", tokens("cmd > \"a b\""), "wc:cmd;r:>;wtq:a b")
+
+-- vim: expandtab
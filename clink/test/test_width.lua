@@ -0,0 +1,82 @@
+--
+-- Copyright (c) 2016 Martin Ridgers
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+-- SOFTWARE.
+--
+
+--------------------------------------------------------------------------------
+-- How fnwidth() (controls are two columns, ^X) and _rl_col_width() (one)
+-- measure ASCII a character at a time. Anything else is left to them.
+local function reference(str, control_width)
+    local width = 0
+    for i = 1, #str do
+        local c = str:byte(i)
+        if c == 0 or c >= 0x80 then
+            return -1
+        end
+
+        width = width + (((c < 0x20 or c == 0x7f) and control_width) or 1)
+    end
+    return width
+end
+
+test_value("Width empty", width_ascii("", 2), 0)
+test_value("Width plain", width_ascii("foo.bar", 2), 7)
+test_value("Width control", width_ascii("a\tb\127", 2), 6)
+test_value("Width control one", width_ascii("a\tb\127", 1), 4)
+test_value("Width UTF-8", width_ascii("caf\xc3\xa9 au lait, s'il vous pla\xc3\xaet", 2), -1)
+test_value("Width NUL", width_ascii("0123456789abcdef\0", 1), -1)
+
+--------------------------------------------------------------------------------
+-- The SIMD measure has to agree with the scalar one and the reference. Odd
+-- bytes land anywhere in strings long enough to cross a few 16 byte blocks.
+math.randomseed(1)
+local odd_bytes = { "\t", "\27", "\127", "\0", "\128", "\xc3\xa9", "\255" }
+local failures = 0
+for i = 1, 4000 do
+    local chars = {}
+    for j = 1, math.random(0, 70) do
+        if math.random(1, 40) == 1 then
+            table.insert(chars, odd_bytes[math.random(1, #odd_bytes)])
+        else
+            table.insert(chars, string.char(math.random(0x20, 0x7e)))
+        end
+    end
+
+    local str = table.concat(chars)
+    local control_width = math.random(1, 2)
+    local simd, scalar = width_ascii(str, control_width)
+    if simd ~= scalar or simd ~= reference(str, control_width) then
+        failures = failures + 1
+    end
+end
+test_value("SIMD agrees with scalar", failures, 0)
+
+--------------------------------------------------------------------------------
+test_value("wcwidth table", wcwidth_table(), 0)
+
+--------------------------------------------------------------------------------
+if bench ~= 0 then
+    for _, length in ipairs({ 8, 24, 120 }) do
+        local simd, scalar = width_bench(length, 100000)
+        print(string.format(
+            "    %d bytes; width %.0fns (scalar %.0fns)", length, simd, scalar
+        ))
+    end
+end
@@ -245,6 +245,7 @@ project("clink_test")
     links("readline")
     links("clink_shared")
     defines("GETWCH_IMPL=getwch_automatic")
+    defines("GETWCH_PENDING_IMPL=getwch_automatic_pending")
     includedirs("getopt")
     includedirs("lua/src")
     includedirs("clink/dll")
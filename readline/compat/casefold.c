@@ -0,0 +1,309 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Windows.h>
+#include <ctype.h>
+#include <stddef.h>
+
+#include "casefold.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#   define CASEFOLD_SSE2
+#   include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+static int fold_ascii(int c, int flags)
+{
+    if ((flags & CASEFOLD_CASE) && c >= 'A' && c <= 'Z')
+    {
+        return c | 0x20;
+    }
+
+    if ((flags & CASEFOLD_MAP) && c == '-')
+    {
+        return '_';
+    }
+
+    return c;
+}
+
+//------------------------------------------------------------------------------
+static int fold_char(int c, int flags)
+{
+    c = (unsigned char)c;
+    if ((flags & CASEFOLD_MAP) && c == '-')
+    {
+        return '_';
+    }
+
+    return (flags & CASEFOLD_CASE) ? tolower(c) : c;
+}
+
+//------------------------------------------------------------------------------
+int casefold_has_simd()
+{
+#if defined(CASEFOLD_SSE2) && defined(_M_IX86)
+    static int has_sse2 = -1;
+
+    if (has_sse2 < 0)
+    {
+        has_sse2 = !!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    }
+
+    return has_sse2;
+#elif defined(CASEFOLD_SSE2)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+int casefold_prefix_scalar(const char* a, const char* b, int limit, int flags)
+{
+    int n;
+
+    for (n = 0; n < limit; ++n)
+    {
+        int ca = (unsigned char)a[n];
+        int cb = (unsigned char)b[n];
+
+        if (ca == 0 || ca >= 0x80 || cb >= 0x80)
+        {
+            break;
+        }
+
+        if (fold_ascii(ca, flags) != fold_ascii(cb, flags))
+        {
+            break;
+        }
+    }
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+int casefold_compare_scalar(const char* a, const char* b, int count, int flags)
+{
+    int n;
+
+    for (n = 0; n < count; ++n)
+    {
+        int ca = fold_char(a[n], flags);
+        int cb = fold_char(b[n], flags);
+
+        if (ca != cb)
+        {
+            return ca - cb;
+        }
+
+        if (ca == 0)
+        {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void casefold_lower_scalar(char* out, const char* in, int length, int flags)
+{
+    int i;
+
+    for (i = 0; i < length; ++i)
+    {
+        out[i] = (char)fold_char(in[i], flags | CASEFOLD_CASE);
+    }
+}
+
+#if defined(CASEFOLD_SSE2)
+//------------------------------------------------------------------------------
+static int lowest_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+//------------------------------------------------------------------------------
+static int crosses_page(const char* p)
+{
+    // Strings of unknown length are read sixteen bytes at a time, which is
+    // only safe past their end if the read stays in the same page.
+    return ((size_t)p & 4095) > 4096 - 16;
+}
+
+//------------------------------------------------------------------------------
+static __m128i fold_sse2(__m128i c, int flags)
+{
+    if (flags & CASEFOLD_CASE)
+    {
+        __m128i upper = _mm_and_si128(
+            _mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+            _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+        c = _mm_add_epi8(c, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+    }
+
+    if (flags & CASEFOLD_MAP)
+    {
+        __m128i dash = _mm_cmpeq_epi8(c, _mm_set1_epi8('-'));
+        c = _mm_add_epi8(c, _mm_and_si128(dash, _mm_set1_epi8('_' - '-')));
+    }
+
+    return c;
+}
+
+//------------------------------------------------------------------------------
+static int prefix_sse2(const char* a, const char* b, int limit, int flags)
+{
+    int n;
+
+    n = 0;
+    while (n + 16 <= limit && !crosses_page(a + n) && !crosses_page(b + n))
+    {
+        __m128i ca;
+        __m128i cb;
+        unsigned stop;
+
+        ca = _mm_loadu_si128((const __m128i*)(a + n));
+        cb = _mm_loadu_si128((const __m128i*)(b + n));
+
+        // Stop at non-ASCII bytes, the end of 'a', or a difference (which
+        // includes the end of 'b').
+        stop = _mm_movemask_epi8(_mm_or_si128(ca, cb));
+        stop |= _mm_movemask_epi8(_mm_cmpeq_epi8(ca, _mm_setzero_si128()));
+        stop |= ~_mm_movemask_epi8(_mm_cmpeq_epi8(
+            fold_sse2(ca, flags),
+            fold_sse2(cb, flags))) & 0xffff;
+
+        if (stop)
+        {
+            return n + lowest_bit(stop);
+        }
+
+        n += 16;
+    }
+
+    return n + casefold_prefix_scalar(a + n, b + n, limit - n, flags);
+}
+
+//------------------------------------------------------------------------------
+static void lower_sse2(char* out, const char* in, int length, int flags)
+{
+    int i;
+
+    flags |= CASEFOLD_CASE;
+    for (i = 0; i + 16 <= length; i += 16)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(in + i));
+
+        if (_mm_movemask_epi8(c))
+        {
+            casefold_lower_scalar(out + i, in + i, 16, flags);
+            continue;
+        }
+
+        _mm_storeu_si128((__m128i*)(out + i), fold_sse2(c, flags));
+    }
+
+    casefold_lower_scalar(out + i, in + i, length - i, flags);
+}
+#endif // CASEFOLD_SSE2
+
+//------------------------------------------------------------------------------
+int casefold_prefix(const char* a, const char* b, int limit, int flags)
+{
+    // Returns how many leading characters 'a' and 'b' have in common, up to
+    // 'limit', the end of either, or the first non-ASCII byte in either.
+
+#if defined(CASEFOLD_SSE2)
+    if (casefold_has_simd())
+    {
+        return prefix_sse2(a, b, limit, flags);
+    }
+#endif
+
+    return casefold_prefix_scalar(a, b, limit, flags);
+}
+
+//------------------------------------------------------------------------------
+int casefold_compare(const char* a, const char* b, int count, int flags)
+{
+    // strnicmp() with 'flags'. Runs of ASCII go through casefold_prefix() and
+    // anything else is compared a byte at a time.
+
+    int n;
+
+    n = 0;
+    while (n < count)
+    {
+        int ca;
+        int cb;
+
+        n += casefold_prefix(a + n, b + n, count - n, flags);
+        if (n >= count)
+        {
+            break;
+        }
+
+        ca = fold_char(a[n], flags);
+        cb = fold_char(b[n], flags);
+        if (ca != cb)
+        {
+            return ca - cb;
+        }
+
+        if (ca == 0)
+        {
+            break;
+        }
+
+        ++n;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void casefold_lower(char* out, const char* in, int length, int flags)
+{
+    // Lowers 'length' bytes of 'in' in to 'out', mapping '-' to '_' too if
+    // CASEFOLD_MAP is set.
+
+#if defined(CASEFOLD_SSE2)
+    if (casefold_has_simd())
+    {
+        lower_sse2(out, in, length, flags);
+        return;
+    }
+#endif
+
+    casefold_lower_scalar(out, in, length, flags);
+}
+
+// vim: expandtab
@@ -0,0 +1,48 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(CASEFOLD_H)
+#define CASEFOLD_H
+
+//------------------------------------------------------------------------------
+// Case-insensitive string primitives for completion's hot paths. Runs of
+// ASCII are folded and compared sixteen bytes at a time where SSE2 is
+// available. Other bytes are left to the caller's multibyte handling by
+// casefold_prefix(), or folded a byte at a time with tolower() by the others,
+// as the code these replace did.
+//
+// CASEFOLD_CASE ignores case. CASEFOLD_MAP also treats '-' and '_' as the same
+// character (Readline's completion-map-case), folding both to '_'.
+#define CASEFOLD_CASE   0x01
+#define CASEFOLD_MAP    0x02
+
+//------------------------------------------------------------------------------
+int                     casefold_has_simd();
+int                     casefold_prefix(const char* a, const char* b, int limit, int flags);
+int                     casefold_compare(const char* a, const char* b, int count, int flags);
+void                    casefold_lower(char* out, const char* in, int length, int flags);
+int                     casefold_prefix_scalar(const char* a, const char* b, int limit, int flags);
+int                     casefold_compare_scalar(const char* a, const char* b, int count, int flags);
+void                    casefold_lower_scalar(char* out, const char* in, int length, int flags);
+
+#endif // CASEFOLD_H
+
+// vim: expandtab
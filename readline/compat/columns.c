@@ -0,0 +1,165 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "columns.h"
+
+//------------------------------------------------------------------------------
+void columns_init(columns_t* columns)
+{
+    memset(columns, 0, sizeof(*columns));
+}
+
+//------------------------------------------------------------------------------
+void columns_free(columns_t* columns)
+{
+    free(columns->widths);
+    columns_init(columns);
+}
+
+//------------------------------------------------------------------------------
+static int fits(columns_t* columns, const int* widths, int count, int column_count,
+    int screen_width, int gap, int horizontal)
+{
+    int rows;
+    int total;
+    int i;
+
+    rows = (count + column_count - 1) / column_count;
+    if (!horizontal)
+    {
+        // Filling down the columns might not need them all.
+        column_count = (count + rows - 1) / rows;
+    }
+
+    memset(columns->widths, 0, column_count * sizeof(int));
+    for (i = 0; i < count; ++i)
+    {
+        int j;
+
+        j = horizontal ? (i % column_count) : (i / rows);
+        if (widths[i] > columns->widths[j])
+        {
+            columns->widths[j] = widths[i];
+        }
+    }
+
+    columns->rows = rows;
+    columns->columns = column_count;
+
+    total = 0;
+    for (i = 0; i < column_count; ++i)
+    {
+        total += columns->widths[i] + gap;
+    }
+
+    return (column_count == 1) || (total < screen_width);
+}
+
+//------------------------------------------------------------------------------
+int columns_layout(columns_t* columns, const int* widths, int count,
+    int screen_width, int gap, int horizontal)
+{
+    int longest;
+    int narrowest;
+    int lo;
+    int hi;
+    int i;
+
+    columns->rows = 0;
+    columns->columns = 0;
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    // Without memory for the column widths everything goes in one column, as
+    // a single column's width is never needed to pad the next one.
+    if (count > columns->size)
+    {
+        int* grown = realloc(columns->widths, count * sizeof(int));
+        if (grown == NULL)
+        {
+            columns->rows = count;
+            columns->columns = 1;
+            return count;
+        }
+
+        columns->widths = grown;
+        columns->size = count;
+    }
+
+    longest = 0;
+    narrowest = widths[0];
+    for (i = 0; i < count; ++i)
+    {
+        longest = (widths[i] > longest) ? widths[i] : longest;
+        narrowest = (widths[i] < narrowest) ? widths[i] : narrowest;
+    }
+
+    // As many columns as fit when they're all as wide as the longest item
+    // always fits, so start there and search up to as many as would fit if
+    // they were all as narrow as the narrowest. Fitting isn't strictly
+    // monotonic in the number of columns but the search never does worse
+    // than equal widths would.
+    lo = screen_width / (longest + gap);
+    if (lo * (longest + gap) == screen_width)
+    {
+        --lo;
+    }
+
+    hi = screen_width / (narrowest + gap);
+    lo = (lo < 1) ? 1 : ((lo > count) ? count : lo);
+    hi = (hi < lo) ? lo : ((hi > count) ? count : hi);
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (fits(columns, widths, count, mid, screen_width, gap, horizontal))
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    fits(columns, widths, count, lo, screen_width, gap, horizontal);
+    return columns->rows;
+}
+
+//------------------------------------------------------------------------------
+int columns_index(const columns_t* columns, int row, int column, int horizontal)
+{
+    // Index of the item at 'row' and 'column', which may be past the end of
+    // the items if the last row or column is short.
+    if (horizontal)
+    {
+        return (row * columns->columns) + column;
+    }
+
+    return (column * columns->rows) + row;
+}
+
+// vim: expandtab
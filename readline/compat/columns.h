@@ -0,0 +1,49 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(COLUMNS_H)
+#define COLUMNS_H
+
+//------------------------------------------------------------------------------
+// Lays out a list of items in columns as wide as the widest item in each, as
+// "ls" does, rather than all as wide as the widest item overall. Items run
+// down the columns, or across the rows if 'horizontal' is set. Columns are
+// separated by 'gap' columns and a row, gaps included, has to stay narrower
+// than the screen (a row as wide as the screen would wrap). The number of
+// columns is found by a binary search that checks each candidate in one pass
+// over the widths, so laying out n items is O(n log n).
+typedef struct
+{
+    int                 rows;
+    int                 columns;
+    int*                widths;         // per column, gap excluded
+    int                 size;
+} columns_t;
+
+//------------------------------------------------------------------------------
+void                    columns_init(columns_t* columns);
+void                    columns_free(columns_t* columns);
+int                     columns_layout(columns_t* columns, const int* widths, int count, int screen_width, int gap, int horizontal);
+int                     columns_index(const columns_t* columns, int row, int column, int horizontal);
+
+#endif // COLUMNS_H
+
+// vim: expandtab
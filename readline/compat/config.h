@@ -36,6 +36,7 @@
 // here be dragons (for purposes of utf-8 and changing stdout handles)
 //
 int                         hooked_fwrite(const void*, int, int, void*);
+int                         hooked_fflush(void*);
 void                        hooked_fprintf(const void*, const char*, ...);
 int                         hooked_putc(int, void*);
 size_t                      hooked_mbrtowc(wchar_t*, const char*, size_t, mbstate_t*);
@@ -46,6 +47,7 @@ int                         hooked_wcwidth(wchar_t wc);
 
 #if defined(__MINGW32__)
 #   undef fwrite
+#   undef fflush
 #   undef fprintf
 #   undef putc
 #   undef mbrtowc
@@ -63,6 +65,7 @@ int                         hooked_wcwidth(wchar_t wc);
 #if defined(BUILD_READLINE)
 #   define wcwidth(x)       (((x) > 0x7f) ? hooked_wcwidth(x) : 1)
 #   define fwrite           hooked_fwrite
+#   define fflush           hooked_fflush
 #   define fprintf          hooked_fprintf
 #   define putc             hooked_putc
 #   define mbrtowc          hooked_mbrtowc
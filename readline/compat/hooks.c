@@ -23,6 +23,8 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <wchar.h>
 #include <sys/stat.h>
 
@@ -32,50 +34,146 @@
 
 //------------------------------------------------------------------------------
 void (*g_alt_fwrite_hook)(wchar_t*) = NULL;
+int g_fwrite_call_count = 0;
+int g_fwrite_flush_count = 0;
+
+//------------------------------------------------------------------------------
+// Output is gathered here and written to the console in one go when flushed.
+// Readline flushes at the end of each redisplay, and the termcap emulation
+// flushes before it moves the cursor about.
+static char*    g_fwrite_buffer         = NULL;
+static int      g_fwrite_buffer_size    = 0;
+static int      g_fwrite_buffer_used    = 0;
+static wchar_t* g_fwrite_wbuffer        = NULL;
+static int      g_fwrite_wbuffer_size   = 0;
 
 //------------------------------------------------------------------------------
 int hooked_fwrite(const void* data, int size, int count, void* unused)
 {
-    wchar_t buf[2048];
-    size_t characters;
+    size *= count;
+    ++g_fwrite_call_count;
+
+    if (size <= 0)
+    {
+        return 0;
+    }
+
+    if (g_fwrite_buffer_used + size > g_fwrite_buffer_size)
+    {
+        char* buffer;
+        int buffer_size;
+
+        buffer_size = g_fwrite_buffer_size ? g_fwrite_buffer_size : 4096;
+        while (g_fwrite_buffer_used + size > buffer_size)
+        {
+            buffer_size *= 2;
+        }
+
+        buffer = realloc(g_fwrite_buffer, buffer_size);
+        if (buffer == NULL)
+        {
+            return 0;
+        }
+
+        g_fwrite_buffer = buffer;
+        g_fwrite_buffer_size = buffer_size;
+    }
+
+    memcpy(g_fwrite_buffer + g_fwrite_buffer_used, data, size);
+    g_fwrite_buffer_used += size;
+    return size;
+}
+
+//------------------------------------------------------------------------------
+int hooked_fflush(void* unused)
+{
+    int characters;
     DWORD written;
 
-    size *= count;
-    
+    if (g_fwrite_buffer_used <= 0)
+    {
+        return 0;
+    }
+
     characters = MultiByteToWideChar(
         CP_UTF8, 0,
-        (const char*)data, size,
-        buf, sizeof_array(buf)
+        g_fwrite_buffer, g_fwrite_buffer_used,
+        NULL, 0
     );
 
-    characters = characters ? characters : sizeof_array(buf) - 1;
-    buf[characters] = L'\0';
+    if (characters >= g_fwrite_wbuffer_size)
+    {
+        wchar_t* wbuffer;
+        int wbuffer_size;
+
+        wbuffer_size = characters + 1024;
+        wbuffer = realloc(g_fwrite_wbuffer, wbuffer_size * sizeof(wchar_t));
+        if (wbuffer == NULL)
+        {
+            g_fwrite_buffer_used = 0;
+            return EOF;
+        }
+
+        g_fwrite_wbuffer = wbuffer;
+        g_fwrite_wbuffer_size = wbuffer_size;
+    }
+
+    characters = MultiByteToWideChar(
+        CP_UTF8, 0,
+        g_fwrite_buffer, g_fwrite_buffer_used,
+        g_fwrite_wbuffer, g_fwrite_wbuffer_size
+    );
+
+    g_fwrite_wbuffer[characters] = L'\0';
+    g_fwrite_buffer_used = 0;
+    ++g_fwrite_flush_count;
 
     if (g_alt_fwrite_hook)
     {
-        g_alt_fwrite_hook(buf);
+        g_alt_fwrite_hook(g_fwrite_wbuffer);
     }
     else
     {
         HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
-        WriteConsoleW(handle, buf, (DWORD)wcslen(buf), &written, NULL);
+        WriteConsoleW(handle, g_fwrite_wbuffer, characters, &written, NULL);
     }
 
-    return size;
+    return 0;
 }
 
 //------------------------------------------------------------------------------
 void hooked_fprintf(const void* unused, const char* format, ...)
 {
     char buffer[2048];
+    char* heap_buffer;
+    int length;
     va_list v;
 
     va_start(v, format);
-    vsnprintf(buffer, sizeof_array(buffer), format, v);
+    length = _vscprintf(format, v);
+    va_end(v);
+
+    if (length < 0)
+    {
+        return;
+    }
+
+    heap_buffer = NULL;
+    if (length >= sizeof_array(buffer))
+    {
+        heap_buffer = malloc(length + 1);
+        if (heap_buffer == NULL)
+        {
+            return;
+        }
+    }
+
+    va_start(v, format);
+    vsnprintf(heap_buffer ? heap_buffer : buffer, length + 1, format, v);
     va_end(v);
 
-    buffer[sizeof_array(buffer) - 1] = '\0';
-    hooked_fwrite(buffer, (int)strlen(buffer), 1, NULL);
+    hooked_fwrite(heap_buffer ? heap_buffer : buffer, length, 1, NULL);
+    free(heap_buffer);
 }
 
 //------------------------------------------------------------------------------
@@ -162,7 +260,17 @@ int hooked_fstat(int fid, struct hooked_stat* out)
 //------------------------------------------------------------------------------
 int hooked_wcwidth(wchar_t wc)
 {
-    int width; 
+    // Widths come from the ANSI code page, which is fixed for the process, so
+    // rather than asking Windows for every character laid out each width is
+    // looked up once and kept in a table. Entries are stored plus one so that
+    // zero means not looked up yet.
+    static unsigned char widths[0x10000];
+    int width;
+
+    if ((unsigned)wc < sizeof_array(widths) && widths[wc])
+    {
+        return widths[wc] - 1;
+    }
 
     width = WideCharToMultiByte(
         CP_ACP, 0,
@@ -171,5 +279,10 @@ int hooked_wcwidth(wchar_t wc)
         NULL, NULL
     );
 
+    if ((unsigned)wc < sizeof_array(widths))
+    {
+        widths[wc] = (unsigned char)(width + 1);
+    }
+
     return width;
 }
@@ -72,6 +72,7 @@
 
 //------------------------------------------------------------------------------
 extern int      _rl_last_v_pos;
+int             hooked_fflush(void*);
 static int      g_default_cursor_size   = -1;
 static int      g_enhanced_cursor       = 0;
 
@@ -98,6 +99,8 @@ void move_cursor(int dx, int dy)
     CONSOLE_SCREEN_BUFFER_INFO i;
     COORD o;
 
+    hooked_fflush(NULL);
+
     GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &i);
     o.X = clamp(i.dwCursorPosition.X + dx, 0, i.dwSize.X - 1);
     o.Y = clamp(i.dwCursorPosition.Y + dy, 0, i.dwSize.Y - 1);
@@ -396,6 +399,10 @@ int tputs(const char* str, int count, int (*putc_func)(int))
 
     termcap_debug(str);
 
+    // Capabilities are applied directly to the console so any buffered output
+    // needs to get there first.
+    hooked_fflush(NULL);
+
     switch (cap)
     {
     case CAP('c', 'r'): set_cursor(0, -1);   return 0;
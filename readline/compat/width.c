@@ -0,0 +1,136 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <Windows.h>
+
+#include "width.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#   define WIDTH_SSE2
+#   include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+int width_has_simd()
+{
+#if defined(WIDTH_SSE2) && defined(_M_IX86)
+    static int has_sse2 = -1;
+
+    if (has_sse2 < 0)
+    {
+        has_sse2 = !!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    }
+
+    return has_sse2;
+#elif defined(WIDTH_SSE2)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+int width_ascii_scalar(const char* str, int length, int control_width)
+{
+    int controls;
+    int i;
+
+    controls = 0;
+    for (i = 0; i < length; ++i)
+    {
+        int c = (unsigned char)str[i];
+
+        if (c == 0 || c >= 0x80)
+        {
+            return -1;
+        }
+
+        controls += (c < 0x20 || c == 0x7f);
+    }
+
+    return length + (controls * (control_width - 1));
+}
+
+#if defined(WIDTH_SSE2)
+//------------------------------------------------------------------------------
+static int width_ascii_sse2(const char* str, int length, int control_width)
+{
+    __m128i zero;
+    __m128i space;
+    __m128i del;
+    int controls;
+    int tail;
+    int i;
+
+    zero = _mm_setzero_si128();
+    space = _mm_set1_epi8(0x20);
+    del = _mm_set1_epi8(0x7f);
+
+    controls = 0;
+    for (i = 0; i + 16 <= length; i += 16)
+    {
+        __m128i block;
+        unsigned mask;
+
+        // Bytes with the high bit set are negative, so less than a space
+        // as signed bytes only leaves the controls once they're ruled out.
+        block = _mm_loadu_si128((const __m128i*)(str + i));
+        mask = _mm_movemask_epi8(block) | _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+        if (mask)
+        {
+            return -1;
+        }
+
+        mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmplt_epi8(block, space),
+            _mm_cmpeq_epi8(block, del)
+        ));
+
+        for (; mask; mask &= mask - 1)
+        {
+            ++controls;
+        }
+    }
+
+    tail = width_ascii_scalar(str + i, length - i, control_width);
+    if (tail < 0)
+    {
+        return -1;
+    }
+
+    return i + tail + (controls * (control_width - 1));
+}
+#endif // WIDTH_SSE2
+
+//------------------------------------------------------------------------------
+int width_ascii(const char* str, int length, int control_width)
+{
+#if defined(WIDTH_SSE2)
+    if (length >= 16 && width_has_simd())
+    {
+        return width_ascii_sse2(str, length, control_width);
+    }
+#endif
+
+    return width_ascii_scalar(str, length, control_width);
+}
+
+// vim: expandtab
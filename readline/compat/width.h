@@ -0,0 +1,38 @@
+/* Copyright (c) 2016 Martin Ridgers
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(WIDTH_H)
+#define WIDTH_H
+
+//------------------------------------------------------------------------------
+// Display width of strings that are only ASCII, so the layout code can skip
+// decoding and measuring them a character at a time. Strings are checked
+// sixteen bytes at a time where SSE2 is available. Returns -1 if any of the
+// 'length' bytes is NUL or has the high bit set, otherwise the width with
+// control characters (below 0x20, and DEL) counting 'control_width' columns
+// and everything else one.
+int                     width_has_simd();
+int                     width_ascii(const char* str, int length, int control_width);
+int                     width_ascii_scalar(const char* str, int length, int control_width);
+
+#endif // WIDTH_H
+
+// vim: expandtab
@@ -83,6 +83,16 @@ static int substring_member_of_array PARAMS((const char *, const char * const *)
 
 static int currently_reading_init_file;
 
+/* begin_clink_change
+ * Hooks that let the host application observe an init file parse, so it
+ * can snapshot the result. The read hook is given each file that the parser
+ * tries to read, with a NULL buffer if the file could not be read. The
+ * variable hook is given each variable set by a `set' command.
+ */
+rl_init_file_read_hook_t *rl_init_file_read_hook = (rl_init_file_read_hook_t *)NULL;
+rl_init_file_variable_hook_t *rl_init_file_variable_hook = (rl_init_file_variable_hook_t *)NULL;
+/* end_clink_change */
+
 /* used only in this file */
 static int _rl_prefer_visible_bell = 1;
 
@@ -681,10 +691,19 @@ rl_named_function (string)
 
   rl_initialize_funmap ();
 
+/* begin_clink_change
+ * Look the name up through funmap's hash index instead of scanning it.
+ */
+#if 0
   for (i = 0; funmap[i]; i++)
     if (_rl_stricmp (funmap[i]->name, string) == 0)
       return (funmap[i]->function);
   return ((rl_command_func_t *)NULL);
+#else
+  i = _rl_find_funmap_entry (string);
+  return ((i >= 0) ? funmap[i]->function : (rl_command_func_t *)NULL);
+#endif
+/* end_clink_change */
 }
 
 /* Return the function (or macro) definition which would be invoked via
@@ -871,6 +890,12 @@ _rl_read_init_file (filename, include_level)
 
   openname = tilde_expand (filename);
   buffer = _rl_read_file (openname, &file_size);
+/* begin_clink_change
+ * Tell the host what was read, before parsing modifies the buffer.
+ */
+  if (rl_init_file_read_hook)
+    (*rl_init_file_read_hook) (openname, buffer, buffer ? file_size : 0);
+/* end_clink_change */
   xfree (openname);
 
   RL_CHECK_SIGNALS ();
@@ -1275,6 +1300,11 @@ rl_parse_and_bind (string)
 	    *e = '\0';
 	}
 
+/* begin_clink_change
+ */
+      if (rl_init_file_variable_hook)
+	(*rl_init_file_variable_hook) (var, value);
+/* end_clink_change */
       rl_variable_bind (var, value);
       return 0;
     }
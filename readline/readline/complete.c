@@ -64,6 +64,12 @@ extern int errno;
 #include "xmalloc.h"
 #include "rlprivate.h"
 
+/* begin_clink_change */
+#include "compat/casefold.h"
+#include "compat/columns.h"
+#include "compat/width.h"
+/* end_clink_change */
+
 #ifdef __STDC__
 typedef int QSFUNC (const void *, const void *);
 #else
@@ -110,8 +116,11 @@ static int get_y_or_n PARAMS((int));
 static int _rl_internal_pager PARAMS((int));
 static char *printable_part PARAMS((char *));
 static int fnwidth PARAMS((const char *));
-static int fnprint PARAMS((const char *, int));
-static int print_filename PARAMS((char *, char *, int));
+/* begin_clink_change */
+static int fnprint PARAMS((const char *, int, int));
+static int print_filename PARAMS((char *, char *, int, int));
+static void measure_matches PARAMS((char **, int, int));
+/* end_clink_change */
 
 static char **gen_completion_matches PARAMS((char *, int, int, rl_compentry_func_t *, int, int));
 
@@ -656,6 +665,14 @@ fnwidth (string)
   memset (&ps, 0, sizeof (mbstate_t));
 #endif
 
+/* begin_clink_change
+ * Strings that are all ASCII are measured without decoding them.
+ */
+  width = width_ascii (string, strlen (string), 2);
+  if (width >= 0)
+    return width;
+/* end_clink_change */
+
   width = pos = 0;
   while (string[pos])
     {
@@ -694,10 +711,15 @@ fnwidth (string)
 
 #define ELLIPSIS_LEN	3
 
+/* begin_clink_change
+ * KNOWN_WIDTH is the width this returns if the caller has already measured
+ * TO_PRINT, or -1.
+ */
 static int
-fnprint (to_print, prefix_bytes)
+fnprint (to_print, prefix_bytes, known_width)
      const char *to_print;
-     int prefix_bytes;
+     int prefix_bytes, known_width;
+/* end_clink_change */
 {
   int printed_len, w;
   const char *s;
@@ -730,6 +752,20 @@ fnprint (to_print, prefix_bytes)
     }
 
   s = to_print + prefix_bytes;
+
+/* begin_clink_change
+ * Without control characters to expand, the bytes written are the string's
+ * own so it can go out in a single write.
+ */
+  for (w = 0; s[w] && !CTRL_CHAR (s[w]) && s[w] != RUBOUT; w++)
+    ;
+  if (s[w] == '\0')
+    {
+      fwrite (s, 1, w, rl_outstream);
+      return ((known_width >= 0) ? known_width : printed_len + fnwidth (s));
+    }
+/* end_clink_change */
+
   while (*s)
     {
       if (CTRL_CHAR (*s))
@@ -787,16 +823,20 @@ fnprint (to_print, prefix_bytes)
    are using it, check for and output a single character for `special'
    filenames.  Return the number of characters we output. */
 
+/* begin_clink_change */
 static int
-print_filename (to_print, full_pathname, prefix_bytes)
+print_filename (to_print, full_pathname, prefix_bytes, known_width)
      char *to_print, *full_pathname;
-     int prefix_bytes;
+     int prefix_bytes, known_width;
+/* end_clink_change */
 {
   int printed_len, extension_char, slen, tlen;
   char *s, c, *new_full_pathname, *dn;
 
   extension_char = 0;
-  printed_len = fnprint (to_print, prefix_bytes);
+/* begin_clink_change */
+  printed_len = fnprint (to_print, prefix_bytes, known_width);
+/* end_clink_change */
 
 #if defined (VISIBLE_STATS)
  if (rl_filename_completion_desired && (rl_visible_stats || _rl_complete_mark_directories))
@@ -1183,9 +1223,16 @@ compute_lcd_of_matches (match_list, matches, text)
 	  memset (&ps2, 0, sizeof (mbstate_t));
 	}
 #endif
+/* begin_clink_change
+ * Runs of ASCII are compared in bulk. Whatever stops the run, a difference
+ * or a multibyte character, is picked up where it left off by the loops below.
+ */
+      si = casefold_prefix (match_list[i], match_list[i + 1], 100000,
+			    _rl_completion_case_fold ? CASEFOLD_CASE : 0);
+/* end_clink_change */
       if (_rl_completion_case_fold)
 	{
-	  for (si = 0;
+	  for (;
 	       (c1 = _rl_to_lower(match_list[i][si])) &&
 	       (c2 = _rl_to_lower(match_list[i + 1][si]));
 	       si++)
@@ -1208,7 +1255,7 @@ compute_lcd_of_matches (match_list, matches, text)
 	}
       else
 	{
-	  for (si = 0;
+	  for (;
 	       (c1 = match_list[i][si]) &&
 	       (c2 = match_list[i + 1][si]);
 	       si++)
@@ -1380,6 +1427,43 @@ complete_get_screenwidth ()
   return _rl_screenwidth;
 }
 
+/* begin_clink_change
+ * Display widths of the matches being listed, measured once by
+ * measure_matches() and indexed like them.  Each is the width fnprint()
+ * returns for its match.  The array only grows.  The columns they are laid
+ * out in are kept alongside.
+ */
+static int *match_widths = (int *)NULL;
+static int match_widths_size = 0;
+static columns_t match_columns;
+
+static void
+measure_matches (matches, len, prefix_bytes)
+     char **matches;
+     int len, prefix_bytes;
+{
+  char *temp;
+  int i;
+
+  if (len + 1 > match_widths_size)
+    {
+      match_widths_size = len + 1;
+      match_widths = (int *)xrealloc (match_widths, match_widths_size * sizeof (int));
+    }
+
+  match_widths[0] = -1;
+  for (i = 1; i <= len; i++)
+    {
+      temp = printable_part (matches[i]);
+      if (prefix_bytes && temp[prefix_bytes] != '\0')
+	match_widths[i] = ELLIPSIS_LEN + fnwidth (temp + prefix_bytes);
+      else
+	match_widths[i] = fnwidth (temp);
+    }
+}
+/* end_clink_change */
+
+
 /* A convenience function for displaying a list of strings in
    columnar format on readline's output stream.  MATCHES is the list
    of strings, in argv format, LEN is the number of strings in MATCHES,
@@ -1389,7 +1473,9 @@ rl_display_match_list (matches, len, max)
      char **matches;
      int len, max;
 {
-  int count, limit, printed_len, lines, cols;
+/* begin_clink_change */
+  int count, printed_len, lines, cols;
+/* end_clink_change */
   int i, j, k, l, common_length, sind;
   char *temp, *t;
 
@@ -1409,94 +1495,52 @@ rl_display_match_list (matches, len, max)
 	common_length = sind = 0;
     }
 
-  /* How many items of MAX length can we fit in the screen window? */
+/* begin_clink_change
+ * Each column is as wide as its widest match rather than all of them being
+ * as wide as the widest overall, so one long match no longer leaves the
+ * rest in a single column.  The matches are measured and the grid laid out
+ * once, then printed a row at a time with the pager between rows.  MAX is
+ * no longer needed.
+ */
   cols = complete_get_screenwidth ();
-  max += 2;
-  limit = cols / max;
-  if (limit != 1 && (limit * max == cols))
-    limit--;
-
-  /* If cols == 0, limit will end up -1 */
-  if (cols < _rl_screenwidth && limit < 0)
-    limit = 1;
-
-  /* Avoid a possible floating exception.  If max > cols,
-     limit will be 0 and a divide-by-zero fault will result. */
-  if (limit == 0)
-    limit = 1;
-
-  /* How many iterations of the printing loop? */
-  count = (len + (limit - 1)) / limit;
-
-  /* Watch out for special case.  If LEN is less than LIMIT, then
-     just do the inner printing loop.
-	   0 < len <= limit  implies  count = 1. */
 
   /* Sort the items if they are not already sorted. */
   if (rl_ignore_completion_duplicates == 0 && rl_sort_completion_matches)
     qsort (matches + 1, len, sizeof (char *), (QSFUNC *)_rl_qsort_string_compare);
 
+  measure_matches (matches, len, sind);
+  count = columns_layout (&match_columns, match_widths + 1, len, cols, 2,
+			  _rl_print_completions_horizontally);
+
   rl_crlf ();
 
   lines = 0;
-  if (_rl_print_completions_horizontally == 0)
+  for (i = 0; i < count; i++)
     {
-      /* Print the sorted items, up-and-down alphabetically, like ls. */
-      for (i = 1; i <= count; i++)
+      for (j = 0; j < match_columns.columns; j++)
 	{
-	  for (j = 0, l = i; j < limit; j++)
-	    {
-	      if (l > len || matches[l] == 0)
-		break;
-	      else
-		{
-		  temp = printable_part (matches[l]);
-		  printed_len = print_filename (temp, matches[l], sind);
+	  l = 1 + columns_index (&match_columns, i, j, _rl_print_completions_horizontally);
+	  if (l > len || matches[l] == 0)
+	    break;
 
-		  if (j + 1 < limit)
-		    for (k = 0; k < max - printed_len; k++)
-		      putc (' ', rl_outstream);
-		}
-	      l += count;
-	    }
-	  rl_crlf ();
-	  lines++;
-	  if (_rl_page_completions && lines >= (_rl_screenheight - 1) && i < count)
-	    {
-	      lines = _rl_internal_pager (lines);
-	      if (lines < 0)
-		return;
-	    }
+	  temp = printable_part (matches[l]);
+	  printed_len = print_filename (temp, matches[l], sind, match_widths[l]);
+
+	  if (j + 1 < match_columns.columns &&
+	      columns_index (&match_columns, i, j + 1, _rl_print_completions_horizontally) < len)
+	    for (k = 0; k < match_columns.widths[j] + 2 - printed_len; k++)
+	      putc (' ', rl_outstream);
 	}
-    }
-  else
-    {
-      /* Print the sorted items, across alphabetically, like ls -x. */
-      for (i = 1; matches[i]; i++)
+      rl_crlf ();
+      lines++;
+      if (_rl_page_completions && lines >= (_rl_screenheight - 1) && i + 1 < count)
 	{
-	  temp = printable_part (matches[i]);
-	  printed_len = print_filename (temp, matches[i], sind);
-	  /* Have we reached the end of this line? */
-	  if (matches[i+1])
-	    {
-	      if (i && (limit > 1) && (i % limit) == 0)
-		{
-		  rl_crlf ();
-		  lines++;
-		  if (_rl_page_completions && lines >= _rl_screenheight - 1)
-		    {
-		      lines = _rl_internal_pager (lines);
-		      if (lines < 0)
-			return;
-		    }
-		}
-	      else
-		for (k = 0; k < max - printed_len; k++)
-		  putc (' ', rl_outstream);
-	    }
+	  lines = _rl_internal_pager (lines);
+	  if (lines < 0)
+	    return;
 	}
-      rl_crlf ();
     }
+/* end_clink_change */
 }
 
 /* Display MATCHES, a list of matching filenames in argv format.  This
@@ -1525,7 +1569,9 @@ display_matches (matches)
     {
       temp = printable_part (matches[0]);
       rl_crlf ();
-      print_filename (temp, matches[0], 0);
+/* begin_clink_change */
+      print_filename (temp, matches[0], 0, -1);
+/* end_clink_change */
       rl_crlf ();
 
       rl_forced_update_display ();
@@ -2107,6 +2153,9 @@ complete_fncmp (convfn, convlen, filename, filename_len)
 {
   register char *s1, *s2;
   int d, len;
+/* begin_clink_change */
+  int same;
+/* end_clink_change */
 
   /* Otherwise, if these match up to the length of filename, then
      it is a match. */
@@ -2117,9 +2166,17 @@ complete_fncmp (convfn, convlen, filename, filename_len)
 	return 1;
       if (convlen < filename_len)
 	return 0;
-      s1 = (char *)convfn;
-      s2 = (char *)filename;
-      len = filename_len;
+/* begin_clink_change
+ * The leading run of ASCII is compared in bulk first.
+ */
+      same = casefold_prefix (convfn, filename, filename_len,
+			      CASEFOLD_CASE|CASEFOLD_MAP);
+      if (same == filename_len)
+	return 1;
+      s1 = (char *)convfn + same;
+      s2 = (char *)filename + same;
+      len = filename_len - same;
+/* end_clink_change */
       do
 	{
 	  d = _rl_to_lower (*s1) - _rl_to_lower (*s2);
@@ -2135,10 +2192,14 @@ complete_fncmp (convfn, convlen, filename, filename_len)
     }
   else if (_rl_completion_case_fold)
     {
+/* begin_clink_change
+ * casefold_compare() rather than the CRT's strnicmp().
+ */
       if ((_rl_to_lower (convfn[0]) == _rl_to_lower (filename[0])) &&
 	  (convlen >= filename_len) &&
-	  (_rl_strnicmp (filename, convfn, filename_len) == 0))
+	  (casefold_compare (filename, convfn, filename_len, CASEFOLD_CASE) == 0))
 	return 1;
+/* end_clink_change */
     }
   else
     {
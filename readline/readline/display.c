@@ -64,6 +64,10 @@
 #endif
 /* end_clink_change */
 
+/* begin_clink_change */
+#include "compat/width.h"
+/* end_clink_change */
+
 #if !defined (strchr) && !defined (__STDC__)
 extern char *strchr (), *strrchr ();
 #endif /* !strchr && !__STDC__ */
@@ -228,6 +232,63 @@ static int prompt_physical_chars;
    lines and the current line is so marked. */
 static int modmark;
 
+/* begin_clink_change
+ * Damage tracking for rl_redisplay(). The last frame's line buffer and the
+ * invisible line drawn from it are kept, along with the buffer position
+ * each wrapped screen row started at (if it started on a character
+ * boundary). If the prompt lays out the same, the next frame copies the
+ * rows before the first changed byte (or the cursor) and only draws the
+ * line from there. Rows that were copied and that are already on screen
+ * skip update_line() entirely.
+ */
+static struct {
+  int valid;
+  char *text;		/* copy of rl_line_buffer */
+  int text_len;
+  int text_size;
+  char *line;		/* copy of invisible_line, including the NUL */
+  int line_size;
+  int *lbreaks;
+  int *wrapped;
+  int *row_in;		/* buffer offset each row starts at, or -1 */
+  int *row_wmc;		/* _rl_wrapped_multicolumn at the row's start */
+  int rows_size;
+  int rows;		/* last row of the frame */
+  int prompt_out;	/* layout state once the prompt was drawn */
+  int prompt_lpos;
+  int prompt_rows;
+  int screenwidth;	/* settings the layout depends on */
+  int meta_chars;
+  int multibyte;
+  int newline_rows;
+} redisplay_cache;
+
+int rl_redisplay_cache = 1;
+
+static void
+redisplay_cache_rows (row)
+     int row;
+{
+  int n;
+
+  if (row < redisplay_cache.rows_size)
+    return;
+
+  n = (row + 64) * 2;
+  redisplay_cache.lbreaks = (int *)xrealloc (redisplay_cache.lbreaks, n * sizeof (int));
+  redisplay_cache.wrapped = (int *)xrealloc (redisplay_cache.wrapped, n * sizeof (int));
+  redisplay_cache.row_in = (int *)xrealloc (redisplay_cache.row_in, n * sizeof (int));
+  redisplay_cache.row_wmc = (int *)xrealloc (redisplay_cache.row_wmc, n * sizeof (int));
+  redisplay_cache.rows_size = n;
+}
+
+static int
+redisplay_cache_newline_rows ()
+{
+  return (_rl_horizontal_scroll_mode == 0 && _rl_term_up && *_rl_term_up);
+}
+/* end_clink_change */
+
 /* Variables to save and restore prompt and display information. */
 
 /* These are getting numerous enough that it's time to create a struct. */
@@ -514,6 +575,9 @@ rl_redisplay ()
   mbstate_t ps;
   int _rl_wrapped_multicolumn = 0;
 #endif
+/* begin_clink_change */
+  int resume_in, damage_row, checkpoint_row, prompt_out, prompt_lpos;
+/* end_clink_change */
 
   if (_rl_echoing_p == 0)
     return;
@@ -737,21 +801,114 @@ rl_redisplay ()
      It maintains an array of line breaks for display (inv_lbreaks).
      This handles expanding tabs for display and displaying meta characters. */
   lb_linenum = 0;
+
+/* begin_clink_change
+ * If the prompt laid out exactly as it did last frame then everything drawn
+ * before the first change to the line buffer (or the cursor, which has to be
+ * located) is the same too. Pick up from the last row that started before
+ * that point.
+ */
+  resume_in = 0;
+  damage_row = 0;
+  checkpoint_row = newlines;
+  prompt_out = out;
+  prompt_lpos = lpos;
+  if (rl_redisplay_cache && redisplay_cache.valid &&
+      redisplay_cache.screenwidth == _rl_screenwidth &&
+      redisplay_cache.meta_chars == _rl_output_meta_chars &&
+      redisplay_cache.multibyte == (MB_CUR_MAX > 1 && rl_byte_oriented == 0) &&
+      redisplay_cache.newline_rows == redisplay_cache_newline_rows () &&
+      redisplay_cache.prompt_out == out &&
+      redisplay_cache.prompt_lpos == lpos &&
+      redisplay_cache.prompt_rows == newlines &&
+      memcmp (redisplay_cache.line, line, out) == 0 &&
+      memcmp (redisplay_cache.lbreaks, inv_lbreaks, (newlines + 1) * sizeof (int)) == 0)
+    {
+      int damage, row;
+
+      temp = (rl_end < redisplay_cache.text_len) ? rl_end : redisplay_cache.text_len;
+      for (damage = 0; damage < temp; damage++)
+	if (rl_line_buffer[damage] != redisplay_cache.text[damage])
+	  break;
+
+      if (rl_point < damage)
+	damage = rl_point;
+
+      for (row = redisplay_cache.rows; row > newlines; row--)
+	if (redisplay_cache.row_in[row] >= 0 && redisplay_cache.row_in[row] <= damage)
+	  break;
+
+      if (row > newlines)
+	{
+	  out = redisplay_cache.lbreaks[row];
+	  memcpy (line, redisplay_cache.line, out);
+
+	  while (row >= (inv_lbsize - 2))
+	    {
+	      inv_lbsize *= 2;
+	      inv_lbreaks = (int *)xrealloc (inv_lbreaks, inv_lbsize * sizeof (int));
+	    }
+	  memcpy (inv_lbreaks, redisplay_cache.lbreaks, (row + 1) * sizeof (int));
+
+#if defined (HANDLE_MULTIBYTE)
+	  if (row >= (line_state_invisible->wbsize - 1))
+	    {
+	      while (row >= (line_state_invisible->wbsize - 1))
+		line_state_invisible->wbsize *= 2;
+	      line_state_invisible->wrapped_line = (int *)xrealloc (line_state_invisible->wrapped_line, line_state_invisible->wbsize * sizeof(int));
+	      memset (line_state_invisible->wrapped_line, 0, line_state_invisible->wbsize * sizeof (int));
+	    }
+	  memcpy (line_state_invisible->wrapped_line, redisplay_cache.wrapped, (row + 1) * sizeof (int));
+	  _rl_wrapped_multicolumn = redisplay_cache.row_wmc[row];
+#endif
+
+	  newlines = row;
+	  lpos = 0;
+	  resume_in = redisplay_cache.row_in[row];
+	  damage_row = row;
+	  checkpoint_row = row - 1;
+	}
+    }
+/* end_clink_change */
+
 #if defined (HANDLE_MULTIBYTE)
-  in = 0;
+/* begin_clink_change */
+  in = resume_in;
+/* end_clink_change */
   if (MB_CUR_MAX > 1 && rl_byte_oriented == 0)
     {
       memset (&ps, 0, sizeof (mbstate_t));
       /* XXX - what if wc_bytes ends up <= 0? check for MB_INVALIDCH */
-      wc_bytes = mbrtowc (&wc, rl_line_buffer, rl_end, &ps);
+/* begin_clink_change */
+      wc_bytes = mbrtowc (&wc, rl_line_buffer + in, rl_end - in, &ps);
+/* end_clink_change */
     }
   else
     wc_bytes = 1;
   while (in < rl_end)
 #else
-  for (in = 0; in < rl_end; in++)
+/* begin_clink_change */
+  for (in = resume_in; in < rl_end; in++)
+/* end_clink_change */
 #endif
     {
+/* begin_clink_change
+ * Note where each row starts on a character boundary, to resume from later.
+ */
+      if (lpos == 0 && newlines > checkpoint_row && inv_lbreaks[newlines] == out)
+	{
+	  redisplay_cache_rows (newlines);
+	  while (checkpoint_row < newlines - 1)
+	    redisplay_cache.row_in[++checkpoint_row] = -1;
+
+	  redisplay_cache.row_in[newlines] = in;
+#if defined (HANDLE_MULTIBYTE)
+	  redisplay_cache.row_wmc[newlines] = _rl_wrapped_multicolumn;
+#endif
+	  checkpoint_row = newlines;
+	}
+/* end_clink_change */
+
       c = (unsigned char)rl_line_buffer[in];
 
 #if defined (HANDLE_MULTIBYTE)
@@ -923,6 +1080,44 @@ rl_redisplay ()
   inv_lbreaks[newlines+1] = out;
   cursor_linenum = lb_linenum;
 
+/* begin_clink_change
+ * Keep this frame for the next one to resume from.
+ */
+  redisplay_cache_rows (newlines + 1);
+  while (checkpoint_row < newlines)
+    redisplay_cache.row_in[++checkpoint_row] = -1;
+
+  if (rl_end > redisplay_cache.text_size)
+    {
+      redisplay_cache.text_size = rl_end + 256;
+      redisplay_cache.text = (char *)xrealloc (redisplay_cache.text, redisplay_cache.text_size);
+    }
+  memcpy (redisplay_cache.text, rl_line_buffer, rl_end);
+  redisplay_cache.text_len = rl_end;
+
+  if (out + 1 > redisplay_cache.line_size)
+    {
+      redisplay_cache.line_size = line_size;
+      redisplay_cache.line = (char *)xrealloc (redisplay_cache.line, redisplay_cache.line_size);
+    }
+  memcpy (redisplay_cache.line, line, out + 1);
+
+  memcpy (redisplay_cache.lbreaks, inv_lbreaks, (newlines + 2) * sizeof (int));
+#if defined (HANDLE_MULTIBYTE)
+  memcpy (redisplay_cache.wrapped, line_state_invisible->wrapped_line, (newlines + 1) * sizeof (int));
+#endif
+
+  redisplay_cache.rows = newlines;
+  redisplay_cache.prompt_out = prompt_out;
+  redisplay_cache.prompt_lpos = prompt_lpos;
+  redisplay_cache.prompt_rows = prompt_last_screen_line;
+  redisplay_cache.screenwidth = _rl_screenwidth;
+  redisplay_cache.meta_chars = _rl_output_meta_chars;
+  redisplay_cache.multibyte = (MB_CUR_MAX > 1 && rl_byte_oriented == 0);
+  redisplay_cache.newline_rows = redisplay_cache_newline_rows ();
+  redisplay_cache.valid = 1;
+/* end_clink_change */
+
   /* CPOS_BUFFER_POSITION == position in buffer where cursor should be placed.
      CURSOR_LINENUM == line number where the cursor should be placed. */
 
@@ -979,6 +1174,20 @@ rl_redisplay ()
 	    {
 	      /* This can lead us astray if we execute a program that changes
 		 the locale from a non-multibyte to a multibyte one. */
+/* begin_clink_change
+ * Rows before the first damaged one were copied from the last frame. If
+ * they're on screen unchanged update_line() would find no difference, so
+ * there's no need to call it. Unless the cursor's waiting at the right
+ * edge of the row above, in which case update_line() will wrap it.
+ */
+	      if (linenum > 0 && linenum < damage_row &&
+		  linenum <= _rl_vis_botlin &&
+		  _rl_last_v_pos != linenum - 1 &&
+		  VIS_LLEN(linenum) == INV_LLEN(linenum) &&
+		  memcmp (VIS_CHARS(linenum), INV_LINE(linenum), INV_LLEN(linenum)) == 0)
+		continue;
+/* end_clink_change */
+
 	      o_cpos = _rl_last_c_pos;
 	      cpos_adjusted = 0;
 	      update_line (VIS_LINE(linenum), INV_LINE(linenum), linenum,
@@ -2632,6 +2841,14 @@ _rl_ttymsg ("_rl_col_width: called with MB_CUR_MAX == 1");
       return (tmp);
     }
 
+/* begin_clink_change
+ * If everything up to END is ASCII (and not NUL) then each byte is a
+ * character one column wide, which is what the loops below would find.
+ */
+  if (width_ascii (str, end, 1) >= 0)
+    return (end - start);
+/* end_clink_change */
+
   while (point < start)
     {
       tmp = mbrlen (str + point, max, &ps);
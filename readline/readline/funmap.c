@@ -37,6 +37,12 @@
 
 #include "rlconf.h"
 #include "readline.h"
+/* begin_clink_change
+ * Needed for _rl_stricmp() and the funmap index's declarations.
+ */
+#include "rldefs.h"
+#include "rlprivate.h"
+/* end_clink_change */
 
 #include "xmalloc.h"
 
@@ -197,6 +203,96 @@ static const FUNMAP default_funmap[] = {
  {(char *)NULL, (rl_command_func_t *)NULL }
 };
 
+/* begin_clink_change
+ * A case-insensitive hash index over funmap. Every binding in an inputrc file
+ * looks a function up by name, and a linear scan with _rl_stricmp() for each
+ * adds up when there are hundreds of them. The index is open-addressed, holds
+ * indices into funmap, and is kept in sync by rl_add_funmap_entry().
+ */
+static int *funmap_index;
+static int funmap_index_size;
+
+static unsigned int
+funmap_hash (name)
+     const char *name;
+{
+  unsigned int hash;
+
+  /* FNV-1a over the lower-cased name. */
+  hash = 2166136261u;
+  while (*name)
+    {
+      hash ^= (unsigned int)_rl_to_lower ((unsigned char)*name);
+      hash *= 16777619u;
+      name++;
+    }
+
+  return hash;
+}
+
+static void
+funmap_index_insert (entry)
+     int entry;
+{
+  unsigned int mask, slot;
+  int other;
+
+  mask = funmap_index_size - 1;
+  slot = funmap_hash (funmap[entry]->name) & mask;
+  while ((other = funmap_index[slot]) >= 0)
+    {
+      /* The first entry with a given name wins, as it did with a linear
+	 scan of funmap. */
+      if (_rl_stricmp ((char *)funmap[other]->name, (char *)funmap[entry]->name) == 0)
+	return;
+
+      slot = (slot + 1) & mask;
+    }
+
+  funmap_index[slot] = entry;
+}
+
+static void
+funmap_index_rebuild (size)
+     int size;
+{
+  register int i;
+
+  funmap_index_size = size;
+  funmap_index = (int *)xrealloc (funmap_index, size * sizeof (int));
+  for (i = 0; i < size; i++)
+    funmap_index[i] = -1;
+
+  for (i = 0; i < funmap_entry; i++)
+    funmap_index_insert (i);
+}
+
+/* Return the index into funmap of the function called NAME (compared
+   case-insensitively), or -1 if there isn't one. */
+int
+_rl_find_funmap_entry (name)
+     const char *name;
+{
+  unsigned int mask, slot;
+  int entry;
+
+  if (funmap_index == 0)
+    return -1;
+
+  mask = funmap_index_size - 1;
+  slot = funmap_hash (name) & mask;
+  while ((entry = funmap_index[slot]) >= 0)
+    {
+      if (_rl_stricmp ((char *)funmap[entry]->name, (char *)name) == 0)
+	return entry;
+
+      slot = (slot + 1) & mask;
+    }
+
+  return -1;
+}
+/* end_clink_change */
+
 int
 rl_add_funmap_entry (name, function)
      const char *name;
@@ -212,6 +308,15 @@ rl_add_funmap_entry (name, function)
   funmap[funmap_entry]->name = name;
   funmap[funmap_entry]->function = function;
 
+/* begin_clink_change
+ * Keep the name index at most half full.
+ */
+  if ((funmap_entry + 1) * 2 > funmap_index_size)
+    funmap_index_rebuild (funmap_index_size ? funmap_index_size * 2 : 512);
+
+  funmap_index_insert (funmap_entry);
+/* end_clink_change */
+
   funmap[++funmap_entry] = (FUNMAP *)NULL;
   return funmap_entry;
 }
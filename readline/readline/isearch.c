@@ -207,6 +207,10 @@ _rl_isearch_init (direction)
   _rl_search_cxt *cxt;
   register int i;
   HIST_ENTRY **hlist;
+/* begin_clink_change */
+  char **ranked;
+  int ranked_count;
+/* end_clink_change */
 
   cxt = _rl_scxt_alloc (RL_SEARCH_ISEARCH, 0);
   if (direction < 0)
@@ -224,9 +228,30 @@ _rl_isearch_init (direction)
 
   /* Allocate space for this many lines, +1 for the current input line,
      and remember those lines. */
-  cxt->lines = (char **)xmalloc ((1 + (cxt->hlen = i)) * sizeof (char *));
-  for (i = 0; i < cxt->hlen; i++)
-    cxt->lines[i] = hlist[i]->line;
+/* begin_clink_change
+ * When searching from the current line, search the host's ranked lines
+ * instead. They're stored worst first so a reverse search meets the best
+ * match first.
+ */
+  ranked = (char **)NULL;
+  if (rl_history_rank_hook && cxt->save_line == i)
+    ranked = (*rl_history_rank_hook) (&ranked_count);
+
+  if (ranked)
+    {
+      cxt->sflags |= SF_RANKED;
+      cxt->lines = (char **)xmalloc ((1 + (cxt->hlen = ranked_count)) * sizeof (char *));
+      for (i = 0; i < cxt->hlen; i++)
+	cxt->lines[i] = ranked[cxt->hlen - 1 - i];
+      cxt->save_line = cxt->last_found_line = cxt->hlen;
+    }
+  else
+    {
+      cxt->lines = (char **)xmalloc ((1 + (cxt->hlen = i)) * sizeof (char *));
+      for (i = 0; i < cxt->hlen; i++)
+	cxt->lines[i] = hlist[i]->line;
+    }
+/* end_clink_change */
 
   if (_rl_saved_line_for_history)
     cxt->lines[i] = _rl_saved_line_for_history->line;
@@ -276,7 +301,16 @@ _rl_isearch_fini (cxt)
   last_isearch_string_len = cxt->search_string_index;
   cxt->search_string = 0;
 
-  if (cxt->last_found_line < cxt->save_line)
+/* begin_clink_change
+ * Ranked lines aren't in history order, so take the found line as it is.
+ */
+  if (cxt->sflags & SF_RANKED)
+    {
+      if (cxt->last_found_line != cxt->save_line)
+	rl_replace_line (cxt->lines[cxt->last_found_line], 0);
+    }
+  else if (cxt->last_found_line < cxt->save_line)
+/* end_clink_change */
     rl_get_previous_history (cxt->save_line - cxt->last_found_line, 0);
   else
     rl_get_next_history (cxt->last_found_line - cxt->save_line, 0);
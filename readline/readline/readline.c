@@ -193,6 +193,12 @@ int rl_key_sequence_length = 0;
    before readline_internal_setup () prints the first prompt. */
 rl_hook_func_t *rl_startup_hook = (rl_hook_func_t *)NULL;
 
+/* begin_clink_change
+ * If non-zero, readline's one-time initialisation doesn't read the init file.
+ */
+int rl_inhibit_init_file = 0;
+/* end_clink_change */
+
 /* If non-zero, this is the address of a function to call just before
    readline_internal_setup () returns and readline_internal starts
    reading input characters. */
@@ -1075,6 +1081,12 @@ readline_initialize_everything ()
   _rl_init_eightbit ();
       
   /* Read in the init file. */
+/* begin_clink_change
+ * Clink reads (or restores a snapshot of) the init file itself once it has
+ * registered its functions, so reading it here would be wasted work.
+ */
+  if (rl_inhibit_init_file == 0)
+/* end_clink_change */
   rl_read_init_file ((char *)NULL);
 
   /* XXX */
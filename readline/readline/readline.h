@@ -555,6 +555,37 @@ extern rl_hook_func_t *rl_startup_hook;
    readline_internal_setup () returns and readline_internal starts
    reading input characters. */
 extern rl_hook_func_t *rl_pre_input_hook;
+
+/* begin_clink_change
+ * Support for hosts that snapshot the result of parsing init files.
+ */
+typedef void rl_init_file_read_hook_t PARAMS((const char *, const char *, size_t));
+typedef void rl_init_file_variable_hook_t PARAMS((const char *, const char *));
+
+/* If non-zero, readline's first initialisation skips reading the init file. */
+extern int rl_inhibit_init_file;
+
+/* Called with each file the init file parser tries to read (the buffer is
+   NULL if the file couldn't be read) and each variable it sets. */
+extern rl_init_file_read_hook_t *rl_init_file_read_hook;
+extern rl_init_file_variable_hook_t *rl_init_file_variable_hook;
+/* end_clink_change */
+
+/* begin_clink_change
+ * If zero, rl_redisplay() draws the whole line each time instead of resuming
+ * from the first row that changed. Lets the two be compared.
+ */
+extern int rl_redisplay_cache;
+/* end_clink_change */
+
+/* begin_clink_change
+ * Lets the host rank the lines history searches look through. The hook returns
+ * distinct lines best first and sets their count, or returns NULL to search
+ * the history in order. The lines must stay valid until it's next called.
+ */
+typedef char **rl_history_rank_func_t PARAMS((int *));
+extern rl_history_rank_func_t *rl_history_rank_hook;
+/* end_clink_change */
       
 /* The address of a function to call periodically while Readline is
    awaiting character input, or NULL, for no event handling. */
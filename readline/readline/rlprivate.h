@@ -57,6 +57,11 @@
 #define SF_FOUND		0x02
 #define SF_FAILED		0x04
 #define SF_CHGKMAP		0x08
+/* begin_clink_change
+ * Searching lines from rl_history_rank_hook rather than the history list.
+ */
+#define SF_RANKED		0x10
+/* end_clink_change */
 
 typedef struct  __rl_search_context
 {
@@ -246,6 +251,13 @@ extern void _rl_reset_completion_state PARAMS((void));
 extern char _rl_find_completion_word PARAMS((int *, int *));
 extern void _rl_free_match_list PARAMS((char **));
 
+/* funmap.c */
+/* begin_clink_change
+ * Hashed, case-insensitive lookup of a function name in funmap.
+ */
+extern int _rl_find_funmap_entry PARAMS((const char *));
+/* end_clink_change */
+
 /* display.c */
 extern char *_rl_strip_prompt PARAMS((char *));
 extern void _rl_move_cursor_relative PARAMS((int, const char *));
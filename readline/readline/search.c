@@ -69,6 +69,14 @@ static int rl_history_search_pos;
 static char *history_search_string;
 static int history_string_size;
 
+/* begin_clink_change
+ * Ranked lines history-search-* is walking, if the host provided them.
+ */
+rl_history_rank_func_t *rl_history_rank_hook = (rl_history_rank_func_t *)NULL;
+static char **rl_history_search_ranked;
+static int rl_history_search_ranked_count;
+/* end_clink_change */
+
 static void make_history_line_current PARAMS((HIST_ENTRY *));
 static int noninc_search_from_pos PARAMS((char *, int, int));
 static int noninc_dosearch PARAMS((char *, int));
@@ -453,10 +461,40 @@ rl_history_search_internal (count, dir)
 {
   HIST_ENTRY *temp;
   int ret, oldpos;
+/* begin_clink_change
+ * Walk the ranked lines instead, best first going backwards. They're distinct
+ * so there's no need to skip repeats.
+ */
+  HIST_ENTRY ranked;
+/* end_clink_change */
 
   rl_maybe_save_line ();
   temp = (HIST_ENTRY *)NULL;
 
+/* begin_clink_change */
+  if (rl_history_search_ranked)
+    {
+      ret = rl_history_search_pos;
+      while (count)
+	{
+	  ret -= dir;
+	  if (ret < 0 || ret >= rl_history_search_ranked_count)
+	    break;
+
+	  if (rl_history_search_len == 0 ||
+	      STREQN (history_search_string + 1, rl_history_search_ranked[ret], rl_history_search_len))
+	    {
+	      rl_history_search_pos = ret;
+	      ranked.line = rl_history_search_ranked[ret];
+	      temp = &ranked;
+	      count--;
+	    }
+	}
+
+      count = 0;
+    }
+/* end_clink_change */
+
   /* Search COUNT times through the history for a line whose prefix
      matches history_search_string.  When this loop finishes, TEMP,
      if non-null, is the history line to copy into the line buffer. */
@@ -517,6 +555,13 @@ rl_history_search_reinit ()
   rl_history_search_pos = where_history ();
   rl_history_search_len = rl_point;
   prev_line_found = (char *)NULL;
+/* begin_clink_change */
+  rl_history_search_ranked = (char **)NULL;
+  if (rl_history_rank_hook)
+    rl_history_search_ranked = (*rl_history_rank_hook) (&rl_history_search_ranked_count);
+  if (rl_history_search_ranked)
+    rl_history_search_pos = -1;
+/* end_clink_change */
   if (rl_point)
     {
       if (rl_history_search_len >= history_string_size - 2)
@@ -545,7 +590,11 @@ rl_history_search_forward (count, ignore)
       rl_last_func != rl_history_search_backward)
     rl_history_search_reinit ();
 
-  if (rl_history_search_len == 0)
+/* begin_clink_change
+ * Ranked searches rank the whole history when there's no prefix.
+ */
+  if (rl_history_search_len == 0 && rl_history_search_ranked == 0)
+/* end_clink_change */
     return (rl_get_next_history (count, ignore));
   return (rl_history_search_internal (abs (count), (count > 0) ? 1 : -1));
 }
@@ -564,7 +613,11 @@ rl_history_search_backward (count, ignore)
       rl_last_func != rl_history_search_backward)
     rl_history_search_reinit ();
 
-  if (rl_history_search_len == 0)
+/* begin_clink_change
+ * Ranked searches rank the whole history when there's no prefix.
+ */
+  if (rl_history_search_len == 0 && rl_history_search_ranked == 0)
+/* end_clink_change */
     return (rl_get_previous_history (count, ignore));
   return (rl_history_search_internal (abs (count), (count > 0) ? -1 : 1));
 }